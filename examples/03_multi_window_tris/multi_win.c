@@ -2,6 +2,7 @@
 #include "core/log.h"
 #include "core/systems.h"
 #include "graphics/opengl.h"
+#include "graphics/render_queue.h"
 #include "platform/window.h"
 #include <GLFW/glfw3.h>
 
@@ -53,6 +54,7 @@ void setup_multi_win() {
         entity_t* win_ent = create_entity();
 
         window_t* window = create_window();
+        make_context_current(window->window);
 
         extern void add_window_t_store(entity_t*, void*);
         add_window_t_store(win_ent, window);
@@ -65,6 +67,7 @@ void setup_multi_win() {
         triangle.program = create_program();
         add_shader(triangle.program, vertex_shader_source, VERTEX_SHADER);
         add_shader(triangle.program, fragment_shader_source, FRAGMENT_SHADER);
+        link_program(triangle.program);
 
         if (i % 2 != 0) {
             triangle.vertex_buffer = create_vertex_buffer(sizeof(vertices), (void*)vertices);
@@ -88,12 +91,17 @@ void render_triangle() {
     while (*ent_ptr != NULL) {
         triangle_t* triangle = get_comp(*ent_ptr, GET_ID(triangle_t));
 
-        glfwMakeContextCurrent(triangle->window->window);
-
-        glUseProgram(triangle->program);
-
-        glBindVertexArray(triangle->vertex_buffer.VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
+        draw_packet_t packet = {
+            .model = mat4_identity(),
+            .color = vec4(1.0f, 1.0f, 1.0f, 1.0f),
+            .context = triangle->window->window,
+            .program = triangle->program,
+            .vertex_array = triangle->vertex_buffer.VAO,
+            .mode = GL_TRIANGLES,
+            .count = 3,
+            .pass = RENDER_PASS_OPAQUE,
+        };
+        submit_draw(&packet);
 
         TRACE("Draw triangle.");
 
@@ -2,6 +2,7 @@
 #include "core/log.h"
 #include "core/systems.h"
 #include "graphics/opengl.h"
+#include "graphics/render_queue.h"
 #include "platform/window.h"
 #include <GLFW/glfw3.h>
 #include <stdint.h>
@@ -52,6 +53,7 @@ void setup_triangle() {
     entity_t* win_ent = create_entity();
 
     window_t* window = create_window();
+    make_context_current(window->window);
 
     extern void add_window_t_store(entity_t*, void*);
     add_window_t_store(win_ent, window);
@@ -64,6 +66,7 @@ void setup_triangle() {
     rect.program = create_program();
     add_shader(rect.program, vertex_shader_source, VERTEX_SHADER);
     add_shader(rect.program, fragment_shader_source, FRAGMENT_SHADER);
+    link_program(rect.program);
 
     rect.vertex_buffer = create_vertex_buffer(sizeof(vertices), (void*)vertices);
     add_index_buffer(&rect.vertex_buffer, sizeof(indices), (void*)indices);
@@ -82,12 +85,18 @@ void render_triangle() {
     while (*ent_ptr != NULL) {
         rect_t* rect = get_comp(*ent_ptr, GET_ID(rect_t));
 
-        glfwMakeContextCurrent(rect->window->window);
-
-        glUseProgram(rect->program);
-
-        glBindVertexArray(rect->vertex_buffer.VAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        draw_packet_t packet = {
+            .model = mat4_identity(),
+            .color = vec4(1.0f, 1.0f, 1.0f, 1.0f),
+            .context = rect->window->window,
+            .program = rect->program,
+            .vertex_array = rect->vertex_buffer.VAO,
+            .mode = GL_TRIANGLES,
+            .index_type = GL_UNSIGNED_INT,
+            .count = 6,
+            .pass = RENDER_PASS_OPAQUE,
+        };
+        submit_draw(&packet);
 
         TRACE("Draw rectangle.");
 
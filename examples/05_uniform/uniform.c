@@ -2,6 +2,7 @@
 #include "core/log.h"
 #include "core/systems.h"
 #include "graphics/opengl.h"
+#include "graphics/render_queue.h"
 #include "platform/window.h"
 #include <GLFW/glfw3.h>
 #include <stddef.h>
@@ -38,16 +39,17 @@ const char *vertex_shader_source ="#version 430 core\n"
 const char *fragment_shader_source = "#version 430 core\n"
     "out vec4 FragColor;\n"
     "in vec3 ourColor;\n"
-    "uniform vec4 newColor;\n"
+    "uniform vec4 color;\n"
     "void main()\n"
     "{\n"
-    "   FragColor = newColor * vec4(ourColor, 1.0);;\n"
+    "   FragColor = color * vec4(ourColor, 1.0);\n"
     "}\n\0";
 
 void setup_triangle() {
     entity_t* win_ent = create_entity();
 
     window_t* window = create_window();
+    make_context_current(window->window);
 
     extern void add_window_t_store(entity_t*, void*);
     add_window_t_store(win_ent, window);
@@ -60,6 +62,7 @@ void setup_triangle() {
     triangle.program = create_program();
     add_shader(triangle.program, vertex_shader_source, VERTEX_SHADER);
     add_shader(triangle.program, fragment_shader_source, FRAGMENT_SHADER);
+    link_program(triangle.program);
 
     triangle.vertex_buffer = create_vertex_buffer(sizeof(vertices), (void*)vertices);
     add_attrib(&triangle.vertex_buffer, 3, GL_FLOAT, 6 * sizeof(float), offsetof(vertex_t, pos));
@@ -77,14 +80,17 @@ void render_triangle() {
     while (*ent_ptr != NULL) {
         triangle_t* triangle = get_comp(*ent_ptr, GET_ID(triangle_t));
 
-        glfwMakeContextCurrent(triangle->window->window);
-
-        glUseProgram(triangle->program);
-
-        SET_UNIFORM(4f, triangle->program, "newColor", 0.2f, 0.2f, 0.2f, 1.0f);
-
-        glBindVertexArray(triangle->vertex_buffer.VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
+        draw_packet_t packet = {
+            .model = mat4_identity(),
+            .color = vec4(0.2f, 0.2f, 0.2f, 1.0f),
+            .context = triangle->window->window,
+            .program = triangle->program,
+            .vertex_array = triangle->vertex_buffer.VAO,
+            .mode = GL_TRIANGLES,
+            .count = 3,
+            .pass = RENDER_PASS_OPAQUE,
+        };
+        submit_draw(&packet);
 
         TRACE("Draw triangle.");
 
@@ -0,0 +1,322 @@
+#include "core/log.h"
+#include "core/systems.h"
+#include "overture/math.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// benchmarks overture/math.h against plain scalar reference code, build with optimizations on
+
+#define MATRIX_COUNT 4096
+#define POINT_COUNT (1 << 20)
+#define ITERATIONS 64
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static float random_float() {
+    return (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+/* scalar reference implementations */
+
+// keeps gcc from vectorizing the references on its own, build with -fno-vectorize on clang
+#if defined(__GNUC__) && !defined(__clang__)
+#define SCALAR __attribute__((optimize("no-tree-vectorize")))
+#else
+#define SCALAR
+#endif
+
+SCALAR static void ref_mat4_mul(float* out, const float* a, const float* b) {
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++) {
+                sum += a[k * 4 + i] * b[j * 4 + k];
+            }
+            out[j * 4 + i] = sum;
+        }
+    }
+}
+
+// gauss jordan with partial pivoting
+SCALAR static void ref_mat4_inverse(float* out, const float* in) {
+    double m[4][8];
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            m[i][j] = in[j * 4 + i];
+            m[i][j + 4] = i == j;
+        }
+    }
+
+    for (int c = 0; c < 4; c++) {
+        int pivot = c;
+        for (int r = c + 1; r < 4; r++) {
+            if (fabs(m[r][c]) > fabs(m[pivot][c])) {
+                pivot = r;
+            }
+        }
+        for (int j = 0; j < 8; j++) {
+            double tmp = m[c][j];
+            m[c][j] = m[pivot][j];
+            m[pivot][j] = tmp;
+        }
+
+        double inv = 1.0 / m[c][c];
+        for (int j = 0; j < 8; j++) {
+            m[c][j] *= inv;
+        }
+        for (int r = 0; r < 4; r++) {
+            if (r == c) {
+                continue;
+            }
+            double f = m[r][c];
+            for (int j = 0; j < 8; j++) {
+                m[r][j] -= f * m[c][j];
+            }
+        }
+    }
+
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            out[j * 4 + i] = m[i][j + 4];
+        }
+    }
+}
+
+SCALAR static void ref_transform_points(const float* m, const float* in, float* out, size_t count) {
+    for (size_t p = 0; p < count; p++) {
+        for (int i = 0; i < 3; i++) {
+            out[p * 3 + i] = m[i] * in[p * 3] + m[4 + i] * in[p * 3 + 1] + m[8 + i] * in[p * 3 + 2] + m[12 + i];
+        }
+    }
+}
+
+SCALAR static void ref_transform_points_soa(const float* m, const float* in, float* out, size_t count) {
+    for (size_t p = 0; p < count; p++) {
+        float x = in[p], y = in[count + p], z = in[2 * count + p];
+        for (int i = 0; i < 3; i++) {
+            out[i * count + p] = m[i] * x + m[4 + i] * y + m[8 + i] * z + m[12 + i];
+        }
+    }
+}
+
+SCALAR static void ref_slerp(float* out, const float* a, const float* b, float t) {
+    float cos_theta = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    float sign = 1.0f;
+    if (cos_theta < 0.0f) {
+        sign = -1.0f;
+        cos_theta = -cos_theta;
+    }
+
+    float wa = 1.0f - t, wb = t;
+    if (cos_theta <= 0.9995f) {
+        float theta = acosf(cos_theta);
+        wa = sinf((1.0f - t) * theta) / sinf(theta);
+        wb = sinf(t * theta) / sinf(theta);
+    }
+
+    float len = 0.0f;
+    for (int i = 0; i < 4; i++) {
+        out[i] = a[i] * wa + b[i] * wb * sign;
+        len += out[i] * out[i];
+    }
+    if (cos_theta > 0.9995f) {
+        for (int i = 0; i < 4; i++) {
+            out[i] /= sqrtf(len);
+        }
+    }
+}
+
+static float max_error(const float* a, const float* b, size_t count) {
+    float err = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        float e = fabsf(a[i] - b[i]) / (1.0f + fabsf(b[i]));
+        err = e > err ? e : err;
+    }
+    return err;
+}
+
+static void report(const char* name, double ref_ms, double simd_ms, float err) {
+    INFO("%-22s scalar %8.3f ms  simd %8.3f ms  speedup %5.2fx  max error %g", name, ref_ms, simd_ms, ref_ms / simd_ms, err);
+}
+
+static volatile float sink;
+
+void bench_mat4() {
+    mat4_t* a = aligned_alloc(16, MATRIX_COUNT * sizeof(mat4_t));
+    mat4_t* b = aligned_alloc(16, MATRIX_COUNT * sizeof(mat4_t));
+    mat4_t* ref = aligned_alloc(16, MATRIX_COUNT * sizeof(mat4_t));
+    mat4_t* out = aligned_alloc(16, MATRIX_COUNT * sizeof(mat4_t));
+
+    for (size_t i = 0; i < MATRIX_COUNT; i++) {
+        quat_t q = quat_normalize(quat(random_float(), random_float(), random_float(), random_float()));
+        a[i] = mat4_from_trs(vec3(random_float(), random_float(), random_float()), q, vec3(1.5f, 0.5f, 2.0f));
+        b[i] = mat4_from_trs(vec3(random_float(), random_float(), random_float()), quat_conjugate(q), vec3(1.0f, 2.0f, 1.0f));
+    }
+
+    double start = now_ms();
+    for (int it = 0; it < ITERATIONS; it++) {
+        for (size_t i = 0; i < MATRIX_COUNT; i++) {
+            ref_mat4_mul(ref[i].m, a[i].m, b[i].m);
+        }
+        sink = ref[it].m[0];
+    }
+    double ref_ms = now_ms() - start;
+
+    start = now_ms();
+    for (int it = 0; it < ITERATIONS; it++) {
+        mat4_mul_batch(out, a, b, MATRIX_COUNT);
+        sink = out[it].m[0];
+    }
+    double simd_ms = now_ms() - start;
+
+    report("mat4_mul", ref_ms, simd_ms, max_error(out->m, ref->m, MATRIX_COUNT * 16));
+
+    start = now_ms();
+    for (int it = 0; it < ITERATIONS / 8; it++) {
+        for (size_t i = 0; i < MATRIX_COUNT; i++) {
+            ref_mat4_inverse(ref[i].m, a[i].m);
+        }
+        sink = ref[it].m[0];
+    }
+    ref_ms = now_ms() - start;
+
+    start = now_ms();
+    for (int it = 0; it < ITERATIONS / 8; it++) {
+        for (size_t i = 0; i < MATRIX_COUNT; i++) {
+            out[i] = mat4_inverse(&a[i]);
+        }
+        sink = out[it].m[0];
+    }
+    simd_ms = now_ms() - start;
+
+    report("mat4_inverse", ref_ms, simd_ms, max_error(out->m, ref->m, MATRIX_COUNT * 16));
+
+    free(a);
+    free(b);
+    free(ref);
+    free(out);
+}
+
+void bench_points() {
+    mat4_t m = mat4_from_trs(vec3(1.0f, 2.0f, 3.0f), quat_from_axis_angle(vec3(0.0f, 1.0f, 0.0f), 0.7f), vec3(2.0f, 2.0f, 2.0f));
+
+    vec3_t* points = malloc(POINT_COUNT * sizeof(vec3_t));
+    vec3_t* out = malloc(POINT_COUNT * sizeof(vec3_t));
+    float* ref = malloc(POINT_COUNT * 3 * sizeof(float));
+    float* soa_in = malloc(POINT_COUNT * 3 * sizeof(float));
+    float* soa_out = malloc(POINT_COUNT * 3 * sizeof(float));
+    float* soa_ref = malloc(POINT_COUNT * 3 * sizeof(float));
+
+    for (size_t i = 0; i < POINT_COUNT; i++) {
+        points[i] = vec3(random_float(), random_float(), random_float());
+        soa_in[i] = points[i].x;
+        soa_in[POINT_COUNT + i] = points[i].y;
+        soa_in[2 * POINT_COUNT + i] = points[i].z;
+    }
+
+    double start = now_ms();
+    for (int it = 0; it < ITERATIONS / 8; it++) {
+        ref_transform_points(m.m, (const float*)points, ref, POINT_COUNT);
+        sink = ref[it];
+    }
+    double ref_ms = now_ms() - start;
+
+    start = now_ms();
+    for (int it = 0; it < ITERATIONS / 8; it++) {
+        mat4_transform_points(&m, points, out, POINT_COUNT);
+        sink = out[it].x;
+    }
+    double simd_ms = now_ms() - start;
+
+    report("transform_points", ref_ms, simd_ms, max_error((const float*)out, ref, POINT_COUNT * 3));
+
+    // against scalar code on the same layout
+    start = now_ms();
+    for (int it = 0; it < ITERATIONS / 8; it++) {
+        ref_transform_points_soa(m.m, soa_in, soa_ref, POINT_COUNT);
+        sink = soa_ref[it];
+    }
+    ref_ms = now_ms() - start;
+
+    start = now_ms();
+    for (int it = 0; it < ITERATIONS / 8; it++) {
+        mat4_transform_points_soa(&m, soa_in, soa_in + POINT_COUNT, soa_in + 2 * POINT_COUNT,
+                                  soa_out, soa_out + POINT_COUNT, soa_out + 2 * POINT_COUNT, POINT_COUNT);
+        sink = soa_out[it];
+    }
+    simd_ms = now_ms() - start;
+
+    report("transform_points_soa", ref_ms, simd_ms, max_error(soa_out, soa_ref, POINT_COUNT * 3));
+
+    free(points);
+    free(out);
+    free(ref);
+    free(soa_in);
+    free(soa_out);
+    free(soa_ref);
+}
+
+void bench_slerp() {
+    quat_t* a = aligned_alloc(16, MATRIX_COUNT * sizeof(quat_t));
+    quat_t* b = aligned_alloc(16, MATRIX_COUNT * sizeof(quat_t));
+    quat_t* out = aligned_alloc(16, MATRIX_COUNT * sizeof(quat_t));
+    float* ref = malloc(MATRIX_COUNT * 4 * sizeof(float));
+
+    for (size_t i = 0; i < MATRIX_COUNT; i++) {
+        a[i] = quat_normalize(quat(random_float(), random_float(), random_float(), random_float()));
+        b[i] = quat_normalize(quat(random_float(), random_float(), random_float(), random_float()));
+    }
+
+    double start = now_ms();
+    for (int it = 0; it < ITERATIONS; it++) {
+        for (size_t i = 0; i < MATRIX_COUNT; i++) {
+            ref_slerp(&ref[i * 4], a[i].v, b[i].v, 0.3f);
+        }
+        sink = ref[it];
+    }
+    double ref_ms = now_ms() - start;
+
+    start = now_ms();
+    for (int it = 0; it < ITERATIONS; it++) {
+        for (size_t i = 0; i < MATRIX_COUNT; i++) {
+            out[i] = quat_slerp(a[i], b[i], 0.3f);
+        }
+        sink = out[it].x;
+    }
+    double simd_ms = now_ms() - start;
+
+    report("quat_slerp", ref_ms, simd_ms, max_error(out->v, ref, MATRIX_COUNT * 4));
+
+    free(a);
+    free(b);
+    free(out);
+    free(ref);
+}
+
+extern int should_exit;
+
+void run_math_bench() {
+    srand(1234);
+
+#if defined(OVERTURE_MATH_SSE)
+    INFO("Math backend: SSE.");
+#elif defined(OVERTURE_MATH_NEON)
+    INFO("Math backend: NEON.");
+#else
+    INFO("Math backend: scalar.");
+#endif
+
+    bench_mat4();
+    bench_points();
+    bench_slerp();
+
+    should_exit = 1;
+}
+
+REGISTER_SYSTEM(run_math_bench, SETUP);
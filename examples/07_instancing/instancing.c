@@ -0,0 +1,159 @@
+#include "core/ecs.h"
+#include "core/log.h"
+#include "core/systems.h"
+#include "core/transform.h"
+#include "graphics/opengl.h"
+#include "graphics/render_queue.h"
+#include "platform/window.h"
+#include <GLFW/glfw3.h>
+#include <stddef.h>
+
+// a grid of triangles that share one program and vertex buffer, the render queue draws them with a single instanced call
+
+#define GRID_SIZE 64
+
+typedef struct {
+    window_t* window;
+    program_t program;
+    vertex_buffer_t vertex_buffer;
+} shape_t;
+
+REGISTER_COMPONENT(shape_t);
+
+typedef struct {
+    float pos[3];
+} vertex_t;
+
+const vertex_t vertices[] = {
+    {{0.0f,  0.5f, 0.0f}},
+    {{0.5f, -0.5f, 0.0f}},
+    {{-0.5f,-0.5f, 0.0f}}
+};
+
+const char *vertex_shader_source ="#version 430 core\n"
+    "layout (location = 0) in vec3 aPos;\n"
+    "struct instance_t { mat4 model; vec4 color; };\n"
+    "layout (std430) readonly buffer instance_data { instance_t instances[]; };\n"
+    "uniform uint instance_base;\n"
+    "out vec4 ourColor;\n"
+    "void main()\n"
+    "{\n"
+    "   instance_t instance = instances[instance_base + gl_InstanceID];\n"
+    "   gl_Position = instance.model * vec4(aPos, 1.0);\n"
+    "   ourColor = instance.color;\n"
+    "}\0";
+
+const char *fragment_shader_source = "#version 430 core\n"
+    "out vec4 FragColor;\n"
+    "in vec4 ourColor;\n"
+    "void main()\n"
+    "{\n"
+    "   FragColor = ourColor;\n"
+    "}\n\0";
+
+static transform_t root;
+static shape_t grid_shape;
+
+void setup_instancing() {
+    entity_t* win_ent = create_entity();
+
+    window_t* window = create_window();
+    make_context_current(window->window);
+
+    extern void add_window_t_store(entity_t*, void*);
+    add_window_t_store(win_ent, window);
+
+    grid_shape.window = get_comp(win_ent, GET_ID(window_t));
+
+    grid_shape.program = create_program();
+    add_shader(grid_shape.program, vertex_shader_source, VERTEX_SHADER);
+    add_shader(grid_shape.program, fragment_shader_source, FRAGMENT_SHADER);
+    link_program(grid_shape.program);
+
+    grid_shape.vertex_buffer = create_vertex_buffer(sizeof(vertices), (void*)vertices);
+    add_attrib(&grid_shape.vertex_buffer, 3, GL_FLOAT, sizeof(vertex_t), offsetof(vertex_t, pos));
+
+    extern void add_transform_t_cpy(entity_t*, void*);
+
+    root = create_transform(TRANSFORM_NONE);
+
+    float step = 2.0f / GRID_SIZE;
+    for (uint32_t y = 0; y < GRID_SIZE; y++) {
+        for (uint32_t x = 0; x < GRID_SIZE; x++) {
+            entity_t* ent = create_entity();
+
+            transform_t transform = create_transform(root);
+            set_transform_position(transform, -1.0f + step * (x + 0.5f), -1.0f + step * (y + 0.5f), 0.0f);
+            set_transform_scale(transform, step, step, 1.0f);
+
+            add_transform_t_cpy(ent, &transform);
+            add_shape_t_cpy(ent, &grid_shape);
+        }
+    }
+}
+
+REGISTER_SYSTEM(setup_instancing, SETUP);
+
+void spin_grid() {
+    float angle = (float)glfwGetTime() * 0.25f;
+    quat_t rotation = quat_from_axis_angle(vec3(0.0f, 0.0f, 1.0f), angle);
+    set_transform_rotation(root, rotation.x, rotation.y, rotation.z, rotation.w);
+}
+
+REGISTER_SYSTEM(spin_grid, UPDATE);
+
+void render_shapes() {
+    entity_t** list = FILTER_ENTITIES(transform_t, shape_t);
+
+    entity_t** ent_ptr = list;
+    while (*ent_ptr != NULL) {
+        transform_t* transform = get_comp(*ent_ptr, GET_ID(transform_t));
+        shape_t* shape = get_comp(*ent_ptr, GET_ID(shape_t));
+
+        const mat4_t* world = get_transform_world(*transform);
+
+        draw_packet_t packet = {
+            .model = *world,
+            .color = vec4(world->m[12] * 0.5f + 0.5f, world->m[13] * 0.5f + 0.5f, 0.5f, 1.0f),
+            .context = shape->window->window,
+            .program = shape->program,
+            .vertex_array = shape->vertex_buffer.VAO,
+            .mode = GL_TRIANGLES,
+            .count = 3,
+            .pass = RENDER_PASS_OPAQUE,
+        };
+        submit_draw(&packet);
+
+        ent_ptr++;
+    }
+
+    free(list);
+}
+
+REGISTER_SYSTEM(render_shapes, RENDER);
+
+extern int should_exit;
+
+void update() {
+    entity_t** list = FILTER_ENTITIES(window_t);
+
+    entity_t** ent_ptr = list;
+    while (*ent_ptr != NULL) {
+        window_t* window = get_comp(*ent_ptr, GET_ID(window_t));
+        if (should_window_close(window)) {
+            should_exit = 1;
+        }
+        ent_ptr++;
+    }
+
+    free(list);
+}
+
+REGISTER_SYSTEM(update, UPDATE);
+
+void cleanup_instancing() {
+    destroy_vertex_buffer(&grid_shape.vertex_buffer);
+    destroy_program(grid_shape.program);
+}
+
+REGISTER_SYSTEM(cleanup_instancing, CLEANUP);
@@ -0,0 +1,189 @@
+#include "core/camera.h"
+#include "core/culling.h"
+#include "core/ecs.h"
+#include "core/log.h"
+#include "core/systems.h"
+#include "core/transform.h"
+#include "graphics/mesh_pool.h"
+#include "graphics/opengl.h"
+#include "graphics/render_queue.h"
+#include "platform/window.h"
+#include <GLFW/glfw3.h>
+#include <math.h>
+#include <stddef.h>
+
+// different meshes from one mesh pool, every frame is a single glMultiDrawElementsIndirect
+// shapes spinning out of the window are culled
+
+#define GRID_SIZE 48
+#define NUM_OF_SHAPES 3
+
+typedef struct {
+    window_t* window;
+    program_t program;
+    mesh_t mesh;
+} shape_t;
+
+REGISTER_COMPONENT(shape_t);
+
+typedef struct {
+    float pos[2];
+} vertex_t;
+
+const char *vertex_shader_source ="#version 430 core\n"
+    "layout (location = 0) in vec2 aPos;\n"
+    "layout (location = 15) in uint instance_id;\n"
+    "struct instance_t { mat4 model; vec4 color; };\n"
+    "layout (std430) readonly buffer instance_data { instance_t instances[]; };\n"
+    "out vec4 ourColor;\n"
+    "void main()\n"
+    "{\n"
+    "   instance_t instance = instances[instance_id];\n"
+    "   gl_Position = instance.model * vec4(aPos, 0.0, 1.0);\n"
+    "   ourColor = instance.color;\n"
+    "}\0";
+
+const char *fragment_shader_source = "#version 430 core\n"
+    "out vec4 FragColor;\n"
+    "in vec4 ourColor;\n"
+    "void main()\n"
+    "{\n"
+    "   FragColor = ourColor;\n"
+    "}\n\0";
+
+static mesh_pool_t pool;
+static program_t program;
+static transform_t root;
+
+// regular polygon as a triangle fan
+static mesh_t add_polygon(uint32_t sides) {
+    vertex_t vertices[16];
+    uint32_t indices[3 * 16];
+
+    vertices[0] = (vertex_t){{0.0f, 0.0f}};
+    for (uint32_t i = 0; i < sides; i++) {
+        float angle = 6.2831853f * i / sides;
+        vertices[i + 1] = (vertex_t){{0.5f * sinf(angle), 0.5f * cosf(angle)}};
+
+        indices[i * 3] = 0;
+        indices[i * 3 + 1] = i + 1;
+        indices[i * 3 + 2] = (i + 1) % sides + 1;
+    }
+
+    return add_mesh(&pool, vertices, sides + 1, indices, sides * 3);
+}
+
+void setup_multi_draw() {
+    entity_t* win_ent = create_entity();
+
+    window_t* window = create_window();
+    make_context_current(window->window);
+
+    extern void add_window_t_store(entity_t*, void*);
+    add_window_t_store(win_ent, window);
+    window = get_comp(win_ent, GET_ID(window_t));
+
+    program = create_program();
+    add_shader(program, vertex_shader_source, VERTEX_SHADER);
+    add_shader(program, fragment_shader_source, FRAGMENT_SHADER);
+    link_program(program);
+
+    pool = create_mesh_pool(sizeof(vertex_t), 0, 0);
+    add_mesh_pool_attrib(&pool, 2, GL_FLOAT, offsetof(vertex_t, pos));
+
+    mesh_t meshes[NUM_OF_SHAPES] = { add_polygon(3), add_polygon(4), add_polygon(6) };
+
+    extern void add_transform_t_cpy(entity_t*, void*);
+    extern void add_bounds_t_cpy(entity_t*, void*);
+    extern void add_camera_t_cpy(entity_t*, void*);
+
+    // matches clip space, the shapes are drawn without a view projection
+    entity_t* cam_ent = create_entity();
+    camera_t camera = ortho_camera(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f);
+    add_camera_t_cpy(cam_ent, &camera);
+
+    bounds_t bounds = sphere_bounds(vec3(0.0f, 0.0f, 0.0f), 0.5f);
+
+    root = create_transform(TRANSFORM_NONE);
+
+    float step = 2.0f / GRID_SIZE;
+    for (uint32_t y = 0; y < GRID_SIZE; y++) {
+        for (uint32_t x = 0; x < GRID_SIZE; x++) {
+            entity_t* ent = create_entity();
+
+            transform_t transform = create_transform(root);
+            set_transform_position(transform, -1.0f + step * (x + 0.5f), -1.0f + step * (y + 0.5f), 0.0f);
+            set_transform_scale(transform, step, step, 1.0f);
+
+            shape_t shape = {
+                .window = window,
+                .program = program,
+                .mesh = meshes[(x + y) % NUM_OF_SHAPES],
+            };
+
+            add_transform_t_cpy(ent, &transform);
+            add_bounds_t_cpy(ent, &bounds);
+            add_shape_t_cpy(ent, &shape);
+        }
+    }
+}
+
+REGISTER_SYSTEM(setup_multi_draw, SETUP);
+
+void spin_grid() {
+    quat_t rotation = quat_from_axis_angle(vec3(0.0f, 0.0f, 1.0f), (float)glfwGetTime() * 0.25f);
+    set_transform_rotation(root, rotation.x, rotation.y, rotation.z, rotation.w);
+}
+
+REGISTER_SYSTEM(spin_grid, UPDATE);
+
+void render_shapes() {
+    entity_t** ent_ptr = get_visible_entities(NULL);
+    while (*ent_ptr != NULL) {
+        transform_t* transform = get_comp(*ent_ptr, GET_ID(transform_t));
+        shape_t* shape = get_comp(*ent_ptr, GET_ID(shape_t));
+
+        const mat4_t* world = get_transform_world(*transform);
+
+        draw_packet_t packet = {
+            .model = *world,
+            .color = vec4(world->m[12] * 0.5f + 0.5f, 0.5f, world->m[13] * 0.5f + 0.5f, 1.0f),
+            .context = shape->window->window,
+            .program = shape->program,
+            .mode = GL_TRIANGLES,
+            .pass = RENDER_PASS_OPAQUE,
+        };
+        set_packet_mesh(&packet, shape->mesh);
+        submit_draw(&packet);
+
+        ent_ptr++;
+    }
+}
+
+REGISTER_SYSTEM(render_shapes, RENDER);
+
+extern int should_exit;
+
+void update() {
+    entity_t** list = FILTER_ENTITIES(window_t);
+
+    entity_t** ent_ptr = list;
+    while (*ent_ptr != NULL) {
+        window_t* window = get_comp(*ent_ptr, GET_ID(window_t));
+        if (should_window_close(window)) {
+            should_exit = 1;
+        }
+        ent_ptr++;
+    }
+
+    free(list);
+}
+
+REGISTER_SYSTEM(update, UPDATE);
+
+void cleanup_multi_draw() {
+    destroy_mesh_pool(&pool);
+    destroy_program(program);
+}
+
+REGISTER_SYSTEM(cleanup_multi_draw, CLEANUP);
@@ -0,0 +1,148 @@
+#include "core/ecs.h"
+#include "core/log.h"
+#include "core/systems.h"
+#include "graphics/opengl.h"
+#include "graphics/render_queue.h"
+#include "graphics/stream_buffer.h"
+#include "platform/window.h"
+#include <GLFW/glfw3.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+// particles rewritten every frame, the vertices are memcpy'd into a stream buffer instead of reuploaded
+
+#define PARTICLE_COUNT 20000
+
+typedef struct {
+    float pos[2];
+    float color[3];
+} vertex_t;
+
+typedef struct {
+    float pos[2];
+    float vel[2];
+} particle_t;
+
+const char *vertex_shader_source ="#version 430 core\n"
+    "layout (location = 0) in vec2 aPos;\n"
+    "layout (location = 1) in vec3 aColor;\n"
+    "out vec3 ourColor;\n"
+    "void main()\n"
+    "{\n"
+    "   gl_Position = vec4(aPos, 0.0, 1.0);\n"
+    "   ourColor = aColor;\n"
+    "}\0";
+
+const char *fragment_shader_source = "#version 430 core\n"
+    "out vec4 FragColor;\n"
+    "in vec3 ourColor;\n"
+    "void main()\n"
+    "{\n"
+    "   FragColor = vec4(ourColor, 1.0f);\n"
+    "}\n\0";
+
+static window_t* window;
+static program_t program;
+static stream_buffer_t* stream;
+static vertex_buffer_t vertex_buffer;
+static particle_t particles[PARTICLE_COUNT];
+
+static float random_float() {
+    return (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+void setup_streaming() {
+    entity_t* win_ent = create_entity();
+
+    extern void add_window_t_store(entity_t*, void*);
+    add_window_t_store(win_ent, create_window());
+    window = get_comp(win_ent, GET_ID(window_t));
+    make_context_current(window->window);
+
+    program = create_program();
+    add_shader(program, vertex_shader_source, VERTEX_SHADER);
+    add_shader(program, fragment_shader_source, FRAGMENT_SHADER);
+    link_program(program);
+
+    // a region size that is a multiple of the stride keeps every allocation on a vertex boundary
+    stream = create_stream_buffer(PARTICLE_COUNT * sizeof(vertex_t));
+
+    glGenVertexArrays(1, &vertex_buffer.VAO);
+    vertex_buffer.VBO = stream->buffer;
+    vertex_buffer.EBO = 0;
+    vertex_buffer.attrib_count = 0;
+    add_attrib(&vertex_buffer, 2, GL_FLOAT, sizeof(vertex_t), offsetof(vertex_t, pos));
+    add_attrib(&vertex_buffer, 3, GL_FLOAT, sizeof(vertex_t), offsetof(vertex_t, color));
+
+    for (uint32_t i = 0; i < PARTICLE_COUNT; i++) {
+        particles[i].pos[0] = random_float();
+        particles[i].pos[1] = random_float();
+        particles[i].vel[0] = random_float() * 0.01f;
+        particles[i].vel[1] = random_float() * 0.01f;
+    }
+}
+
+REGISTER_SYSTEM(setup_streaming, SETUP);
+
+void move_particles() {
+    for (uint32_t i = 0; i < PARTICLE_COUNT; i++) {
+        for (uint32_t j = 0; j < 2; j++) {
+            particles[i].pos[j] += particles[i].vel[j];
+            if (particles[i].pos[j] < -1.0f || particles[i].pos[j] > 1.0f) {
+                particles[i].vel[j] = -particles[i].vel[j];
+            }
+        }
+    }
+}
+
+REGISTER_SYSTEM(move_particles, UPDATE);
+
+// allocating from a stream is lock free, so this can run on a render system thread
+void render_particles() {
+    stream_alloc_t alloc = stream_buffer_alloc(stream, PARTICLE_COUNT * sizeof(vertex_t), sizeof(vertex_t));
+    if (alloc.data == NULL) {
+        return;
+    }
+
+    vertex_t* vertices = alloc.data;
+    for (uint32_t i = 0; i < PARTICLE_COUNT; i++) {
+        vertices[i].pos[0] = particles[i].pos[0];
+        vertices[i].pos[1] = particles[i].pos[1];
+        vertices[i].color[0] = particles[i].pos[0] * 0.5f + 0.5f;
+        vertices[i].color[1] = particles[i].pos[1] * 0.5f + 0.5f;
+        vertices[i].color[2] = 1.0f;
+    }
+
+    draw_packet_t packet = {
+        .model = mat4_identity(),
+        .color = vec4(1.0f, 1.0f, 1.0f, 1.0f),
+        .context = window->window,
+        .program = program,
+        .vertex_array = vertex_buffer.VAO,
+        .mode = GL_POINTS,
+        .first = alloc.offset / sizeof(vertex_t),
+        .count = PARTICLE_COUNT,
+        .pass = RENDER_PASS_OPAQUE,
+    };
+    submit_draw(&packet);
+}
+
+REGISTER_SYSTEM(render_particles, RENDER);
+
+extern int should_exit;
+
+void update() {
+    if (should_window_close(window)) {
+        should_exit = 1;
+    }
+}
+
+REGISTER_SYSTEM(update, UPDATE);
+
+void cleanup_streaming() {
+    glDeleteVertexArrays(1, &vertex_buffer.VAO);
+    destroy_stream_buffer(stream);
+    destroy_program(program);
+}
+
+REGISTER_SYSTEM(cleanup_streaming, CLEANUP);
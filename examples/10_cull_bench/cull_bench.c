@@ -0,0 +1,295 @@
+#include "core/bvh.h"
+#include "core/camera.h"
+#include "core/culling.h"
+#include "core/ecs.h"
+#include "core/log.h"
+#include "core/systems.h"
+#include "core/transform.h"
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+// benchmarks frustum culling and the spatial index against plain per box loops and checks they agree, runs headless
+
+#define BOX_COUNT (1 << 20)
+#define ENTITY_COUNT 32768
+#define ITERATIONS 32
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static float random_float() {
+    return (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+static frustum_t make_frustum() {
+    camera_t camera = perspective_camera(1.0f, 16.0f / 9.0f, 0.1f, 150.0f);
+    set_camera_look_at(&camera, vec3(0.0f, 0.0f, 0.0f), vec3(0.3f, 0.1f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
+    mat4_t view_projection = get_camera_view_projection(&camera);
+    return frustum_from_matrix(&view_projection);
+}
+
+void bench_boxes() {
+    float* soa = malloc(BOX_COUNT * 6 * sizeof(float));
+    float *cx = soa, *cy = cx + BOX_COUNT, *cz = cy + BOX_COUNT;
+    float *ex = cz + BOX_COUNT, *ey = ex + BOX_COUNT, *ez = ey + BOX_COUNT;
+    uint32_t* visible = malloc(BOX_COUNT * sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < BOX_COUNT; i++) {
+        cx[i] = random_float() * 200.0f;
+        cy[i] = random_float() * 200.0f;
+        cz[i] = random_float() * 200.0f;
+        ex[i] = ey[i] = ez[i] = 0.5f + (random_float() + 1.0f);
+    }
+
+    frustum_t frustum = make_frustum();
+
+    uint32_t ref_count = 0;
+    double start = now_ms();
+    for (int it = 0; it < ITERATIONS; it++) {
+        ref_count = 0;
+        for (uint32_t i = 0; i < BOX_COUNT; i++) {
+            ref_count += frustum_test_aabb(&frustum, vec3(cx[i], cy[i], cz[i]), vec3(ex[i], ey[i], ez[i]));
+        }
+    }
+    double ref_ms = (now_ms() - start) / ITERATIONS;
+
+    uint32_t count = 0;
+    start = now_ms();
+    for (int it = 0; it < ITERATIONS; it++) {
+        count = frustum_cull_aabbs(&frustum, cx, cy, cz, ex, ey, ez, BOX_COUNT, visible);
+    }
+    double simd_ms = (now_ms() - start) / ITERATIONS;
+
+    INFO("frustum_cull_aabbs: %d boxes, scalar %.3f ms, simd %.3f ms, speedup %.2fx, visible %d / %d.",
+         BOX_COUNT, ref_ms, simd_ms, ref_ms / simd_ms, count, ref_count);
+    if (count != ref_count) {
+        ERROR("Simd and scalar culling disagree.");
+    }
+
+    free(soa);
+    free(visible);
+}
+
+void bench_entities() {
+    extern void add_transform_t_cpy(entity_t*, void*);
+    extern void add_bounds_t_cpy(entity_t*, void*);
+    extern void add_camera_t_cpy(entity_t*, void*);
+
+    for (uint32_t i = 0; i < ENTITY_COUNT; i++) {
+        entity_t* ent = create_entity();
+
+        transform_t transform = create_transform(TRANSFORM_NONE);
+        set_transform_position(transform, random_float() * 200.0f, random_float() * 200.0f, random_float() * 200.0f);
+        quat_t q = quat_normalize(quat(random_float(), random_float(), random_float(), random_float()));
+        set_transform_rotation(transform, q.x, q.y, q.z, q.w);
+
+        bounds_t bounds = aabb_bounds(vec3(-1.0f, -0.5f, -2.0f), vec3(1.0f, 0.5f, 2.0f));
+
+        add_transform_t_cpy(ent, &transform);
+        add_bounds_t_cpy(ent, &bounds);
+    }
+
+    entity_t* cam_ent = create_entity();
+    camera_t camera = perspective_camera(1.0f, 16.0f / 9.0f, 0.1f, 150.0f);
+    set_camera_look_at(&camera, vec3(0.0f, 0.0f, 0.0f), vec3(0.3f, 0.1f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
+    add_camera_t_cpy(cam_ent, &camera);
+
+    update_transforms();
+
+    double start = now_ms();
+    for (int it = 0; it < ITERATIONS; it++) {
+        cull_entities();
+    }
+    double ms = (now_ms() - start) / ITERATIONS;
+
+    uint32_t count = 0;
+    entity_t** visible = get_visible_entities(&count);
+
+    // reference, world box of every entity tested one by one
+    frustum_t frustum = make_frustum();
+    entity_t** list = FILTER_ENTITIES(transform_t, bounds_t);
+    uint32_t ref_count = 0;
+    uint32_t v = 0;
+    int mismatch = 0;
+    for (entity_t** ent_ptr = list; *ent_ptr != NULL; ent_ptr++) {
+        transform_t* transform = (*ent_ptr)->components[GET_ID(transform_t) - 1];
+        bounds_t* bounds = (*ent_ptr)->components[GET_ID(bounds_t) - 1];
+        const mat4_t* m = get_transform_world(*transform);
+
+        vec3_t corners_min = vec3(1e30f, 1e30f, 1e30f);
+        vec3_t corners_max = vec3(-1e30f, -1e30f, -1e30f);
+        for (int c = 0; c < 8; c++) {
+            vec3_t corner = vec3(bounds->center.x + (c & 1 ? bounds->extents.x : -bounds->extents.x),
+                                 bounds->center.y + (c & 2 ? bounds->extents.y : -bounds->extents.y),
+                                 bounds->center.z + (c & 4 ? bounds->extents.z : -bounds->extents.z));
+            corner = mat4_mul_point(m, corner);
+            corners_min = vec3_min(corners_min, corner);
+            corners_max = vec3_max(corners_max, corner);
+        }
+
+        bounds_t world = aabb_bounds(corners_min, corners_max);
+        if (frustum_test_aabb(&frustum, world.center, world.extents)) {
+            ref_count++;
+            mismatch |= v >= count || visible[v++] != *ent_ptr;
+        }
+    }
+    free(list);
+
+    INFO("cull_entities: %d entities, %.3f ms per cull, visible %d / %d.", ENTITY_COUNT, ms, count, ref_count);
+    if (mismatch || count != ref_count) {
+        ERROR("Visible list does not match the reference.");
+    }
+}
+
+static int contains_entity(entity_t** list, entity_t* ent) {
+    for (; *list != NULL; list++) {
+        if (*list == ent) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static bounds_t world_bounds(entity_t* ent) {
+    transform_t* transform = ent->components[GET_ID(transform_t) - 1];
+    bounds_t* bounds = ent->components[GET_ID(bounds_t) - 1];
+    bounds_t world = *bounds;
+    transform_bounds(bounds, get_transform_world(*transform), &world.center, &world.extents);
+    return world;
+}
+
+// the index is built from the entities bench_entities made, then a quarter of them move
+void bench_bvh() {
+    double start = now_ms();
+    update_spatial_index();
+    double build_ms = now_ms() - start;
+
+    const bvh_t* index = get_spatial_index();
+    INFO("update_spatial_index: batch insert of %d entities in %.3f ms, %d nodes.", index->leaf_count, build_ms, index->node_count);
+
+    entity_t** list = FILTER_ENTITIES(transform_t, bounds_t);
+    uint32_t moved = 0;
+    for (entity_t** ent_ptr = list; *ent_ptr != NULL; ent_ptr++) {
+        if (rand() % 4 == 0) {
+            transform_t* transform = (*ent_ptr)->components[GET_ID(transform_t) - 1];
+            set_transform_position(*transform, random_float() * 200.0f, random_float() * 200.0f, random_float() * 200.0f);
+            moved++;
+        }
+    }
+
+    update_transforms();
+
+    start = now_ms();
+    update_spatial_index();
+    double move_ms = now_ms() - start;
+    INFO("update_spatial_index: %d moved entities refitted in %.3f ms.", moved, move_ms);
+
+    // the index returns fattened candidates, every exact hit has to be among them
+    frustum_t frustum = make_frustum();
+    vec3_t center = vec3(10.0f, -5.0f, -40.0f);
+    float radius = 25.0f;
+
+    entity_t** in_frustum = NULL;
+    entity_t** in_sphere = NULL;
+    start = now_ms();
+    for (int it = 0; it < ITERATIONS; it++) {
+        free(in_frustum);
+        free(in_sphere);
+        in_frustum = query_entities_frustum(&frustum);
+        in_sphere = query_entities_sphere(center, radius);
+    }
+    double query_ms = (now_ms() - start) / ITERATIONS;
+
+    uint32_t frustum_count = 0, sphere_count = 0;
+    uint32_t ref_frustum = 0, ref_sphere = 0;
+    int missing = 0;
+    for (entity_t** ent_ptr = in_frustum; *ent_ptr != NULL; ent_ptr++) {
+        frustum_count++;
+    }
+    for (entity_t** ent_ptr = in_sphere; *ent_ptr != NULL; ent_ptr++) {
+        sphere_count++;
+    }
+
+    start = now_ms();
+    for (entity_t** ent_ptr = list; *ent_ptr != NULL; ent_ptr++) {
+        bounds_t world = world_bounds(*ent_ptr);
+        if (frustum_test_aabb(&frustum, world.center, world.extents)) {
+            ref_frustum++;
+            missing |= !contains_entity(in_frustum, *ent_ptr);
+        }
+
+        vec3_t closest = vec3_max(vec3_sub(world.center, world.extents), vec3_min(center, vec3_add(world.center, world.extents)));
+        vec3_t d = vec3_sub(closest, center);
+        if (vec3_dot(d, d) <= radius * radius) {
+            ref_sphere++;
+            missing |= !contains_entity(in_sphere, *ent_ptr);
+        }
+    }
+
+    INFO("bvh queries: %.3f ms for a frustum and a sphere, frustum %d candidates for %d hits, sphere %d candidates for %d hits.",
+         query_ms, frustum_count, ref_frustum, sphere_count, ref_sphere);
+
+    // a ray down the view direction has to stop at the closest box it passes through
+    vec3_t origin = vec3(0.0f, 0.0f, 0.0f);
+    vec3_t dir = vec3_normalize(vec3(0.3f, 0.1f, -1.0f));
+    float distance = 0.0f;
+    entity_t* hit = raycast_entities(origin, dir, 1000.0f, &distance);
+
+    float ref_distance = 1000.0f;
+    entity_t* ref_hit = NULL;
+    for (entity_t** ent_ptr = list; *ent_ptr != NULL; ent_ptr++) {
+        bounds_t world = world_bounds(*ent_ptr);
+        float t_min = 0.0f, t_max = ref_distance;
+        for (int a = 0; a < 3 && t_min <= t_max; a++) {
+            float t0 = (world.center.v[a] - world.extents.v[a] - origin.v[a]) / dir.v[a];
+            float t1 = (world.center.v[a] + world.extents.v[a] - origin.v[a]) / dir.v[a];
+            t_min = fmaxf(t_min, fminf(t0, t1));
+            t_max = fminf(t_max, fmaxf(t0, t1));
+        }
+        if (t_min <= t_max) {
+            ref_distance = t_min;
+            ref_hit = *ent_ptr;
+        }
+    }
+
+    INFO("raycast_entities: hit at %.3f, reference %.3f.", hit ? distance : -1.0f, ref_hit ? ref_distance : -1.0f);
+
+    if (missing || hit != ref_hit) {
+        ERROR("Spatial index queries do not match the reference.");
+    }
+
+    // removing entities has to take them out of the index through the component hooks
+    uint32_t leaves = index->leaf_count;
+    uint32_t removed = 0;
+    for (uint32_t i = 0; list[i] != NULL; i++) {
+        if (i % 7 == 0) {
+            remove_ent(list[i]->id);
+            removed++;
+        }
+    }
+    if (index->leaf_count != leaves - removed) {
+        ERROR("Spatial index has %d entities after removing %d of %d.", index->leaf_count, removed, leaves);
+    }
+
+    free(in_frustum);
+    free(in_sphere);
+    free(list);
+}
+
+extern int should_exit;
+
+void run_cull_bench() {
+    srand(1234);
+
+    bench_boxes();
+    bench_entities();
+    bench_bvh();
+
+    should_exit = 1;
+}
+
+REGISTER_SYSTEM(run_cull_bench, SETUP);
@@ -0,0 +1,156 @@
+#include "core/camera.h"
+#include "core/ecs.h"
+#include "core/log.h"
+#include "core/systems.h"
+#include "core/transform.h"
+#include "graphics/light_clusters.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// benchmarks clustered light assignment against testing every light with every cluster, runs headless
+
+#define LIGHT_COUNT 10000
+#define ECS_LIGHT_COUNT 2000
+#define ITERATIONS 32
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static float random_float() {
+    return (float)rand() / (float)RAND_MAX * 2.0f - 1.0f;
+}
+
+static light_t random_light() {
+    vec3_t color = vec3(random_float() * 0.5f + 0.5f, random_float() * 0.5f + 0.5f, random_float() * 0.5f + 0.5f);
+    float range = 1.0f + (random_float() + 1.0f) * 2.0f;
+    if (rand() % 2) {
+        return point_light(color, 1.0f, range);
+    }
+    return spot_light(color, 1.0f, range * 2.0f, 0.2f, 0.3f + (random_float() + 1.0f) * 0.4f);
+}
+
+// lists have to be equal cluster by cluster, both come out in ascending light order
+static int compare_clusters(const light_clusters_t* a, const light_clusters_t* b) {
+    if (a->cluster_count != b->cluster_count || a->index_count != b->index_count) {
+        return 0;
+    }
+    for (uint32_t c = 0; c < a->cluster_count; c++) {
+        if (a->clusters[c].count != b->clusters[c].count ||
+            memcmp(&a->indices[a->clusters[c].offset], &b->indices[b->clusters[c].offset], a->clusters[c].count * sizeof(uint32_t)) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint32_t max_cluster_lights(const light_clusters_t* clusters) {
+    uint32_t max = 0;
+    for (uint32_t c = 0; c < clusters->cluster_count; c++) {
+        max = clusters->clusters[c].count > max ? clusters->clusters[c].count : max;
+    }
+    return max;
+}
+
+void bench_assign() {
+    camera_t camera = perspective_camera(1.0f, 16.0f / 9.0f, 0.1f, 200.0f);
+    set_camera_look_at(&camera, vec3(0.0f, 5.0f, 0.0f), vec3(0.0f, 0.0f, -50.0f), vec3(0.0f, 1.0f, 0.0f));
+
+    cluster_grid_t grid = create_cluster_grid(CLUSTER_DIM_X, CLUSTER_DIM_Y, CLUSTER_DIM_Z);
+    build_cluster_grid(&grid, &camera.projection, camera.near, camera.far);
+
+    gpu_light_t* lights = malloc(LIGHT_COUNT * sizeof(gpu_light_t));
+    for (uint32_t i = 0; i < LIGHT_COUNT; i++) {
+        light_t light = random_light();
+        quat_t q = quat_normalize(quat(random_float(), random_float(), random_float(), random_float()));
+        mat4_t world = mat4_from_trs(vec3(random_float() * 60.0f, random_float() * 10.0f, -60.0f + random_float() * 60.0f), q, vec3(1.0f, 1.0f, 1.0f));
+        lights[i] = make_gpu_light(&light, &camera.view, &world);
+    }
+
+    light_clusters_t clusters = {0};
+    light_clusters_t reference = {0};
+
+    double start = now_ms();
+    for (int it = 0; it < ITERATIONS; it++) {
+        assign_lights(&grid, lights, LIGHT_COUNT, &clusters);
+    }
+    double ms = (now_ms() - start) / ITERATIONS;
+
+    start = now_ms();
+    assign_lights_reference(&grid, lights, LIGHT_COUNT, &reference);
+    double ref_ms = now_ms() - start;
+
+    INFO("assign_lights: %d lights, %d clusters, brute force %.3f ms, clustered %.3f ms, speedup %.2fx.",
+         LIGHT_COUNT, clusters.cluster_count, ref_ms, ms, ref_ms / ms);
+    INFO("assign_lights: %d indices, at most %d lights in a cluster, reference %d indices.",
+         clusters.index_count, max_cluster_lights(&clusters), reference.index_count);
+
+    if (!compare_clusters(&clusters, &reference)) {
+        ERROR("Clustered and brute force light lists disagree.");
+    }
+
+    destroy_light_clusters(&clusters);
+    destroy_light_clusters(&reference);
+    destroy_cluster_grid(&grid);
+    free(lights);
+}
+
+// the same through the ecs with a moving camera entity
+void bench_entities() {
+    extern void add_transform_t_cpy(entity_t*, void*);
+    extern void add_light_t_cpy(entity_t*, void*);
+    extern void add_camera_t_cpy(entity_t*, void*);
+
+    for (uint32_t i = 0; i < ECS_LIGHT_COUNT; i++) {
+        entity_t* ent = create_entity();
+
+        transform_t transform = create_transform(TRANSFORM_NONE);
+        set_transform_position(transform, random_float() * 60.0f, random_float() * 10.0f, -60.0f + random_float() * 60.0f);
+        quat_t q = quat_normalize(quat(random_float(), random_float(), random_float(), random_float()));
+        set_transform_rotation(transform, q.x, q.y, q.z, q.w);
+
+        light_t light = random_light();
+        add_transform_t_cpy(ent, &transform);
+        add_light_t_cpy(ent, &light);
+    }
+
+    entity_t* cam_ent = create_entity();
+    camera_t camera = perspective_camera(1.2f, 16.0f / 9.0f, 0.5f, 100.0f);
+    transform_t cam_transform = create_transform(TRANSFORM_NONE);
+    set_transform_position(cam_transform, 3.0f, 2.0f, 10.0f);
+    add_camera_t_cpy(cam_ent, &camera);
+    add_transform_t_cpy(cam_ent, &cam_transform);
+
+    update_transforms();
+    update_light_clusters();
+
+    const light_clusters_t* clusters = get_light_clusters();
+    light_clusters_t reference = {0};
+    assign_lights_reference(get_cluster_grid(), clusters->lights, clusters->light_count, &reference);
+
+    INFO("update_light_clusters: %d lights, %d indices, reference %d indices.",
+         clusters->light_count, clusters->index_count, reference.index_count);
+
+    if (!compare_clusters(clusters, &reference)) {
+        ERROR("Light clusters of the scene disagree with the reference.");
+    }
+
+    destroy_light_clusters(&reference);
+}
+
+extern int should_exit;
+
+void run_light_bench() {
+    srand(1234);
+
+    bench_assign();
+    bench_entities();
+
+    should_exit = 1;
+}
+
+REGISTER_SYSTEM(run_light_bench, SETUP);
@@ -0,0 +1,127 @@
+#include "core/log.h"
+#include "core/systems.h"
+#include "graphics/render_graph.h"
+
+// compiles the frame the readme plans without a gpu and checks culling, ordering, aliasing and barriers
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        ERROR("Render graph check failed: %s.", what);
+    }
+}
+
+static uint32_t position_of(const render_graph_t* graph, uint32_t pass) {
+    uint32_t count = 0;
+    const uint32_t* order = get_render_graph_order(graph, &count);
+    for (uint32_t i = 0; i < count; i++) {
+        if (order[i] == pass) {
+            return i;
+        }
+    }
+    return GRAPH_NONE;
+}
+
+extern int should_exit;
+
+void run_render_graph() {
+    // no context, compiling never touches gl
+    render_graph_t* graph = create_render_graph(NULL);
+    set_render_graph_size(graph, 1920, 1080);
+
+    uint32_t backbuffer = import_graph_backbuffer(graph);
+    uint32_t depth = add_graph_texture(graph, "depth", 0, 0, GL_DEPTH_COMPONENT32F);
+    uint32_t shadow_map = add_graph_texture(graph, "shadow map", 2048, 2048, GL_DEPTH_COMPONENT32F);
+    uint32_t light_grid = add_graph_buffer(graph, "light grid", 1 << 20);
+    uint32_t hdr = add_graph_texture(graph, "hdr", 0, 0, GL_RGBA16F);
+    uint32_t normals = add_graph_texture(graph, "normals", 0, 0, GL_RGBA8);
+    uint32_t ao = add_graph_texture(graph, "ao", 0, 0, GL_R8);
+    uint32_t ao_blurred = add_graph_texture(graph, "ao blurred", 0, 0, GL_R8);
+    uint32_t bright = add_graph_texture(graph, "bright", 0, 0, GL_RGBA16F);
+    uint32_t bloom = add_graph_texture(graph, "bloom", 0, 0, GL_RGBA16F);
+    uint32_t bloom_blurred = add_graph_texture(graph, "bloom blurred", 0, 0, GL_RGBA16F);
+    uint32_t debug_view = add_graph_texture(graph, "debug view", 0, 0, GL_RGBA8);
+
+    uint32_t prepass = add_graph_pass(graph, "z prepass", NULL, NULL, 0);
+    graph_write(graph, prepass, depth, GRAPH_WRITE_DEPTH);
+
+    uint32_t light_cull = add_graph_pass(graph, "light culling", NULL, NULL, 0);
+    graph_read(graph, light_cull, depth, GRAPH_READ_TEXTURE);
+    graph_write(graph, light_cull, light_grid, GRAPH_WRITE_STORAGE);
+
+    uint32_t shadows = add_graph_pass(graph, "shadows", NULL, NULL, 0);
+    graph_write(graph, shadows, shadow_map, GRAPH_WRITE_DEPTH);
+
+    uint32_t forward = add_graph_pass(graph, "forward", NULL, NULL, 0);
+    graph_read(graph, forward, depth, GRAPH_READ_DEPTH);
+    graph_read(graph, forward, shadow_map, GRAPH_READ_TEXTURE);
+    graph_read(graph, forward, light_grid, GRAPH_READ_STORAGE);
+    graph_write(graph, forward, hdr, GRAPH_WRITE_COLOR);
+    graph_write(graph, forward, normals, GRAPH_WRITE_COLOR);
+
+    // only needs the prepass, the forward pass is declared in between but shares its depth target
+    uint32_t debug = add_graph_pass(graph, "debug overdraw", NULL, NULL, 0);
+    graph_read(graph, debug, depth, GRAPH_READ_TEXTURE);
+    graph_write(graph, debug, debug_view, GRAPH_WRITE_COLOR);
+
+    uint32_t ssao = add_graph_pass(graph, "ssao", NULL, NULL, 0);
+    graph_read(graph, ssao, depth, GRAPH_READ_TEXTURE);
+    graph_read(graph, ssao, normals, GRAPH_READ_TEXTURE);
+    graph_write(graph, ssao, ao, GRAPH_WRITE_IMAGE);
+
+    uint32_t ssao_blur = add_graph_pass(graph, "ssao blur", NULL, NULL, 0);
+    graph_read(graph, ssao_blur, ao, GRAPH_READ_TEXTURE);
+    graph_write(graph, ssao_blur, ao_blurred, GRAPH_WRITE_COLOR);
+
+    uint32_t bright_pass = add_graph_pass(graph, "bright", NULL, NULL, 0);
+    graph_read(graph, bright_pass, hdr, GRAPH_READ_TEXTURE);
+    graph_write(graph, bright_pass, bright, GRAPH_WRITE_COLOR);
+
+    uint32_t blur_h = add_graph_pass(graph, "bloom blur h", NULL, NULL, 0);
+    graph_read(graph, blur_h, bright, GRAPH_READ_TEXTURE);
+    graph_write(graph, blur_h, bloom, GRAPH_WRITE_COLOR);
+
+    uint32_t blur_v = add_graph_pass(graph, "bloom blur v", NULL, NULL, 0);
+    graph_read(graph, blur_v, bloom, GRAPH_READ_TEXTURE);
+    graph_write(graph, blur_v, bloom_blurred, GRAPH_WRITE_COLOR);
+
+    uint32_t tonemap = add_graph_pass(graph, "tonemap", NULL, NULL, 0);
+    graph_read(graph, tonemap, hdr, GRAPH_READ_TEXTURE);
+    graph_read(graph, tonemap, ao_blurred, GRAPH_READ_TEXTURE);
+    graph_read(graph, tonemap, bloom_blurred, GRAPH_READ_TEXTURE);
+    graph_write(graph, tonemap, backbuffer, GRAPH_WRITE_COLOR);
+
+    check(compile_render_graph(graph), "graph compiles");
+    log_render_graph(graph);
+
+    render_graph_stats_t stats = get_render_graph_stats(graph);
+
+    check(is_graph_pass_culled(graph, debug), "debug pass without consumers is culled");
+    check(stats.culled_passes == 1, "only the debug pass is culled");
+
+    // every producer before its consumers
+    uint32_t edges[][2] = {
+        { prepass, light_cull }, { light_cull, forward }, { shadows, forward }, { prepass, forward },
+        { forward, ssao }, { ssao, ssao_blur }, { forward, bright_pass }, { bright_pass, blur_h },
+        { blur_h, blur_v }, { ssao_blur, tonemap }, { blur_v, tonemap },
+    };
+    for (uint32_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+        check(position_of(graph, edges[i][0]) < position_of(graph, edges[i][1]), "passes are ordered by their dependencies");
+    }
+
+    // bright is done once the horizontal blur read it, the vertical blur's output can take its place
+    check(get_graph_physical(graph, bloom_blurred) == get_graph_physical(graph, bright), "bloom blurred aliases bright");
+    check(get_graph_physical(graph, ao) != get_graph_physical(graph, ao_blurred), "overlapping lifetimes don't alias");
+    check(stats.physical_bytes < stats.transient_bytes, "aliasing saves memory");
+
+    check(get_graph_pass_barriers(graph, light_cull) == 0, "no barrier after plain depth writes");
+    check(get_graph_pass_barriers(graph, forward) & GL_SHADER_STORAGE_BARRIER_BIT, "forward waits for the light grid");
+    check(get_graph_pass_barriers(graph, ssao_blur) & GL_TEXTURE_FETCH_BARRIER_BIT, "blur waits for the ssao image");
+    check(stats.framebuffer_binds <= 8, "framebuffers are bound once per target change");
+
+    INFO("Render graph checks done, %d gl objects for %d resources.", stats.physical_count, stats.resource_count);
+
+    destroy_render_graph(graph);
+    should_exit = 1;
+}
+
+REGISTER_SYSTEM(run_render_graph, SETUP);
@@ -0,0 +1,217 @@
+#include "core/log.h"
+#include "core/systems.h"
+#include "graphics/mesh_file.h"
+#include "graphics/mesh_optimize.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// optimizes a shuffled sphere, round trips it through the mesh format and checks what comes back
+
+#define RINGS 96
+#define SEGMENTS 192
+#define MESH_PATH "/tmp/overture_sphere.mesh"
+
+typedef struct {
+    float position[3];
+    float normal[3];
+    float uv[2];
+} vertex_t;
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        ERROR("Mesh format check failed: %s.", what);
+    }
+}
+
+// rotated so the smallest index comes first, winding is kept
+static void canonical_triangle(const uint32_t* t, uint32_t out[3]) {
+    uint32_t first = t[0] < t[1] ? (t[0] < t[2] ? 0 : 2) : (t[1] < t[2] ? 1 : 2);
+    for (int i = 0; i < 3; i++) {
+        out[i] = t[(first + i) % 3];
+    }
+}
+
+static int compare_triangles(const void* a, const void* b) {
+    return memcmp(a, b, sizeof(uint32_t) * 3) > 0 ? 1 : (memcmp(a, b, sizeof(uint32_t) * 3) < 0 ? -1 : 0);
+}
+
+static int same_triangles(const uint32_t* a, const uint32_t* b, uint32_t index_count) {
+    uint32_t* sorted_a = malloc(index_count * sizeof(uint32_t));
+    uint32_t* sorted_b = malloc(index_count * sizeof(uint32_t));
+    for (uint32_t i = 0; i < index_count; i += 3) {
+        canonical_triangle(&a[i], &sorted_a[i]);
+        canonical_triangle(&b[i], &sorted_b[i]);
+    }
+    qsort(sorted_a, index_count / 3, sizeof(uint32_t) * 3, compare_triangles);
+    qsort(sorted_b, index_count / 3, sizeof(uint32_t) * 3, compare_triangles);
+
+    int same = memcmp(sorted_a, sorted_b, index_count * sizeof(uint32_t)) == 0;
+    free(sorted_a);
+    free(sorted_b);
+    return same;
+}
+
+static void check_half_floats() {
+    check(float_to_half(1.0f) == 0x3c00, "1 is exact as a half");
+    check(float_to_half(-2.0f) == 0xc000, "-2 is exact as a half");
+    check(float_to_half(65504.0f) == 0x7bff, "the largest half survives");
+    check(float_to_half(1e6f) == 0x7c00, "overflow goes to infinity");
+    check(half_to_float(float_to_half(5.96e-8f)) == half_to_float(0x0001), "the smallest denormal survives");
+    check(float_to_half(1.0f + 1.0f / 2048.0f) == 0x3c00, "ties round to even");
+
+    for (float f = -4.0f; f <= 4.0f; f += 0.0137f) {
+        check(fabsf(half_to_float(float_to_half(f)) - f) <= fabsf(f) / 2048.0f, "halves round to nearest");
+    }
+}
+
+extern int should_exit;
+
+void run_mesh_format() {
+    check_half_floats();
+
+    uint32_t vertex_count = (RINGS + 1) * (SEGMENTS + 1);
+    uint32_t index_count = RINGS * SEGMENTS * 6;
+    vertex_t* vertices = malloc(vertex_count * sizeof(vertex_t));
+    uint32_t* indices = malloc(index_count * sizeof(uint32_t));
+
+    for (uint32_t r = 0; r <= RINGS; r++) {
+        for (uint32_t s = 0; s <= SEGMENTS; s++) {
+            float theta = (float)r / RINGS * 3.14159265f, phi = (float)s / SEGMENTS * 6.28318531f;
+            vertex_t* v = &vertices[r * (SEGMENTS + 1) + s];
+            v->normal[0] = sinf(theta) * cosf(phi);
+            v->normal[1] = cosf(theta);
+            v->normal[2] = sinf(theta) * sinf(phi);
+            for (int i = 0; i < 3; i++) {
+                v->position[i] = v->normal[i] * 2.5f + (i == 1 ? 10.0f : 0.0f);
+            }
+            v->uv[0] = (float)s / SEGMENTS;
+            v->uv[1] = (float)r / RINGS;
+        }
+    }
+
+    uint32_t count = 0;
+    for (uint32_t r = 0; r < RINGS; r++) {
+        for (uint32_t s = 0; s < SEGMENTS; s++) {
+            uint32_t a = r * (SEGMENTS + 1) + s, b = a + SEGMENTS + 1;
+            uint32_t quad[6] = { a, b, a + 1, a + 1, b, b + 1 };
+            memcpy(&indices[count], quad, sizeof(quad));
+            count += 6;
+        }
+    }
+
+    // worst case input, like an exporter that doesn't care about order
+    srand(1234);
+    for (uint32_t t = index_count / 3 - 1; t > 0; t--) {
+        uint32_t other = rand() % (t + 1), swap[3];
+        memcpy(swap, &indices[t * 3], sizeof(swap));
+        memcpy(&indices[t * 3], &indices[other * 3], sizeof(swap));
+        memcpy(&indices[other * 3], swap, sizeof(swap));
+    }
+
+    uint32_t* optimized = malloc(index_count * sizeof(uint32_t));
+    uint32_t* clusters = malloc(index_count / 3 * sizeof(uint32_t));
+
+    float acmr_before = analyze_vertex_cache(indices, index_count, VERTEX_CACHE_SIZE);
+    uint32_t cluster_count = optimize_vertex_cache(optimized, indices, index_count, vertex_count, VERTEX_CACHE_SIZE, clusters);
+    float acmr_tipsify = analyze_vertex_cache(optimized, index_count, VERTEX_CACHE_SIZE);
+    check(same_triangles(indices, optimized, index_count), "tipsify keeps every triangle and its winding");
+
+    optimize_overdraw(optimized, index_count, vertices, sizeof(vertex_t), vertex_count, clusters, cluster_count,
+                      VERTEX_CACHE_SIZE, OVERDRAW_THRESHOLD);
+    float acmr_overdraw = analyze_vertex_cache(optimized, index_count, VERTEX_CACHE_SIZE);
+    check(same_triangles(indices, optimized, index_count), "overdraw sorting keeps every triangle and its winding");
+
+    check(acmr_tipsify < acmr_before * 0.5f, "tipsify at least halves the cache misses");
+    check(acmr_tipsify < 0.9f, "tipsify gets close to one miss per triangle");
+    check(acmr_overdraw <= acmr_tipsify * OVERDRAW_THRESHOLD + 0.05f, "overdraw sorting stays near the threshold");
+
+    uint32_t used = optimize_vertex_fetch(vertices, sizeof(vertex_t), vertex_count, optimized, index_count);
+    check(used == vertex_count, "the sphere uses every vertex");
+
+    uint32_t next = 0;
+    int linear = 1;
+    for (uint32_t i = 0; i < index_count; i++) {
+        linear &= optimized[i] <= next;
+        next = optimized[i] == next ? next + 1 : next;
+    }
+    check(linear, "vertices are numbered in the order they are first used");
+
+    INFO("%d triangles, %d clusters, acmr %.3f -> %.3f (tipsify) -> %.3f (overdraw).", index_count / 3, cluster_count,
+         acmr_before, acmr_tipsify, acmr_overdraw);
+
+    float* positions = malloc(used * sizeof(float) * 3);
+    float* normals = malloc(used * sizeof(float) * 3);
+    float* uvs = malloc(used * sizeof(float) * 2);
+    for (uint32_t i = 0; i < used; i++) {
+        memcpy(&positions[i * 3], vertices[i].position, sizeof(float) * 3);
+        memcpy(&normals[i * 3], vertices[i].normal, sizeof(float) * 3);
+        memcpy(&uvs[i * 2], vertices[i].uv, sizeof(float) * 2);
+    }
+
+    check(save_mesh_file(MESH_PATH, positions, normals, uvs, used, optimized, index_count), "the mesh is saved");
+
+    mesh_file_t file;
+    if (!open_mesh_file(MESH_PATH, &file)) {
+        ERROR("Mesh format check failed: the mesh can't be opened.");
+        should_exit = 1;
+        return;
+    }
+
+    const mesh_file_header_t* header = file.header;
+    check(header->vertex_count == used && header->index_count == index_count, "counts survive");
+    check(header->index_size == 2, "small meshes get 16 bit indices");
+    check(header->flags == (MESH_HAS_NORMALS | MESH_HAS_UVS), "attribute flags are set");
+    check(get_mesh_index_type(&file) == GL_UNSIGNED_SHORT, "index type matches the index size");
+    check(file.size == header->index_offset + index_count * 2, "nothing after the indices");
+
+    const uint16_t* file_indices = file.indices;
+    int indices_match = 1;
+    for (uint32_t i = 0; i < index_count; i++) {
+        indices_match &= file_indices[i] == optimized[i];
+    }
+    check(indices_match, "indices survive");
+
+    mat4_t dequantize = get_mesh_dequantize(&file);
+    float position_error = 0.0f, normal_dot = 1.0f, uv_error = 0.0f;
+    for (uint32_t i = 0; i < used; i++) {
+        const packed_vertex_t* packed = &file.vertices[i];
+
+        // what the gpu does with a normalized unsigned short and the dequantize matrix
+        vec4_t local = vec4(packed->position[0] / 65535.0f, packed->position[1] / 65535.0f, packed->position[2] / 65535.0f, 1.0f);
+        vec4_t position = mat4_mul_vec4(&dequantize, local);
+        position_error = fmaxf(position_error, fabsf(position.x - positions[i * 3]));
+        position_error = fmaxf(position_error, fabsf(position.y - positions[i * 3 + 1]));
+        position_error = fmaxf(position_error, fabsf(position.z - positions[i * 3 + 2]));
+
+        vec3_t normal = oct_decode(packed->normal);
+        normal_dot = fminf(normal_dot, vec3_dot(normal, vec3(normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2])));
+
+        uv_error = fmaxf(uv_error, fabsf(half_to_float(packed->uv[0]) - uvs[i * 2]));
+        uv_error = fmaxf(uv_error, fabsf(half_to_float(packed->uv[1]) - uvs[i * 2 + 1]));
+    }
+
+    // half a quantization step over a 5 unit extent, plus float slack
+    check(position_error < 5.0f / 65535.0f, "positions decode within a quantization step");
+    check(normal_dot > 0.99999f, "normals decode within a tiny angle");
+    check(uv_error <= 1.0f / 2048.0f, "uvs decode within half precision");
+
+    INFO("Mesh format checks done, %zu bytes instead of %zu, max errors: position %g, normal angle %g rad, uv %g.", file.size,
+         used * sizeof(vertex_t) + index_count * sizeof(uint32_t), position_error, acosf(fminf(normal_dot, 1.0f)), uv_error);
+
+    close_mesh_file(&file);
+    remove(MESH_PATH);
+
+    free(positions);
+    free(normals);
+    free(uvs);
+    free(optimized);
+    free(clusters);
+    free(indices);
+    free(vertices);
+    should_exit = 1;
+}
+
+REGISTER_SYSTEM(run_mesh_format, SETUP);
@@ -0,0 +1,327 @@
+#include "core/camera.h"
+#include "core/culling.h"
+#include "core/ecs.h"
+#include "core/lod.h"
+#include "core/log.h"
+#include "core/systems.h"
+#include "core/transform.h"
+#include "graphics/mesh_simplify.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// simplifies a bumpy sphere and a flat grid, then selects levels for a field of entities, runs headless
+
+#define RINGS 96
+#define SEGMENTS 192
+#define GRID 64
+#define ENTITY_COUNT 20000
+#define FRAMES 20
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        ERROR("Lod check failed: %s.", what);
+    }
+}
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static float bumpy_radius(float theta, float phi) {
+    return 1.0f + 0.08f * sinf(5.0f * theta) * sinf(4.0f * phi);
+}
+
+// shared poles and seam so the surface is closed
+static uint32_t sphere_vertex(uint32_t r, uint32_t s) {
+    if (r == 0) {
+        return 0;
+    }
+    if (r == RINGS) {
+        return 1;
+    }
+    return 2 + (r - 1) * SEGMENTS + s % SEGMENTS;
+}
+
+static float lod_surface_error(const float* positions, const uint32_t* indices, uint32_t index_count) {
+    // distance of every triangle's centroid to the analytic surface
+    float worst = 0.0f;
+    for (uint32_t i = 0; i < index_count; i += 3) {
+        vec3_t c = vec3(0.0f, 0.0f, 0.0f);
+        for (int k = 0; k < 3; k++) {
+            const float* p = &positions[indices[i + k] * 3];
+            c = vec3_add(c, vec3_scale(vec3(p[0], p[1], p[2]), 1.0f / 3.0f));
+        }
+        float length = vec3_length(c);
+        float theta = acosf(fmaxf(-1.0f, fminf(1.0f, c.y / length))), phi = atan2f(c.z, c.x);
+        worst = fmaxf(worst, fabsf(length - bumpy_radius(theta, phi)));
+    }
+    return worst;
+}
+
+static void check_sphere_lods(mesh_lod_t* lods, uint32_t* lod_count) {
+    uint32_t vertex_count = 2 + (RINGS - 1) * SEGMENTS;
+    uint32_t index_count = (RINGS - 1) * SEGMENTS * 6;
+    float* positions = malloc(vertex_count * sizeof(float) * 3);
+    uint32_t* indices = malloc(index_count * sizeof(uint32_t));
+
+    for (uint32_t r = 0; r <= RINGS; r++) {
+        for (uint32_t s = 0; s < SEGMENTS; s++) {
+            float theta = (float)r / RINGS * 3.14159265f, phi = (float)s / SEGMENTS * 6.28318531f;
+            float radius = bumpy_radius(theta, phi);
+            float* p = &positions[sphere_vertex(r, s) * 3];
+            p[0] = radius * sinf(theta) * cosf(phi);
+            p[1] = radius * cosf(theta);
+            p[2] = radius * sinf(theta) * sinf(phi);
+        }
+    }
+
+    uint32_t count = 0;
+    for (uint32_t r = 0; r < RINGS; r++) {
+        for (uint32_t s = 0; s < SEGMENTS; s++) {
+            uint32_t a = sphere_vertex(r, s), b = sphere_vertex(r + 1, s);
+            uint32_t c = sphere_vertex(r, s + 1), d = sphere_vertex(r + 1, s + 1);
+            // the pole rows only have one real triangle per quad
+            if (r != 0) {
+                indices[count++] = a;
+                indices[count++] = b;
+                indices[count++] = c;
+            }
+            if (r != RINGS - 1) {
+                indices[count++] = c;
+                indices[count++] = b;
+                indices[count++] = d;
+            }
+        }
+    }
+    index_count = count;
+
+    uint32_t* lod_indices = malloc(index_count * MAX_MESH_LODS * sizeof(uint32_t));
+    double start = now_ms();
+    *lod_count = generate_mesh_lods(lod_indices, lods, MAX_MESH_LODS, indices, index_count, positions, sizeof(float) * 3,
+                                    vertex_count, 0.5f, 0.1f);
+    double ms = now_ms() - start;
+
+    check(*lod_count >= 5, "at least five levels");
+    for (uint32_t l = 1; l < *lod_count; l++) {
+        float surface_error = lod_surface_error(positions, lod_indices + lods[l].first, lods[l].count);
+        INFO("Sphere level %d: %d triangles, error %.5f, surface error %.5f.", l, lods[l].count / 3, lods[l].error, surface_error);
+
+        check(lods[l].count <= lods[l - 1].count * 0.55f, "every level about halves the triangles");
+        check(lods[l].error >= lods[l - 1].error, "errors grow with the level");
+        check(surface_error <= lods[l].error * 4.0f + 0.01f, "the surface stays close to the reported error");
+    }
+    INFO("Generated %d levels from %d triangles in %.1f ms.", *lod_count, index_count / 3, ms);
+
+    free(lod_indices);
+    free(positions);
+    free(indices);
+}
+
+static float triangle_area_z(const float* positions, const uint32_t* t) {
+    const float* a = &positions[t[0] * 3];
+    const float* b = &positions[t[1] * 3];
+    const float* c = &positions[t[2] * 3];
+    return 0.5f * ((b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]));
+}
+
+static void check_flat_grid() {
+    uint32_t vertex_count = (GRID + 1) * (GRID + 1);
+    uint32_t index_count = GRID * GRID * 6;
+    float* positions = malloc(vertex_count * sizeof(float) * 3);
+    uint32_t* indices = malloc(index_count * sizeof(uint32_t));
+
+    for (uint32_t y = 0; y <= GRID; y++) {
+        for (uint32_t x = 0; x <= GRID; x++) {
+            float* p = &positions[(y * (GRID + 1) + x) * 3];
+            p[0] = (float)x / GRID;
+            p[1] = (float)y / GRID;
+            p[2] = 0.0f;
+        }
+    }
+
+    uint32_t count = 0;
+    for (uint32_t y = 0; y < GRID; y++) {
+        for (uint32_t x = 0; x < GRID; x++) {
+            uint32_t a = y * (GRID + 1) + x, b = a + 1, c = a + GRID + 1, d = c + 1;
+            uint32_t quad[6] = { a, b, d, a, d, c };
+            memcpy(&indices[count], quad, sizeof(quad));
+            count += 6;
+        }
+    }
+
+    float error = 0.0f;
+    uint32_t simplified = simplify_mesh(indices, indices, index_count, positions, sizeof(float) * 3, vertex_count, 0, 1e-4f, &error);
+
+    float area = 0.0f;
+    int flipped = 0;
+    for (uint32_t i = 0; i < simplified; i += 3) {
+        float a = triangle_area_z(positions, &indices[i]);
+        area += a;
+        flipped |= a <= 0.0f;
+    }
+
+    INFO("Flat grid: %d triangles down to %d, error %g, area %.6f.", index_count / 3, simplified / 3, error, area);
+    check(simplified < index_count / 20, "a flat grid collapses almost entirely");
+    check(fabsf(area - 1.0f) < 1e-4f, "the open border keeps its outline");
+    check(!flipped, "no triangle is flipped");
+
+    free(positions);
+    free(indices);
+}
+
+static void check_hysteresis() {
+    float errors[3] = { 0.0f, 0.01f, 0.02f };
+    lod_t lod = lod_levels(0, errors, 3);
+
+    // level 1 projects to 0.9 pixels, inside the band
+    lod.level = 0;
+    check(select_lod(&lod, 90.0f, 1.0f, 0.25f) == 0, "a finer level stays while the coarser one is in the band");
+    lod.level = 1;
+    check(select_lod(&lod, 90.0f, 1.0f, 0.25f) == 1, "a coarser level stays while it is in the band");
+    lod.level = 0;
+    check(select_lod(&lod, 70.0f, 1.0f, 0.25f) == 1, "coarser below the band");
+    lod.level = 1;
+    check(select_lod(&lod, 110.0f, 1.0f, 0.25f) == 0, "finer above the threshold");
+    lod.level = 0;
+    check(select_lod(&lod, 10.0f, 1.0f, 0.25f) == 2, "levels can be skipped");
+}
+
+// levels are indexed by entity id, entities are created first so ids stay below ENTITY_COUNT
+static uint32_t count_changes(uint32_t* levels) {
+    uint64_t lod_id = GET_ID(lod_t);
+    uint32_t changes = 0, count = 0;
+    entity_t** list = get_lod_entities(&count);
+    for (uint32_t i = 0; i < count; i++) {
+        const lod_t* lod = list[i]->components[lod_id - 1];
+        // entities that only just came into view have nothing to flicker from
+        changes += levels[list[i]->id] != UINT32_MAX && levels[list[i]->id] != lod->level;
+        levels[list[i]->id] = lod->level;
+    }
+    return changes;
+}
+
+extern int should_exit;
+
+void run_lod() {
+    extern void add_transform_t_cpy(entity_t*, void*);
+    extern void add_bounds_t_cpy(entity_t*, void*);
+    extern void add_camera_t_cpy(entity_t*, void*);
+    extern void add_lod_t_cpy(entity_t*, void*);
+
+    mesh_lod_t lods[MAX_MESH_LODS];
+    uint32_t lod_count = 0;
+    check_sphere_lods(lods, &lod_count);
+    check_flat_grid();
+    check_hysteresis();
+
+    float errors[MAX_LODS] = {0};
+    for (uint32_t l = 0; l < lod_count; l++) {
+        errors[l] = lods[l].error;
+    }
+
+    srand(42);
+    for (uint32_t i = 0; i < ENTITY_COUNT; i++) {
+        entity_t* ent = create_entity();
+        transform_t transform = create_transform(TRANSFORM_NONE);
+        float distance = 2.0f + (float)rand() / RAND_MAX * 400.0f;
+        float side = ((float)rand() / RAND_MAX - 0.5f) * distance * 0.5f;
+        set_transform_position(transform, side, 0.0f, -distance);
+
+        bounds_t bounds = sphere_bounds(vec3(0.0f, 0.0f, 0.0f), 1.1f);
+        lod_t lod = lod_levels(i % 3, errors, lod_count);
+
+        add_transform_t_cpy(ent, &transform);
+        add_bounds_t_cpy(ent, &bounds);
+        add_lod_t_cpy(ent, &lod);
+    }
+
+    entity_t* cam_ent = create_entity();
+    camera_t camera = perspective_camera(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+    set_camera_look_at(&camera, vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
+    add_camera_t_cpy(cam_ent, &camera);
+    camera_t* stored = cam_ent->components[GET_ID(camera_t) - 1];
+
+    update_transforms();
+    cull_entities();
+
+    double start = now_ms();
+    select_lods();
+    double ms = now_ms() - start;
+
+    uint32_t count = 0, batch_count = 0;
+    entity_t** list = get_lod_entities(&count);
+    const lod_batch_t* batches = get_lod_batches(&batch_count);
+    uint32_t visible_count = 0;
+    get_visible_entities(&visible_count);
+    check(count == visible_count && count > 0, "every visible entity gets a level");
+
+    // first frame from level 0, so everything is at the coarsest level under the band
+    uint64_t lod_id = GET_ID(lod_t), transform_id = GET_ID(transform_t);
+    float projection_scale = 1080.0f * 0.5f * stored->projection.m[5];
+    int levels_match = 1;
+    for (uint32_t i = 0; i < count; i++) {
+        const lod_t* lod = list[i]->components[lod_id - 1];
+        const mat4_t* world = get_transform_world(*(transform_t*)list[i]->components[transform_id - 1]);
+        float distance = vec3_length(vec3(world->m[12], world->m[13], world->m[14])) - 1.1f;
+
+        uint32_t expected = 0;
+        for (uint32_t l = 1; l < lod->count; l++) {
+            expected = lod->errors[l] * projection_scale / distance <= 0.75f ? l : expected;
+        }
+        levels_match &= lod->level == expected;
+    }
+    check(levels_match, "levels match the projected error");
+
+    uint32_t covered = 0;
+    int batches_ok = 1;
+    for (uint32_t b = 0; b < batch_count; b++) {
+        const lod_batch_t* batch = &batches[b];
+        batches_ok &= batch->first == covered && batch->count > 0;
+        if (b > 0) {
+            const lod_batch_t* previous = &batches[b - 1];
+            batches_ok &= previous->group < batch->group || (previous->group == batch->group && previous->level < batch->level);
+        }
+        for (uint32_t i = batch->first; i < batch->first + batch->count; i++) {
+            const lod_t* lod = list[i]->components[lod_id - 1];
+            batches_ok &= lod->group == batch->group && lod->level == batch->level;
+        }
+        covered += batch->count;
+    }
+    check(batches_ok && covered == count, "batches are sorted, contiguous and cover every entity");
+    INFO("select_lods: %d entities, %.3f ms, %d batches.", count, ms, batch_count);
+
+    // jittering the camera back and forth must not make levels flicker
+    uint32_t* levels = malloc((ENTITY_COUNT + 1) * sizeof(uint32_t));
+    memset(levels, 0xff, (ENTITY_COUNT + 1) * sizeof(uint32_t));
+    count_changes(levels);
+
+    uint32_t changes = 0, changes_without = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        set_lod_threshold(1.0f, pass == 0 ? 0.25f : 0.0f);
+        for (int frame = 0; frame < FRAMES; frame++) {
+            float z = frame % 2 ? 0.05f : -0.05f;
+            set_camera_look_at(stored, vec3(0.0f, 0.0f, z), vec3(0.0f, 0.0f, z - 1.0f), vec3(0.0f, 1.0f, 0.0f));
+            cull_entities();
+            select_lods();
+            uint32_t frame_changes = count_changes(levels);
+            // levels settle once both camera positions were seen, anything after that is flicker
+            if (frame > 1) {
+                *(pass == 0 ? &changes : &changes_without) += frame_changes;
+            }
+        }
+    }
+    INFO("Level changes over %d jittered frames: %d with hysteresis, %d without.", FRAMES - 2, changes, changes_without);
+    check(changes == 0, "hysteresis stops flickering");
+    check(changes_without > 0, "without hysteresis levels flicker");
+
+    free(levels);
+    set_lod_threshold(1.0f, 0.25f);
+    should_exit = 1;
+}
+
+REGISTER_SYSTEM(run_lod, SETUP);
@@ -0,0 +1,415 @@
+#include "core/log.h"
+#include "core/systems.h"
+#include "graphics/image.h"
+#include "graphics/opengl.h"
+#include "graphics/render_thread.h"
+#include "graphics/stream_buffer.h"
+#include "graphics/texture_stream.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// streams a few generated images through fake gl entry points that keep texture contents in
+// memory, so residency order, the upload budget and the final texel data can be checked headless
+
+#define MAX_FAKE 64
+#define BUDGET (64 << 10)
+#define MAX_FRAMES 1000
+
+typedef struct {
+    uint32_t channels;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+    int base_level;
+    uint8_t* data[16];
+} fake_texture_t;
+
+static fake_texture_t textures[MAX_FAKE];
+static uint32_t texture_count = 0;
+static uint32_t deleted_textures = 0;
+static uint32_t bound_texture = 0;
+
+static uint8_t* buffers[MAX_FAKE];
+static uint32_t buffer_count = 0;
+static uint32_t copy_buffer = 0;
+static uint32_t unpack_buffer = 0;
+
+// set while a render thread owns the context, gl calls for it must come from that thread
+static render_thread_t* uploader = NULL;
+static pthread_t uploader_id;
+static uint32_t calls_elsewhere = 0;
+
+static size_t frame_bytes = 0;
+static uint64_t last_upload_size = 0;
+static int out_of_order = 0;
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        ERROR("Texture streaming check failed: %s.", what);
+    }
+}
+
+static void count_thread() {
+    calls_elsewhere += uploader != NULL && !pthread_equal(pthread_self(), uploader_id);
+}
+
+static void fake_gen_textures(GLsizei n, GLuint* ids) {
+    for (GLsizei i = 0; i < n; i++) {
+        memset(&textures[texture_count], 0, sizeof(fake_texture_t));
+        ids[i] = ++texture_count;
+    }
+}
+
+static void fake_delete_textures(GLsizei n, const GLuint* ids) {
+    count_thread();
+    for (GLsizei i = 0; i < n; i++) {
+        fake_texture_t* texture = &textures[ids[i] - 1];
+        for (uint32_t l = 0; l < texture->levels; l++) {
+            free(texture->data[l]);
+            texture->data[l] = NULL;
+        }
+        deleted_textures++;
+    }
+}
+
+static void fake_active_texture(GLenum unit) {
+    (void)unit;
+}
+
+static void fake_bind_texture(GLenum target, GLuint id) {
+    (void)target;
+    bound_texture = id;
+}
+
+static void fake_tex_storage(GLenum target, GLsizei levels, GLenum format, GLsizei width, GLsizei height) {
+    (void)target;
+    count_thread();
+    fake_texture_t* texture = &textures[bound_texture - 1];
+    texture->channels = format == GL_R8 ? 1 : 4;
+    texture->width = width;
+    texture->height = height;
+    texture->levels = levels;
+    texture->base_level = levels;
+    for (GLsizei l = 0; l < levels; l++) {
+        uint32_t w = width >> l ? width >> l : 1, h = height >> l ? height >> l : 1;
+        texture->data[l] = calloc((size_t)w * h, texture->channels);
+    }
+}
+
+static void fake_tex_parameter(GLenum target, GLenum name, GLint value) {
+    (void)target;
+    if (name == GL_TEXTURE_BASE_LEVEL) {
+        textures[bound_texture - 1].base_level = value;
+    }
+}
+
+static void fake_pixel_store(GLenum name, GLint value) {
+    (void)name;
+    (void)value;
+}
+
+static void fake_tex_sub_image(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format,
+                               GLenum type, const void* pixels) {
+    (void)target;
+    (void)type;
+    count_thread();
+    fake_texture_t* texture = &textures[bound_texture - 1];
+    uint32_t channels = format == GL_RED ? 1 : 4;
+    uint32_t level_width = texture->width >> level ? texture->width >> level : 1;
+    size_t row_bytes = (size_t)width * channels;
+
+    check(unpack_buffer != 0, "uploads go through a pixel unpack buffer");
+    check(x == 0 && (uint32_t)width == level_width, "bands cover whole rows");
+
+    const uint8_t* src = buffers[unpack_buffer - 1] + (size_t)pixels;
+    memcpy(texture->data[level] + (size_t)y * row_bytes, src, row_bytes * height);
+
+    // smallest levels first, across textures
+    uint32_t level_height = texture->height >> level ? texture->height >> level : 1;
+    uint64_t size = (uint64_t)level_width * level_height * channels;
+    out_of_order += size < last_upload_size;
+    last_upload_size = size;
+    frame_bytes += row_bytes * height;
+}
+
+static void fake_gen_buffers(GLsizei n, GLuint* ids) {
+    for (GLsizei i = 0; i < n; i++) {
+        buffers[buffer_count] = NULL;
+        ids[i] = ++buffer_count;
+    }
+}
+
+static void fake_delete_buffers(GLsizei n, const GLuint* ids) {
+    for (GLsizei i = 0; i < n; i++) {
+        free(buffers[ids[i] - 1]);
+        buffers[ids[i] - 1] = NULL;
+    }
+}
+
+static void fake_bind_buffer(GLenum target, GLuint id) {
+    if (target == GL_PIXEL_UNPACK_BUFFER) {
+        unpack_buffer = id;
+    } else if (target == GL_COPY_WRITE_BUFFER) {
+        copy_buffer = id;
+    }
+}
+
+static void fake_buffer_data(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    (void)target;
+    (void)data;
+    (void)usage;
+    free(buffers[copy_buffer - 1]);
+    buffers[copy_buffer - 1] = calloc(1, size);
+}
+
+static void fake_buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    (void)target;
+    memcpy(buffers[copy_buffer - 1] + offset, data, size);
+}
+
+static GLsync fake_fence_sync(GLenum condition, GLbitfield flags) {
+    (void)condition;
+    (void)flags;
+    return (GLsync)1;
+}
+
+static GLenum fake_client_wait_sync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+    (void)sync;
+    (void)flags;
+    (void)timeout;
+    return GL_ALREADY_SIGNALED;
+}
+
+static void fake_delete_sync(GLsync sync) {
+    (void)sync;
+}
+
+static void install_fake_gl() {
+    glad_glGenTextures = fake_gen_textures;
+    glad_glDeleteTextures = fake_delete_textures;
+    glad_glActiveTexture = fake_active_texture;
+    glad_glBindTexture = fake_bind_texture;
+    glad_glTexStorage2D = fake_tex_storage;
+    glad_glTexParameteri = fake_tex_parameter;
+    glad_glPixelStorei = fake_pixel_store;
+    glad_glTexSubImage2D = fake_tex_sub_image;
+    glad_glGenBuffers = fake_gen_buffers;
+    glad_glDeleteBuffers = fake_delete_buffers;
+    glad_glBindBuffer = fake_bind_buffer;
+    glad_glBufferData = fake_buffer_data;
+    glad_glBufferSubData = fake_buffer_sub_data;
+    glad_glFenceSync = fake_fence_sync;
+    glad_glClientWaitSync = fake_client_wait_sync;
+    glad_glDeleteSync = fake_delete_sync;
+}
+
+static image_t make_image(uint32_t width, uint32_t height, uint32_t channels, uint32_t seed) {
+    image_t image = { width, height, channels, malloc((size_t)width * height * channels) };
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            for (uint32_t c = 0; c < channels; c++) {
+                image.pixels[((size_t)y * width + x) * channels + c] = (uint8_t)((x * (3 + c) + y * (5 + seed) + (x ^ y) * c) & 0xff);
+            }
+        }
+    }
+    return image;
+}
+
+static int save_ppm(const char* path, const image_t* image) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        return 0;
+    }
+    fprintf(file, "P6\n# generated\n%d %d\n255\n", image->width, image->height);
+    for (size_t i = 0; i < (size_t)image->width * image->height; i++) {
+        fwrite(image->pixels + i * 4, 1, 3, file);
+    }
+    return fclose(file) == 0;
+}
+
+// the texture's levels from base up have to match the chain built from the file
+static int matches_chain(texture_handle_t handle, const char* path, int srgb) {
+    const texture_t* info = get_texture_info(handle);
+    uint32_t level;
+    if (info == NULL || get_texture(handle, &level) == 0) {
+        return 0;
+    }
+
+    fake_texture_t* texture = &textures[info->id - 1];
+    if (texture->base_level != (int)level) {
+        return 0;
+    }
+
+    image_t image;
+    load_image(path, &image);
+    int ok = 1;
+    for (uint32_t l = 0; l < info->levels; l++) {
+        if (l >= level) {
+            ok = ok && memcmp(texture->data[l], image.pixels, (size_t)image.width * image.height * image.channels) == 0;
+        }
+        if (l + 1 < info->levels) {
+            image_t next = { .pixels = malloc((size_t)image.width * image.height * image.channels) };
+            downsample_image(&image, &next, srgb);
+            free_image(&image);
+            image = next;
+        }
+    }
+    free_image(&image);
+    return ok;
+}
+
+static void record_uploader(void* data) {
+    (void)data;
+    uploader_id = pthread_self();
+}
+
+static uint32_t stream_frames(uint32_t max_frames, size_t* max_bytes) {
+    uint32_t frames = 0;
+    for (; frames < max_frames; frames++) {
+        frame_bytes = 0;
+        update_texture_streaming();
+        // the frame's draws would wait for the render thread before the streams advance
+        if (uploader != NULL) {
+            wait_render_thread(uploader);
+        }
+        advance_stream_buffers();
+        *max_bytes = frame_bytes > *max_bytes ? frame_bytes : *max_bytes;
+        if (frame_bytes == 0) {
+            break;
+        }
+    }
+    return frames;
+}
+
+extern int should_exit;
+
+void run_texture_streaming() {
+    install_fake_gl();
+
+    // decoders round trip what save_tga and a hand written ppm contain
+    image_t color = make_image(512, 256, 4, 0);
+    image_t gray = make_image(300, 200, 1, 1);
+    image_t small = make_image(64, 64, 4, 2);
+    for (size_t i = 0; i < 64 * 64; i++) {
+        small.pixels[i * 4 + 3] = 255; // ppm has no alpha
+    }
+
+    check(save_tga("/tmp/overture_color.tga", &color), "saving tga");
+    check(save_tga("/tmp/overture_gray.tga", &gray), "saving gray tga");
+    check(save_ppm("/tmp/overture_small.ppm", &small), "saving ppm");
+
+    image_t loaded;
+    check(load_image("/tmp/overture_color.tga", &loaded) && memcmp(loaded.pixels, color.pixels, 512 * 256 * 4) == 0, "tga round trip");
+    free_image(&loaded);
+    check(load_image("/tmp/overture_gray.tga", &loaded) && loaded.channels == 1 && memcmp(loaded.pixels, gray.pixels, 300 * 200) == 0,
+          "gray tga round trip");
+    free_image(&loaded);
+    check(load_image("/tmp/overture_small.ppm", &loaded) && memcmp(loaded.pixels, small.pixels, 64 * 64 * 4) == 0, "ppm round trip");
+    free_image(&loaded);
+
+    // black and white average to 0.5 in linear light, which is 188 in srgb
+    uint8_t checker[16] = { 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0 };
+    uint8_t mip[4];
+    image_t src = { 2, 2, 4, checker }, dst = { .pixels = mip };
+    downsample_image(&src, &dst, 1);
+    check(dst.width == 1 && dst.height == 1 && mip[0] == 188 && mip[3] == 128, "srgb downsample");
+    downsample_image(&src, &dst, 0);
+    check(mip[0] == 128, "linear downsample");
+
+    free_image(&color);
+    free_image(&gray);
+    free_image(&small);
+
+    set_texture_upload_budget(BUDGET);
+    texture_handle_t handles[4] = {
+        load_texture("/tmp/overture_color.tga", TEXTURE_SRGB),
+        load_texture("/tmp/overture_gray.tga", 0),
+        load_texture("/tmp/overture_small.ppm", TEXTURE_NO_MIPS),
+        load_texture("/tmp/overture_missing.tga", 0),
+    };
+    wait_for_texture_decodes();
+
+    texture_stream_stats_t stats = get_texture_stream_stats();
+    INFO("Decoded: %d streaming, %d queued, %d decoding, %d kb staged.", stats.streaming, stats.queued, stats.decoding,
+         (int)(stats.staging_bytes >> 10));
+    check(get_texture_state(handles[3]) == TEXTURE_FAILED, "missing file fails");
+
+    // without requests only the tail of each chain goes up
+    size_t max_bytes = 0;
+    uint32_t frames = stream_frames(MAX_FRAMES, &max_bytes);
+    uint32_t color_level = 0, gray_level = 0, small_level = 1;
+    get_texture(handles[0], &color_level);
+    get_texture(handles[1], &gray_level);
+    get_texture(handles[2], &small_level);
+    INFO("Tail streamed in %d frames, at most %d bytes a frame, levels %d, %d and %d.", frames, (int)max_bytes, color_level, gray_level,
+         small_level);
+    check(color_level == 2 && gray_level == 2 && small_level == 0, "tail levels");
+    check(get_texture_state(handles[2]) == TEXTURE_RESIDENT, "single level texture resident");
+    check(get_texture_state(handles[0]) == TEXTURE_STREAMING, "finer levels wait for requests");
+
+    // 600 pixels on screen want the full color texture, 100 only the gray one's 150x100 level
+    uint32_t color_wanted = get_texture_level_for_size(handles[0], 600.0f);
+    uint32_t gray_wanted = get_texture_level_for_size(handles[1], 100.0f);
+    check(color_wanted == 0 && gray_wanted == 1, "level for screen size");
+    request_texture_level(handles[0], color_wanted);
+    request_texture_level(handles[1], gray_wanted);
+
+    last_upload_size = 0;
+    frames = stream_frames(MAX_FRAMES, &max_bytes);
+    get_texture(handles[0], &color_level);
+    get_texture(handles[1], &gray_level);
+    stats = get_texture_stream_stats();
+    INFO("Requested levels streamed in %d frames, %d kb total, %d resident, %d kb still staged.", frames,
+         (int)(stats.total_uploaded_bytes >> 10), stats.resident, (int)(stats.staging_bytes >> 10));
+
+    check(max_bytes <= BUDGET, "upload budget");
+    check(out_of_order == 0, "smallest levels first");
+    check(color_level == 0 && get_texture_state(handles[0]) == TEXTURE_RESIDENT, "color texture resident");
+    check(gray_level == 1 && get_texture_state(handles[1]) == TEXTURE_STREAMING, "gray texture stops at the request");
+    check(matches_chain(handles[0], "/tmp/overture_color.tga", 1), "color texture contents");
+    check(matches_chain(handles[1], "/tmp/overture_gray.tga", 0), "gray texture contents");
+    check(matches_chain(handles[2], "/tmp/overture_small.ppm", 0), "small texture contents");
+
+    for (uint32_t i = 0; i < 4; i++) {
+        unload_texture(handles[i]);
+    }
+    check(deleted_textures == 3, "textures deleted on unload");
+
+    // a context owned by a render thread gets its textures created, uploaded and deleted there,
+    // loading borrows the context, streaming never does
+    GLFWwindow* context = (GLFWwindow*)(uintptr_t)0x1000;
+    uploader = start_render_thread(context);
+    post_render_command(uploader, record_uploader, NULL);
+    make_context_current(context);
+    texture_handle_t threaded = load_texture("/tmp/overture_color.tga", TEXTURE_SRGB | TEXTURE_LOAD_ALL);
+    wait_for_texture_decodes();
+
+    max_bytes = 0;
+    frames = stream_frames(MAX_FRAMES, &max_bytes);
+    INFO("Streamed on a render thread in %d frames, %d calls from other threads.", frames, calls_elsewhere);
+    check(get_current_context() == NULL, "streaming leaves the context on its thread");
+    check(get_texture_state(threaded) == TEXTURE_RESIDENT && matches_chain(threaded, "/tmp/overture_color.tga", 1),
+          "texture streamed on the render thread");
+
+    unload_texture(threaded);
+    wait_render_thread(uploader);
+    check(deleted_textures == 4, "texture deleted on the render thread");
+    check(calls_elsewhere == 0, "texture calls on the owning thread");
+
+    stop_render_thread(uploader);
+    forget_context(context);
+    uploader = NULL;
+
+    remove("/tmp/overture_color.tga");
+    remove("/tmp/overture_gray.tga");
+    remove("/tmp/overture_small.ppm");
+
+    INFO("Texture streaming checks done.");
+    should_exit = 1;
+}
+
+REGISTER_SYSTEM(run_texture_streaming, SETUP);
@@ -0,0 +1,223 @@
+#include "core/log.h"
+#include "core/systems.h"
+#include "graphics/bcn.h"
+#include "graphics/image.h"
+#include "graphics/opengl.h"
+#include "graphics/texture_file.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// encodes a generated image in every block format and checks quality, then writes a texture file
+// and uploads it through fake gl entry points to check levels go to gl straight from the mapping
+
+#define SIZE 512
+
+static const uint8_t* uploaded[16];
+static size_t uploaded_sizes[16];
+static GLenum storage_format = 0;
+static uint32_t storage_levels = 0;
+static uint32_t unpack_buffer = 1;
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        ERROR("Compressed texture check failed: %s.", what);
+    }
+}
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void fake_gen_textures(GLsizei n, GLuint* ids) {
+    for (GLsizei i = 0; i < n; i++) {
+        ids[i] = i + 1;
+    }
+}
+
+static void fake_delete_textures(GLsizei n, const GLuint* ids) {
+    (void)n;
+    (void)ids;
+}
+
+static void fake_active_texture(GLenum unit) {
+    (void)unit;
+}
+
+static void fake_bind_texture(GLenum target, GLuint id) {
+    (void)target;
+    (void)id;
+}
+
+static void fake_bind_buffer(GLenum target, GLuint id) {
+    if (target == GL_PIXEL_UNPACK_BUFFER) {
+        unpack_buffer = id;
+    }
+}
+
+static void fake_tex_storage(GLenum target, GLsizei levels, GLenum format, GLsizei width, GLsizei height) {
+    (void)target;
+    (void)width;
+    (void)height;
+    storage_format = format;
+    storage_levels = levels;
+}
+
+static void fake_tex_parameter(GLenum target, GLenum name, GLint value) {
+    (void)target;
+    (void)name;
+    (void)value;
+}
+
+static void fake_compressed_sub_image(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format,
+                                      GLsizei size, const void* data) {
+    (void)target;
+    (void)x;
+    (void)y;
+    (void)width;
+    (void)height;
+    check(format == storage_format && unpack_buffer == 0, "compressed upload from client memory");
+    uploaded[level] = data;
+    uploaded_sizes[level] = size;
+}
+
+// smooth gradients with a few hard edges and some noise, alpha fades across
+static image_t make_image(uint32_t width, uint32_t height) {
+    image_t image = { width, height, 4, malloc((size_t)width * height * 4) };
+    uint32_t seed = 1;
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            seed = seed * 1664525u + 1013904223u;
+            float noise = ((seed >> 24) - 128.0f) / 32.0f;
+            float edge = ((x / 64 + y / 64) & 1) ? 40.0f : 0.0f;
+            uint8_t* p = image.pixels + ((size_t)y * width + x) * 4;
+            p[0] = (uint8_t)fminf(255.0f, fmaxf(0.0f, 127.5f + 100.0f * sinf(x * 0.02f) + edge + noise));
+            p[1] = (uint8_t)fminf(255.0f, fmaxf(0.0f, 127.5f + 100.0f * cosf(y * 0.015f) + noise));
+            p[2] = (uint8_t)fminf(255.0f, fmaxf(0.0f, (x + y) * 255.0f / (width + height) + edge));
+            p[3] = (uint8_t)(x * 255 / (width - 1));
+        }
+    }
+    return image;
+}
+
+static double psnr(const image_t* image, const uint8_t* decoded, uint32_t channel_mask) {
+    double error = 0.0;
+    size_t count = 0;
+    for (size_t i = 0; i < (size_t)image->width * image->height; i++) {
+        for (uint32_t c = 0; c < 4; c++) {
+            if (channel_mask & 1 << c) {
+                double d = (double)image->pixels[i * 4 + c] - decoded[i * 4 + c];
+                error += d * d;
+                count++;
+            }
+        }
+    }
+    return error == 0.0 ? 99.0 : 10.0 * log10(255.0 * 255.0 / (error / count));
+}
+
+extern int should_exit;
+
+void run_compressed_textures() {
+    static const char* names[] = { "BC1", "BC3", "BC5", "BC7" };
+    static const uint32_t masks[] = { 0x7, 0xf, 0x3, 0xf };
+    static const double min_psnr[] = { 32.0, 32.0, 36.0, 36.0 };
+
+    image_t image = make_image(SIZE, SIZE);
+    uint8_t* decoded = malloc((size_t)SIZE * SIZE * 4);
+
+    for (uint32_t format = BC1_RGB; format <= BC7_RGBA; format++) {
+        size_t size = get_bc_level_size(format, SIZE, SIZE);
+        uint8_t* blocks = malloc(size);
+
+        double start = now_ms();
+        encode_bc_image(format, &image, blocks);
+        double ms = now_ms() - start;
+        decode_bc_image(format, blocks, SIZE, SIZE, decoded);
+
+        double quality = psnr(&image, decoded, masks[format]);
+        INFO("%s: %d kb, %.0fx smaller than rgba8, %.2f db, encoded at %.1f mpixels/s.", names[format], (int)(size >> 10),
+             (double)SIZE * SIZE * 4 / size, quality, SIZE * SIZE / ms / 1e3);
+        check(quality >= min_psnr[format], "block compression quality");
+        free(blocks);
+    }
+
+    // flat blocks of representable colors come back exactly, partial edge blocks only cover the image
+    image_t flat = { 6, 5, 4, malloc(6 * 5 * 4) };
+    for (uint32_t i = 0; i < 6 * 5; i++) {
+        memcpy(flat.pixels + i * 4, (uint8_t[4]){ 255, 0, 255, 255 }, 4);
+    }
+    uint8_t flat_blocks[4 * 16], flat_decoded[6 * 5 * 4];
+    for (uint32_t format = BC1_RGB; format <= BC7_RGBA; format++) {
+        check(get_bc_level_size(format, 6, 5) == get_bc_block_size(format) * 4, "partial blocks are counted");
+        encode_bc_image(format, &flat, flat_blocks);
+        decode_bc_image(format, flat_blocks, 6, 5, flat_decoded);
+        // mode 6 shares one p bit per endpoint, so 0 and 255 in one color can be off by one
+        check(psnr(&flat, flat_decoded, masks[format]) >= (format == BC7_RGBA ? 48.0 : 99.0), "flat blocks");
+    }
+    free_image(&flat);
+
+    // a mip chain through the file and the upload path
+    uint32_t levels = get_mip_count(SIZE, SIZE);
+    uint8_t* level_data[16];
+    image_t level = { SIZE, SIZE, 4, malloc((size_t)SIZE * SIZE * 4) };
+    memcpy(level.pixels, image.pixels, (size_t)SIZE * SIZE * 4);
+    for (uint32_t l = 0; l < levels; l++) {
+        level_data[l] = malloc(get_bc_level_size(BC7_RGBA, level.width, level.height));
+        encode_bc_image(BC7_RGBA, &level, level_data[l]);
+        image_t next = { .pixels = malloc((size_t)level.width * level.height * 4) };
+        downsample_image(&level, &next, 1);
+        free_image(&level);
+        level = next;
+    }
+    free_image(&level);
+
+    check(save_texture_file("/tmp/overture_texture.tex", BC7_RGBA, TEXTURE_FILE_SRGB, SIZE, SIZE, levels, (const uint8_t* const*)level_data),
+          "saving texture file");
+
+    texture_file_t file;
+    check(open_texture_file("/tmp/overture_texture.tex", &file), "opening texture file");
+    for (uint32_t l = 0; l < levels; l++) {
+        size_t size = get_bc_level_size(BC7_RGBA, SIZE >> l ? SIZE >> l : 1, SIZE >> l ? SIZE >> l : 1);
+        check(file.header->level_sizes[l] == size && memcmp(get_texture_file_level(&file, l), level_data[l], size) == 0,
+              "texture file levels");
+    }
+
+    glad_glGenTextures = fake_gen_textures;
+    glad_glDeleteTextures = fake_delete_textures;
+    glad_glActiveTexture = fake_active_texture;
+    glad_glBindTexture = fake_bind_texture;
+    glad_glBindBuffer = fake_bind_buffer;
+    glad_glTexStorage2D = fake_tex_storage;
+    glad_glTexParameteri = fake_tex_parameter;
+    glad_glCompressedTexSubImage2D = fake_compressed_sub_image;
+
+    texture_t texture = create_texture_from_file(&file);
+    check(storage_format == GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM && storage_levels == levels, "compressed storage");
+
+    uint32_t zero_copy = 0;
+    for (uint32_t l = 0; l < levels; l++) {
+        zero_copy += uploaded[l] == get_texture_file_level(&file, l) && uploaded_sizes[l] == file.header->level_sizes[l];
+    }
+    INFO("Uploaded %d of %d levels straight from the %d kb mapping.", zero_copy, levels, (int)(file.size >> 10));
+    check(zero_copy == levels, "levels uploaded from the mapping");
+
+    destroy_texture(&texture);
+    close_texture_file(&file);
+    remove("/tmp/overture_texture.tex");
+
+    for (uint32_t l = 0; l < levels; l++) {
+        free(level_data[l]);
+    }
+    free(decoded);
+    free_image(&image);
+
+    INFO("Compressed texture checks done.");
+    should_exit = 1;
+}
+
+REGISTER_SYSTEM(run_compressed_textures, SETUP);
@@ -0,0 +1,198 @@
+#include "core/log.h"
+#include "core/systems.h"
+#include "graphics/opengl.h"
+#include "graphics/render_thread.h"
+#include "graphics/stream_buffer.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// drives render threads for a few fake contexts headless, swaps are simulated with a sleep so the
+// parallel frame time can be compared with swapping every window from the main thread
+
+#define WINDOWS 4
+#define FRAMES 10
+#define SWAP_MS 8
+
+typedef struct {
+    GLFWwindow* context;
+    render_thread_t* thread;
+    pthread_t thread_id;
+    GLFWwindow* seen_context;
+    stream_buffer_t* stream;
+    uint32_t uploads_on_thread;
+    uint32_t uploads_elsewhere;
+} fake_window_t;
+
+static fake_window_t windows[WINDOWS];
+static pthread_mutex_t fake_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t next_buffer = 1;
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        ERROR("Render thread check failed: %s.", what);
+    }
+}
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void fake_gen_buffers(GLsizei n, GLuint* ids) {
+    pthread_mutex_lock(&fake_lock);
+    for (GLsizei i = 0; i < n; i++) {
+        ids[i] = next_buffer++;
+    }
+    pthread_mutex_unlock(&fake_lock);
+}
+
+static void fake_bind_buffer(GLenum target, GLuint id) {
+    (void)target;
+    (void)id;
+}
+
+static void fake_buffer_data(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    (void)target;
+    (void)size;
+    (void)data;
+    (void)usage;
+}
+
+// uploads have to happen on the thread owning the context they're for
+static void fake_buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    (void)target;
+    (void)offset;
+    (void)size;
+    (void)data;
+    GLFWwindow* context = get_current_context();
+    for (uint32_t i = 0; i < WINDOWS; i++) {
+        if (windows[i].context == context) {
+            pthread_mutex_lock(&fake_lock);
+            if (pthread_equal(pthread_self(), windows[i].thread_id)) {
+                windows[i].uploads_on_thread++;
+            } else {
+                windows[i].uploads_elsewhere++;
+            }
+            pthread_mutex_unlock(&fake_lock);
+        }
+    }
+}
+
+static GLsync fake_fence_sync(GLenum condition, GLbitfield flags) {
+    (void)condition;
+    (void)flags;
+    return (GLsync)1;
+}
+
+static GLenum fake_client_wait_sync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+    (void)sync;
+    (void)flags;
+    (void)timeout;
+    return GL_ALREADY_SIGNALED;
+}
+
+static void fake_delete_sync(GLsync sync) {
+    (void)sync;
+}
+
+static void record_thread(void* data) {
+    fake_window_t* window = data;
+    window->thread_id = pthread_self();
+    window->seen_context = get_current_context();
+}
+
+static void fake_swap(void* data) {
+    (void)data;
+    struct timespec ts = { 0, SWAP_MS * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+extern int should_exit;
+
+void run_render_threads() {
+    glad_glGenBuffers = fake_gen_buffers;
+    glad_glBindBuffer = fake_bind_buffer;
+    glad_glBufferData = fake_buffer_data;
+    glad_glBufferSubData = fake_buffer_sub_data;
+    glad_glFenceSync = fake_fence_sync;
+    glad_glClientWaitSync = fake_client_wait_sync;
+    glad_glDeleteSync = fake_delete_sync;
+
+    for (uint32_t i = 0; i < WINDOWS; i++) {
+        windows[i].context = (GLFWwindow*)(uintptr_t)(0x1000 * (i + 1));
+        // like a window that was just created, setup keeps using it until the first command
+        make_context_current(windows[i].context);
+        windows[i].thread = start_render_thread(windows[i].context);
+        check(get_current_context() == windows[i].context, "context stays current until the first command");
+        post_render_command(windows[i].thread, record_thread, &windows[i]);
+        wait_render_thread(windows[i].thread);
+        check(get_render_thread(windows[i].context) == windows[i].thread, "thread lookup");
+        check(windows[i].seen_context == windows[i].context && get_current_context() == NULL, "context handed to its thread");
+
+        // created by the owning thread even though the main thread asks for it
+        windows[i].stream = get_default_stream(windows[i].context);
+        check(windows[i].stream->context == windows[i].context && get_current_context() == NULL, "default stream of a context");
+    }
+
+    // every window swapping from the main thread, one after the other
+    double start = now_ms();
+    for (uint32_t frame = 0; frame < FRAMES; frame++) {
+        for (uint32_t i = 0; i < WINDOWS; i++) {
+            fake_swap(NULL);
+        }
+    }
+    double serial = (now_ms() - start) / FRAMES;
+
+    // on render threads streams are flushed and fenced on the owning thread, swaps overlap
+    start = now_ms();
+    for (uint32_t frame = 0; frame < FRAMES; frame++) {
+        // what render systems write into each context's stream, allocating works from any thread
+        for (uint32_t i = 0; i < WINDOWS; i++) {
+            stream_alloc_t alloc = stream_alloc(windows[i].context, 256, 16);
+            memset(alloc.data, 0xab, 256);
+        }
+        flush_stream_buffers();
+        advance_stream_buffers();
+        for (uint32_t i = 0; i < WINDOWS; i++) {
+            post_render_command(windows[i].thread, fake_swap, NULL);
+        }
+    }
+    for (uint32_t i = 0; i < WINDOWS; i++) {
+        wait_render_thread(windows[i].thread);
+    }
+    double threaded = (now_ms() - start) / FRAMES;
+
+    uint32_t on_thread = 0, elsewhere = 0;
+    for (uint32_t i = 0; i < WINDOWS; i++) {
+        on_thread += windows[i].uploads_on_thread;
+        elsewhere += windows[i].uploads_elsewhere;
+    }
+
+    INFO("%d windows: %.1f ms a frame swapping from the main thread, %.1f ms on render threads.", WINDOWS, serial, threaded);
+    INFO("Stream uploads: %d on the owning thread, %d elsewhere.", on_thread, elsewhere);
+    check(threaded < serial * 0.6, "swaps overlap");
+    check(on_thread == WINDOWS * FRAMES && elsewhere == 0, "stream work runs on the owning thread");
+    check(get_current_context() == NULL, "the main thread never took a context");
+
+    // the main thread borrows a context back and the next command returns it
+    make_context_current(windows[0].context);
+    check(get_current_context() == windows[0].context, "borrowed context");
+    post_render_command(windows[0].thread, record_thread, &windows[0]);
+    wait_render_thread(windows[0].thread);
+    check(get_current_context() == NULL && windows[0].seen_context == windows[0].context, "context handed back");
+
+    for (uint32_t i = 0; i < WINDOWS; i++) {
+        stop_render_thread(windows[i].thread);
+        forget_context(windows[i].context);
+    }
+    check(get_render_thread(windows[0].context) == NULL, "stopped threads are forgotten");
+
+    INFO("Render thread checks done.");
+    should_exit = 1;
+}
+
+REGISTER_SYSTEM(run_render_threads, SETUP);
@@ -0,0 +1,168 @@
+#include "core/log.h"
+#include "core/systems.h"
+#include "graphics/render_thread.h"
+#include "platform/input.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+// feeds the input ring headless: a producer thread pushing as fast as it can while the main thread
+// consumes, an overflowing burst, the state built from events and polls made while waiting on a
+// render thread
+
+#define STREAM_EVENTS 200000
+#define BURST_EVENTS (INPUT_RING_SIZE + 500)
+#define SLOW_COMMAND_MS 40
+#define HOOK_MS 2.0
+
+static _Atomic int producer_done = 0;
+static uint64_t producer_retries = 0;
+static uint32_t hook_calls = 0;
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        ERROR("Input check failed: %s.", what);
+    }
+}
+
+static double now_s() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static input_event_t numbered(uint32_t i) {
+    return (input_event_t){ INPUT_MOUSE_MOVE, now_s(), NULL, 0, 0, 0, i, 0.0 };
+}
+
+static void* produce(void* data) {
+    (void)data;
+    for (uint32_t i = 0; i < STREAM_EVENTS; i++) {
+        input_event_t event = numbered(i);
+        while (!push_input_event(&event)) {
+            producer_retries++;
+            sched_yield();
+        }
+    }
+    producer_done = 1;
+    return NULL;
+}
+
+static void push(input_event_type_t type, int32_t code, int32_t action, double x, double y) {
+    input_event_t event = { type, now_s(), NULL, code, action, 0, x, y };
+    check(push_input_event(&event), "push with room left");
+}
+
+static void slow_command(void* data) {
+    (void)data;
+    struct timespec ts = { 0, SLOW_COMMAND_MS * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+// stands in for glfwPollEvents() running callbacks
+static void counting_poll() {
+    hook_calls++;
+    push(INPUT_KEY, GLFW_KEY_SPACE, GLFW_REPEAT, 0.0, 0.0);
+}
+
+static void* wait_off_main(void* data) {
+    wait_render_thread(data);
+    return NULL;
+}
+
+extern int should_exit;
+
+void run_input() {
+    const input_state_t* input = get_input();
+
+    // every event arrives once and in order while the producer runs alongside the consumer
+    pthread_t producer;
+    pthread_create(&producer, NULL, produce, NULL);
+
+    uint32_t received = 0, updates = 0, out_of_order = 0;
+    double last_time = 0.0;
+    while (!producer_done || received < STREAM_EVENTS) {
+        update_input();
+        updates++;
+        for (uint32_t i = 0; i < input->event_count; i++) {
+            const input_event_t* event = &input->events[i];
+            out_of_order += (uint32_t)event->x != received || event->time < last_time;
+            last_time = event->time;
+            received++;
+        }
+        sched_yield();
+    }
+    pthread_join(producer, NULL);
+
+    INFO("Streamed %d events over %d updates, the producer found the ring full %lu times.", received, updates, producer_retries);
+    check(received == STREAM_EVENTS, "every streamed event received");
+    check(out_of_order == 0, "events in order");
+    check(input->dropped == producer_retries, "full pushes counted as dropped");
+
+    // a burst larger than the ring keeps the oldest events and counts the rest
+    uint64_t dropped_before = input->dropped;
+    uint32_t accepted = 0;
+    for (uint32_t i = 0; i < BURST_EVENTS; i++) {
+        input_event_t event = numbered(i);
+        accepted += push_input_event(&event);
+    }
+    update_input();
+    INFO("Burst of %d events: %d kept, %lu dropped.", BURST_EVENTS, input->event_count, input->dropped - dropped_before);
+    check(accepted == INPUT_RING_SIZE && input->event_count == INPUT_RING_SIZE, "burst fills the ring");
+    check(input->dropped - dropped_before == BURST_EVENTS - INPUT_RING_SIZE, "burst overflow counted");
+    check(input->events[0].x == 0.0 && input->events[INPUT_RING_SIZE - 1].x == INPUT_RING_SIZE - 1, "oldest events kept");
+
+    // a press and release within one frame still shows up as pressed
+    push(INPUT_KEY, GLFW_KEY_A, GLFW_PRESS, 0.0, 0.0);
+    push(INPUT_KEY, GLFW_KEY_A, GLFW_RELEASE, 0.0, 0.0);
+    push(INPUT_KEY, GLFW_KEY_B, GLFW_PRESS, 0.0, 0.0);
+    push(INPUT_MOUSE_BUTTON, GLFW_MOUSE_BUTTON_LEFT, GLFW_PRESS, 0.0, 0.0);
+    push(INPUT_MOUSE_MOVE, 0, 0, 10.0, 20.0);
+    push(INPUT_MOUSE_MOVE, 0, 0, 30.0, 40.0);
+    push(INPUT_SCROLL, 0, 0, 0.0, 1.0);
+    push(INPUT_SCROLL, 0, 0, 0.5, 2.0);
+    push(INPUT_KEY, -1, GLFW_PRESS, 0.0, 0.0);
+    update_input();
+    check(!is_key_down(GLFW_KEY_A) && was_key_pressed(GLFW_KEY_A), "short press seen");
+    check(is_key_down(GLFW_KEY_B) && was_key_pressed(GLFW_KEY_B), "held key");
+    check(input->buttons[GLFW_MOUSE_BUTTON_LEFT] && input->buttons_pressed[GLFW_MOUSE_BUTTON_LEFT], "mouse button");
+    check(input->cursor_x == 30.0 && input->cursor_y == 40.0, "latest cursor position");
+    check(input->scroll_x == 0.5 && input->scroll_y == 3.0, "scroll summed");
+
+    update_input();
+    check(is_key_down(GLFW_KEY_B) && !was_key_pressed(GLFW_KEY_B), "pressed lasts one update");
+    check(input->scroll_y == 0.0 && input->event_count == 0, "nothing new");
+
+    // polls keep coming while the main thread waits on a busy render thread
+    render_thread_t* thread = start_render_thread((GLFWwindow*)(uintptr_t)0x1000);
+    set_render_wait_hook(counting_poll, HOOK_MS);
+    post_render_command(thread, slow_command, NULL);
+    wait_render_thread(thread);
+
+    // other threads waiting on it never poll, glfw only works on the main thread
+    uint32_t main_polls = hook_calls;
+    post_render_command(thread, slow_command, NULL);
+    pthread_t waiter;
+    pthread_create(&waiter, NULL, wait_off_main, thread);
+    pthread_join(waiter, NULL);
+    check(hook_calls == main_polls, "no polls off the main thread");
+
+    set_render_wait_hook(NULL, 0.0);
+    update_input();
+
+    INFO("Polled %d times during a %d ms wait.", hook_calls, SLOW_COMMAND_MS);
+    check(hook_calls >= SLOW_COMMAND_MS / HOOK_MS / 2, "polled while waiting");
+    check(input->event_count == hook_calls, "polled events arrive");
+
+    post_render_command(thread, slow_command, NULL);
+    wait_render_thread(thread);
+    check(hook_calls == input->event_count, "no polls once turned off");
+
+    stop_render_thread(thread);
+
+    INFO("Input checks done.");
+    should_exit = 1;
+}
+
+REGISTER_SYSTEM(run_input, SETUP);
@@ -0,0 +1,152 @@
+#include "core/log.h"
+#include "core/systems.h"
+#include "platform/frame_pacer.h"
+
+#include <math.h>
+
+// runs the frame pacer against a simulated 144 hz vsync display on a mocked clock. The loop is
+// the engine's: the cpu works on a frame, submitting waits until the render thread returned from
+// the last swap, which with one queued frame is its present, and the next frame starts after
+// pacing
+
+#define REFRESH (1.0 / 144.0)
+#define FRAMES 600
+#define MAX_PENDING 8
+
+typedef struct {
+    double cpu_time;
+    double gpu_time;
+    double cpu_time_after; // from frame FRAMES / 2 on
+    double gpu_time_after;
+} workload_t;
+
+typedef struct {
+    double draws_done;
+    double present;
+} sim_frame_t;
+
+static double now = 0.0;
+static frame_pacer_t* sim_pacer = NULL;
+static sim_frame_t pending[MAX_PENDING];
+static uint32_t pending_head = 0;
+static uint32_t pending_count = 0;
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        ERROR("Frame pacing check failed: %s.", what);
+    }
+}
+
+static double mock_clock() {
+    return now;
+}
+
+// presents happen while time passes
+static void advance(double time) {
+    now = time > now ? time : now;
+    while (pending_count > 0 && pending[pending_head].present <= now) {
+        present_paced_frame(sim_pacer, pending[pending_head].draws_done, pending[pending_head].present);
+        pending_head = (pending_head + 1) % MAX_PENDING;
+        pending_count--;
+    }
+}
+
+static void mock_sleep(double seconds) {
+    advance(now + seconds);
+}
+
+static frame_timings_t simulate(workload_t workload, int pacing, int known_refresh, uint32_t* missed_after_change) {
+    frame_pacer_t pacer;
+    init_frame_pacer(&pacer, mock_clock, mock_sleep, pacing);
+    pacer.refresh = known_refresh ? REFRESH : 0.0;
+    sim_pacer = &pacer;
+    now = 0.0;
+    pending_head = pending_count = 0;
+
+    double gpu_free = 0.0, last_present = 0.0;
+    *missed_after_change = 0;
+
+    begin_paced_frame(&pacer);
+    for (uint32_t frame = 0; frame < FRAMES; frame++) {
+        advance(now + (frame < FRAMES / 2 ? workload.cpu_time : workload.cpu_time_after));
+        // execute_draw_packets waits for the render thread, stuck in the last swap until its present
+        if (pending_count > 0) {
+            advance(pending[(pending_head + pending_count - 1) % MAX_PENDING].present);
+        }
+        submit_paced_frame(&pacer);
+
+        double gpu_time = frame < FRAMES / 2 ? workload.gpu_time : workload.gpu_time_after;
+        double draws_done = (now > gpu_free ? now : gpu_free) + gpu_time;
+        gpu_free = draws_done;
+        // vsync, one frame per vblank
+        double present = ceil(draws_done / REFRESH - 1e-9) * REFRESH;
+        present = present > last_present + REFRESH * 0.5 ? present : last_present + REFRESH;
+        if (frame >= FRAMES / 2 && present - last_present > REFRESH * 1.5) {
+            (*missed_after_change)++;
+        }
+        last_present = present;
+        pending[(pending_head + pending_count++) % MAX_PENDING] = (sim_frame_t){ draws_done, present };
+
+        frame_pacer_t* pacers[] = { &pacer };
+        pace_frames(pacers, 1);
+    }
+    advance(last_present);
+
+    frame_timings_t timings = get_frame_timings(&pacer);
+    destroy_frame_pacer(&pacer);
+    return timings;
+}
+
+static void report(const char* name, frame_timings_t timings) {
+    INFO("%s: %.2f ms present to present (deviation %.3f), %.2f ms start to present, last delay %.2f ms.", name,
+         timings.average * 1e3, timings.deviation * 1e3, timings.latency * 1e3, timings.delay * 1e3);
+}
+
+extern int should_exit;
+
+void run_frame_pacing() {
+    uint32_t missed;
+
+    // light frames: unpaced they start a whole vblank too early
+    workload_t light = { 0.002, 0.0015, 0.002, 0.0015 };
+    frame_timings_t unpaced = simulate(light, 0, 1, &missed);
+    frame_timings_t paced = simulate(light, 1, 1, &missed);
+    report("Unpaced", unpaced);
+    report("Paced", paced);
+    check(unpaced.frames == FRAMES && paced.frames == FRAMES, "every frame presented");
+    check(fabs(paced.average - REFRESH) < 1e-6 && paced.deviation < 1e-6, "paced frames every vblank");
+    check(paced.latency < unpaced.latency * 0.5, "pacing cuts latency");
+    check(paced.latency < light.cpu_time + light.gpu_time + PACER_MARGIN + 1e-4, "paced latency is the frame's work");
+    check(paced.delay > 0.0 && unpaced.delay == 0.0, "only the paced run delays");
+
+    paced = simulate(light, 1, 0, &missed);
+    report("Paced, refresh learned", paced);
+    check(fabs(paced.average - REFRESH) < 1e-6 && paced.latency < unpaced.latency * 0.5, "refresh learned from presents");
+
+    // the gpu gets slower half way, at most the first slower frame misses its vblank
+    workload_t heavier = { 0.002, 0.0015, 0.002, 0.003 };
+    paced = simulate(heavier, 1, 1, &missed);
+    report("Heavier gpu half way", paced);
+    INFO("Missed %d vblanks after the gpu got slower.", missed);
+    check(missed <= 1, "pacer adapts to the gpu time");
+
+    // frames longer than a vblank settle on every other one instead of alternating
+    workload_t slow = { 0.009, 0.002, 0.009, 0.002 };
+    unpaced = simulate(slow, 0, 1, &missed);
+    paced = simulate(slow, 1, 1, &missed);
+    report("Cpu bound, unpaced", unpaced);
+    report("Cpu bound, paced", paced);
+    check(fabs(paced.average - 2 * REFRESH) < 1e-6 && paced.deviation < 1e-6, "even cadence below the refresh rate");
+    check(unpaced.deviation > paced.deviation && paced.latency < unpaced.latency, "pacing steadies slow frames");
+
+    // and go back to every vblank once the frames get light again
+    workload_t lighter = { 0.009, 0.002, 0.002, 0.0015 };
+    paced = simulate(lighter, 1, 1, &missed);
+    report("Lighter half way", paced);
+    check(fabs(paced.interval - REFRESH) < 1e-6, "back to the refresh rate");
+
+    INFO("Frame pacing checks done.");
+    should_exit = 1;
+}
+
+REGISTER_SYSTEM(run_frame_pacing, SETUP);
@@ -0,0 +1,109 @@
+#include "core/events.h"
+#include "core/log.h"
+#include "core/systems.h"
+
+#include <time.h>
+
+// runs real frames headless: four systems send events in parallel every UPDATE, a fifth one
+// reads what they sent the frame before
+
+#define WRITERS 4
+#define EVENTS_PER_WRITER 20000
+#define FRAMES 20
+
+typedef struct {
+    uint32_t writer;
+    uint32_t frame;
+    uint32_t sequence;
+} hit_event_t;
+
+typedef struct {
+    uint32_t value;
+} started_event_t;
+
+REGISTER_EVENT(hit_event_t);
+REGISTER_EVENT(started_event_t);
+
+static uint32_t frame = 1;
+static uint32_t failures = 0;
+static uint64_t events_read = 0;
+static double send_ms = 0.0;
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        ERROR("Event check failed in frame %d: %s.", frame, what);
+        failures++;
+    }
+}
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+void send_started() {
+    SEND_EVENT(started_event_t, (started_event_t){ 42 });
+}
+
+REGISTER_SYSTEM(send_started, SETUP);
+
+static void write_hits(uint32_t writer) {
+    for (uint32_t i = 0; i < EVENTS_PER_WRITER; i++) {
+        SEND_EVENT(hit_event_t, (hit_event_t){ writer, frame, i });
+    }
+}
+
+void write_hits_0() { write_hits(0); }
+void write_hits_1() { write_hits(1); }
+void write_hits_2() { write_hits(2); }
+void write_hits_3() { write_hits(3); }
+
+REGISTER_SYSTEM(write_hits_0, UPDATE);
+REGISTER_SYSTEM(write_hits_1, UPDATE);
+REGISTER_SYSTEM(write_hits_2, UPDATE);
+REGISTER_SYSTEM(write_hits_3, UPDATE);
+
+// runs alongside the writers, they only ever touch next frame's events
+void read_hits() {
+    uint32_t count;
+    const started_event_t* started = READ_EVENTS(started_event_t, &count);
+    check(frame == 1 ? count == 1 && started[0].value == 42 : count == 0, "setup event read in the first frame only");
+
+    const hit_event_t* hits = READ_EVENTS(hit_event_t, &count);
+    check(count == (frame == 1 ? 0 : WRITERS * EVENTS_PER_WRITER), "every event of the last frame");
+
+    uint32_t next[WRITERS] = { 0 };
+    for (uint32_t i = 0; i < count; i++) {
+        const hit_event_t* hit = &hits[i];
+        if (hit->writer >= WRITERS || hit->frame != frame - 1 || hit->sequence != next[hit->writer]) {
+            check(0, "events of one writer in order");
+            break;
+        }
+        next[hit->writer]++;
+    }
+    events_read += count;
+}
+
+REGISTER_SYSTEM(read_hits, UPDATE);
+
+extern int should_exit;
+
+void end_frame() {
+    static double last = 0.0;
+    double now = now_ms();
+    if (frame > 1) {
+        send_ms += now - last;
+    }
+    last = now;
+
+    if (frame++ == FRAMES) {
+        INFO("Read %lu events over %d frames, %.2f ms a frame for %d events from %d threads.", events_read, FRAMES,
+             send_ms / (FRAMES - 1), WRITERS * EVENTS_PER_WRITER, WRITERS);
+        check(events_read == (uint64_t)(FRAMES - 1) * WRITERS * EVENTS_PER_WRITER, "total events read");
+        INFO("Event checks done, %d failed.", failures);
+        should_exit = 1;
+    }
+}
+
+REGISTER_SYSTEM(end_frame, POST_RENDER);
@@ -0,0 +1,138 @@
+#include "core/ecs.h"
+#include "core/frame_time.h"
+#include "core/log.h"
+#include "core/resources.h"
+#include "core/systems.h"
+
+#include <stdatomic.h>
+#include <time.h>
+
+// runs real frames headless: two systems writing a resource, one reading it and two that declare
+// nothing, all in UPDATE. The reader is registered first and still sees both writes
+
+#define FRAMES 10
+#define WORK_MS 5
+#define LOOKUPS 10000
+#define ENTITIES 100
+
+typedef struct {
+    uint64_t points;
+    _Atomic int writing;
+} score_board_t;
+
+typedef struct {
+    int value;
+} singleton_t;
+
+REGISTER_RESOURCE(score_board_t);
+REGISTER_COMPONENT(singleton_t);
+
+static uint32_t frame = 1;
+static uint32_t failures = 0;
+static _Atomic int unrelated_running = 0;
+static _Atomic int overlapped = 0;
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        ERROR("Resource check failed in frame %d: %s.", frame, what);
+        failures++;
+    }
+}
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void work() {
+    struct timespec ts = { 0, WORK_MS * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+void check_points() {
+    check(GET_RESOURCE(score_board_t)->points == 2 * frame, "reader runs after both writers");
+}
+
+static void add_points() {
+    score_board_t* board = GET_RESOURCE(score_board_t);
+    check(atomic_fetch_add(&board->writing, 1) == 0, "writers one at a time");
+    overlapped |= unrelated_running > 0;
+    work();
+    board->points++;
+    atomic_fetch_sub(&board->writing, 1);
+}
+
+void add_points_a() { add_points(); }
+void add_points_b() { add_points(); }
+
+static void unrelated() {
+    unrelated_running++;
+    work();
+    unrelated_running--;
+}
+
+void unrelated_a() { unrelated(); }
+void unrelated_b() { unrelated(); }
+
+REGISTER_SYSTEM(check_points, UPDATE);
+REGISTER_SYSTEM(unrelated_a, UPDATE);
+REGISTER_SYSTEM(add_points_a, UPDATE);
+REGISTER_SYSTEM(add_points_b, UPDATE);
+REGISTER_SYSTEM(unrelated_b, UPDATE);
+
+READS_RESOURCE(check_points, score_board_t);
+WRITES_RESOURCE(add_points_a, score_board_t);
+WRITES_RESOURCE(add_points_b, score_board_t);
+
+// in the same schedule as the update, ordered behind it
+void check_frame_time() {
+    const frame_time_t* time = GET_RESOURCE(frame_time_t);
+    check(time->frame == frame, "frame time updated first");
+    check(frame == 1 ? time->delta == 0.0 : time->delta > 0.0, "frame delta");
+}
+
+REGISTER_SYSTEM_FRONT(check_frame_time, PRE_UPDATE);
+READS_RESOURCE(check_frame_time, frame_time_t);
+
+// what a singleton costs as an entity compared to a resource
+void compare_lookups() {
+    for (uint32_t i = 0; i < ENTITIES; i++) {
+        create_entity();
+    }
+    entity_t* holder = create_entity();
+    add_singleton_t_cpy(holder, &(singleton_t){ 7 });
+
+    double start = now_ms();
+    int sum = 0;
+    for (uint32_t i = 0; i < LOOKUPS; i++) {
+        entity_t** list = FILTER_ENTITIES(singleton_t);
+        sum += ((singleton_t*)get_comp(list[0], GET_ID(singleton_t)))->value;
+        free(list);
+    }
+    double filtered = now_ms() - start;
+
+    start = now_ms();
+    for (uint32_t i = 0; i < LOOKUPS; i++) {
+        sum += GET_RESOURCE(score_board_t) != NULL;
+    }
+    double resource = now_ms() - start;
+
+    INFO("%d singleton lookups among %d entities: %.3f ms filtering, %.3f ms as a resource.", LOOKUPS, ENTITIES + 1, filtered, resource);
+    check(sum == LOOKUPS * 8, "lookups found the singleton");
+    check(resource < filtered, "resources are cheaper");
+}
+
+REGISTER_SYSTEM(compare_lookups, SETUP);
+
+extern int should_exit;
+
+void end_frame() {
+    if (frame++ == FRAMES) {
+        check(overlapped, "undeclared systems still run alongside");
+        INFO("Resource checks done, %d failed.", failures);
+        should_exit = 1;
+    }
+}
+
+REGISTER_SYSTEM(end_frame, POST_RENDER);
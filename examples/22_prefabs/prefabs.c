@@ -0,0 +1,153 @@
+#include "core/ecs.h"
+#include "core/log.h"
+#include "core/serialize_deserialize.h"
+#include "core/systems.h"
+
+#include <time.h>
+
+// spawns a wave of entities one by one and from a prefab, then checks the batch behaves like
+// entities made one by one: filtering, hooks, removal in any order and components added later
+
+#define WAVE 2000
+
+typedef struct {
+    float x, y, z;
+} position_t;
+
+typedef struct {
+    float x, y, z;
+} velocity_t;
+
+CREATE_SERIALIZABLE_STRUCT(health_t, (int32_t, hp), (float, armor));
+
+typedef struct {
+    uint32_t target;
+} target_t;
+
+REGISTER_COMPONENT(position_t);
+REGISTER_COMPONENT(velocity_t);
+REGISTER_COMPONENT(health_t);
+REGISTER_COMPONENT(target_t);
+
+static uint32_t health_added = 0;
+static uint32_t health_removed = 0;
+
+static void on_health_add(entity_t* ent, void* component) {
+    (void)ent;
+    health_added += ((health_t*)component)->hp == 100;
+}
+
+static void on_health_remove(entity_t* ent, void* component) {
+    (void)ent;
+    (void)component;
+    health_removed++;
+}
+
+REGISTER_COMP_HOOKS(health_t, on_health_add, on_health_remove);
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        ERROR("Prefab check failed: %s.", what);
+    }
+}
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static uint64_t count_entities(entity_t** list) {
+    uint64_t count = 0;
+    while (list[count] != NULL) {
+        count++;
+    }
+    free(list);
+    return count;
+}
+
+extern int should_exit;
+
+void run_prefabs() {
+    position_t position = { 1.0f, 2.0f, 3.0f };
+    velocity_t velocity = { 0.0f, -1.0f, 0.0f };
+    health_t health = { 100, 0.5f };
+
+    double start = now_ms();
+    uint64_t first_single = create_entity()->id;
+    remove_ent(first_single);
+    for (uint32_t i = 0; i < WAVE; i++) {
+        entity_t* ent = create_entity();
+        add_position_t_cpy(ent, &position);
+        add_velocity_t_cpy(ent, &velocity);
+        add_health_t_cpy(ent, &health);
+    }
+    double single = now_ms() - start;
+
+    // health comes from the packed format, like it would from a map file
+    unsigned char packed[64];
+    serialize(&health_t_fmt, &health, packed);
+
+    prefab_t* prefab = create_prefab();
+    SET_PREFAB_COMP(prefab, position_t, position);
+    SET_PREFAB_COMP(prefab, velocity_t, (velocity_t){ 0.0f, 0.0f, 0.0f });
+    SET_PREFAB_COMP(prefab, velocity_t, velocity);
+    check(set_prefab_comp_packed(prefab, GET_ID(health_t), &health_t_fmt, packed) == health_t_fmt.packed_size, "packed read");
+    check(prefab->comp_count == 3, "setting a component twice replaces it");
+
+    entity_t** wave = malloc(WAVE * sizeof(entity_t*));
+    start = now_ms();
+    instantiate_batch(prefab, WAVE, wave);
+    double batched = now_ms() - start;
+
+    INFO("Spawning %d entities with 3 components: %.2f ms one by one, %.2f ms from a prefab.", WAVE, single, batched);
+    check(batched < single, "batches are faster");
+
+    check(health_added == 2 * WAVE, "add hooks ran for the batch");
+    check(count_entities(FILTER_ENTITIES(position_t, velocity_t, health_t)) == 2 * WAVE, "batch entities filter");
+
+    int values_ok = 1, contiguous = 1;
+    for (uint32_t i = 0; i < WAVE; i++) {
+        position_t* p = get_comp(wave[i], GET_ID(position_t));
+        health_t* h = get_comp(wave[i], GET_ID(health_t));
+        values_ok &= p->y == 2.0f && h->hp == 100 && h->armor == 0.5f && wave[i]->id == wave[0]->id + i;
+        if (i > 0) {
+            position_t* prev = get_comp(wave[i - 1], GET_ID(position_t));
+            contiguous &= (uint8_t*)p - (uint8_t*)prev == (uint8_t*)get_comp(wave[1], GET_ID(position_t)) - (uint8_t*)get_comp(wave[0], GET_ID(position_t));
+        }
+    }
+    check(values_ok, "values and ids");
+    check(contiguous, "components laid out in columns");
+
+    // components change per entity after spawning, new component types still fit
+    ((position_t*)get_comp(wave[0], GET_ID(position_t)))->x = 9.0f;
+    check(((position_t*)get_comp(wave[1], GET_ID(position_t)))->x == 1.0f, "entities own their copies");
+    add_target_t_cpy(wave[3], &(target_t){ 7 });
+    remove_comp(wave[4], GET_ID(velocity_t));
+    add_velocity_t_cpy(wave[4], &(velocity_t){ 5.0f, 0.0f, 0.0f });
+    check(((velocity_t*)get_comp(wave[4], GET_ID(velocity_t)))->x == 5.0f, "replaced batch component");
+
+    // every other one first, then the rest backwards
+    uint64_t first = wave[0]->id;
+    for (uint32_t i = 0; i < WAVE; i += 2) {
+        remove_ent(first + i);
+    }
+    check(count_entities(FILTER_ENTITIES(position_t)) == WAVE + WAVE / 2, "half the batch removed");
+    for (uint32_t i = WAVE - 1; i < WAVE; i -= 2) {
+        remove_ent(first + i);
+    }
+    check(count_entities(FILTER_ENTITIES(position_t)) == WAVE, "whole batch removed");
+    check(health_removed == WAVE, "remove hooks ran");
+
+    entity_t* one = instantiate(prefab);
+    check(one != NULL && ((velocity_t*)get_comp(one, GET_ID(velocity_t)))->y == -1.0f, "single instance");
+    remove_ent(one->id);
+
+    free(wave);
+    destroy_prefab(prefab);
+
+    INFO("Prefab checks done.");
+    should_exit = 1;
+}
+
+REGISTER_SYSTEM(run_prefabs, SETUP);
@@ -0,0 +1,144 @@
+#include "core/ecs.h"
+#include "core/log.h"
+#include "core/relations.h"
+#include "core/systems.h"
+
+#include <time.h>
+
+// a squad of units under one commander, each targeting two of a few enemies. Checks the lookups
+// both ways and that removing either side of a pair cleans up the other
+
+#define UNITS 1000
+#define ENEMIES 10
+
+typedef struct {
+    uint64_t enemies[2];
+} aim_t;
+
+REGISTER_COMPONENT(aim_t);
+REGISTER_RELATION(child_of);
+REGISTER_RELATION(targets);
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        ERROR("Relation check failed: %s.", what);
+    }
+}
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static uint32_t count_sources(entity_t* target, uint64_t relation) {
+    uint32_t count;
+    get_relation_sources(relation, target, &count);
+    return count;
+}
+
+extern int should_exit;
+
+void run_relations() {
+    entity_t* commander = create_entity();
+    entity_t* enemies[ENEMIES];
+    for (uint32_t i = 0; i < ENEMIES; i++) {
+        enemies[i] = create_entity();
+    }
+
+    entity_t* units[UNITS];
+    for (uint32_t i = 0; i < UNITS; i++) {
+        units[i] = create_entity();
+        ADD_RELATION(child_of, units[i], commander);
+        ADD_RELATION(targets, units[i], enemies[i % ENEMIES]);
+        ADD_RELATION(targets, units[i], enemies[(i + 1) % ENEMIES]);
+        ADD_RELATION(targets, units[i], enemies[i % ENEMIES]);
+        add_aim_t_cpy(units[i], &(aim_t){ { enemies[i % ENEMIES]->id, enemies[(i + 1) % ENEMIES]->id } });
+    }
+
+    uint32_t count;
+    GET_RELATION_SOURCES(child_of, commander, &count);
+    check(count == UNITS, "commander's units");
+    const uint64_t* aimed = GET_RELATION_TARGETS(targets, units[5], &count);
+    check(count == 2 && aimed[0] == enemies[5]->id && aimed[1] == enemies[6]->id, "unit's targets, duplicates ignored");
+    check(HAS_RELATION(targets, units[5], enemies[6]) && !HAS_RELATION(targets, units[5], enemies[7]), "has relation");
+    check(!HAS_RELATION(targets, enemies[6], units[5]), "relations have a direction");
+    check(count_sources(enemies[3], GET_RELATION_ID(targets)) == 2 * UNITS / ENEMIES, "who targets an enemy");
+
+    // who targets each enemy, scanning every unit compared to the relation
+    double start = now_ms();
+    uint64_t scanned = 0;
+    entity_t** list = FILTER_ENTITIES(aim_t);
+    for (uint32_t e = 0; e < ENEMIES; e++) {
+        for (entity_t** ent = list; *ent != NULL; ent++) {
+            aim_t* aim = (*ent)->components[GET_ID(aim_t) - 1];
+            if (aim->enemies[0] == enemies[e]->id || aim->enemies[1] == enemies[e]->id) {
+                scanned += (*ent)->id;
+            }
+        }
+    }
+    free(list);
+    double scan = now_ms() - start;
+
+    start = now_ms();
+    uint64_t looked_up = 0;
+    for (uint32_t e = 0; e < ENEMIES; e++) {
+        const uint64_t* sources = GET_RELATION_SOURCES(targets, enemies[e], &count);
+        for (uint32_t i = 0; i < count; i++) {
+            looked_up += sources[i];
+        }
+    }
+    double lookup = now_ms() - start;
+
+    INFO("Attackers of %d enemies: %.3f ms scanning %d units, %.3f ms through the relation.", ENEMIES, scan, UNITS, lookup);
+    check(scanned == looked_up, "both find every attacker");
+
+    // removing a source
+    uint64_t gone = units[0]->id;
+    remove_ent(gone);
+    check(count_sources(commander, GET_RELATION_ID(child_of)) == UNITS - 1, "removed unit left the commander");
+    check(count_sources(enemies[0], GET_RELATION_ID(targets)) == 2 * UNITS / ENEMIES - 1, "removed unit stopped targeting");
+
+    // removing a target
+    remove_ent(enemies[1]->id);
+    int none_aim = 1;
+    for (uint32_t i = 1; i < UNITS; i++) {
+        GET_RELATION_TARGETS(targets, units[i], &count);
+        none_aim &= count == (i % ENEMIES == 1 || (i + 1) % ENEMIES == 1 ? 1 : 2);
+    }
+    check(none_aim, "removed enemy dropped from every unit");
+
+    // removing a pair by hand, a relation to itself and the component itself
+    REMOVE_RELATION(targets, units[2], enemies[2]);
+    check(!HAS_RELATION(targets, units[2], enemies[2]) && count_sources(enemies[2], GET_RELATION_ID(targets)) == 2 * UNITS / ENEMIES - 1,
+          "pair removed both ways");
+    ADD_RELATION(targets, units[3], units[3]);
+    remove_comp(units[3], GET_ID(relations_t));
+    GET_RELATION_TARGETS(child_of, units[3], &count);
+    check(count == 0 && count_sources(commander, GET_RELATION_ID(child_of)) == UNITS - 2, "removing the component drops its relations");
+
+    remove_ent(commander->id);
+    int orphaned = 1;
+    for (uint32_t i = 1; i < UNITS; i++) {
+        GET_RELATION_TARGETS(child_of, units[i], &count);
+        orphaned &= count == 0;
+    }
+    check(orphaned, "removed commander dropped from every unit");
+
+    check(get_ent(units[10]->id) == units[10], "entities found by id");
+
+    for (uint32_t i = 1; i < UNITS; i++) {
+        remove_ent(units[i]->id);
+    }
+    for (uint32_t i = 0; i < ENEMIES; i++) {
+        if (i != 1) {
+            check(count_sources(enemies[i], GET_RELATION_ID(targets)) == 0, "no attackers left");
+            remove_ent(enemies[i]->id);
+        }
+    }
+
+    INFO("Relation checks done.");
+    should_exit = 1;
+}
+
+REGISTER_SYSTEM(run_relations, SETUP);
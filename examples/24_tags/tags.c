@@ -0,0 +1,159 @@
+#include "core/ecs.h"
+#include "core/log.h"
+#include "core/systems.h"
+
+#include <time.h>
+
+// marks entities with tags and with a one byte component doing the same job, then checks tags
+// allocate nothing, filter with and without exclusions and survive prefabs and removal
+
+#define COUNT 20000
+
+typedef struct {
+    float x, y, z;
+} position_t;
+
+typedef struct {
+    uint8_t set;
+} marker_t;
+
+REGISTER_COMPONENT(position_t);
+REGISTER_COMPONENT(marker_t);
+
+REGISTER_TAG(frozen);
+REGISTER_TAG(hidden);
+REGISTER_TAG(enemy);
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        ERROR("Tag check failed: %s.", what);
+    }
+}
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static uint64_t count_entities(entity_t** list) {
+    uint64_t count = 0;
+    while (list[count] != NULL) {
+        count++;
+    }
+    free(list);
+    return count;
+}
+
+extern int should_exit;
+
+void run_tags() {
+    entity_t** ents = malloc(COUNT * sizeof(entity_t*));
+    for (uint32_t i = 0; i < COUNT; i++) {
+        ents[i] = create_entity();
+        add_position_t_cpy(ents[i], &(position_t){ (float)i, 0.0f, 0.0f });
+    }
+
+    double start = now_ms();
+    for (uint32_t i = 0; i < COUNT; i++) {
+        add_marker_t_cpy(ents[i], &(marker_t){ 1 });
+    }
+    for (uint32_t i = 0; i < COUNT; i++) {
+        remove_comp(ents[i], GET_ID(marker_t));
+    }
+    double component = now_ms() - start;
+
+    start = now_ms();
+    for (uint32_t i = 0; i < COUNT; i++) {
+        ADD_TAG(frozen, ents[i]);
+    }
+    for (uint32_t i = 0; i < COUNT; i++) {
+        REMOVE_TAG(frozen, ents[i]);
+    }
+    double tag = now_ms() - start;
+
+    INFO("Marking and unmarking %d entities: %.2f ms with a 1 byte component, %.2f ms with a tag.", COUNT, component, tag);
+
+    // every third frozen, every fifth hidden, every other one an enemy
+    for (uint32_t i = 0; i < COUNT; i++) {
+        if (i % 3 == 0) ADD_TAG(frozen, ents[i]);
+        if (i % 5 == 0) ADD_TAG(hidden, ents[i]);
+        if (i % 2 == 0) ADD_TAG(enemy, ents[i]);
+    }
+
+    int no_data = 1, bits = 1;
+    for (uint32_t i = 0; i < COUNT; i++) {
+        no_data &= ents[i]->components[GET_ID(frozen) - 1] == NULL;
+        no_data &= ents[i]->components[GET_ID(hidden) - 1] == NULL;
+        no_data &= ents[i]->components[GET_ID(enemy) - 1] == NULL;
+        bits &= HAS_TAG(frozen, ents[i]) == (i % 3 == 0) && HAS_TAG(hidden, ents[i]) == (i % 5 == 0);
+    }
+    check(no_data, "tags store nothing");
+    check(bits, "tag bits");
+    check(get_comp(ents[0], GET_ID(frozen)) == NULL, "get_comp on a tag");
+
+    uint64_t frozen_count = (COUNT + 2) / 3;
+    uint64_t hidden_count = (COUNT + 4) / 5;
+    uint64_t both = (COUNT + 14) / 15;
+    check(count_entities(FILTER_ENTITIES(frozen)) == frozen_count, "filter a tag");
+    check(count_entities(FILTER_ENTITIES(position_t, frozen, hidden)) == both, "filter tags with a component");
+    check(count_entities(FILTER_ENTITIES_WITHOUT((position_t), (frozen))) == COUNT - frozen_count, "filter without a tag");
+    check(count_entities(FILTER_ENTITIES_WITHOUT((position_t), (frozen, hidden))) == COUNT - frozen_count - hidden_count + both, "filter without either tag");
+    check(count_entities(FILTER_ENTITIES_WITHOUT((enemy), (frozen))) == COUNT / 2 - (COUNT + 5) / 6, "enemies that aren't frozen");
+
+    // the same query with a component to look into per entity
+    for (uint32_t i = 0; i < COUNT; i++) {
+        if (i % 3 == 0) add_marker_t_cpy(ents[i], &(marker_t){ 1 });
+    }
+
+    start = now_ms();
+    entity_t** list = FILTER_ENTITIES(position_t);
+    uint64_t moving = 0;
+    for (entity_t** ent = list; *ent != NULL; ent++) {
+        marker_t* marker = (*ent)->components[GET_ID(marker_t) - 1];
+        moving += marker == NULL || !marker->set;
+    }
+    free(list);
+    double by_component = now_ms() - start;
+
+    start = now_ms();
+    uint64_t moving_tagged = count_entities(FILTER_ENTITIES_WITHOUT((position_t), (frozen)));
+    double by_tag = now_ms() - start;
+
+    INFO("Finding %ld unfrozen entities: %.2f ms checking a component, %.2f ms excluding a tag.", moving_tagged, by_component, by_tag);
+    check(moving == moving_tagged, "exclusion matches the component check");
+    check(by_tag < by_component, "excluding a tag is faster");
+
+    // removing a tag or the whole entity touches no memory of its own
+    REMOVE_TAG(hidden, ents[0]);
+    remove_comp(ents[5], GET_ID(hidden));
+    check(count_entities(FILTER_ENTITIES(hidden)) == hidden_count - 2, "removed tags");
+    for (uint32_t i = 0; i < COUNT; i += 3) {
+        remove_ent(ents[i]->id);
+    }
+    check(count_entities(FILTER_ENTITIES(frozen)) == 0, "removed tagged entities");
+
+    prefab_t* prefab = create_prefab();
+    SET_PREFAB_COMP(prefab, position_t, (position_t){ 1.0f, 2.0f, 3.0f });
+    SET_PREFAB_TAG(prefab, enemy);
+    entity_t* spawned[4];
+    instantiate_batch(prefab, 4, spawned);
+    check(HAS_TAG(enemy, spawned[3]) && spawned[3]->components[GET_ID(enemy) - 1] == NULL, "prefab tags");
+    check(((position_t*)get_comp(spawned[3], GET_ID(position_t)))->z == 3.0f, "prefab components next to tags");
+    check(count_entities(FILTER_ENTITIES_WITHOUT((enemy, position_t), (hidden))) == 4 + COUNT / 2 - (COUNT + 5) / 6 - (COUNT + 9) / 10 + (COUNT + 29) / 30,
+          "prefab tags filter");
+    for (uint32_t i = 0; i < 4; i++) {
+        remove_ent(spawned[i]->id);
+    }
+    destroy_prefab(prefab);
+
+    for (uint32_t i = 1; i < COUNT; i++) {
+        if (i % 3 != 0) remove_ent(ents[i]->id);
+    }
+    free(ents);
+
+    INFO("Tag checks done.");
+    should_exit = 1;
+}
+
+REGISTER_SYSTEM(run_tags, SETUP);
@@ -0,0 +1,684 @@
+#ifndef OVERTURE_MATH
+#define OVERTURE_MATH
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Header only vector, matrix and quaternion math.
+ *
+ * Everything is column major to match glUniformMatrix*fv with transpose = GL_FALSE. vec4_t, quat_t
+ * and mat4_t are 16 byte aligned and use SSE or NEON when available, define OVERTURE_MATH_SCALAR
+ * before including this to force the plain C paths (useful for comparing results).
+ */
+
+#if defined(__SSE__) && !defined(OVERTURE_MATH_SCALAR)
+#define OVERTURE_MATH_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) && !defined(OVERTURE_MATH_SCALAR)
+#define OVERTURE_MATH_NEON
+#include <arm_neon.h>
+#endif
+
+#define MATH_INLINE static inline __attribute__((always_inline))
+
+typedef union {
+    struct { float x, y; };
+    float v[2];
+} vec2_t;
+
+typedef union {
+    struct { float x, y, z; };
+    float v[3];
+} vec3_t;
+
+typedef union __attribute__((aligned(16))) {
+    struct { float x, y, z, w; };
+    float v[4];
+#if defined(OVERTURE_MATH_SSE)
+    __m128 simd;
+#elif defined(OVERTURE_MATH_NEON)
+    float32x4_t simd;
+#endif
+} vec4_t;
+
+// (x, y, z) is the imaginary part, w the real part
+typedef vec4_t quat_t;
+
+typedef union {
+    vec3_t cols[3];
+    float m[9];
+} mat3_t;
+
+typedef union __attribute__((aligned(16))) {
+    vec4_t cols[4];
+    float m[16];
+} mat4_t;
+
+/* vec2 */
+
+MATH_INLINE vec2_t vec2(float x, float y) {
+    return (vec2_t){ .v = {x, y} };
+}
+
+MATH_INLINE vec2_t vec2_add(vec2_t a, vec2_t b) {
+    return vec2(a.x + b.x, a.y + b.y);
+}
+
+MATH_INLINE vec2_t vec2_sub(vec2_t a, vec2_t b) {
+    return vec2(a.x - b.x, a.y - b.y);
+}
+
+MATH_INLINE vec2_t vec2_scale(vec2_t a, float s) {
+    return vec2(a.x * s, a.y * s);
+}
+
+MATH_INLINE float vec2_dot(vec2_t a, vec2_t b) {
+    return a.x * b.x + a.y * b.y;
+}
+
+MATH_INLINE float vec2_length(vec2_t a) {
+    return sqrtf(vec2_dot(a, a));
+}
+
+MATH_INLINE vec2_t vec2_normalize(vec2_t a) {
+    float len = vec2_length(a);
+    return len > 0.0f ? vec2_scale(a, 1.0f / len) : a;
+}
+
+/* vec3 */
+
+MATH_INLINE vec3_t vec3(float x, float y, float z) {
+    return (vec3_t){ .v = {x, y, z} };
+}
+
+MATH_INLINE vec3_t vec3_add(vec3_t a, vec3_t b) {
+    return vec3(a.x + b.x, a.y + b.y, a.z + b.z);
+}
+
+MATH_INLINE vec3_t vec3_sub(vec3_t a, vec3_t b) {
+    return vec3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+MATH_INLINE vec3_t vec3_mul(vec3_t a, vec3_t b) {
+    return vec3(a.x * b.x, a.y * b.y, a.z * b.z);
+}
+
+MATH_INLINE vec3_t vec3_scale(vec3_t a, float s) {
+    return vec3(a.x * s, a.y * s, a.z * s);
+}
+
+MATH_INLINE float vec3_dot(vec3_t a, vec3_t b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+MATH_INLINE vec3_t vec3_cross(vec3_t a, vec3_t b) {
+    return vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+MATH_INLINE float vec3_length(vec3_t a) {
+    return sqrtf(vec3_dot(a, a));
+}
+
+MATH_INLINE vec3_t vec3_normalize(vec3_t a) {
+    float len = vec3_length(a);
+    return len > 0.0f ? vec3_scale(a, 1.0f / len) : a;
+}
+
+MATH_INLINE vec3_t vec3_lerp(vec3_t a, vec3_t b, float t) {
+    return vec3(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+}
+
+MATH_INLINE vec3_t vec3_min(vec3_t a, vec3_t b) {
+    return vec3(fminf(a.x, b.x), fminf(a.y, b.y), fminf(a.z, b.z));
+}
+
+MATH_INLINE vec3_t vec3_max(vec3_t a, vec3_t b) {
+    return vec3(fmaxf(a.x, b.x), fmaxf(a.y, b.y), fmaxf(a.z, b.z));
+}
+
+/* vec4 */
+
+MATH_INLINE vec4_t vec4(float x, float y, float z, float w) {
+    return (vec4_t){ .v = {x, y, z, w} };
+}
+
+MATH_INLINE vec4_t vec4_splat(float s) {
+    return vec4(s, s, s, s);
+}
+
+MATH_INLINE vec4_t vec4_add(vec4_t a, vec4_t b) {
+    vec4_t r;
+#if defined(OVERTURE_MATH_SSE)
+    r.simd = _mm_add_ps(a.simd, b.simd);
+#elif defined(OVERTURE_MATH_NEON)
+    r.simd = vaddq_f32(a.simd, b.simd);
+#else
+    for (int i = 0; i < 4; i++) r.v[i] = a.v[i] + b.v[i];
+#endif
+    return r;
+}
+
+MATH_INLINE vec4_t vec4_sub(vec4_t a, vec4_t b) {
+    vec4_t r;
+#if defined(OVERTURE_MATH_SSE)
+    r.simd = _mm_sub_ps(a.simd, b.simd);
+#elif defined(OVERTURE_MATH_NEON)
+    r.simd = vsubq_f32(a.simd, b.simd);
+#else
+    for (int i = 0; i < 4; i++) r.v[i] = a.v[i] - b.v[i];
+#endif
+    return r;
+}
+
+MATH_INLINE vec4_t vec4_mul(vec4_t a, vec4_t b) {
+    vec4_t r;
+#if defined(OVERTURE_MATH_SSE)
+    r.simd = _mm_mul_ps(a.simd, b.simd);
+#elif defined(OVERTURE_MATH_NEON)
+    r.simd = vmulq_f32(a.simd, b.simd);
+#else
+    for (int i = 0; i < 4; i++) r.v[i] = a.v[i] * b.v[i];
+#endif
+    return r;
+}
+
+MATH_INLINE vec4_t vec4_scale(vec4_t a, float s) {
+    vec4_t r;
+#if defined(OVERTURE_MATH_SSE)
+    r.simd = _mm_mul_ps(a.simd, _mm_set1_ps(s));
+#elif defined(OVERTURE_MATH_NEON)
+    r.simd = vmulq_n_f32(a.simd, s);
+#else
+    for (int i = 0; i < 4; i++) r.v[i] = a.v[i] * s;
+#endif
+    return r;
+}
+
+MATH_INLINE float vec4_dot(vec4_t a, vec4_t b) {
+#if defined(OVERTURE_MATH_SSE)
+    __m128 m = _mm_mul_ps(a.simd, b.simd);
+    m = _mm_add_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_add_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(m);
+#elif defined(OVERTURE_MATH_NEON) && defined(__aarch64__)
+    return vaddvq_f32(vmulq_f32(a.simd, b.simd));
+#else
+    return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+#endif
+}
+
+MATH_INLINE float vec4_length(vec4_t a) {
+    return sqrtf(vec4_dot(a, a));
+}
+
+MATH_INLINE vec4_t vec4_normalize(vec4_t a) {
+    float len = vec4_length(a);
+    return len > 0.0f ? vec4_scale(a, 1.0f / len) : a;
+}
+
+MATH_INLINE vec4_t vec4_lerp(vec4_t a, vec4_t b, float t) {
+    return vec4_add(a, vec4_scale(vec4_sub(b, a), t));
+}
+
+/* mat3 */
+
+MATH_INLINE mat3_t mat3_identity() {
+    return (mat3_t){ .m = {1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f} };
+}
+
+MATH_INLINE vec3_t mat3_mul_vec3(const mat3_t* m, vec3_t v) {
+    return vec3(m->m[0] * v.x + m->m[3] * v.y + m->m[6] * v.z,
+                m->m[1] * v.x + m->m[4] * v.y + m->m[7] * v.z,
+                m->m[2] * v.x + m->m[5] * v.y + m->m[8] * v.z);
+}
+
+MATH_INLINE mat3_t mat3_mul(const mat3_t* a, const mat3_t* b) {
+    mat3_t r;
+    for (int j = 0; j < 3; j++) {
+        r.cols[j] = mat3_mul_vec3(a, b->cols[j]);
+    }
+    return r;
+}
+
+MATH_INLINE mat3_t mat3_transpose(const mat3_t* m) {
+    return (mat3_t){ .m = {
+        m->m[0], m->m[3], m->m[6],
+        m->m[1], m->m[4], m->m[7],
+        m->m[2], m->m[5], m->m[8],
+    } };
+}
+
+MATH_INLINE mat3_t mat3_inverse(const mat3_t* m) {
+    // columns of the inverse transpose are the cross products of the columns
+    vec3_t c0 = vec3_cross(m->cols[1], m->cols[2]);
+    vec3_t c1 = vec3_cross(m->cols[2], m->cols[0]);
+    vec3_t c2 = vec3_cross(m->cols[0], m->cols[1]);
+    float inv_det = 1.0f / vec3_dot(m->cols[0], c0);
+
+    mat3_t r = { .cols = {vec3_scale(c0, inv_det), vec3_scale(c1, inv_det), vec3_scale(c2, inv_det)} };
+    return mat3_transpose(&r);
+}
+
+/* mat4 */
+
+MATH_INLINE mat4_t mat4_identity() {
+    return (mat4_t){ .m = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f,
+    } };
+}
+
+MATH_INLINE mat3_t mat3_from_mat4(const mat4_t* m) {
+    return (mat3_t){ .m = {
+        m->m[0], m->m[1], m->m[2],
+        m->m[4], m->m[5], m->m[6],
+        m->m[8], m->m[9], m->m[10],
+    } };
+}
+
+MATH_INLINE vec4_t mat4_mul_vec4(const mat4_t* m, vec4_t v) {
+    vec4_t r;
+#if defined(OVERTURE_MATH_SSE)
+    __m128 x = _mm_shuffle_ps(v.simd, v.simd, _MM_SHUFFLE(0, 0, 0, 0));
+    __m128 y = _mm_shuffle_ps(v.simd, v.simd, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 z = _mm_shuffle_ps(v.simd, v.simd, _MM_SHUFFLE(2, 2, 2, 2));
+    __m128 w = _mm_shuffle_ps(v.simd, v.simd, _MM_SHUFFLE(3, 3, 3, 3));
+    r.simd = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m->cols[0].simd, x), _mm_mul_ps(m->cols[1].simd, y)),
+                        _mm_add_ps(_mm_mul_ps(m->cols[2].simd, z), _mm_mul_ps(m->cols[3].simd, w)));
+#elif defined(OVERTURE_MATH_NEON)
+    float32x4_t t = vmulq_n_f32(m->cols[0].simd, v.x);
+    t = vmlaq_n_f32(t, m->cols[1].simd, v.y);
+    t = vmlaq_n_f32(t, m->cols[2].simd, v.z);
+    r.simd = vmlaq_n_f32(t, m->cols[3].simd, v.w);
+#else
+    for (int i = 0; i < 4; i++) {
+        r.v[i] = m->m[i] * v.x + m->m[4 + i] * v.y + m->m[8 + i] * v.z + m->m[12 + i] * v.w;
+    }
+#endif
+    return r;
+}
+
+MATH_INLINE vec3_t mat4_mul_point(const mat4_t* m, vec3_t p) {
+    vec4_t r = mat4_mul_vec4(m, vec4(p.x, p.y, p.z, 1.0f));
+    return vec3(r.x, r.y, r.z);
+}
+
+// out = a * b, out may alias a or b
+MATH_INLINE void mat4_mul_to(mat4_t* out, const mat4_t* a, const mat4_t* b) {
+#if defined(OVERTURE_MATH_SSE)
+    __m128 c0 = a->cols[0].simd;
+    __m128 c1 = a->cols[1].simd;
+    __m128 c2 = a->cols[2].simd;
+    __m128 c3 = a->cols[3].simd;
+    __m128 r[4];
+    for (int j = 0; j < 4; j++) {
+        __m128 col = b->cols[j].simd;
+        __m128 t = _mm_mul_ps(c0, _mm_shuffle_ps(col, col, _MM_SHUFFLE(0, 0, 0, 0)));
+        t = _mm_add_ps(t, _mm_mul_ps(c1, _mm_shuffle_ps(col, col, _MM_SHUFFLE(1, 1, 1, 1))));
+        t = _mm_add_ps(t, _mm_mul_ps(c2, _mm_shuffle_ps(col, col, _MM_SHUFFLE(2, 2, 2, 2))));
+        t = _mm_add_ps(t, _mm_mul_ps(c3, _mm_shuffle_ps(col, col, _MM_SHUFFLE(3, 3, 3, 3))));
+        r[j] = t;
+    }
+    for (int j = 0; j < 4; j++) {
+        out->cols[j].simd = r[j];
+    }
+#else
+    mat4_t r;
+    for (int j = 0; j < 4; j++) {
+        r.cols[j] = mat4_mul_vec4(a, b->cols[j]);
+    }
+    *out = r;
+#endif
+}
+
+MATH_INLINE mat4_t mat4_mul(const mat4_t* a, const mat4_t* b) {
+    mat4_t r;
+    mat4_mul_to(&r, a, b);
+    return r;
+}
+
+MATH_INLINE mat4_t mat4_transpose(const mat4_t* m) {
+    mat4_t r;
+#if defined(OVERTURE_MATH_SSE)
+    __m128 c0 = m->cols[0].simd, c1 = m->cols[1].simd, c2 = m->cols[2].simd, c3 = m->cols[3].simd;
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    r.cols[0].simd = c0;
+    r.cols[1].simd = c1;
+    r.cols[2].simd = c2;
+    r.cols[3].simd = c3;
+#else
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            r.m[j * 4 + i] = m->m[i * 4 + j];
+        }
+    }
+#endif
+    return r;
+}
+
+#if defined(OVERTURE_MATH_SSE)
+#define MATH_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+#define MATH_SWIZZLE(a, x, y, z, w) MATH_SHUFFLE(a, a, x, y, z, w)
+
+// 2x2 matrices packed as (m00, m01, m10, m11)
+MATH_INLINE __m128 mat2_mul_sse(__m128 a, __m128 b) {
+    return _mm_add_ps(_mm_mul_ps(a, MATH_SWIZZLE(b, 0, 3, 0, 3)),
+                      _mm_mul_ps(MATH_SWIZZLE(a, 1, 0, 3, 2), MATH_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+// adj(a) * b
+MATH_INLINE __m128 mat2_adj_mul_sse(__m128 a, __m128 b) {
+    return _mm_sub_ps(_mm_mul_ps(MATH_SWIZZLE(a, 3, 3, 0, 0), b),
+                      _mm_mul_ps(MATH_SWIZZLE(a, 1, 1, 2, 2), MATH_SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+// a * adj(b)
+MATH_INLINE __m128 mat2_mul_adj_sse(__m128 a, __m128 b) {
+    return _mm_sub_ps(_mm_mul_ps(a, MATH_SWIZZLE(b, 3, 0, 3, 0)),
+                      _mm_mul_ps(MATH_SWIZZLE(a, 1, 0, 3, 2), MATH_SWIZZLE(b, 2, 1, 2, 1)));
+}
+#endif
+
+// general inverse, singular matrices produce infinities
+MATH_INLINE mat4_t mat4_inverse(const mat4_t* m) {
+    mat4_t r;
+#if defined(OVERTURE_MATH_SSE)
+    // block wise inverse on 2x2 sub matrices, works on columns the same way it does on rows
+    __m128 c0 = m->cols[0].simd, c1 = m->cols[1].simd, c2 = m->cols[2].simd, c3 = m->cols[3].simd;
+
+    __m128 a = _mm_movelh_ps(c0, c1);
+    __m128 b = _mm_movehl_ps(c1, c0);
+    __m128 c = _mm_movelh_ps(c2, c3);
+    __m128 d = _mm_movehl_ps(c3, c2);
+
+    __m128 det_sub = _mm_sub_ps(
+        _mm_mul_ps(MATH_SHUFFLE(c0, c2, 0, 2, 0, 2), MATH_SHUFFLE(c1, c3, 1, 3, 1, 3)),
+        _mm_mul_ps(MATH_SHUFFLE(c0, c2, 1, 3, 1, 3), MATH_SHUFFLE(c1, c3, 0, 2, 0, 2)));
+    __m128 det_a = MATH_SWIZZLE(det_sub, 0, 0, 0, 0);
+    __m128 det_b = MATH_SWIZZLE(det_sub, 1, 1, 1, 1);
+    __m128 det_c = MATH_SWIZZLE(det_sub, 2, 2, 2, 2);
+    __m128 det_d = MATH_SWIZZLE(det_sub, 3, 3, 3, 3);
+
+    __m128 d_c = mat2_adj_mul_sse(d, c);
+    __m128 a_b = mat2_adj_mul_sse(a, b);
+    __m128 x = _mm_sub_ps(_mm_mul_ps(det_d, a), mat2_mul_sse(b, d_c));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(det_a, d), mat2_mul_sse(c, a_b));
+    __m128 y = _mm_sub_ps(_mm_mul_ps(det_b, c), mat2_mul_adj_sse(d, a_b));
+    __m128 z = _mm_sub_ps(_mm_mul_ps(det_c, b), mat2_mul_adj_sse(a, d_c));
+
+    __m128 det = _mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c));
+    __m128 tr = _mm_mul_ps(a_b, MATH_SWIZZLE(d_c, 0, 2, 1, 3));
+    tr = _mm_add_ps(tr, _mm_movehl_ps(tr, tr));
+    tr = _mm_add_ss(tr, MATH_SWIZZLE(tr, 1, 1, 1, 1));
+    det = _mm_sub_ps(det, MATH_SWIZZLE(tr, 0, 0, 0, 0));
+
+    __m128 inv_det = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+    x = _mm_mul_ps(x, inv_det);
+    y = _mm_mul_ps(y, inv_det);
+    z = _mm_mul_ps(z, inv_det);
+    w = _mm_mul_ps(w, inv_det);
+
+    r.cols[0].simd = MATH_SHUFFLE(x, y, 3, 1, 3, 1);
+    r.cols[1].simd = MATH_SHUFFLE(x, y, 2, 0, 2, 0);
+    r.cols[2].simd = MATH_SHUFFLE(z, w, 3, 1, 3, 1);
+    r.cols[3].simd = MATH_SHUFFLE(z, w, 2, 0, 2, 0);
+#else
+    const float* s = m->m;
+    float* o = r.m;
+
+    o[0] = s[5] * s[10] * s[15] - s[5] * s[11] * s[14] - s[9] * s[6] * s[15] + s[9] * s[7] * s[14] + s[13] * s[6] * s[11] - s[13] * s[7] * s[10];
+    o[4] = -s[4] * s[10] * s[15] + s[4] * s[11] * s[14] + s[8] * s[6] * s[15] - s[8] * s[7] * s[14] - s[12] * s[6] * s[11] + s[12] * s[7] * s[10];
+    o[8] = s[4] * s[9] * s[15] - s[4] * s[11] * s[13] - s[8] * s[5] * s[15] + s[8] * s[7] * s[13] + s[12] * s[5] * s[11] - s[12] * s[7] * s[9];
+    o[12] = -s[4] * s[9] * s[14] + s[4] * s[10] * s[13] + s[8] * s[5] * s[14] - s[8] * s[6] * s[13] - s[12] * s[5] * s[10] + s[12] * s[6] * s[9];
+    o[1] = -s[1] * s[10] * s[15] + s[1] * s[11] * s[14] + s[9] * s[2] * s[15] - s[9] * s[3] * s[14] - s[13] * s[2] * s[11] + s[13] * s[3] * s[10];
+    o[5] = s[0] * s[10] * s[15] - s[0] * s[11] * s[14] - s[8] * s[2] * s[15] + s[8] * s[3] * s[14] + s[12] * s[2] * s[11] - s[12] * s[3] * s[10];
+    o[9] = -s[0] * s[9] * s[15] + s[0] * s[11] * s[13] + s[8] * s[1] * s[15] - s[8] * s[3] * s[13] - s[12] * s[1] * s[11] + s[12] * s[3] * s[9];
+    o[13] = s[0] * s[9] * s[14] - s[0] * s[10] * s[13] - s[8] * s[1] * s[14] + s[8] * s[2] * s[13] + s[12] * s[1] * s[10] - s[12] * s[2] * s[9];
+    o[2] = s[1] * s[6] * s[15] - s[1] * s[7] * s[14] - s[5] * s[2] * s[15] + s[5] * s[3] * s[14] + s[13] * s[2] * s[7] - s[13] * s[3] * s[6];
+    o[6] = -s[0] * s[6] * s[15] + s[0] * s[7] * s[14] + s[4] * s[2] * s[15] - s[4] * s[3] * s[14] - s[12] * s[2] * s[7] + s[12] * s[3] * s[6];
+    o[10] = s[0] * s[5] * s[15] - s[0] * s[7] * s[13] - s[4] * s[1] * s[15] + s[4] * s[3] * s[13] + s[12] * s[1] * s[7] - s[12] * s[3] * s[5];
+    o[14] = -s[0] * s[5] * s[14] + s[0] * s[6] * s[13] + s[4] * s[1] * s[14] - s[4] * s[2] * s[13] - s[12] * s[1] * s[6] + s[12] * s[2] * s[5];
+    o[3] = -s[1] * s[6] * s[11] + s[1] * s[7] * s[10] + s[5] * s[2] * s[11] - s[5] * s[3] * s[10] - s[9] * s[2] * s[7] + s[9] * s[3] * s[6];
+    o[7] = s[0] * s[6] * s[11] - s[0] * s[7] * s[10] - s[4] * s[2] * s[11] + s[4] * s[3] * s[10] + s[8] * s[2] * s[7] - s[8] * s[3] * s[6];
+    o[11] = -s[0] * s[5] * s[11] + s[0] * s[7] * s[9] + s[4] * s[1] * s[11] - s[4] * s[3] * s[9] - s[8] * s[1] * s[7] + s[8] * s[3] * s[5];
+    o[15] = s[0] * s[5] * s[10] - s[0] * s[6] * s[9] - s[4] * s[1] * s[10] + s[4] * s[2] * s[9] + s[8] * s[1] * s[6] - s[8] * s[2] * s[5];
+
+    float inv_det = 1.0f / (s[0] * o[0] + s[1] * o[4] + s[2] * o[8] + s[3] * o[12]);
+    for (int i = 0; i < 16; i++) {
+        o[i] *= inv_det;
+    }
+#endif
+    return r;
+}
+
+MATH_INLINE mat4_t mat4_translate(vec3_t t) {
+    mat4_t r = mat4_identity();
+    r.m[12] = t.x;
+    r.m[13] = t.y;
+    r.m[14] = t.z;
+    return r;
+}
+
+MATH_INLINE mat4_t mat4_scale(vec3_t s) {
+    mat4_t r = mat4_identity();
+    r.m[0] = s.x;
+    r.m[5] = s.y;
+    r.m[10] = s.z;
+    return r;
+}
+
+// translation * rotation * scale without the two multiplies
+MATH_INLINE mat4_t mat4_from_trs(vec3_t t, quat_t q, vec3_t s) {
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+    return (mat4_t){ .m = {
+        (1.0f - 2.0f * (yy + zz)) * s.x, 2.0f * (xy + wz) * s.x, 2.0f * (xz - wy) * s.x, 0.0f,
+        2.0f * (xy - wz) * s.y, (1.0f - 2.0f * (xx + zz)) * s.y, 2.0f * (yz + wx) * s.y, 0.0f,
+        2.0f * (xz + wy) * s.z, 2.0f * (yz - wx) * s.z, (1.0f - 2.0f * (xx + yy)) * s.z, 0.0f,
+        t.x, t.y, t.z, 1.0f,
+    } };
+}
+
+MATH_INLINE mat4_t mat4_from_quat(quat_t q) {
+    return mat4_from_trs(vec3(0.0f, 0.0f, 0.0f), q, vec3(1.0f, 1.0f, 1.0f));
+}
+
+// right handed, clip space depth -1 to 1
+MATH_INLINE mat4_t mat4_perspective(float fovy, float aspect, float near, float far) {
+    float f = 1.0f / tanf(fovy * 0.5f);
+    mat4_t r = { .m = {0} };
+    r.m[0] = f / aspect;
+    r.m[5] = f;
+    r.m[10] = (far + near) / (near - far);
+    r.m[11] = -1.0f;
+    r.m[14] = 2.0f * far * near / (near - far);
+    return r;
+}
+
+MATH_INLINE mat4_t mat4_ortho(float left, float right, float bottom, float top, float near, float far) {
+    mat4_t r = mat4_identity();
+    r.m[0] = 2.0f / (right - left);
+    r.m[5] = 2.0f / (top - bottom);
+    r.m[10] = -2.0f / (far - near);
+    r.m[12] = -(right + left) / (right - left);
+    r.m[13] = -(top + bottom) / (top - bottom);
+    r.m[14] = -(far + near) / (far - near);
+    return r;
+}
+
+MATH_INLINE mat4_t mat4_look_at(vec3_t eye, vec3_t center, vec3_t up) {
+    vec3_t f = vec3_normalize(vec3_sub(center, eye));
+    vec3_t s = vec3_normalize(vec3_cross(f, up));
+    vec3_t u = vec3_cross(s, f);
+
+    return (mat4_t){ .m = {
+        s.x, u.x, -f.x, 0.0f,
+        s.y, u.y, -f.y, 0.0f,
+        s.z, u.z, -f.z, 0.0f,
+        -vec3_dot(s, eye), -vec3_dot(u, eye), vec3_dot(f, eye), 1.0f,
+    } };
+}
+
+/* quat */
+
+MATH_INLINE quat_t quat(float x, float y, float z, float w) {
+    return vec4(x, y, z, w);
+}
+
+MATH_INLINE quat_t quat_identity() {
+    return quat(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+// axis has to be normalized
+MATH_INLINE quat_t quat_from_axis_angle(vec3_t axis, float angle) {
+    float s = sinf(angle * 0.5f);
+    return quat(axis.x * s, axis.y * s, axis.z * s, cosf(angle * 0.5f));
+}
+
+MATH_INLINE quat_t quat_mul(quat_t a, quat_t b) {
+    return quat(a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+                a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+                a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z);
+}
+
+MATH_INLINE quat_t quat_conjugate(quat_t q) {
+    return quat(-q.x, -q.y, -q.z, q.w);
+}
+
+MATH_INLINE quat_t quat_normalize(quat_t q) {
+    return vec4_normalize(q);
+}
+
+MATH_INLINE vec3_t quat_rotate(quat_t q, vec3_t v) {
+    vec3_t u = vec3(q.x, q.y, q.z);
+    vec3_t t = vec3_scale(vec3_cross(u, v), 2.0f);
+    return vec3_add(vec3_add(v, vec3_scale(t, q.w)), vec3_cross(u, t));
+}
+
+// shortest path, the weights come from Eberly's polynomial fit instead of acos and sin, both
+// evaluated at once in the first two lanes, max error around 3e-5
+MATH_INLINE quat_t quat_slerp(quat_t a, quat_t b, float t) {
+    static const float u[8] = {
+        1.0f / (1 * 3), 1.0f / (2 * 5), 1.0f / (3 * 7), 1.0f / (4 * 9),
+        1.0f / (5 * 11), 1.0f / (6 * 13), 1.0f / (7 * 15), 1.85298109240830f / (8 * 17),
+    };
+    static const float v[8] = {
+        1.0f / 3, 2.0f / 5, 3.0f / 7, 4.0f / 9,
+        5.0f / 11, 6.0f / 13, 7.0f / 15, 1.85298109240830f * 8 / 17,
+    };
+
+    float cos_theta = vec4_dot(a, b);
+    float sign = cos_theta < 0.0f ? -1.0f : 1.0f;
+    vec4_t x = vec4_splat(cos_theta * sign - 1.0f);
+
+    float s = 1.0f - t;
+    vec4_t sq = vec4(s * s, t * t, 0.0f, 0.0f);
+    vec4_t one = vec4_splat(1.0f);
+    vec4_t f = one;
+    for (int i = 7; i >= 0; i--) {
+        vec4_t term = vec4_mul(vec4_sub(vec4_scale(sq, u[i]), vec4_splat(v[i])), x);
+        f = vec4_add(one, vec4_mul(term, f));
+    }
+
+    return vec4_add(vec4_scale(a, s * f.x), vec4_scale(b, sign * t * f.y));
+}
+
+/* batches */
+
+// transforms count points (w = 1), in and out may be the same array
+MATH_INLINE void mat4_transform_points(const mat4_t* m, const vec3_t* in, vec3_t* out, size_t count) {
+    size_t i = 0;
+#if defined(OVERTURE_MATH_SSE)
+    __m128 m0 = _mm_set1_ps(m->m[0]), m1 = _mm_set1_ps(m->m[1]), m2 = _mm_set1_ps(m->m[2]);
+    __m128 m4 = _mm_set1_ps(m->m[4]), m5 = _mm_set1_ps(m->m[5]), m6 = _mm_set1_ps(m->m[6]);
+    __m128 m8 = _mm_set1_ps(m->m[8]), m9 = _mm_set1_ps(m->m[9]), m10 = _mm_set1_ps(m->m[10]);
+    __m128 m12 = _mm_set1_ps(m->m[12]), m13 = _mm_set1_ps(m->m[13]), m14 = _mm_set1_ps(m->m[14]);
+
+    // 4 points are 3 registers of xyzx yzxy zxyz, transpose to soa and back
+    for (; i + 4 <= count; i += 4) {
+        const float* src = in[i].v;
+        __m128 a = _mm_loadu_ps(src);
+        __m128 b = _mm_loadu_ps(src + 4);
+        __m128 c = _mm_loadu_ps(src + 8);
+
+        __m128 px = MATH_SHUFFLE(a, MATH_SHUFFLE(b, c, 2, 2, 1, 1), 0, 3, 0, 2);
+        __m128 py = MATH_SHUFFLE(MATH_SHUFFLE(a, b, 1, 1, 0, 0), MATH_SHUFFLE(b, c, 3, 3, 2, 2), 0, 2, 0, 2);
+        __m128 pz = MATH_SHUFFLE(MATH_SHUFFLE(a, b, 2, 2, 1, 1), MATH_SHUFFLE(c, c, 0, 0, 3, 3), 0, 2, 0, 2);
+
+        __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, px), _mm_mul_ps(m4, py)), _mm_add_ps(_mm_mul_ps(m8, pz), m12));
+        __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, px), _mm_mul_ps(m5, py)), _mm_add_ps(_mm_mul_ps(m9, pz), m13));
+        __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, px), _mm_mul_ps(m6, py)), _mm_add_ps(_mm_mul_ps(m10, pz), m14));
+
+        float* dst = out[i].v;
+        _mm_storeu_ps(dst, MATH_SHUFFLE(MATH_SHUFFLE(rx, ry, 0, 0, 0, 0), MATH_SHUFFLE(rz, rx, 0, 0, 1, 1), 0, 2, 0, 2));
+        _mm_storeu_ps(dst + 4, MATH_SHUFFLE(MATH_SHUFFLE(ry, rz, 1, 1, 1, 1), MATH_SHUFFLE(rx, ry, 2, 2, 2, 2), 0, 2, 0, 2));
+        _mm_storeu_ps(dst + 8, MATH_SHUFFLE(MATH_SHUFFLE(rz, rx, 2, 2, 3, 3), MATH_SHUFFLE(ry, rz, 3, 3, 3, 3), 0, 2, 0, 2));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = mat4_mul_point(m, in[i]);
+    }
+}
+
+// structure of arrays version, 4 points per iteration when SIMD is available
+MATH_INLINE void mat4_transform_points_soa(const mat4_t* m,
+                                           const float* x, const float* y, const float* z,
+                                           float* out_x, float* out_y, float* out_z, size_t count) {
+    size_t i = 0;
+#if defined(OVERTURE_MATH_SSE)
+    __m128 m0 = _mm_set1_ps(m->m[0]), m1 = _mm_set1_ps(m->m[1]), m2 = _mm_set1_ps(m->m[2]);
+    __m128 m4 = _mm_set1_ps(m->m[4]), m5 = _mm_set1_ps(m->m[5]), m6 = _mm_set1_ps(m->m[6]);
+    __m128 m8 = _mm_set1_ps(m->m[8]), m9 = _mm_set1_ps(m->m[9]), m10 = _mm_set1_ps(m->m[10]);
+    __m128 m12 = _mm_set1_ps(m->m[12]), m13 = _mm_set1_ps(m->m[13]), m14 = _mm_set1_ps(m->m[14]);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 pz = _mm_loadu_ps(z + i);
+
+        __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, px), _mm_mul_ps(m4, py)), _mm_add_ps(_mm_mul_ps(m8, pz), m12));
+        __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, px), _mm_mul_ps(m5, py)), _mm_add_ps(_mm_mul_ps(m9, pz), m13));
+        __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, px), _mm_mul_ps(m6, py)), _mm_add_ps(_mm_mul_ps(m10, pz), m14));
+
+        _mm_storeu_ps(out_x + i, rx);
+        _mm_storeu_ps(out_y + i, ry);
+        _mm_storeu_ps(out_z + i, rz);
+    }
+#elif defined(OVERTURE_MATH_NEON)
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t px = vld1q_f32(x + i);
+        float32x4_t py = vld1q_f32(y + i);
+        float32x4_t pz = vld1q_f32(z + i);
+
+        float32x4_t rx = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(m->m[12]), px, m->m[0]), py, m->m[4]), pz, m->m[8]);
+        float32x4_t ry = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(m->m[13]), px, m->m[1]), py, m->m[5]), pz, m->m[9]);
+        float32x4_t rz = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(m->m[14]), px, m->m[2]), py, m->m[6]), pz, m->m[10]);
+
+        vst1q_f32(out_x + i, rx);
+        vst1q_f32(out_y + i, ry);
+        vst1q_f32(out_z + i, rz);
+    }
+#endif
+    for (; i < count; i++) {
+        float px = x[i], py = y[i], pz = z[i];
+        out_x[i] = m->m[0] * px + m->m[4] * py + m->m[8] * pz + m->m[12];
+        out_y[i] = m->m[1] * px + m->m[5] * py + m->m[9] * pz + m->m[13];
+        out_z[i] = m->m[2] * px + m->m[6] * py + m->m[10] * pz + m->m[14];
+    }
+}
+
+// out[i] = a[i] * b[i]
+MATH_INLINE void mat4_mul_batch(mat4_t* out, const mat4_t* a, const mat4_t* b, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        mat4_mul_to(&out[i], &a[i], &b[i]);
+    }
+}
+
+#endif
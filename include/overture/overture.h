@@ -1,4 +1,6 @@
 #ifndef OVERTURE_H
 #define OVERTURE_H
 
+#include "overture/math.h"
+
 #endif
@@ -0,0 +1,727 @@
+#include "core/bvh.h"
+#include "core/log.h"
+#include "core/systems.h"
+#include "core/transform.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// deep enough for any balanced tree that fits in memory
+#define STACK_SIZE 256
+
+static inline aabb_t aabb_union(aabb_t a, aabb_t b) {
+    return (aabb_t){ .min = vec3_min(a.min, b.min), .max = vec3_max(a.max, b.max) };
+}
+
+// half the surface area, only used for comparisons
+static inline float aabb_area(aabb_t a) {
+    vec3_t d = vec3_sub(a.max, a.min);
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+static inline int aabb_contains(aabb_t outer, aabb_t inner) {
+    return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+           outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+}
+
+static inline int aabb_overlaps(aabb_t a, aabb_t b) {
+    return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+           a.min.y <= b.max.y && a.max.y >= b.min.y &&
+           a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+static inline aabb_t aabb_grow(aabb_t a, float margin) {
+    vec3_t m = vec3(margin, margin, margin);
+    return (aabb_t){ .min = vec3_sub(a.min, m), .max = vec3_add(a.max, m) };
+}
+
+static inline int is_leaf(const bvh_node_t* node) {
+    return node->left == BVH_NONE;
+}
+
+static inline int32_t max_height(int32_t a, int32_t b) {
+    return a > b ? a : b;
+}
+
+bvh_t create_bvh(float margin) {
+    return (bvh_t){
+        .root = BVH_NONE,
+        .free_list = BVH_NONE,
+        .margin = margin,
+    };
+}
+
+void destroy_bvh(bvh_t* tree) {
+    free(tree->nodes);
+    *tree = create_bvh(tree->margin);
+}
+
+// may move the node array, don't hold node pointers across this
+static uint32_t alloc_node(bvh_t* tree) {
+    uint32_t index;
+    if (tree->free_list != BVH_NONE) {
+        index = tree->free_list;
+        tree->free_list = tree->nodes[index].parent;
+    } else {
+        if (tree->node_count == tree->capacity) {
+            tree->capacity = tree->capacity ? tree->capacity * 2 : 64;
+            tree->nodes = realloc(tree->nodes, tree->capacity * sizeof(bvh_node_t));
+            if (tree->nodes == NULL) {
+                FATAL("Failed to grow bvh to %d nodes.", tree->capacity);
+            }
+        }
+        index = tree->node_count++;
+    }
+
+    tree->nodes[index] = (bvh_node_t){
+        .parent = BVH_NONE,
+        .left = BVH_NONE,
+        .right = BVH_NONE,
+        .height = 0,
+        .data = NULL,
+    };
+    return index;
+}
+
+static void free_node(bvh_t* tree, uint32_t index) {
+    tree->nodes[index].height = -1;
+    tree->nodes[index].parent = tree->free_list;
+    tree->free_list = index;
+}
+
+static void replace_child(bvh_t* tree, uint32_t parent, uint32_t old_child, uint32_t new_child) {
+    if (parent == BVH_NONE) {
+        tree->root = new_child;
+    } else if (tree->nodes[parent].left == old_child) {
+        tree->nodes[parent].left = new_child;
+    } else {
+        tree->nodes[parent].right = new_child;
+    }
+}
+
+static void fit_node(bvh_t* tree, uint32_t index) {
+    bvh_node_t* node = &tree->nodes[index];
+    const bvh_node_t* left = &tree->nodes[node->left];
+    const bvh_node_t* right = &tree->nodes[node->right];
+    node->box = aabb_union(left->box, right->box);
+    node->height = 1 + max_height(left->height, right->height);
+}
+
+// rotates the taller grandchild up when the children's heights differ by more than one
+static uint32_t balance(bvh_t* tree, uint32_t ia) {
+    bvh_node_t* nodes = tree->nodes;
+    bvh_node_t* a = &nodes[ia];
+    if (is_leaf(a) || a->height < 2) {
+        return ia;
+    }
+
+    uint32_t ib = a->left;
+    uint32_t ic = a->right;
+    bvh_node_t* b = &nodes[ib];
+    bvh_node_t* c = &nodes[ic];
+    int32_t difference = c->height - b->height;
+
+    if (difference > 1) {
+        uint32_t i_f = c->left;
+        uint32_t i_g = c->right;
+
+        c->left = ia;
+        c->parent = a->parent;
+        a->parent = ic;
+        replace_child(tree, c->parent, ia, ic);
+
+        if (nodes[i_f].height > nodes[i_g].height) {
+            c->right = i_f;
+            a->right = i_g;
+            nodes[i_g].parent = ia;
+        } else {
+            c->right = i_g;
+            a->right = i_f;
+            nodes[i_f].parent = ia;
+        }
+        fit_node(tree, ia);
+        fit_node(tree, ic);
+        return ic;
+    }
+
+    if (difference < -1) {
+        uint32_t i_d = b->left;
+        uint32_t i_e = b->right;
+
+        b->left = ia;
+        b->parent = a->parent;
+        a->parent = ib;
+        replace_child(tree, b->parent, ia, ib);
+
+        if (nodes[i_d].height > nodes[i_e].height) {
+            b->right = i_d;
+            a->left = i_e;
+            nodes[i_e].parent = ia;
+        } else {
+            b->right = i_e;
+            a->left = i_d;
+            nodes[i_d].parent = ia;
+        }
+        fit_node(tree, ia);
+        fit_node(tree, ib);
+        return ib;
+    }
+
+    return ia;
+}
+
+static void refit_from(bvh_t* tree, uint32_t index) {
+    while (index != BVH_NONE) {
+        index = balance(tree, index);
+        fit_node(tree, index);
+        index = tree->nodes[index].parent;
+    }
+}
+
+// also works for the root of a subtree, its box is used like a leaf's
+static void insert_node(bvh_t* tree, uint32_t leaf) {
+    if (tree->root == BVH_NONE) {
+        tree->root = leaf;
+        tree->nodes[leaf].parent = BVH_NONE;
+        return;
+    }
+
+    // walk down to the sibling that makes the tree grow the least
+    aabb_t box = tree->nodes[leaf].box;
+    uint32_t index = tree->root;
+    while (!is_leaf(&tree->nodes[index])) {
+        const bvh_node_t* node = &tree->nodes[index];
+
+        float area = aabb_area(node->box);
+        float combined_area = aabb_area(aabb_union(node->box, box));
+        float cost = 2.0f * combined_area;
+        float inheritance = 2.0f * (combined_area - area);
+
+        float child_cost[2];
+        uint32_t children[2] = { node->left, node->right };
+        for (int i = 0; i < 2; i++) {
+            const bvh_node_t* child = &tree->nodes[children[i]];
+            float grown = aabb_area(aabb_union(child->box, box));
+            child_cost[i] = (is_leaf(child) ? grown : grown - aabb_area(child->box)) + inheritance;
+        }
+
+        if (cost < child_cost[0] && cost < child_cost[1]) {
+            break;
+        }
+        index = child_cost[0] < child_cost[1] ? children[0] : children[1];
+    }
+
+    uint32_t sibling = index;
+    uint32_t old_parent = tree->nodes[sibling].parent;
+    uint32_t new_parent = alloc_node(tree);
+
+    bvh_node_t* parent = &tree->nodes[new_parent];
+    parent->parent = old_parent;
+    parent->left = sibling;
+    parent->right = leaf;
+    replace_child(tree, old_parent, sibling, new_parent);
+
+    tree->nodes[sibling].parent = new_parent;
+    tree->nodes[leaf].parent = new_parent;
+
+    refit_from(tree, new_parent);
+}
+
+static void remove_node(bvh_t* tree, uint32_t leaf) {
+    if (leaf == tree->root) {
+        tree->root = BVH_NONE;
+        return;
+    }
+
+    uint32_t parent = tree->nodes[leaf].parent;
+    uint32_t grand_parent = tree->nodes[parent].parent;
+    uint32_t sibling = tree->nodes[parent].left == leaf ? tree->nodes[parent].right : tree->nodes[parent].left;
+
+    replace_child(tree, grand_parent, parent, sibling);
+    tree->nodes[sibling].parent = grand_parent;
+    free_node(tree, parent);
+
+    refit_from(tree, grand_parent);
+}
+
+uint32_t bvh_insert(bvh_t* tree, aabb_t box, void* data) {
+    uint32_t leaf = alloc_node(tree);
+    tree->nodes[leaf].box = aabb_grow(box, tree->margin);
+    tree->nodes[leaf].data = data;
+    tree->leaf_count++;
+
+    insert_node(tree, leaf);
+    return leaf;
+}
+
+void bvh_remove(bvh_t* tree, uint32_t proxy) {
+    if (proxy >= tree->node_count || !is_leaf(&tree->nodes[proxy]) || tree->nodes[proxy].height != 0) {
+        WARN("Bvh proxy %d is not a leaf.", proxy);
+        return;
+    }
+
+    remove_node(tree, proxy);
+    free_node(tree, proxy);
+    tree->leaf_count--;
+}
+
+int bvh_move(bvh_t* tree, uint32_t proxy, aabb_t box) {
+    if (aabb_contains(tree->nodes[proxy].box, box)) {
+        return 0;
+    }
+
+    remove_node(tree, proxy);
+    tree->nodes[proxy].box = aabb_grow(box, tree->margin);
+    insert_node(tree, proxy);
+    return 1;
+}
+
+// qsort has no user pointer, the batch build runs under the caller's lock
+static const bvh_node_t* sort_nodes;
+static int sort_axis;
+
+static int compare_centers(const void* a, const void* b) {
+    const aabb_t* box_a = &sort_nodes[*(const uint32_t*)a].box;
+    const aabb_t* box_b = &sort_nodes[*(const uint32_t*)b].box;
+    float center_a = box_a->min.v[sort_axis] + box_a->max.v[sort_axis];
+    float center_b = box_b->min.v[sort_axis] + box_b->max.v[sort_axis];
+    return (center_a > center_b) - (center_a < center_b);
+}
+
+// median split on the longest axis of the centers
+static uint32_t build_subtree(bvh_t* tree, uint32_t* leaves, uint32_t count) {
+    if (count == 1) {
+        return leaves[0];
+    }
+
+    vec3_t min = vec3(1e30f, 1e30f, 1e30f);
+    vec3_t max = vec3(-1e30f, -1e30f, -1e30f);
+    for (uint32_t i = 0; i < count; i++) {
+        const aabb_t* box = &tree->nodes[leaves[i]].box;
+        vec3_t center = vec3_add(box->min, box->max);
+        min = vec3_min(min, center);
+        max = vec3_max(max, center);
+    }
+
+    vec3_t size = vec3_sub(max, min);
+    sort_axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+    sort_nodes = tree->nodes;
+    qsort(leaves, count, sizeof(uint32_t), compare_centers);
+
+    uint32_t mid = count / 2;
+    uint32_t left = build_subtree(tree, leaves, mid);
+    uint32_t right = build_subtree(tree, leaves + mid, count - mid);
+
+    uint32_t index = alloc_node(tree);
+    tree->nodes[index].left = left;
+    tree->nodes[index].right = right;
+    tree->nodes[left].parent = index;
+    tree->nodes[right].parent = index;
+    fit_node(tree, index);
+    return index;
+}
+
+void bvh_insert_batch(bvh_t* tree, const aabb_t* boxes, void** data, uint32_t count, uint32_t* proxies) {
+    if (count == 0) {
+        return;
+    }
+
+    uint32_t* leaves = malloc(count * sizeof(uint32_t));
+    for (uint32_t i = 0; i < count; i++) {
+        leaves[i] = alloc_node(tree);
+        tree->nodes[leaves[i]].box = aabb_grow(boxes[i], tree->margin);
+        tree->nodes[leaves[i]].data = data ? data[i] : NULL;
+        if (proxies != NULL) {
+            proxies[i] = leaves[i];
+        }
+    }
+    tree->leaf_count += count;
+
+    insert_node(tree, build_subtree(tree, leaves, count));
+
+    free(leaves);
+}
+
+void bvh_remove_batch(bvh_t* tree, const uint32_t* proxies, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        bvh_remove(tree, proxies[i]);
+    }
+}
+
+// visits every leaf under index without further tests
+static int visit_all(const bvh_t* tree, uint32_t index, bvh_visit_t visit, void* user) {
+    uint32_t stack[STACK_SIZE];
+    uint32_t top = 0;
+    stack[top++] = index;
+
+    while (top > 0) {
+        const bvh_node_t* node = &tree->nodes[stack[--top]];
+        if (is_leaf(node)) {
+            if (!visit(node - tree->nodes, node->data, user)) {
+                return 0;
+            }
+        } else if (top + 2 <= STACK_SIZE) {
+            stack[top++] = node->left;
+            stack[top++] = node->right;
+        }
+    }
+    return 1;
+}
+
+void bvh_query_aabb(const bvh_t* tree, aabb_t box, bvh_visit_t visit, void* user) {
+    if (tree->root == BVH_NONE) {
+        return;
+    }
+
+    uint32_t stack[STACK_SIZE];
+    uint32_t top = 0;
+    stack[top++] = tree->root;
+
+    while (top > 0) {
+        uint32_t index = stack[--top];
+        const bvh_node_t* node = &tree->nodes[index];
+        if (!aabb_overlaps(node->box, box)) {
+            continue;
+        }
+
+        if (is_leaf(node)) {
+            if (!visit(index, node->data, user)) {
+                return;
+            }
+        } else if (top + 2 <= STACK_SIZE) {
+            stack[top++] = node->left;
+            stack[top++] = node->right;
+        }
+    }
+}
+
+void bvh_query_sphere(const bvh_t* tree, vec3_t center, float radius, bvh_visit_t visit, void* user) {
+    if (tree->root == BVH_NONE) {
+        return;
+    }
+
+    uint32_t stack[STACK_SIZE];
+    uint32_t top = 0;
+    stack[top++] = tree->root;
+
+    while (top > 0) {
+        uint32_t index = stack[--top];
+        const bvh_node_t* node = &tree->nodes[index];
+
+        // distance from the center to the closest point of the box
+        vec3_t closest = vec3_max(node->box.min, vec3_min(center, node->box.max));
+        vec3_t d = vec3_sub(closest, center);
+        if (vec3_dot(d, d) > radius * radius) {
+            continue;
+        }
+
+        if (is_leaf(node)) {
+            if (!visit(index, node->data, user)) {
+                return;
+            }
+        } else if (top + 2 <= STACK_SIZE) {
+            stack[top++] = node->left;
+            stack[top++] = node->right;
+        }
+    }
+}
+
+// 0 outside, 1 intersecting, 2 inside
+static int classify_box(const frustum_t* frustum, aabb_t box) {
+    vec3_t center = vec3_scale(vec3_add(box.min, box.max), 0.5f);
+    vec3_t extents = vec3_scale(vec3_sub(box.max, box.min), 0.5f);
+
+    int result = 2;
+    for (int i = 0; i < 6; i++) {
+        const vec4_t* p = &frustum->planes[i];
+        float distance = p->x * center.x + p->y * center.y + p->z * center.z + p->w;
+        float radius = fabsf(p->x) * extents.x + fabsf(p->y) * extents.y + fabsf(p->z) * extents.z;
+        if (distance + radius < 0.0f) {
+            return 0;
+        }
+        if (distance - radius < 0.0f) {
+            result = 1;
+        }
+    }
+    return result;
+}
+
+void bvh_query_frustum(const bvh_t* tree, const frustum_t* frustum, bvh_visit_t visit, void* user) {
+    if (tree->root == BVH_NONE) {
+        return;
+    }
+
+    uint32_t stack[STACK_SIZE];
+    uint32_t top = 0;
+    stack[top++] = tree->root;
+
+    while (top > 0) {
+        uint32_t index = stack[--top];
+        const bvh_node_t* node = &tree->nodes[index];
+
+        int result = classify_box(frustum, node->box);
+        if (result == 0) {
+            continue;
+        }
+
+        // everything below a node that is completely inside is visible
+        if (result == 2 || is_leaf(node)) {
+            if (!visit_all(tree, index, visit, user)) {
+                return;
+            }
+        } else if (top + 2 <= STACK_SIZE) {
+            stack[top++] = node->left;
+            stack[top++] = node->right;
+        }
+    }
+}
+
+// slab test, returns the entry distance or a negative value on a miss
+static float ray_box(aabb_t box, vec3_t origin, vec3_t inv_dir, float max_distance) {
+    float t_min = 0.0f;
+    float t_max = max_distance;
+    for (int i = 0; i < 3; i++) {
+        float t0 = (box.min.v[i] - origin.v[i]) * inv_dir.v[i];
+        float t1 = (box.max.v[i] - origin.v[i]) * inv_dir.v[i];
+        if (t0 > t1) {
+            float tmp = t0;
+            t0 = t1;
+            t1 = tmp;
+        }
+        t_min = t0 > t_min ? t0 : t_min;
+        t_max = t1 < t_max ? t1 : t_max;
+        if (t_min > t_max) {
+            return -1.0f;
+        }
+    }
+    return t_min;
+}
+
+uint32_t bvh_raycast(const bvh_t* tree, vec3_t origin, vec3_t dir, float max_distance, bvh_ray_visit_t visit, void* user, float* distance) {
+    uint32_t hit = BVH_NONE;
+    if (tree->root == BVH_NONE) {
+        return hit;
+    }
+
+    vec3_t inv_dir = vec3(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+
+    uint32_t stack[STACK_SIZE];
+    uint32_t top = 0;
+    stack[top++] = tree->root;
+
+    while (top > 0) {
+        uint32_t index = stack[--top];
+        const bvh_node_t* node = &tree->nodes[index];
+
+        if (ray_box(node->box, origin, inv_dir, max_distance) < 0.0f) {
+            continue;
+        }
+
+        if (is_leaf(node)) {
+            // every hit shortens the ray so later boxes are rejected sooner
+            float t = visit(index, node->data, origin, dir, max_distance, user);
+            if (t >= 0.0f && t <= max_distance) {
+                max_distance = t;
+                hit = index;
+            }
+        } else if (top + 2 <= STACK_SIZE) {
+            stack[top++] = node->left;
+            stack[top++] = node->right;
+        }
+    }
+
+    if (hit != BVH_NONE && distance != NULL) {
+        *distance = max_distance;
+    }
+    return hit;
+}
+
+/* spatial index */
+
+static bvh_t spatial_index = { .root = BVH_NONE, .free_list = BVH_NONE, .margin = BVH_DEFAULT_MARGIN };
+
+// bounds added since the last update, inserted as one batch
+static entity_t** pending = NULL;
+static uint32_t pending_count = 0;
+static uint32_t pending_capacity = 0;
+
+// hooks can run from parallel systems
+static pthread_mutex_t index_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static transform_t* find_transform(entity_t* ent) {
+    uint64_t id = GET_ID(transform_t);
+    return id != 0 ? ent->components[id - 1] : NULL;
+}
+
+static aabb_t entity_box(entity_t* ent, const bounds_t* bounds) {
+    vec3_t center = bounds->center;
+    vec3_t extents = bounds->extents;
+
+    transform_t* transform = find_transform(ent);
+    if (transform != NULL) {
+        transform_bounds(bounds, get_transform_world(*transform), &center, &extents);
+    }
+
+    return (aabb_t){ .min = vec3_sub(center, extents), .max = vec3_add(center, extents) };
+}
+
+static void on_bounds_added(entity_t* ent, void* component) {
+    bounds_t* bounds = component;
+    bounds->proxy = BVH_NONE;
+
+    pthread_mutex_lock(&index_lock);
+
+    if (pending_count == pending_capacity) {
+        pending_capacity = pending_capacity ? pending_capacity * 2 : 256;
+        pending = realloc(pending, pending_capacity * sizeof(entity_t*));
+    }
+    pending[pending_count++] = ent;
+
+    pthread_mutex_unlock(&index_lock);
+}
+
+static void on_bounds_removed(entity_t* ent, void* component) {
+    bounds_t* bounds = component;
+
+    pthread_mutex_lock(&index_lock);
+
+    if (bounds->proxy != BVH_NONE) {
+        bvh_remove(&spatial_index, bounds->proxy);
+        bounds->proxy = BVH_NONE;
+    } else {
+        for (uint32_t i = 0; i < pending_count; i++) {
+            if (pending[i] == ent) {
+                pending[i] = pending[--pending_count];
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&index_lock);
+}
+
+REGISTER_COMP_HOOKS(bounds_t, on_bounds_added, on_bounds_removed);
+
+void update_spatial_index() {
+    pthread_mutex_lock(&index_lock);
+
+    uint64_t bounds_id = GET_ID(bounds_t);
+
+    if (pending_count > 0) {
+        aabb_t* boxes = malloc(pending_count * sizeof(aabb_t));
+        uint32_t* proxies = malloc(pending_count * sizeof(uint32_t));
+        for (uint32_t i = 0; i < pending_count; i++) {
+            boxes[i] = entity_box(pending[i], pending[i]->components[bounds_id - 1]);
+        }
+
+        bvh_insert_batch(&spatial_index, boxes, (void**)pending, pending_count, proxies);
+
+        for (uint32_t i = 0; i < pending_count; i++) {
+            bounds_t* bounds = pending[i]->components[bounds_id - 1];
+            bounds->proxy = proxies[i];
+        }
+
+        TRACE("Inserted %d entities into the spatial index.", pending_count);
+
+        free(boxes);
+        free(proxies);
+        pending_count = 0;
+    }
+
+    // only leaves whose transform was recomputed this frame can have moved
+    uint32_t moved = 0;
+    for (uint32_t i = 0; i < spatial_index.node_count; i++) {
+        bvh_node_t* node = &spatial_index.nodes[i];
+        if (node->height != 0 || node->data == NULL) {
+            continue;
+        }
+
+        entity_t* ent = node->data;
+        transform_t* transform = find_transform(ent);
+        if (transform == NULL || !was_transform_updated(*transform)) {
+            continue;
+        }
+
+        // the node array can move while reinserting
+        moved += bvh_move(&spatial_index, i, entity_box(ent, ent->components[bounds_id - 1]));
+    }
+
+    if (moved > 0) {
+        TRACE("Reinserted %d moved entities into the spatial index.", moved);
+    }
+
+    pthread_mutex_unlock(&index_lock);
+}
+
+// after update_transforms at the front of PRE_RENDER
+REGISTER_SYSTEM(update_spatial_index, PRE_RENDER);
+
+const bvh_t* get_spatial_index() {
+    return &spatial_index;
+}
+
+typedef struct {
+    entity_t** list;
+    uint32_t count;
+    uint32_t capacity;
+} entity_list_t;
+
+static int collect_entity(uint32_t proxy, void* data, void* user) {
+    (void)proxy;
+    entity_list_t* result = user;
+    if (result->count + 1 >= result->capacity) {
+        result->capacity = result->capacity ? result->capacity * 2 : 64;
+        result->list = realloc(result->list, result->capacity * sizeof(entity_t*));
+    }
+    result->list[result->count++] = data;
+    return 1;
+}
+
+static entity_t** finish_list(entity_list_t* result) {
+    if (result->list == NULL) {
+        result->list = malloc(sizeof(entity_t*));
+    }
+    result->list[result->count] = NULL;
+    return result->list;
+}
+
+entity_t** query_entities_aabb(aabb_t box) {
+    entity_list_t result = {0};
+    bvh_query_aabb(&spatial_index, box, collect_entity, &result);
+    return finish_list(&result);
+}
+
+entity_t** query_entities_sphere(vec3_t center, float radius) {
+    entity_list_t result = {0};
+    bvh_query_sphere(&spatial_index, center, radius, collect_entity, &result);
+    return finish_list(&result);
+}
+
+entity_t** query_entities_frustum(const frustum_t* frustum) {
+    entity_list_t result = {0};
+    bvh_query_frustum(&spatial_index, frustum, collect_entity, &result);
+    return finish_list(&result);
+}
+
+static float ray_entity(uint32_t proxy, void* data, vec3_t origin, vec3_t dir, float max_distance, void* user) {
+    (void)proxy;
+    (void)user;
+    entity_t* ent = data;
+    aabb_t box = entity_box(ent, ent->components[GET_ID(bounds_t) - 1]);
+    return ray_box(box, origin, vec3(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z), max_distance);
+}
+
+entity_t* raycast_entities(vec3_t origin, vec3_t dir, float max_distance, float* distance) {
+    uint32_t hit = bvh_raycast(&spatial_index, origin, dir, max_distance, ray_entity, NULL, distance);
+    return hit == BVH_NONE ? NULL : spatial_index.nodes[hit].data;
+}
+
+void cleanup_spatial_index() {
+    destroy_bvh(&spatial_index);
+    free(pending);
+    pending = NULL;
+    pending_count = pending_capacity = 0;
+}
+
+REGISTER_SYSTEM(cleanup_spatial_index, CLEANUP);
@@ -0,0 +1,84 @@
+#ifndef OVERTURE_BVH
+#define OVERTURE_BVH
+
+#include <stdint.h>
+#include "core/culling.h"
+#include "core/ecs.h"
+#include "overture/math.h"
+
+/*
+ * Dynamic aabb tree. Leaves store a box grown by the tree's margin so small moves don't touch
+ * the tree, moves outside of it reinsert the leaf. Inserts pick the sibling by surface area
+ * and the tree is kept balanced with rotations. All nodes live in one array and are addressed
+ * by index, a leaf's index (its proxy) stays the same until it is removed.
+ *
+ * Queries test against the grown boxes, exact tests are up to the callback.
+ */
+
+#define BVH_NONE UINT32_MAX
+#define BVH_DEFAULT_MARGIN 0.1f
+
+typedef struct {
+    vec3_t min;
+    vec3_t max;
+} aabb_t;
+
+typedef struct {
+    aabb_t box;
+    uint32_t parent; // next free node while on the free list
+    uint32_t left;
+    uint32_t right; // both BVH_NONE on leaves
+    int32_t height; // 0 on leaves, -1 when free
+    void* data;
+} bvh_node_t;
+
+typedef struct {
+    bvh_node_t* nodes;
+    uint32_t node_count;
+    uint32_t capacity;
+    uint32_t root;
+    uint32_t free_list;
+    uint32_t leaf_count;
+    float margin;
+} bvh_t;
+
+// return 0 to stop the query
+typedef int (*bvh_visit_t)(uint32_t proxy, void* data, void* user);
+// returns the distance along the ray the leaf's contents were hit at, or a negative value for a miss
+typedef float (*bvh_ray_visit_t)(uint32_t proxy, void* data, vec3_t origin, vec3_t dir, float max_distance, void* user);
+
+bvh_t create_bvh(float margin);
+void destroy_bvh(bvh_t* tree);
+
+uint32_t bvh_insert(bvh_t* tree, aabb_t box, void* data);
+void bvh_remove(bvh_t* tree, uint32_t proxy);
+// returns 1 when the leaf had to be reinserted
+int bvh_move(bvh_t* tree, uint32_t proxy, aabb_t box);
+
+// builds a balanced subtree out of the new leaves and inserts that once, proxies may be NULL
+void bvh_insert_batch(bvh_t* tree, const aabb_t* boxes, void** data, uint32_t count, uint32_t* proxies);
+void bvh_remove_batch(bvh_t* tree, const uint32_t* proxies, uint32_t count);
+
+void bvh_query_aabb(const bvh_t* tree, aabb_t box, bvh_visit_t visit, void* user);
+void bvh_query_sphere(const bvh_t* tree, vec3_t center, float radius, bvh_visit_t visit, void* user);
+void bvh_query_frustum(const bvh_t* tree, const frustum_t* frustum, bvh_visit_t visit, void* user);
+// nearest hit, returns its proxy or BVH_NONE and writes its distance
+uint32_t bvh_raycast(const bvh_t* tree, vec3_t origin, vec3_t dir, float max_distance, bvh_ray_visit_t visit, void* user, float* distance);
+
+/*
+ * Spatial index over every entity with a bounds_t, leaves are added and removed by component
+ * hooks and moved by update_spatial_index() (PRE_RENDER) when their transform changed. New
+ * entities are inserted as one batch at the next update, so queries only see them after that.
+ * Query results are NULL terminated lists that have to be freed, like FILTER_ENTITIES.
+ */
+
+void update_spatial_index();
+const bvh_t* get_spatial_index();
+
+entity_t** query_entities_aabb(aabb_t box);
+entity_t** query_entities_sphere(vec3_t center, float radius);
+entity_t** query_entities_frustum(const frustum_t* frustum);
+// tests the exact world bounds, NULL on a miss
+entity_t* raycast_entities(vec3_t origin, vec3_t dir, float max_distance, float* distance);
+
+#endif
@@ -0,0 +1,66 @@
+#include "core/camera.h"
+#include "core/transform.h"
+
+REGISTER_COMPONENT(camera_t);
+
+camera_t perspective_camera(float fovy, float aspect, float near, float far) {
+    return (camera_t){
+        .view = mat4_identity(),
+        .projection = mat4_perspective(fovy, aspect, near, far),
+        .near = near,
+        .far = far,
+        .active = 1,
+    };
+}
+
+camera_t ortho_camera(float left, float right, float bottom, float top, float near, float far) {
+    return (camera_t){
+        .view = mat4_identity(),
+        .projection = mat4_ortho(left, right, bottom, top, near, far),
+        .near = near,
+        .far = far,
+        .active = 1,
+    };
+}
+
+void set_camera_look_at(camera_t* camera, vec3_t eye, vec3_t target, vec3_t up) {
+    camera->view = mat4_look_at(eye, target, up);
+}
+
+mat4_t get_camera_view_projection(const camera_t* camera) {
+    return mat4_mul(&camera->projection, &camera->view);
+}
+
+camera_t* get_active_camera(entity_t** entity) {
+    entity_t** list = FILTER_ENTITIES(camera_t);
+    camera_t* active = NULL;
+
+    for (entity_t** ent_ptr = list; *ent_ptr != NULL; ent_ptr++) {
+        camera_t* camera = get_comp(*ent_ptr, GET_ID(camera_t));
+        if (camera->active) {
+            active = camera;
+            if (entity != NULL) {
+                *entity = *ent_ptr;
+            }
+            break;
+        }
+    }
+
+    free(list);
+    return active;
+}
+
+camera_t* update_camera() {
+    entity_t** list = FILTER_ENTITIES(camera_t, transform_t);
+
+    for (entity_t** ent_ptr = list; *ent_ptr != NULL; ent_ptr++) {
+        camera_t* camera = get_comp(*ent_ptr, GET_ID(camera_t));
+        transform_t* transform = get_comp(*ent_ptr, GET_ID(transform_t));
+        if (camera->active) {
+            camera->view = mat4_inverse(get_transform_world(*transform));
+        }
+    }
+
+    free(list);
+    return get_active_camera(NULL);
+}
@@ -0,0 +1,33 @@
+#ifndef OVERTURE_CAMERA
+#define OVERTURE_CAMERA
+
+#include <stdint.h>
+#include "core/ecs.h"
+#include "overture/math.h"
+
+/*
+ * Camera component, the first active camera is the one the scene is culled and rendered with.
+ * When the camera's entity also has a transform_t its view is the inverse of the transform's
+ * world matrix, refreshed by update_camera().
+ */
+
+typedef struct {
+    mat4_t view;
+    mat4_t projection;
+    float near;
+    float far;
+    uint8_t active;
+} camera_t;
+
+camera_t perspective_camera(float fovy, float aspect, float near, float far);
+camera_t ortho_camera(float left, float right, float bottom, float top, float near, float far);
+
+void set_camera_look_at(camera_t* camera, vec3_t eye, vec3_t target, vec3_t up);
+mat4_t get_camera_view_projection(const camera_t* camera);
+
+// NULL when there is no active camera, entity is optional
+camera_t* get_active_camera(entity_t** entity);
+// syncs active cameras with their transforms, returns the active camera
+camera_t* update_camera();
+
+#endif
@@ -0,0 +1,352 @@
+#include "core/culling.h"
+#include "core/camera.h"
+#include "core/log.h"
+#include "core/systems.h"
+#include "core/transform.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// below this many entities spawning threads costs more than it saves
+#define PARALLEL_THRESHOLD 16384
+#define MAX_THREADS 16
+
+REGISTER_COMPONENT(bounds_t);
+
+bounds_t aabb_bounds(vec3_t min, vec3_t max) {
+    vec3_t extents = vec3_scale(vec3_sub(max, min), 0.5f);
+    return (bounds_t){
+        .center = vec3_scale(vec3_add(min, max), 0.5f),
+        .extents = extents,
+        .radius = vec3_length(extents),
+        .proxy = UINT32_MAX,
+    };
+}
+
+bounds_t sphere_bounds(vec3_t center, float radius) {
+    return (bounds_t){
+        .center = center,
+        .extents = vec3(radius, radius, radius),
+        .radius = radius,
+        .proxy = UINT32_MAX,
+    };
+}
+
+// box center goes through the matrix, the extents through its absolute value
+void transform_bounds(const bounds_t* bounds, const mat4_t* m, vec3_t* center, vec3_t* extents) {
+    vec3_t e = bounds->extents;
+    *center = mat4_mul_point(m, bounds->center);
+    *extents = vec3(fabsf(m->m[0]) * e.x + fabsf(m->m[4]) * e.y + fabsf(m->m[8]) * e.z,
+                    fabsf(m->m[1]) * e.x + fabsf(m->m[5]) * e.y + fabsf(m->m[9]) * e.z,
+                    fabsf(m->m[2]) * e.x + fabsf(m->m[6]) * e.y + fabsf(m->m[10]) * e.z);
+}
+
+frustum_t frustum_from_matrix(const mat4_t* m) {
+    // rows of the column major matrix
+    vec4_t rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = vec4(m->m[i], m->m[4 + i], m->m[8 + i], m->m[12 + i]);
+    }
+
+    frustum_t frustum;
+    frustum.planes[0] = vec4_add(rows[3], rows[0]); // left
+    frustum.planes[1] = vec4_sub(rows[3], rows[0]); // right
+    frustum.planes[2] = vec4_add(rows[3], rows[1]); // bottom
+    frustum.planes[3] = vec4_sub(rows[3], rows[1]); // top
+    frustum.planes[4] = vec4_add(rows[3], rows[2]); // near
+    frustum.planes[5] = vec4_sub(rows[3], rows[2]); // far
+
+    for (int i = 0; i < 6; i++) {
+        vec4_t p = frustum.planes[i];
+        float length = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+        frustum.planes[i] = vec4_scale(p, 1.0f / length);
+    }
+
+    return frustum;
+}
+
+int frustum_test_aabb(const frustum_t* frustum, vec3_t center, vec3_t extents) {
+    for (int i = 0; i < 6; i++) {
+        const vec4_t* p = &frustum->planes[i];
+        float distance = p->x * center.x + p->y * center.y + p->z * center.z + p->w;
+        float radius = fabsf(p->x) * extents.x + fabsf(p->y) * extents.y + fabsf(p->z) * extents.z;
+        if (distance + radius < 0.0f) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int frustum_test_sphere(const frustum_t* frustum, vec3_t center, float radius) {
+    for (int i = 0; i < 6; i++) {
+        const vec4_t* p = &frustum->planes[i];
+        if (p->x * center.x + p->y * center.y + p->z * center.z + p->w < -radius) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+uint32_t frustum_cull_aabbs(const frustum_t* frustum,
+                            const float* cx, const float* cy, const float* cz,
+                            const float* ex, const float* ey, const float* ez,
+                            uint32_t count, uint32_t* visible) {
+    uint32_t visible_count = 0;
+    uint32_t i = 0;
+
+#if defined(OVERTURE_MATH_SSE)
+    __m128 plane[6][4];
+    __m128 plane_abs[6][3];
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    for (int p = 0; p < 6; p++) {
+        for (int c = 0; c < 4; c++) {
+            plane[p][c] = _mm_set1_ps(frustum->planes[p].v[c]);
+        }
+        for (int c = 0; c < 3; c++) {
+            plane_abs[p][c] = _mm_andnot_ps(sign_mask, plane[p][c]);
+        }
+    }
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(cx + i), y = _mm_loadu_ps(cy + i), z = _mm_loadu_ps(cz + i);
+        __m128 hx = _mm_loadu_ps(ex + i), hy = _mm_loadu_ps(ey + i), hz = _mm_loadu_ps(ez + i);
+
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane[p][0], x), _mm_mul_ps(plane[p][1], y)),
+                                         _mm_add_ps(_mm_mul_ps(plane[p][2], z), plane[p][3]));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_abs[p][0], hx), _mm_mul_ps(plane_abs[p][1], hy)),
+                                       _mm_mul_ps(plane_abs[p][2], hz));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+
+        int mask = ~_mm_movemask_ps(outside) & 0xf;
+        while (mask) {
+            int lane = __builtin_ctz(mask);
+            visible[visible_count++] = i + lane;
+            mask &= mask - 1;
+        }
+    }
+#elif defined(OVERTURE_MATH_NEON)
+    float32x4_t plane[6][4];
+    float32x4_t plane_abs[6][3];
+    for (int p = 0; p < 6; p++) {
+        for (int c = 0; c < 4; c++) {
+            plane[p][c] = vdupq_n_f32(frustum->planes[p].v[c]);
+        }
+        for (int c = 0; c < 3; c++) {
+            plane_abs[p][c] = vabsq_f32(plane[p][c]);
+        }
+    }
+
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t x = vld1q_f32(cx + i), y = vld1q_f32(cy + i), z = vld1q_f32(cz + i);
+        float32x4_t hx = vld1q_f32(ex + i), hy = vld1q_f32(ey + i), hz = vld1q_f32(ez + i);
+
+        uint32x4_t outside = vdupq_n_u32(0);
+        for (int p = 0; p < 6; p++) {
+            float32x4_t distance = vmlaq_f32(vmlaq_f32(vmlaq_f32(plane[p][3], plane[p][0], x), plane[p][1], y), plane[p][2], z);
+            distance = vmlaq_f32(vmlaq_f32(vmlaq_f32(distance, plane_abs[p][0], hx), plane_abs[p][1], hy), plane_abs[p][2], hz);
+            outside = vorrq_u32(outside, vcltq_f32(distance, vdupq_n_f32(0.0f)));
+        }
+
+        uint32_t lanes[4];
+        vst1q_u32(lanes, outside);
+        for (int lane = 0; lane < 4; lane++) {
+            if (!lanes[lane]) {
+                visible[visible_count++] = i + lane;
+            }
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        if (frustum_test_aabb(frustum, vec3(cx[i], cy[i], cz[i]), vec3(ex[i], ey[i], ez[i]))) {
+            visible[visible_count++] = i;
+        }
+    }
+
+    return visible_count;
+}
+
+// world space boxes of this frame's candidates in soa layout, reused between frames
+static struct {
+    float* cx;
+    float* cy;
+    float* cz;
+    float* ex;
+    float* ey;
+    float* ez;
+    uint32_t* indices;
+} world;
+static uint32_t world_capacity = 0;
+
+static entity_t** candidates = NULL;
+static entity_t** visible = NULL;
+static uint32_t visible_count = 0;
+static uint32_t visible_capacity = 0;
+
+static frustum_t view_frustum;
+
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    uint32_t visible;
+} cull_range_t;
+
+static void reserve_world(uint32_t count) {
+    if (count <= world_capacity) {
+        return;
+    }
+
+    world_capacity = world_capacity ? world_capacity : 1024;
+    while (world_capacity < count) {
+        world_capacity *= 2;
+    }
+
+    world.cx = realloc(world.cx, world_capacity * sizeof(float));
+    world.cy = realloc(world.cy, world_capacity * sizeof(float));
+    world.cz = realloc(world.cz, world_capacity * sizeof(float));
+    world.ex = realloc(world.ex, world_capacity * sizeof(float));
+    world.ey = realloc(world.ey, world_capacity * sizeof(float));
+    world.ez = realloc(world.ez, world_capacity * sizeof(float));
+    world.indices = realloc(world.indices, world_capacity * sizeof(uint32_t));
+}
+
+static void* cull_range(void* arg) {
+    cull_range_t* range = arg;
+
+    // the filter guarantees both components, skip get_comp's signature checks and logging
+    uint64_t transform_id = GET_ID(transform_t);
+    uint64_t bounds_id = GET_ID(bounds_t);
+
+    for (uint32_t i = range->start; i < range->end; i++) {
+        transform_t* transform = candidates[i]->components[transform_id - 1];
+        bounds_t* bounds = candidates[i]->components[bounds_id - 1];
+
+        vec3_t c, e;
+        transform_bounds(bounds, get_transform_world(*transform), &c, &e);
+
+        world.cx[i] = c.x;
+        world.cy[i] = c.y;
+        world.cz[i] = c.z;
+        world.ex[i] = e.x;
+        world.ey[i] = e.y;
+        world.ez[i] = e.z;
+    }
+
+    uint32_t count = range->end - range->start;
+    uint32_t* indices = &world.indices[range->start];
+    range->visible = frustum_cull_aabbs(&view_frustum,
+                                        world.cx + range->start, world.cy + range->start, world.cz + range->start,
+                                        world.ex + range->start, world.ey + range->start, world.ez + range->start,
+                                        count, indices);
+
+    // compacted into the front of this range, ranges are joined in order afterwards
+    for (uint32_t i = 0; i < range->visible; i++) {
+        visible[range->start + i] = candidates[range->start + indices[i]];
+    }
+
+    return NULL;
+}
+
+void cull_entities() {
+    camera_t* camera = update_camera();
+
+    free(candidates);
+    candidates = FILTER_ENTITIES(transform_t, bounds_t);
+
+    uint32_t count = 0;
+    while (candidates[count] != NULL) {
+        count++;
+    }
+
+    reserve_world(count);
+    if (count + 1 > visible_capacity) {
+        visible_capacity = world_capacity + 1;
+        visible = realloc(visible, visible_capacity * sizeof(entity_t*));
+    }
+
+    if (camera == NULL) {
+        memcpy(visible, candidates, count * sizeof(entity_t*));
+        visible_count = count;
+        visible[visible_count] = NULL;
+        return;
+    }
+
+    mat4_t view_projection = get_camera_view_projection(camera);
+    view_frustum = frustum_from_matrix(&view_projection);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t thread_count = cpus > 1 ? (uint32_t)cpus : 1;
+    if (thread_count > MAX_THREADS) {
+        thread_count = MAX_THREADS;
+    }
+    if (count < PARALLEL_THRESHOLD) {
+        thread_count = 1;
+    }
+
+    // ranges are multiples of 4 so only the last one has a scalar tail
+    pthread_t threads[MAX_THREADS];
+    cull_range_t ranges[MAX_THREADS];
+    uint32_t per_thread = (count / thread_count + 3) & ~3u;
+
+    for (uint32_t t = 0; t < thread_count; t++) {
+        ranges[t].start = t * per_thread < count ? t * per_thread : count;
+        ranges[t].end = (t + 1) * per_thread < count && t + 1 < thread_count ? (t + 1) * per_thread : count;
+        ranges[t].visible = 0;
+    }
+
+    for (uint32_t t = 1; t < thread_count; t++) {
+        pthread_create(&threads[t], NULL, cull_range, &ranges[t]);
+    }
+    cull_range(&ranges[0]);
+    for (uint32_t t = 1; t < thread_count; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    visible_count = ranges[0].visible;
+    for (uint32_t t = 1; t < thread_count; t++) {
+        memmove(&visible[visible_count], &visible[ranges[t].start], ranges[t].visible * sizeof(entity_t*));
+        visible_count += ranges[t].visible;
+    }
+    visible[visible_count] = NULL;
+
+    TRACE("Culled %d of %d entities.", count - visible_count, count);
+}
+
+// after update_transforms at the front of PRE_RENDER
+REGISTER_SYSTEM(cull_entities, PRE_RENDER);
+
+entity_t** get_visible_entities(uint32_t* count) {
+    if (count != NULL) {
+        *count = visible_count;
+    }
+    return visible;
+}
+
+const frustum_t* get_view_frustum() {
+    return &view_frustum;
+}
+
+void cleanup_culling() {
+    free(world.cx);
+    free(world.cy);
+    free(world.cz);
+    free(world.ex);
+    free(world.ey);
+    free(world.ez);
+    free(world.indices);
+    memset(&world, 0, sizeof(world));
+    world_capacity = 0;
+
+    free(candidates);
+    free(visible);
+    candidates = NULL;
+    visible = NULL;
+    visible_count = visible_capacity = 0;
+}
+
+REGISTER_SYSTEM(cleanup_culling, CLEANUP);
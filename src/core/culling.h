@@ -0,0 +1,51 @@
+#ifndef OVERTURE_CULLING
+#define OVERTURE_CULLING
+
+#include <stdint.h>
+#include "core/ecs.h"
+#include "overture/math.h"
+
+/*
+ * Frustum culling of every entity with a transform_t and a bounds_t against the active camera.
+ * cull_entities() runs in PRE_RENDER after the transforms are propagated, it transforms the
+ * bounds to world space and tests them 4 at a time with SSE/NEON, split over threads once there
+ * are enough of them. Render systems iterate get_visible_entities() instead of filtering.
+ *
+ * The frustum functions don't touch the ecs so they can be used on their own.
+ */
+
+// local space box, the sphere around it is kept for cheaper tests
+typedef struct {
+    vec3_t center;
+    vec3_t extents; // half size
+    float radius;
+    uint32_t proxy; // leaf in the spatial index, managed by bvh.c
+} bounds_t;
+
+bounds_t aabb_bounds(vec3_t min, vec3_t max);
+bounds_t sphere_bounds(vec3_t center, float radius);
+// world space box around the transformed bounds
+void transform_bounds(const bounds_t* bounds, const mat4_t* m, vec3_t* center, vec3_t* extents);
+
+// planes point inwards, a point is inside when dot(plane.xyz, p) + plane.w >= 0
+typedef struct {
+    vec4_t planes[6];
+} frustum_t;
+
+frustum_t frustum_from_matrix(const mat4_t* view_projection);
+int frustum_test_aabb(const frustum_t* frustum, vec3_t center, vec3_t extents);
+int frustum_test_sphere(const frustum_t* frustum, vec3_t center, float radius);
+
+// boxes in soa layout, writes the indices of the visible ones and returns how many there are
+uint32_t frustum_cull_aabbs(const frustum_t* frustum,
+                            const float* cx, const float* cy, const float* cz,
+                            const float* ex, const float* ey, const float* ez,
+                            uint32_t count, uint32_t* visible);
+
+// valid until the next cull, every entity is visible when there is no active camera
+entity_t** get_visible_entities(uint32_t* count);
+const frustum_t* get_view_frustum();
+
+void cull_entities();
+
+#endif
@@ -8,17 +8,39 @@
 #include <stdlib.h>
 #include <string.h>
 
+// entities made by instantiate_batch() live in one block with their component arrays, signatures
+// and components, freed once the last of them is removed
+typedef struct {
+    size_t size;
+    uint32_t alive;
+} entity_batch_t;
+
 typedef struct entity_node_t {
     entity_t entity;
     struct entity_node_t* next;
+    struct entity_node_t* prev;
+    entity_batch_t* batch; // NULL when made by create_entity()
 } entity_node_t;
 
 static entity_node_t* entity_head = NULL;
 static entity_node_t* entity_tail = NULL;
 
+// by id, NULL once removed, ids are never reused
+static entity_node_t** entity_index = NULL;
+static uint64_t entity_index_size = 0;
+
 static uint64_t ent_num = 0;
 static uint64_t comp_num = 0;
 
+typedef struct {
+    comp_hook_t on_add;
+    comp_hook_t on_remove;
+} comp_hooks_t;
+
+// indexed by component id - 1
+static comp_hooks_t* comp_hooks = NULL;
+static uint64_t comp_hooks_size = 0;
+
 // TODO: IMPORTANT: error handling in case realloc doesn't work use tmp ptrs before moving pointer
 
 void add_sig(signature_t s1, const signature_t s2) {
@@ -47,6 +69,17 @@ static int contains_sig(const signature_t s1, const signature_t s2) {
     return result;
 }
 
+// nothing in common
+static int excludes_sig(const signature_t s1, const signature_t s2) {
+    uint64_t n = comp_num / CHAR_BIT + 1;
+    while (n--) {
+        if (s1[n] & s2[n]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
 signature_t id_to_sig(uint64_t id) {
     signature_t signature = calloc(comp_num / CHAR_BIT + 1, sizeof(unsigned char));
     uint64_t n = comp_num / CHAR_BIT + 1;
@@ -85,16 +118,42 @@ signature_t create_sig(uint32_t n, ...) {
     return signature;
 }
 
+static int in_batch(entity_node_t* node, void* ptr) {
+    return node->batch != NULL && (uint8_t*)ptr >= (uint8_t*)node->batch && (uint8_t*)ptr < (uint8_t*)node->batch + node->batch->size;
+}
+
+// frees what the entity owns on its own, batch memory goes with the batch
+static void release(entity_node_t* node, void* ptr) {
+    if (!in_batch(node, ptr)) {
+        free(ptr);
+    }
+}
+
+// realloc for arrays that may be part of a batch
+static void* resize(entity_node_t* node, void* ptr, size_t old_size, size_t size) {
+    if (!in_batch(node, ptr)) {
+        return realloc(ptr, size);
+    }
+    void* moved = malloc(size);
+    memcpy(moved, ptr, old_size < size ? old_size : size);
+    return moved;
+}
+
 // DONE
 uint64_t register_new_comp() {
     comp_num++;
 
     entity_node_t* temp = entity_head;
     while (temp != NULL) {
-        temp->entity.components = realloc(temp->entity.components, comp_num * sizeof(component_t));
+        temp->entity.components = resize(temp, temp->entity.components, (comp_num - 1) * sizeof(component_t), comp_num * sizeof(component_t));
+        temp->entity.components[comp_num - 1] = NULL;
 
         // maybe we should only realloc when signature overflows
-        temp->entity.signature = realloc(temp->entity.signature, (comp_num / CHAR_BIT + 1) * sizeof(unsigned char));
+        temp->entity.signature = resize(temp, temp->entity.signature, ((comp_num - 1) / CHAR_BIT + 1) * sizeof(unsigned char),
+                                        (comp_num / CHAR_BIT + 1) * sizeof(unsigned char));
+        if (comp_num % CHAR_BIT == 0) {
+            temp->entity.signature[comp_num / CHAR_BIT] = 0;
+        }
         temp = temp->next;
     }
 
@@ -103,6 +162,29 @@ uint64_t register_new_comp() {
     return comp_num;
 }
 
+void set_comp_hooks(uint64_t comp_id, comp_hook_t on_add, comp_hook_t on_remove) {
+    if (comp_id > comp_hooks_size) {
+        comp_hooks = realloc(comp_hooks, comp_id * sizeof(comp_hooks_t));
+        memset(&comp_hooks[comp_hooks_size], 0, (comp_id - comp_hooks_size) * sizeof(comp_hooks_t));
+        comp_hooks_size = comp_id;
+    }
+
+    comp_hooks[comp_id - 1].on_add = on_add;
+    comp_hooks[comp_id - 1].on_remove = on_remove;
+}
+
+static void run_add_hook(entity_t* ent, uint64_t comp_id) {
+    if (comp_id <= comp_hooks_size && comp_hooks[comp_id - 1].on_add != NULL) {
+        comp_hooks[comp_id - 1].on_add(ent, ent->components[comp_id - 1]);
+    }
+}
+
+static void run_remove_hook(entity_t* ent, uint64_t comp_id) {
+    if (comp_id <= comp_hooks_size && comp_hooks[comp_id - 1].on_remove != NULL && ent->components[comp_id - 1] != NULL) {
+        comp_hooks[comp_id - 1].on_remove(ent, ent->components[comp_id - 1]);
+    }
+}
+
 // passed a stack pointer
 void add_comp_cpy(entity_t* ent, uint64_t comp_id, void *data, size_t size) {
     if (ent == NULL) {
@@ -122,6 +204,8 @@ void add_comp_cpy(entity_t* ent, uint64_t comp_id, void *data, size_t size) {
     free(comp_sig);
 
     TRACE("Added component %ld to entity %ld.", comp_id, ent->id);
+
+    run_add_hook(ent, comp_id);
 }
 
 // passed a heap pointer
@@ -141,6 +225,8 @@ void add_comp_store(entity_t* ent, uint64_t comp_id, void *data, size_t size) {
     free(comp_sig);
 
     TRACE("Added component %ld to entity %ld.", comp_id, ent->id);
+
+    run_add_hook(ent, comp_id);
 }
 
 // DONE
@@ -172,7 +258,9 @@ void remove_comp(entity_t* ent, uint64_t comp_id) {
         return;
     }
 
-    free(ent->components[comp_id - 1]);
+    run_remove_hook(ent, comp_id);
+
+    release((entity_node_t*)ent, ent->components[comp_id - 1]);
     ent->components[comp_id - 1] = NULL;
 
     signature_t comp_sig = id_to_sig(comp_id);
@@ -185,6 +273,53 @@ void remove_comp(entity_t* ent, uint64_t comp_id) {
     TRACE("Removed component %ld from entity %ld", comp_id, ent->id);
 }
 
+// same bit id_to_sig() sets, without allocating a signature for it
+void add_tag(entity_t* ent, uint64_t tag_id) {
+    if (ent == NULL) {
+        WARN("Entity does not exist, failed to add tag %ld.", tag_id);
+        return;
+    }
+
+    ent->signature[(tag_id - 1) / CHAR_BIT] |= 1 << ((tag_id - 1) % CHAR_BIT);
+    TRACE("Added tag %ld to entity %ld.", tag_id, ent->id);
+}
+
+void remove_tag(entity_t* ent, uint64_t tag_id) {
+    if (ent == NULL) {
+        WARN("Entity does not exist, cannot remove tag %ld.", tag_id);
+        return;
+    }
+
+    ent->signature[(tag_id - 1) / CHAR_BIT] &= ~(1 << ((tag_id - 1) % CHAR_BIT));
+    TRACE("Removed tag %ld from entity %ld.", tag_id, ent->id);
+}
+
+int has_tag(entity_t* ent, uint64_t tag_id) {
+    if (ent == NULL) {
+        WARN("Entity does not exist.");
+        return 0;
+    }
+
+    return (ent->signature[(tag_id - 1) / CHAR_BIT] >> ((tag_id - 1) % CHAR_BIT)) & 1;
+}
+
+static void index_entities(entity_node_t* nodes, uint64_t count) {
+    uint64_t needed = nodes[0].entity.id + count;
+    if (needed > entity_index_size) {
+        uint64_t size = entity_index_size == 0 ? 1024 : entity_index_size;
+        while (size < needed) {
+            size *= 2;
+        }
+        entity_index = realloc(entity_index, size * sizeof(entity_node_t*));
+        memset(&entity_index[entity_index_size], 0, (size - entity_index_size) * sizeof(entity_node_t*));
+        entity_index_size = size;
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
+        entity_index[nodes[i].entity.id] = &nodes[i];
+    }
+}
+
 // DONE? maybe entity needs to be malloc idk
 entity_t* create_entity() {
     entity_node_t* node = malloc(sizeof(entity_node_t));
@@ -192,8 +327,11 @@ entity_t* create_entity() {
     node->entity.components = calloc(comp_num, sizeof(component_t));
     node->entity.signature = calloc(comp_num / CHAR_BIT + 1, sizeof(unsigned char));
     node->next = NULL;
+    node->prev = entity_tail;
+    node->batch = NULL;
 
     ent_num++;
+    index_entities(node, 1);
 
     TRACE("Created entity %ld.", ent_num - 1);
 
@@ -211,13 +349,9 @@ entity_t* create_entity() {
 
 // DONE
 entity_t* get_ent(uint64_t id) {
-    entity_node_t* temp = entity_head;
-    while (temp != NULL) {
-        if (temp->entity.id == id) {
-            TRACE("Retrieved entity %ld.", id);
-            return &temp->entity;
-        }
-        temp = temp->next;
+    if (id < entity_index_size && entity_index[id] != NULL) {
+        TRACE("Retrieved entity %ld.", id);
+        return &entity_index[id]->entity;
     }
 
     ERROR("Entity %ld does not exist.", id);
@@ -226,39 +360,66 @@ entity_t* get_ent(uint64_t id) {
 
 // DONE unless entity_t is malloc
 void remove_ent(uint64_t id) {
-    entity_node_t* temp = entity_head;
-    while (temp != NULL) {
-        if (temp->next->entity.id == id) {
-            entity_node_t* ent = temp->next;
+    entity_node_t* temp = id < entity_index_size ? entity_index[id] : NULL;
+    if (temp == NULL) {
+        WARN("Entity %ld does not exist, it cannot be removed.", id);
+        return;
+    }
 
-            uint64_t n = comp_num;
-            while (n--) {
-                free(ent->entity.components[n]);
-                ent->entity.components[n] = NULL;
-            }
-            free(ent->entity.signature);
-            ent->entity.signature = NULL;
+    uint64_t n = comp_num;
+    while (n--) {
+        run_remove_hook(&temp->entity, n + 1);
+    }
 
-            temp->next = ent->next;
+    n = comp_num;
+    while (n--) {
+        release(temp, temp->entity.components[n]);
+        temp->entity.components[n] = NULL;
+    }
+    release(temp, temp->entity.components);
+    release(temp, temp->entity.signature);
 
-            free(ent);
-            ent = NULL;
+    if (temp->prev == NULL) {
+        entity_head = temp->next;
+    } else {
+        temp->prev->next = temp->next;
+    }
+    if (temp->next == NULL) {
+        entity_tail = temp->prev;
+    } else {
+        temp->next->prev = temp->prev;
+    }
+    entity_index[id] = NULL;
 
-            TRACE("Removed entity %ld.", id);
-            return;
-        }
-        temp = temp->next;
+    if (temp->batch == NULL) {
+        free(temp);
+    } else if (--temp->batch->alive == 0) {
+        free(temp->batch);
     }
 
-    WARN("Entity %ld does not exist, it cannot be removed.\n", id);
-    return;
+    TRACE("Removed entity %ld.", id);
 }
 
-entity_t** filter_entities(signature_t filter) {
+static int matches(entity_node_t* node, signature_t filter, signature_t exclude) {
+    return contains_sig(node->entity.signature, filter) && (exclude == NULL || excludes_sig(node->entity.signature, exclude));
+}
+
+static void format_sig(char* buff, signature_t signature) {
+    uint64_t n = comp_num / CHAR_BIT + 1;
+    while (n--) {
+        if (n == comp_num / CHAR_BIT) {
+            buff += sprintf(buff, "%8.8B", signature[n]);
+            continue;
+        }
+        buff += sprintf(buff, " %8.8B", signature[n]);
+    }
+}
+
+entity_t** filter_entities_without(signature_t filter, signature_t exclude) {
     uint64_t len = 0;
     entity_node_t* temp = entity_head;
     while (temp != NULL) {
-        if (contains_sig(temp->entity.signature, filter)) {
+        if (matches(temp, filter, exclude)) {
             len += 1;
         }
         temp = temp->next;
@@ -269,7 +430,7 @@ entity_t** filter_entities(signature_t filter) {
     uint64_t idx = 0;
     temp = entity_head;
     while (temp != NULL) {
-        if (contains_sig(temp->entity.signature, filter)) {
+        if (matches(temp, filter, exclude)) {
             list[idx++] = &temp->entity;
         }
         temp = temp->next;
@@ -278,16 +439,164 @@ entity_t** filter_entities(signature_t filter) {
     list[idx++] = NULL;
 
     char buff[100] = "";
-    uint64_t n = comp_num / CHAR_BIT + 1;
-    while (n--) {
-        if (n == comp_num / CHAR_BIT) {
-            sprintf(buff,"%s%8.8B", buff, filter[n]);
+    format_sig(buff, filter);
+    if (exclude == NULL) {
+        TRACE("Filtered %ld entities with signature %s.", len, buff);
+        return list;
+    }
+
+    char exclude_buff[100] = "";
+    format_sig(exclude_buff, exclude);
+    TRACE("Filtered %ld entities with signature %s without %s.", len, buff, exclude_buff);
+
+    return list;
+}
+
+entity_t** filter_entities(signature_t filter) {
+    return filter_entities_without(filter, NULL);
+}
+
+prefab_t* create_prefab() {
+    return calloc(1, sizeof(prefab_t));
+}
+
+void destroy_prefab(prefab_t* prefab) {
+    for (uint32_t i = 0; i < prefab->comp_count; i++) {
+        free(prefab->comps[i].data);
+    }
+    free(prefab->comps);
+    free(prefab);
+}
+
+void set_prefab_comp(prefab_t* prefab, uint64_t comp_id, void* data, size_t size) {
+    prefab_comp_t* comp = NULL;
+    for (uint32_t i = 0; i < prefab->comp_count; i++) {
+        if (prefab->comps[i].comp_id == comp_id) {
+            comp = &prefab->comps[i];
+            free(comp->data);
+        }
+    }
+    if (comp == NULL) {
+        prefab->comps = realloc(prefab->comps, (prefab->comp_count + 1) * sizeof(prefab_comp_t));
+        comp = &prefab->comps[prefab->comp_count++];
+    }
+
+    comp->comp_id = comp_id;
+    comp->size = size;
+    comp->data = NULL;
+    if (size != 0) {
+        comp->data = malloc(size);
+        memcpy(comp->data, data, size);
+    }
+}
+
+void set_prefab_tag(prefab_t* prefab, uint64_t tag_id) {
+    set_prefab_comp(prefab, tag_id, NULL, 0);
+}
+
+size_t set_prefab_comp_packed(prefab_t* prefab, uint64_t comp_id, struct struct_fmt* fmt, unsigned char* buffer) {
+    void* data = calloc(1, fmt->struct_size);
+    size_t read = deserialize(fmt, buffer, data);
+    set_prefab_comp(prefab, comp_id, data, fmt->struct_size);
+    free(data);
+    return read;
+}
+
+#define BATCH_ALIGN 16
+#define ALIGN_UP(x) (((x) + BATCH_ALIGN - 1) & ~(size_t)(BATCH_ALIGN - 1))
+
+void instantiate_batch(prefab_t* prefab, uint32_t count, entity_t** out) {
+    if (count == 0) {
+        return;
+    }
+
+    uint64_t sig_size = comp_num / CHAR_BIT + 1;
+
+    // one block: header, nodes, component arrays, signatures, then a column per component
+    size_t nodes_offset = ALIGN_UP(sizeof(entity_batch_t));
+    size_t arrays_offset = ALIGN_UP(nodes_offset + count * sizeof(entity_node_t));
+    size_t sigs_offset = ALIGN_UP(arrays_offset + count * comp_num * sizeof(component_t));
+    size_t size = ALIGN_UP(sigs_offset + count * sig_size);
+
+    // tags get no column, their slot stays NULL
+    size_t* column_offsets = malloc(prefab->comp_count * sizeof(size_t));
+    for (uint32_t i = 0; i < prefab->comp_count; i++) {
+        column_offsets[i] = size;
+        size = ALIGN_UP(size + count * ALIGN_UP(prefab->comps[i].size));
+    }
+
+    uint8_t* block = calloc(1, size);
+    entity_batch_t* batch = (entity_batch_t*)block;
+    batch->size = size;
+    batch->alive = count;
+
+    // the prefab's signature once, copied to every entity
+    signature_t signature = calloc(sig_size, sizeof(unsigned char));
+    for (uint32_t i = 0; i < prefab->comp_count; i++) {
+        signature_t comp_sig = id_to_sig(prefab->comps[i].comp_id);
+        add_sig(signature, comp_sig);
+        free(comp_sig);
+    }
+
+    entity_node_t* nodes = (entity_node_t*)(block + nodes_offset);
+    for (uint32_t e = 0; e < count; e++) {
+        entity_node_t* node = &nodes[e];
+        node->entity.id = ent_num + e;
+        node->entity.components = (component_t*)(block + arrays_offset) + e * comp_num;
+        node->entity.signature = block + sigs_offset + e * sig_size;
+        memcpy(node->entity.signature, signature, sig_size);
+        node->next = e + 1 < count ? &nodes[e + 1] : NULL;
+        node->prev = e > 0 ? &nodes[e - 1] : entity_tail;
+        node->batch = batch;
+    }
+
+    // column by column, every entity's copy of a component sits next to the others
+    for (uint32_t i = 0; i < prefab->comp_count; i++) {
+        prefab_comp_t* comp = &prefab->comps[i];
+        if (comp->size == 0) {
             continue;
         }
-        sprintf(buff,"%s %8.8B", buff, filter[n]);
+        size_t stride = ALIGN_UP(comp->size);
+        uint8_t* column = block + column_offsets[i];
+        for (uint32_t e = 0; e < count; e++) {
+            memcpy(column + e * stride, comp->data, comp->size);
+            nodes[e].entity.components[comp->comp_id - 1] = column + e * stride;
+        }
     }
 
-    TRACE("Filtered %ld entities with signature %s.", len, buff);
+    if (entity_head == NULL) {
+        entity_head = &nodes[0];
+    } else {
+        entity_tail->next = &nodes[0];
+    }
+    entity_tail = &nodes[count - 1];
+    ent_num += count;
+    index_entities(nodes, count);
 
-    return list;
+    free(signature);
+    free(column_offsets);
+
+    TRACE("Instantiated %d entities, %ld to %ld.", count, ent_num - count, ent_num - 1);
+
+    for (uint32_t i = 0; i < prefab->comp_count; i++) {
+        uint64_t comp_id = prefab->comps[i].comp_id;
+        if (comp_id > comp_hooks_size || comp_hooks[comp_id - 1].on_add == NULL) {
+            continue;
+        }
+        for (uint32_t e = 0; e < count; e++) {
+            run_add_hook(&nodes[e].entity, comp_id);
+        }
+    }
+
+    if (out != NULL) {
+        for (uint32_t e = 0; e < count; e++) {
+            out[e] = &nodes[e].entity;
+        }
+    }
+}
+
+entity_t* instantiate(prefab_t* prefab) {
+    entity_t* ent = NULL;
+    instantiate_batch(prefab, 1, &ent);
+    return ent;
 }
@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include <string.h>
 #include "core/log.h"
+#include "core/serialize_deserialize.h"
 #include "macros.h"
 
 /*
@@ -40,6 +41,76 @@ component_t get_comp(entity_t* ent, uint64_t comp_id);
 void remove_comp(entity_t* ent, uint64_t comp_id);
 
 entity_t** filter_entities(signature_t filter);
+// entities with every component of filter and none of exclude
+entity_t** filter_entities_without(signature_t filter, signature_t exclude);
+
+/*
+ * Tags are components without data, only the entity's signature bit is set. Adding one allocates
+ * nothing and its slot in the component array stays NULL, so get_comp() on a tag returns NULL,
+ * use has_tag(). They filter like any component and have no hooks.
+ *
+ *     REGISTER_TAG(frozen);
+ *     ADD_TAG(frozen, ent);
+ *     entity_t** moving = FILTER_ENTITIES_WITHOUT((transform_t, velocity_t), (frozen));
+ */
+void add_tag(entity_t* ent, uint64_t tag_id);
+void remove_tag(entity_t* ent, uint64_t tag_id);
+int has_tag(entity_t* ent, uint64_t tag_id);
+
+/*
+ * Hooks run right after a component is added and right before it is freed, either by
+ * remove_comp or remove_ent. They get the stored copy, so they can keep state inside it.
+ */
+typedef void (*comp_hook_t)(entity_t* ent, void* component);
+
+void set_comp_hooks(uint64_t comp_id, comp_hook_t on_add, comp_hook_t on_remove);
+
+#define REGISTER_COMP_HOOKS(component_struct, on_add, on_remove) \
+    __attribute__((constructor)) \
+    void add_ ## component_struct ## _hooks() { \
+        extern uint64_t component_struct ## _id; \
+        REGISTER_ID(component_struct) \
+        set_comp_hooks(component_struct ## _id, on_add, on_remove); \
+    }
+
+/*
+ * Prefabs are a set of component values to stamp out entities from. instantiate_batch() makes
+ * count entities in one allocation, ids, component arrays, signatures and every component
+ * included, with each component's copies laid out next to each other. The entities behave like
+ * any other, removing one only frees the block once all of its entities are gone.
+ */
+typedef struct {
+    uint64_t comp_id;
+    size_t size;
+    void* data;
+} prefab_comp_t;
+
+typedef struct {
+    prefab_comp_t* comps;
+    uint32_t comp_count;
+} prefab_t;
+
+prefab_t* create_prefab();
+void destroy_prefab(prefab_t* prefab);
+// copies data, replaces the component's value when it's already set
+void set_prefab_comp(prefab_t* prefab, uint64_t comp_id, void* data, size_t size);
+// a tag in the prefab, its entities get the signature bit only
+void set_prefab_tag(prefab_t* prefab, uint64_t tag_id);
+// reads the component from the packed format serialize() writes, returns the bytes read
+size_t set_prefab_comp_packed(prefab_t* prefab, uint64_t comp_id, struct struct_fmt* fmt, unsigned char* buffer);
+
+entity_t* instantiate(prefab_t* prefab);
+// out gets the entities when it isn't NULL, add hooks run once all of them exist
+void instantiate_batch(prefab_t* prefab, uint32_t count, entity_t** out);
+
+#define SET_PREFAB_COMP(prefab, component_struct, ...) ({ \
+    extern uint64_t component_struct ## _id; \
+    REGISTER_ID(component_struct) \
+    component_struct prefab_value = __VA_ARGS__; \
+    set_prefab_comp(prefab, component_struct ## _id, &prefab_value, sizeof(component_struct)); \
+})
+
+#define SET_PREFAB_TAG(prefab, tag) set_prefab_tag(prefab, GET_ID(tag))
 
 #define FILTER_ENTITIES(...) ({ \
     signature_t filter = CREATE_SIG(__VA_ARGS__); \
@@ -48,6 +119,16 @@ entity_t** filter_entities(signature_t filter);
     list; \
 })
 
+// both lists in parentheses, FILTER_ENTITIES_WITHOUT((transform_t), (frozen, hidden))
+#define FILTER_ENTITIES_WITHOUT(with, without) ({ \
+    signature_t filter = CREATE_SIG with; \
+    signature_t exclude = CREATE_SIG without; \
+    entity_t** list = filter_entities_without(filter, exclude); \
+    free(filter); \
+    free(exclude); \
+    list; \
+})
+
 signature_t id_to_sig(uint64_t id);
 
 signature_t create_sig(uint32_t n, ...);
@@ -67,6 +148,17 @@ signature_t create_sig(uint32_t n, ...);
     create_sig(VARCOUNT(__VA_ARGS__), MAP_LIST(X_ID,__VA_ARGS__)); \
 })
 
+#define REGISTER_TAG(tag) \
+    uint64_t tag ## _id = 0; \
+    __attribute__((constructor)) \
+    void add_ ## tag ## _tag() { \
+        REGISTER_ID(tag) \
+    }
+
+#define ADD_TAG(tag, ent) add_tag(ent, GET_ID(tag))
+#define REMOVE_TAG(tag, ent) remove_tag(ent, GET_ID(tag))
+#define HAS_TAG(tag, ent) has_tag(ent, GET_ID(tag))
+
 // using ddlexport on win add_struct_name will be called using dlsym etc
 #define REGISTER_COMPONENT(struct_name) \
     uint64_t struct_name ## _id = 0; \
@@ -0,0 +1,165 @@
+#include "core/events.h"
+#include "core/log.h"
+#include "core/systems.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct event_buffer_t {
+    uint8_t* data;
+    uint32_t count;
+    uint32_t capacity;
+    struct event_buffer_t* next;
+} event_buffer_t;
+
+typedef struct {
+    const char* name;
+    size_t size;
+
+    pthread_mutex_t lock; // only taken when a thread starts writing a type
+    event_buffer_t* writing; // handed out this frame
+    event_buffer_t* free;
+
+    uint8_t* read;
+    uint32_t read_count;
+    uint32_t read_capacity;
+} event_type_t;
+
+// a thread's buffer is only its own for the frame it was taken in
+typedef struct {
+    uint64_t frame;
+    event_buffer_t* buffer;
+} event_writer_t;
+
+static event_type_t types[MAX_EVENT_TYPES];
+static uint64_t type_count = 0;
+static _Atomic uint64_t event_frame = 1;
+
+static _Thread_local event_writer_t writers[MAX_EVENT_TYPES];
+
+uint64_t register_event(const char* name, size_t size) {
+    if (type_count == MAX_EVENT_TYPES) {
+        FATAL("Can't register event %s, MAX_EVENT_TYPES is %d.", name, MAX_EVENT_TYPES);
+        return 0;
+    }
+
+    event_type_t* type = &types[type_count++];
+    type->name = name;
+    type->size = size;
+    pthread_mutex_init(&type->lock, NULL);
+
+    TRACE("Registered id %ld for event %s.", type_count, name);
+    return type_count;
+}
+
+static event_buffer_t* take_buffer(event_type_t* type) {
+    pthread_mutex_lock(&type->lock);
+    event_buffer_t* buffer = type->free;
+    if (buffer != NULL) {
+        type->free = buffer->next;
+    } else {
+        buffer = calloc(1, sizeof(event_buffer_t));
+    }
+    buffer->next = type->writing;
+    type->writing = buffer;
+    pthread_mutex_unlock(&type->lock);
+
+    return buffer;
+}
+
+void send_event(uint64_t event_id, const void* event) {
+    if (event_id == 0 || event_id > type_count) {
+        ERROR("Sending unregistered event %ld.", event_id);
+        return;
+    }
+
+    event_type_t* type = &types[event_id - 1];
+    event_writer_t* writer = &writers[event_id - 1];
+    uint64_t frame = atomic_load_explicit(&event_frame, memory_order_relaxed);
+    if (writer->frame != frame) {
+        writer->buffer = take_buffer(type);
+        writer->frame = frame;
+    }
+
+    event_buffer_t* buffer = writer->buffer;
+    if (buffer->count == buffer->capacity) {
+        buffer->capacity = buffer->capacity == 0 ? 64 : buffer->capacity * 2;
+        buffer->data = realloc(buffer->data, buffer->capacity * type->size);
+    }
+    memcpy(buffer->data + buffer->count * type->size, event, type->size);
+    buffer->count++;
+}
+
+const void* read_events(uint64_t event_id, uint32_t* count) {
+    if (event_id == 0 || event_id > type_count) {
+        ERROR("Reading unregistered event %ld.", event_id);
+        *count = 0;
+        return NULL;
+    }
+
+    event_type_t* type = &types[event_id - 1];
+    *count = type->read_count;
+    return type->read;
+}
+
+void swap_event_buffers() {
+    for (uint64_t i = 0; i < type_count; i++) {
+        event_type_t* type = &types[i];
+
+        uint32_t count = 0;
+        for (event_buffer_t* buffer = type->writing; buffer != NULL; buffer = buffer->next) {
+            count += buffer->count;
+        }
+        if (count > type->read_capacity) {
+            type->read_capacity = count;
+            type->read = realloc(type->read, count * type->size);
+        }
+
+        // buffers were taken newest first, gather them oldest first
+        uint32_t offset = count;
+        event_buffer_t* buffer = type->writing;
+        while (buffer != NULL) {
+            offset -= buffer->count;
+            memcpy(type->read + offset * type->size, buffer->data, buffer->count * type->size);
+            buffer->count = 0;
+
+            event_buffer_t* next = buffer->next;
+            buffer->next = type->free;
+            type->free = buffer;
+            buffer = next;
+        }
+        type->writing = NULL;
+        type->read_count = count;
+    }
+
+    // every thread's buffer is stale now
+    atomic_fetch_add_explicit(&event_frame, 1, memory_order_relaxed);
+}
+
+static void free_buffers(event_buffer_t* buffer) {
+    while (buffer != NULL) {
+        event_buffer_t* next = buffer->next;
+        free(buffer->data);
+        free(buffer);
+        buffer = next;
+    }
+}
+
+void cleanup_events() {
+    for (uint64_t i = 0; i < type_count; i++) {
+        event_type_t* type = &types[i];
+        free_buffers(type->writing);
+        free_buffers(type->free);
+        free(type->read);
+        type->writing = type->free = NULL;
+        type->read = NULL;
+        type->read_count = type->read_capacity = 0;
+    }
+    atomic_fetch_add_explicit(&event_frame, 1, memory_order_relaxed);
+
+    TRACE("Cleaned up events.");
+}
+
+REGISTER_SYSTEM(cleanup_events, CLEANUP);
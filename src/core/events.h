@@ -0,0 +1,54 @@
+#ifndef OVERTURE_EVENTS
+#define OVERTURE_EVENTS
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Typed events between systems. Every event type is a struct registered with REGISTER_EVENT.
+ * Events sent during a frame become readable in the next one, by every system in any schedule,
+ * and are gone in the one after. swap_event_buffers() flips them over at the start of each frame.
+ *
+ * Systems running in parallel send without contending: each thread appends to a buffer of its
+ * own, taken from a pool the first time it sends a type in a frame. The swap gathers them into
+ * one array per type. Events from one thread keep their order, across threads there's none.
+ *
+ *     REGISTER_EVENT(damage_t);
+ *
+ *     SEND_EVENT(damage_t, (damage_t){ target, 10 });
+ *
+ *     uint32_t count;
+ *     const damage_t* damage = READ_EVENTS(damage_t, &count);
+ */
+
+#ifndef MAX_EVENT_TYPES
+#define MAX_EVENT_TYPES 64
+#endif
+
+// ids start at 1, called by REGISTER_EVENT before main
+uint64_t register_event(const char* name, size_t size);
+
+void send_event(uint64_t event_id, const void* event);
+// what was sent last frame, valid until the next swap
+const void* read_events(uint64_t event_id, uint32_t* count);
+
+// no event may be sent while this runs, entry.c calls it between frames
+void swap_event_buffers();
+
+#define REGISTER_EVENT(event_struct) \
+    uint64_t event_struct ## _event_id = 0; \
+    __attribute__((constructor)) \
+    void add_ ## event_struct ## _event() { \
+        event_struct ## _event_id = register_event(#event_struct, sizeof(event_struct)); \
+    }
+
+#define GET_EVENT_ID(event_struct) ({extern uint64_t event_struct ## _event_id; event_struct ## _event_id;})
+
+#define SEND_EVENT(event_struct, ...) ({ \
+    event_struct sent_event = __VA_ARGS__; \
+    send_event(GET_EVENT_ID(event_struct), &sent_event); \
+})
+
+#define READ_EVENTS(event_struct, count) ((const event_struct*)read_events(GET_EVENT_ID(event_struct), count))
+
+#endif
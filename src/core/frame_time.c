@@ -0,0 +1,26 @@
+#include "core/frame_time.h"
+#include "core/resources.h"
+#include "core/systems.h"
+
+#include <time.h>
+
+REGISTER_RESOURCE(frame_time_t);
+
+static double start = 0.0;
+
+void update_frame_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    double now = ts.tv_sec + ts.tv_nsec / 1e9;
+
+    frame_time_t* time = GET_RESOURCE(frame_time_t);
+    if (time->frame == 0) {
+        start = now;
+    }
+    time->delta = time->frame == 0 ? 0.0 : now - start - time->time;
+    time->time = now - start;
+    time->frame++;
+}
+
+REGISTER_SYSTEM_FRONT(update_frame_time, PRE_UPDATE);
+WRITES_RESOURCE(update_frame_time, frame_time_t);
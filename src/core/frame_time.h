@@ -0,0 +1,19 @@
+#ifndef OVERTURE_FRAME_TIME
+#define OVERTURE_FRAME_TIME
+
+#include <stdint.h>
+
+/*
+ * Frame timing as a resource, updated first thing in PRE_UPDATE. PRE_UPDATE systems reading it
+ * declare READS_RESOURCE(system, frame_time_t) to run after the update.
+ */
+
+typedef struct {
+    double time; // seconds since the first frame
+    double delta; // seconds since the last frame, 0 in the first
+    uint64_t frame; // starting at 1
+} frame_time_t;
+
+void update_frame_time();
+
+#endif
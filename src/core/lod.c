@@ -0,0 +1,263 @@
+#include "core/lod.h"
+#include "core/camera.h"
+#include "core/culling.h"
+#include "core/log.h"
+#include "core/systems.h"
+#include "core/transform.h"
+
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// below this many entities spawning threads costs more than it saves
+#define PARALLEL_THRESHOLD 16384
+#define MAX_THREADS 16
+
+REGISTER_COMPONENT(lod_t);
+
+typedef struct {
+    uint64_t key; // group, level and position in the visible list
+    entity_t* entity;
+} lod_entry_t;
+
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    float projection_scale; // pixels per unit at distance 1, or at any distance when orthographic
+    int orthographic;
+    vec3_t eye;
+    float near;
+} lod_range_t;
+
+static float threshold = 1.0f;
+static float hysteresis = 0.25f;
+static float viewport_height = 1080.0f;
+
+static lod_entry_t* entries = NULL;
+static lod_entry_t* sorted = NULL;
+static entity_t** lod_entities = NULL;
+static uint32_t entry_count = 0;
+static uint32_t entry_capacity = 0;
+
+static lod_batch_t* batches = NULL;
+static uint32_t batch_count = 0;
+
+lod_t lod_levels(uint32_t group, const float* errors, uint32_t count) {
+    lod_t lod = { .count = count < MAX_LODS ? count : MAX_LODS, .group = group };
+    memcpy(lod.errors, errors, lod.count * sizeof(float));
+    return lod;
+}
+
+void set_lod_threshold(float pixels, float fraction) {
+    threshold = pixels;
+    hysteresis = fraction;
+}
+
+void set_lod_viewport_height(float pixels) {
+    viewport_height = pixels;
+}
+
+uint32_t select_lod(const lod_t* lod, float pixels_per_unit, float pixels, float fraction) {
+    // errors only grow with the level so the last one that fits is the coarsest
+    uint32_t coarsest = 0, relaxed = 0;
+    for (uint32_t i = 1; i < lod->count; i++) {
+        float projected = lod->errors[i] * pixels_per_unit;
+        coarsest = projected <= pixels ? i : coarsest;
+        relaxed = projected <= pixels * (1.0f - fraction) ? i : relaxed;
+    }
+
+    // anywhere between the two is fine, so stay unless the current level left that band
+    uint32_t level = lod->level < lod->count ? lod->level : 0;
+    level = level < relaxed ? relaxed : level;
+    return level > coarsest ? coarsest : level;
+}
+
+static void* select_range(void* arg) {
+    lod_range_t* range = arg;
+
+    // entries only hold entities with both components, skip get_comp's checks and logging
+    uint64_t transform_id = GET_ID(transform_t);
+    uint64_t bounds_id = GET_ID(bounds_t);
+    uint64_t lod_id = GET_ID(lod_t);
+
+    for (uint32_t i = range->start; i < range->end; i++) {
+        entity_t* entity = entries[i].entity;
+        transform_t* transform = entity->components[transform_id - 1];
+        bounds_t* bounds = entity->components[bounds_id - 1];
+        lod_t* lod = entity->components[lod_id - 1];
+
+        const mat4_t* world = get_transform_world(*transform);
+        float scale = fmaxf(vec3_length(vec3(world->m[0], world->m[1], world->m[2])),
+                            fmaxf(vec3_length(vec3(world->m[4], world->m[5], world->m[6])),
+                                  vec3_length(vec3(world->m[8], world->m[9], world->m[10]))));
+
+        float pixels_per_unit = range->projection_scale * scale;
+        if (!range->orthographic) {
+            vec4_t center = mat4_mul_vec4(world, vec4(bounds->center.x, bounds->center.y, bounds->center.z, 1.0f));
+            float distance = vec3_length(vec3_sub(vec3(center.x, center.y, center.z), range->eye)) - bounds->radius * scale;
+            pixels_per_unit /= distance > range->near ? distance : range->near;
+        }
+
+        lod->level = select_lod(lod, pixels_per_unit, threshold, hysteresis);
+        entries[i].key = (uint64_t)lod->group << 40 | (uint64_t)lod->level << 32 | i;
+    }
+
+    return NULL;
+}
+
+static void reserve_entries(uint32_t count) {
+    if (count + 1 <= entry_capacity) {
+        return;
+    }
+
+    entry_capacity = entry_capacity ? entry_capacity : 1024;
+    while (entry_capacity < count + 1) {
+        entry_capacity *= 2;
+    }
+
+    entries = realloc(entries, entry_capacity * sizeof(lod_entry_t));
+    sorted = realloc(sorted, entry_capacity * sizeof(lod_entry_t));
+    lod_entities = realloc(lod_entities, entry_capacity * sizeof(entity_t*));
+    batches = realloc(batches, entry_capacity * sizeof(lod_batch_t));
+}
+
+// lsd radix sort on 16 bit digits, only as many passes as the largest key needs
+static void sort_entries(uint32_t count) {
+    uint64_t max_key = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        max_key = entries[i].key > max_key ? entries[i].key : max_key;
+    }
+
+    lod_entry_t* from = entries;
+    lod_entry_t* to = sorted;
+    for (uint32_t shift = 0; shift < 64 && (max_key >> shift) != 0; shift += 16) {
+        static uint32_t histogram[1 << 16];
+        memset(histogram, 0, sizeof(histogram));
+
+        for (uint32_t i = 0; i < count; i++) {
+            histogram[(from[i].key >> shift) & 0xffff]++;
+        }
+        uint32_t offset = 0;
+        for (uint32_t d = 0; d < (1 << 16); d++) {
+            uint32_t bucket = histogram[d];
+            histogram[d] = offset;
+            offset += bucket;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            to[histogram[(from[i].key >> shift) & 0xffff]++] = from[i];
+        }
+
+        lod_entry_t* swap = from;
+        from = to;
+        to = swap;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        lod_entities[i] = from[i].entity;
+    }
+    lod_entities[count] = NULL;
+}
+
+void select_lods() {
+    camera_t* camera = get_active_camera(NULL);
+
+    uint32_t visible_count = 0;
+    entity_t** visible = get_visible_entities(&visible_count);
+    reserve_entries(visible_count);
+
+    // visible entities all have a transform and bounds
+    uint64_t lod_id = GET_ID(lod_t);
+    entry_count = 0;
+    for (uint32_t i = 0; i < visible_count; i++) {
+        if (visible[i]->components[lod_id - 1] != NULL) {
+            entries[entry_count++].entity = visible[i];
+        }
+    }
+
+    // without a camera every entity gets its finest level
+    lod_range_t base = { .projection_scale = FLT_MAX, .orthographic = 1 };
+    if (camera != NULL) {
+        base.projection_scale = viewport_height * 0.5f * camera->projection.m[5];
+        const mat4_t* v = &camera->view;
+        base.orthographic = camera->projection.m[15] == 1.0f;
+        base.near = camera->near > 1e-3f ? camera->near : 1e-3f;
+        // the view is rigid, so the eye is -R^T * t
+        base.eye = vec3(-(v->m[0] * v->m[12] + v->m[1] * v->m[13] + v->m[2] * v->m[14]),
+                        -(v->m[4] * v->m[12] + v->m[5] * v->m[13] + v->m[6] * v->m[14]),
+                        -(v->m[8] * v->m[12] + v->m[9] * v->m[13] + v->m[10] * v->m[14]));
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t thread_count = cpus > 1 ? (uint32_t)cpus : 1;
+    if (thread_count > MAX_THREADS) {
+        thread_count = MAX_THREADS;
+    }
+    if (entry_count < PARALLEL_THRESHOLD) {
+        thread_count = 1;
+    }
+
+    pthread_t threads[MAX_THREADS];
+    lod_range_t ranges[MAX_THREADS];
+    uint32_t per_thread = (entry_count + thread_count - 1) / thread_count;
+
+    for (uint32_t t = 0; t < thread_count; t++) {
+        ranges[t] = base;
+        ranges[t].start = t * per_thread < entry_count ? t * per_thread : entry_count;
+        ranges[t].end = (t + 1) * per_thread < entry_count ? (t + 1) * per_thread : entry_count;
+    }
+
+    for (uint32_t t = 1; t < thread_count; t++) {
+        pthread_create(&threads[t], NULL, select_range, &ranges[t]);
+    }
+    select_range(&ranges[0]);
+    for (uint32_t t = 1; t < thread_count; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    sort_entries(entry_count);
+
+    batch_count = 0;
+    for (uint32_t i = 0; i < entry_count; i++) {
+        const lod_t* lod = lod_entities[i]->components[lod_id - 1];
+        lod_batch_t* last = batch_count ? &batches[batch_count - 1] : NULL;
+        if (last != NULL && last->group == lod->group && last->level == lod->level) {
+            last->count++;
+        } else {
+            batches[batch_count++] = (lod_batch_t){ .group = lod->group, .level = lod->level, .first = i, .count = 1 };
+        }
+    }
+
+    TRACE("Selected levels for %d entities in %d batches.", entry_count, batch_count);
+}
+
+REGISTER_SYSTEM_AFTER(select_lods, cull_entities, PRE_RENDER);
+
+entity_t** get_lod_entities(uint32_t* count) {
+    if (count != NULL) {
+        *count = entry_count;
+    }
+    return lod_entities;
+}
+
+const lod_batch_t* get_lod_batches(uint32_t* count) {
+    if (count != NULL) {
+        *count = batch_count;
+    }
+    return batches;
+}
+
+void cleanup_lods() {
+    free(entries);
+    free(sorted);
+    free(lod_entities);
+    free(batches);
+    entries = sorted = NULL;
+    lod_entities = NULL;
+    batches = NULL;
+    entry_count = entry_capacity = batch_count = 0;
+}
+
+REGISTER_SYSTEM(cleanup_lods, CLEANUP);
@@ -0,0 +1,50 @@
+#ifndef OVERTURE_LOD
+#define OVERTURE_LOD
+
+#include <stdint.h>
+#include "core/ecs.h"
+
+/*
+ * Level of detail selection. select_lods() runs in PRE_RENDER right after cull_entities() and
+ * picks a level for every visible entity with a lod_t by projecting each level's model space
+ * error (see generate_mesh_lods() in mesh_simplify.h) to pixels on the active camera. The
+ * coarsest level under the threshold is used, but an entity only moves to a coarser level once
+ * that level is under threshold * (1 - hysteresis), so entities near a switching distance don't
+ * flicker between levels every frame.
+ *
+ * The selected entities are then sorted into batches of the same group and level, each one is a
+ * single instanced draw of that level's index range.
+ */
+
+#define MAX_LODS 8
+
+typedef struct {
+    float errors[MAX_LODS]; // increasing, level 0 is usually 0
+    uint32_t count;
+    uint32_t group; // below 2^24, entities of a group share their levels, usually one per mesh
+    uint32_t level; // written by select_lods()
+} lod_t;
+
+typedef struct {
+    uint32_t group;
+    uint32_t level;
+    uint32_t first; // into get_lod_entities()
+    uint32_t count;
+} lod_batch_t;
+
+lod_t lod_levels(uint32_t group, const float* errors, uint32_t count);
+
+// defaults are 1 pixel, 0.25 and 1080 pixels
+void set_lod_threshold(float pixels, float hysteresis);
+void set_lod_viewport_height(float pixels);
+
+// pixels_per_unit is how large one model unit appears on screen
+uint32_t select_lod(const lod_t* lod, float pixels_per_unit, float threshold, float hysteresis);
+
+// valid until the next select_lods(), sorted by group and level
+entity_t** get_lod_entities(uint32_t* count);
+const lod_batch_t* get_lod_batches(uint32_t* count);
+
+void select_lods();
+
+#endif
@@ -0,0 +1,163 @@
+#include "core/relations.h"
+#include "core/log.h"
+
+#include <stdlib.h>
+
+static const char* relation_names[MAX_RELATIONS];
+static uint64_t relation_count = 0;
+
+REGISTER_COMPONENT(relations_t);
+
+uint64_t register_relation(const char* name) {
+    if (relation_count == MAX_RELATIONS) {
+        FATAL("Can't register relation %s, MAX_RELATIONS is %d.", name, MAX_RELATIONS);
+        return 0;
+    }
+
+    relation_names[relation_count++] = name;
+    TRACE("Registered id %ld for relation %s.", relation_count, name);
+    return relation_count;
+}
+
+static relations_t* find_relations(entity_t* ent) {
+    uint64_t id = GET_ID(relations_t);
+    return id != 0 ? ent->components[id - 1] : NULL;
+}
+
+static relations_t* get_or_add_relations(entity_t* ent) {
+    relations_t* relations = find_relations(ent);
+    if (relations == NULL) {
+        relations_t empty = {
+            .targets = calloc(relation_count, sizeof(relation_list_t)),
+            .sources = calloc(relation_count, sizeof(relation_list_t)),
+        };
+        add_relations_t_cpy(ent, &empty);
+        relations = find_relations(ent);
+    }
+    return relations;
+}
+
+static void list_add(relation_list_t* list, uint64_t id) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity == 0 ? 4 : list->capacity * 2;
+        list->ids = realloc(list->ids, list->capacity * sizeof(uint64_t));
+    }
+    list->ids[list->count++] = id;
+}
+
+// order isn't kept
+static int list_remove(relation_list_t* list, uint64_t id) {
+    for (uint32_t i = 0; i < list->count; i++) {
+        if (list->ids[i] == id) {
+            list->ids[i] = list->ids[--list->count];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int list_contains(const relation_list_t* list, uint64_t id) {
+    for (uint32_t i = 0; i < list->count; i++) {
+        if (list->ids[i] == id) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int valid_relation(uint64_t relation) {
+    if (relation == 0 || relation > relation_count) {
+        ERROR("Relation %ld isn't registered.", relation);
+        return 0;
+    }
+    return 1;
+}
+
+void add_relation(uint64_t relation, entity_t* source, entity_t* target) {
+    if (!valid_relation(relation) || source == NULL || target == NULL) {
+        return;
+    }
+
+    relations_t* from = get_or_add_relations(source);
+    if (list_contains(&from->targets[relation - 1], target->id)) {
+        return;
+    }
+    relations_t* to = get_or_add_relations(target);
+
+    list_add(&from->targets[relation - 1], target->id);
+    list_add(&to->sources[relation - 1], source->id);
+
+    TRACE("Added relation %s from entity %ld to %ld.", relation_names[relation - 1], source->id, target->id);
+}
+
+void remove_relation(uint64_t relation, entity_t* source, entity_t* target) {
+    if (!valid_relation(relation) || source == NULL || target == NULL) {
+        return;
+    }
+
+    relations_t* from = find_relations(source);
+    relations_t* to = find_relations(target);
+    if (from == NULL || to == NULL || !list_remove(&from->targets[relation - 1], target->id)) {
+        WARN("Entity %ld has no relation %s to %ld.", source->id, relation_names[relation - 1], target->id);
+        return;
+    }
+    list_remove(&to->sources[relation - 1], source->id);
+
+    TRACE("Removed relation %s from entity %ld to %ld.", relation_names[relation - 1], source->id, target->id);
+}
+
+int has_relation(uint64_t relation, entity_t* source, entity_t* target) {
+    if (!valid_relation(relation) || source == NULL || target == NULL) {
+        return 0;
+    }
+
+    relations_t* from = find_relations(source);
+    return from != NULL && list_contains(&from->targets[relation - 1], target->id);
+}
+
+const uint64_t* get_relation_targets(uint64_t relation, entity_t* source, uint32_t* count) {
+    relations_t* from = source != NULL && valid_relation(relation) ? find_relations(source) : NULL;
+    *count = from != NULL ? from->targets[relation - 1].count : 0;
+    return from != NULL ? from->targets[relation - 1].ids : NULL;
+}
+
+const uint64_t* get_relation_sources(uint64_t relation, entity_t* target, uint32_t* count) {
+    relations_t* to = target != NULL && valid_relation(relation) ? find_relations(target) : NULL;
+    *count = to != NULL ? to->sources[relation - 1].count : 0;
+    return to != NULL ? to->sources[relation - 1].ids : NULL;
+}
+
+// runs before the entity or the component goes away, the other sides forget it
+static void on_relations_remove(entity_t* ent, void* component) {
+    relations_t* relations = component;
+
+    for (uint64_t r = 0; r < relation_count; r++) {
+        relation_list_t* targets = &relations->targets[r];
+        for (uint32_t i = 0; i < targets->count; i++) {
+            entity_t* target = targets->ids[i] != ent->id ? get_ent(targets->ids[i]) : NULL;
+            relations_t* other = target != NULL ? find_relations(target) : NULL;
+            if (other != NULL) {
+                list_remove(&other->sources[r], ent->id);
+            }
+        }
+
+        relation_list_t* sources = &relations->sources[r];
+        for (uint32_t i = 0; i < sources->count; i++) {
+            entity_t* source = sources->ids[i] != ent->id ? get_ent(sources->ids[i]) : NULL;
+            relations_t* other = source != NULL ? find_relations(source) : NULL;
+            if (other != NULL) {
+                list_remove(&other->targets[r], ent->id);
+            }
+        }
+
+        free(targets->ids);
+        free(sources->ids);
+    }
+
+    free(relations->targets);
+    free(relations->sources);
+
+    TRACE("Dropped the relations of entity %ld.", ent->id);
+}
+
+REGISTER_COMP_HOOKS(relations_t, NULL, on_relations_remove);
@@ -0,0 +1,64 @@
+#ifndef OVERTURE_RELATIONS
+#define OVERTURE_RELATIONS
+
+#include <stdint.h>
+
+#include "core/ecs.h"
+
+/*
+ * Relations are pairs between two entities, a source and a target, of a registered kind:
+ *
+ *     REGISTER_RELATION(child_of);
+ *     ADD_RELATION(child_of, child, parent);
+ *
+ * Both sides keep the ids of the other one per kind, so a source's targets and the sources of a
+ * target are an O(1) lookup returning O(k) ids, get_ent() turns them back into entities in O(1).
+ *
+ * Entities in a relation carry a relations_t component. Its remove hook drops every pair the
+ * entity is part of from the other side, so removing either side with remove_ent() or removing
+ * the component cleans up on its own. Relations aren't part of prefabs.
+ */
+
+#ifndef MAX_RELATIONS
+#define MAX_RELATIONS 32
+#endif
+
+typedef struct {
+    uint64_t* ids;
+    uint32_t count;
+    uint32_t capacity;
+} relation_list_t;
+
+typedef struct {
+    relation_list_t* targets; // by relation id - 1
+    relation_list_t* sources;
+} relations_t;
+
+// ids start at 1, called by REGISTER_RELATION before main
+uint64_t register_relation(const char* name);
+
+// nothing happens when the pair already exists
+void add_relation(uint64_t relation, entity_t* source, entity_t* target);
+void remove_relation(uint64_t relation, entity_t* source, entity_t* target);
+int has_relation(uint64_t relation, entity_t* source, entity_t* target);
+
+// valid until the entity's relations of that kind change
+const uint64_t* get_relation_targets(uint64_t relation, entity_t* source, uint32_t* count);
+const uint64_t* get_relation_sources(uint64_t relation, entity_t* target, uint32_t* count);
+
+#define REGISTER_RELATION(relation) \
+    uint64_t relation ## _relation_id = 0; \
+    __attribute__((constructor)) \
+    void add_ ## relation ## _relation() { \
+        relation ## _relation_id = register_relation(#relation); \
+    }
+
+#define GET_RELATION_ID(relation) ({extern uint64_t relation ## _relation_id; relation ## _relation_id;})
+
+#define ADD_RELATION(relation, source, target) add_relation(GET_RELATION_ID(relation), source, target)
+#define REMOVE_RELATION(relation, source, target) remove_relation(GET_RELATION_ID(relation), source, target)
+#define HAS_RELATION(relation, source, target) has_relation(GET_RELATION_ID(relation), source, target)
+#define GET_RELATION_TARGETS(relation, source, count) get_relation_targets(GET_RELATION_ID(relation), source, count)
+#define GET_RELATION_SOURCES(relation, target, count) get_relation_sources(GET_RELATION_ID(relation), target, count)
+
+#endif
@@ -0,0 +1,34 @@
+#include "core/resources.h"
+#include "core/log.h"
+
+#include <stdlib.h>
+
+typedef struct {
+    const char* name;
+    void* data;
+} resource_t;
+
+static resource_t resources[MAX_RESOURCES];
+static uint64_t resource_count = 0;
+
+uint64_t register_resource(const char* name, size_t size) {
+    if (resource_count == MAX_RESOURCES) {
+        FATAL("Can't register resource %s, MAX_RESOURCES is %d.", name, MAX_RESOURCES);
+        return 0;
+    }
+
+    resources[resource_count].name = name;
+    resources[resource_count].data = calloc(1, size);
+    resource_count++;
+
+    TRACE("Registered id %ld for resource %s.", resource_count, name);
+    return resource_count;
+}
+
+void* get_resource(uint64_t resource_id) {
+    if (resource_id == 0 || resource_id > resource_count) {
+        ERROR("Getting unregistered resource %ld.", resource_id);
+        return NULL;
+    }
+    return resources[resource_id - 1].data;
+}
@@ -0,0 +1,60 @@
+#ifndef OVERTURE_RESOURCES
+#define OVERTURE_RESOURCES
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/systems.h"
+
+/*
+ * Resources are engine wide singletons, one zeroed instance per registered struct, reached in
+ * O(1) through their id instead of filtering for the one entity that holds them.
+ *
+ *     REGISTER_RESOURCE(frame_time_t);
+ *     frame_time_t* time = GET_RESOURCE(frame_time_t);
+ *
+ * Systems in parallel schedules declare what they read and write. run_systems_parrallel() then
+ * runs the systems writing a resource before the ones only reading it, and systems writing the
+ * same resource one after the other in registration order. Everything else still runs at once,
+ * undeclared access isn't ordered.
+ *
+ *     READS_RESOURCE(move_players, input_state_t);
+ *     WRITES_RESOURCE(update_input, input_state_t);
+ */
+
+#ifndef MAX_RESOURCES
+#define MAX_RESOURCES 64
+#endif
+
+// ids start at 1, called by REGISTER_RESOURCE before main
+uint64_t register_resource(const char* name, size_t size);
+void* get_resource(uint64_t resource_id);
+
+#define REGISTER_RESOURCE(resource_struct) \
+    uint64_t resource_struct ## _resource_id = 0; \
+    __attribute__((constructor)) \
+    void add_ ## resource_struct ## _resource() { \
+        if (resource_struct ## _resource_id == 0) { \
+            resource_struct ## _resource_id = register_resource(#resource_struct, sizeof(resource_struct)); \
+        } \
+    }
+
+#define GET_RESOURCE_ID(resource_struct) ({extern uint64_t resource_struct ## _resource_id; resource_struct ## _resource_id;})
+#define GET_RESOURCE(resource_struct) ((resource_struct*)get_resource(GET_RESOURCE_ID(resource_struct)))
+
+// the resource may not be registered yet when these run
+#define READS_RESOURCE(system, resource_struct) \
+    __attribute__((constructor)) \
+    void add_ ## system ## _reads_ ## resource_struct() { \
+        extern uint64_t resource_struct ## _resource_id; \
+        declare_resource_access(system, &resource_struct ## _resource_id, 0); \
+    }
+
+#define WRITES_RESOURCE(system, resource_struct) \
+    __attribute__((constructor)) \
+    void add_ ## system ## _writes_ ## resource_struct() { \
+        extern uint64_t resource_struct ## _resource_id; \
+        declare_resource_access(system, &resource_struct ## _resource_id, 1); \
+    }
+
+#endif
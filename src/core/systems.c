@@ -13,6 +13,44 @@ typedef struct system_node_t {
 
 static system_node_t* schedule_heads[NUM_OF_SCHEDULES];
 
+typedef struct access_node_t {
+    system_ptr_t system;
+    const uint64_t* resource;
+    int write;
+    struct access_node_t* next;
+} access_node_t;
+
+static access_node_t* access_head = NULL;
+
+typedef struct order_node_t {
+    system_ptr_t system;
+    system_ptr_t after;
+    struct order_node_t* next;
+} order_node_t;
+
+static order_node_t* order_head = NULL;
+
+// deeper than this the order can only be a cycle
+#define MAX_ORDER_DEPTH 64
+
+// waves of a parallel schedule, worked out on its first run after anything was registered
+typedef struct {
+    int valid;
+    uint32_t count;
+    system_ptr_t* systems;
+    uint32_t* waves;
+    uint32_t wave_count;
+    pthread_t* threads;
+} schedule_waves_t;
+
+static schedule_waves_t schedule_waves[NUM_OF_SCHEDULES];
+
+static void invalidate_waves() {
+    for (uint32_t i = 0; i < NUM_OF_SCHEDULES; i++) {
+        schedule_waves[i].valid = 0;
+    }
+}
+
 // maybe figure out a way to automatically update this with macros or smt
 const char* schedules[] = {
     "SETUP",
@@ -25,8 +63,47 @@ const char* schedules[] = {
     "CLEANUP",
 };
 
+static int runs_after(system_ptr_t system, system_ptr_t target) {
+    for (order_node_t* order = order_head; order != NULL; order = order->next) {
+        if (order->system == system && order->after == target) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// moves the systems that have to run after node's and were registered before it right behind it,
+// then the ones that have to run after those
+static void place_after(schedule_t schedule, system_node_t* node, uint32_t depth) {
+    if (depth == MAX_ORDER_DEPTH) {
+        WARN("System order in schedule %s has a cycle.", schedules[schedule]);
+        return;
+    }
+
+    system_node_t* tail = node;
+    system_node_t** link = &schedule_heads[schedule];
+    while (*link != node) {
+        system_node_t* temp = *link;
+        if (!runs_after(temp->system, node->system)) {
+            link = &temp->next;
+            continue;
+        }
+
+        *link = temp->next;
+        temp->next = tail->next;
+        tail->next = temp;
+        tail = temp;
+    }
+
+    for (system_node_t* moved = node->next; moved != tail->next; moved = moved->next) {
+        place_after(schedule, moved, depth + 1);
+    }
+}
+
 // TODO: error handling for malloc
 void register_system(system_ptr_t system, schedule_t schedule) {
+    invalidate_waves();
+
     system_node_t* node = malloc(sizeof(system_node_t));
     node->system = system;
     node->next = NULL;
@@ -43,9 +120,12 @@ void register_system(system_ptr_t system, schedule_t schedule) {
     }
 
     temp->next = node;
+    place_after(schedule, node, 0);
 }
 
 void register_system_front(system_ptr_t system, schedule_t schedule) {
+    invalidate_waves();
+
     system_node_t* node = malloc(sizeof(system_node_t));
     node->system = system;
     node->next = NULL;
@@ -60,9 +140,23 @@ void register_system_front(system_ptr_t system, schedule_t schedule) {
 
     node->next = temp;
     schedule_heads[schedule] = node;
+    place_after(schedule, node, 0);
+}
+
+void register_system_after(system_ptr_t system, system_ptr_t target, schedule_t schedule) {
+    order_node_t* order = malloc(sizeof(order_node_t));
+    order->system = system;
+    order->after = target;
+    order->next = order_head;
+    order_head = order;
+
+    // appending keeps it behind target when target is already there, place_after() handles the rest
+    register_system(system, schedule);
 }
 
 void register_system_before(system_ptr_t system, system_ptr_t target, schedule_t schedule) {
+    invalidate_waves();
+
     system_node_t* node = malloc(sizeof(system_node_t));
     node->system = system;
     node->next = NULL;
@@ -82,6 +176,39 @@ void register_system_before(system_ptr_t system, system_ptr_t target, schedule_t
     temp->next = node;
 }
 
+void declare_resource_access(system_ptr_t system, const uint64_t* resource, int write) {
+    invalidate_waves();
+
+    access_node_t* node = malloc(sizeof(access_node_t));
+    node->system = system;
+    node->resource = resource;
+    node->write = write;
+    node->next = access_head;
+    access_head = node;
+}
+
+// 1 when a has to run before b: writers of a resource before its readers, two writers in order,
+// and systems registered to run after another one
+static int system_precedes(system_ptr_t a, uint32_t a_idx, system_ptr_t b, uint32_t b_idx) {
+    if (runs_after(b, a)) {
+        return 1;
+    }
+    for (access_node_t* x = access_head; x != NULL; x = x->next) {
+        if (x->system != a) {
+            continue;
+        }
+        for (access_node_t* y = access_head; y != NULL; y = y->next) {
+            if (y->system != b || y->resource != x->resource || !(x->write || y->write)) {
+                continue;
+            }
+            if (x->write && y->write ? a_idx < b_idx : x->write) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
 void run_systems_sequential(schedule_t schedule) {
     system_node_t* temp = schedule_heads[schedule];
 
@@ -97,53 +224,87 @@ void run_systems_sequential(schedule_t schedule) {
     TRACE("Finished execution of %d systems in schedule: %s.", count, schedules[schedule]);
 }
 
-typedef struct thread_node_t {
-    pthread_t thread;
-    struct thread_node_t* next;
-} thread_node_t;
-
 void* run_system(void* arg) {
     system_ptr_t system = arg;
     system();
     return NULL;
 }
 
-void run_systems_parrallel(schedule_t schedule) {
-    system_node_t* temp = schedule_heads[schedule];
-
-    TRACE("Executing systems in schedule: %s.", schedules[schedule]);
+// systems run in waves, each one after the waves of the systems that have to precede it.
+// Without declared resource access or order everything is wave 0
+static void build_waves(schedule_t schedule) {
+    schedule_waves_t* cache = &schedule_waves[schedule];
 
     uint32_t count = 0;
+    for (system_node_t* temp = schedule_heads[schedule]; temp != NULL; temp = temp->next) {
+        count++;
+    }
 
-    thread_node_t* thread_head = NULL;
-    thread_node_t* curr_thread_node = thread_head;
+    cache->systems = realloc(cache->systems, (count ? count : 1) * sizeof(system_ptr_t));
+    cache->waves = realloc(cache->waves, (count ? count : 1) * sizeof(uint32_t));
+    cache->threads = realloc(cache->threads, (count ? count : 1) * sizeof(pthread_t));
+    cache->count = count;
 
-    while (temp != NULL) {
-        thread_node_t* new = malloc(sizeof(thread_node_t));
-        pthread_create(&new->thread, NULL, run_system, temp->system);
-        new->next = NULL;
-
-        if (curr_thread_node == NULL) {
-            curr_thread_node = new;
-        } else {
-            curr_thread_node->next = new;
-            curr_thread_node = curr_thread_node->next;
+    uint32_t idx = 0;
+    for (system_node_t* temp = schedule_heads[schedule]; temp != NULL; temp = temp->next) {
+        cache->systems[idx] = temp->system;
+        cache->waves[idx++] = 0;
+    }
+
+    system_ptr_t* systems = cache->systems;
+    uint32_t* waves = cache->waves;
+
+    int changed = access_head != NULL || order_head != NULL;
+    for (uint32_t pass = 0; changed && pass <= count; pass++) {
+        changed = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            for (uint32_t j = 0; j < count; j++) {
+                if (i != j && waves[j] <= waves[i] && system_precedes(systems[i], i, systems[j], j)) {
+                    waves[j] = waves[i] + 1;
+                    changed = 1;
+                }
+            }
+        }
+    }
+    if (changed) {
+        WARN("Resource access in schedule %s has a cycle, running its systems one after another.", schedules[schedule]);
+        for (uint32_t i = 0; i < count; i++) {
+            waves[i] = i;
         }
-        temp = temp->next;
-        count++;
     }
 
-    TRACE("Waiting for system threads to finish...");
+    cache->wave_count = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        cache->wave_count = waves[i] + 1 > cache->wave_count ? waves[i] + 1 : cache->wave_count;
+    }
+    cache->valid = 1;
 
-    while (curr_thread_node != NULL) {
-        pthread_join(curr_thread_node->thread, NULL);
+    TRACE("Schedule %s runs %d systems in %d waves.", schedules[schedule], count, cache->wave_count);
+}
 
-        thread_node_t* next = curr_thread_node->next;
+void run_systems_parrallel(schedule_t schedule) {
+    TRACE("Executing systems in schedule: %s.", schedules[schedule]);
+
+    schedule_waves_t* cache = &schedule_waves[schedule];
+    if (!cache->valid) {
+        build_waves(schedule);
+    }
 
-        free(curr_thread_node);
+    for (uint32_t wave = 0; wave < cache->wave_count; wave++) {
+        for (uint32_t i = 0; i < cache->count; i++) {
+            if (cache->waves[i] == wave) {
+                pthread_create(&cache->threads[i], NULL, run_system, cache->systems[i]);
+            }
+        }
 
-        curr_thread_node = next;
+        TRACE("Waiting for system threads to finish...");
+
+        for (uint32_t i = 0; i < cache->count; i++) {
+            if (cache->waves[i] == wave) {
+                pthread_join(cache->threads[i], NULL);
+            }
+        }
     }
 
-    TRACE("Finished execution of %d systems in schedule: %s.", count, schedules[schedule]);
+    TRACE("Finished execution of %d systems in schedule: %s.", cache->count, schedules[schedule]);
 }
@@ -1,6 +1,8 @@
 #ifndef OVERTURE_SYSTEMS
 #define OVERTURE_SYSTEMS
 
+#include <stdint.h>
+
 typedef void(*system_ptr_t)(void);
 
 typedef enum {
@@ -28,6 +30,15 @@ typedef enum {
         register_system_before(system, target, schedule); \
     }
 
+// system always runs after target, in sequential schedules somewhere behind it and in parallel
+// ones in a later wave, no matter which of the two gets registered first or whether target was
+// registered at the front
+#define REGISTER_SYSTEM_AFTER(system, target, schedule) \
+    __attribute__((constructor)) \
+    void add_ ## system() { \
+        register_system_after(system, target, schedule); \
+    }
+
 #define REGISTER_SYSTEM_FRONT(system, schedule) \
     __attribute__((constructor)) \
     void add_ ## system() { \
@@ -36,9 +47,13 @@ typedef enum {
 
 void register_system(system_ptr_t system, schedule_t schedule);
 void register_system_front(system_ptr_t system, schedule_t schedule);
+void register_system_after(system_ptr_t system, system_ptr_t target, schedule_t schedule);
 // doesn't work don't use
 void register_system_before(system_ptr_t system, system_ptr_t target, schedule_t schedule);
 
+// resource is the address of the resource's id, see core/resources.h
+void declare_resource_access(system_ptr_t system, const uint64_t* resource, int write);
+
 void run_systems_sequential(schedule_t schedule);
 void run_systems_parrallel(schedule_t schedule);
 
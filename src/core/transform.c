@@ -0,0 +1,522 @@
+#include "core/transform.h"
+#include "core/ecs.h"
+#include "core/log.h"
+#include "core/systems.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NONE UINT32_MAX
+
+// below this many transforms spawning threads costs more than it saves
+#define PARALLEL_THRESHOLD 8192
+#define MAX_THREADS 16
+
+REGISTER_COMPONENT(transform_t);
+
+typedef struct {
+    quat_t rotation;
+    vec3_t position;
+    vec3_t scale;
+} trs_t;
+
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    uint8_t dirty;
+} subtree_t;
+
+// dense storage, every subtree is contiguous and sorted by depth
+typedef struct {
+    mat4_t* world;
+    trs_t* local;
+    uint32_t* parent; // dense index
+    uint32_t* subtree;
+    uint32_t* handle; // NONE once destroyed
+    uint8_t* dirty;
+    uint32_t* changed; // update the world matrix was last recomputed in
+} transform_storage_t;
+
+static transform_storage_t storage;
+static uint32_t count = 0;
+static uint32_t capacity = 0;
+
+// indexed by handle
+static uint32_t* dense_of = NULL;
+static uint32_t* free_handles = NULL;
+static uint32_t handle_count = 0;
+static uint32_t handle_capacity = 0;
+static uint32_t free_count = 0;
+
+static subtree_t* subtrees = NULL;
+static uint32_t subtree_count = 0;
+static uint32_t subtree_capacity = 0;
+
+// set on any structural change, the order gets rebuilt before the next propagation
+static int order_dirty = 0;
+
+// counts update_transforms() calls, new transforms start at 0 which never matches
+static uint32_t update_frame = 1;
+
+// UPDATE systems run in parallel, structural changes have to be serialized
+static pthread_mutex_t hierarchy_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const trs_t identity_trs = {
+    .rotation = { .v = {0.0f, 0.0f, 0.0f, 1.0f} },
+    .position = { .v = {0.0f, 0.0f, 0.0f} },
+    .scale = { .v = {1.0f, 1.0f, 1.0f} },
+};
+
+static const mat4_t identity_matrix = { .m = {
+    1.0f, 0.0f, 0.0f, 0.0f,
+    0.0f, 1.0f, 0.0f, 0.0f,
+    0.0f, 0.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f,
+} };
+
+static void alloc_storage(transform_storage_t* s, uint32_t new_capacity) {
+    s->world = aligned_alloc(16, new_capacity * sizeof(mat4_t));
+    s->local = malloc(new_capacity * sizeof(trs_t));
+    s->parent = malloc(new_capacity * sizeof(uint32_t));
+    s->subtree = malloc(new_capacity * sizeof(uint32_t));
+    s->handle = malloc(new_capacity * sizeof(uint32_t));
+    s->dirty = malloc(new_capacity * sizeof(uint8_t));
+    s->changed = malloc(new_capacity * sizeof(uint32_t));
+
+    if (!s->world || !s->local || !s->parent || !s->subtree || !s->handle || !s->dirty || !s->changed) {
+        FATAL("Failed to allocate storage for %d transforms.", new_capacity);
+    }
+}
+
+static void free_storage(transform_storage_t* s) {
+    free(s->world);
+    free(s->local);
+    free(s->parent);
+    free(s->subtree);
+    free(s->handle);
+    free(s->dirty);
+    free(s->changed);
+    memset(s, 0, sizeof(transform_storage_t));
+}
+
+static void reserve_dense(uint32_t needed) {
+    if (needed <= capacity) {
+        return;
+    }
+
+    uint32_t new_capacity = capacity ? capacity * 2 : 256;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+
+    transform_storage_t new_storage;
+    alloc_storage(&new_storage, new_capacity);
+
+    if (count > 0) {
+        memcpy(new_storage.world, storage.world, count * sizeof(mat4_t));
+        memcpy(new_storage.local, storage.local, count * sizeof(trs_t));
+        memcpy(new_storage.parent, storage.parent, count * sizeof(uint32_t));
+        memcpy(new_storage.subtree, storage.subtree, count * sizeof(uint32_t));
+        memcpy(new_storage.handle, storage.handle, count * sizeof(uint32_t));
+        memcpy(new_storage.dirty, storage.dirty, count * sizeof(uint8_t));
+        memcpy(new_storage.changed, storage.changed, count * sizeof(uint32_t));
+    }
+
+    free_storage(&storage);
+    storage = new_storage;
+    capacity = new_capacity;
+}
+
+static uint32_t alloc_handle() {
+    if (free_count > 0) {
+        return free_handles[--free_count];
+    }
+
+    if (handle_count == handle_capacity) {
+        handle_capacity = handle_capacity ? handle_capacity * 2 : 256;
+        dense_of = realloc(dense_of, handle_capacity * sizeof(uint32_t));
+        free_handles = realloc(free_handles, handle_capacity * sizeof(uint32_t));
+        if (!dense_of || !free_handles) {
+            FATAL("Failed to allocate %d transform handles.", handle_capacity);
+        }
+    }
+
+    return handle_count++;
+}
+
+static uint32_t get_dense(transform_t transform) {
+    if (transform.id >= handle_count || dense_of[transform.id] == NONE) {
+        WARN("Transform %d does not exist.", transform.id);
+        return NONE;
+    }
+    return dense_of[transform.id];
+}
+
+static void mark_dirty(uint32_t idx) {
+    storage.dirty[idx] = 1;
+    if (!order_dirty) {
+        subtrees[storage.subtree[idx]].dirty = 1;
+    }
+}
+
+// lays every root subtree out contiguously in breadth first order and drops destroyed transforms
+static void rebuild_order() {
+    uint32_t* child_start = calloc(count + 1, sizeof(uint32_t));
+    uint32_t* children = malloc((count + 1) * sizeof(uint32_t));
+    uint32_t* order = malloc((count + 1) * sizeof(uint32_t));
+    uint32_t* new_index = malloc((count + 1) * sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (storage.handle[i] != NONE && storage.parent[i] != NONE) {
+            child_start[storage.parent[i] + 1]++;
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        child_start[i + 1] += child_start[i];
+    }
+    memcpy(new_index, child_start, count * sizeof(uint32_t)); // used as fill cursors
+    for (uint32_t i = 0; i < count; i++) {
+        if (storage.handle[i] != NONE && storage.parent[i] != NONE) {
+            children[new_index[storage.parent[i]]++] = i;
+        }
+    }
+
+    subtree_count = 0;
+    uint32_t live = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (storage.handle[i] == NONE || storage.parent[i] != NONE) {
+            continue;
+        }
+
+        if (subtree_count == subtree_capacity) {
+            subtree_capacity = subtree_capacity ? subtree_capacity * 2 : 64;
+            subtrees = realloc(subtrees, subtree_capacity * sizeof(subtree_t));
+        }
+
+        uint32_t start = live;
+        order[live++] = i;
+        for (uint32_t head = start; head < live; head++) {
+            uint32_t node = order[head];
+            for (uint32_t c = child_start[node]; c < child_start[node + 1]; c++) {
+                order[live++] = children[c];
+            }
+        }
+
+        subtrees[subtree_count++] = (subtree_t){ .start = start, .end = live, .dirty = 0 };
+    }
+
+    for (uint32_t k = 0; k < live; k++) {
+        new_index[order[k]] = k;
+    }
+
+    transform_storage_t new_storage;
+    alloc_storage(&new_storage, capacity);
+
+    for (uint32_t s = 0; s < subtree_count; s++) {
+        for (uint32_t k = subtrees[s].start; k < subtrees[s].end; k++) {
+            uint32_t old = order[k];
+            new_storage.world[k] = storage.world[old];
+            new_storage.local[k] = storage.local[old];
+            new_storage.parent[k] = storage.parent[old] == NONE ? NONE : new_index[storage.parent[old]];
+            new_storage.subtree[k] = s;
+            new_storage.handle[k] = storage.handle[old];
+            new_storage.dirty[k] = storage.dirty[old];
+            new_storage.changed[k] = storage.changed[old];
+
+            dense_of[new_storage.handle[k]] = k;
+            subtrees[s].dirty |= new_storage.dirty[k];
+        }
+    }
+
+    free_storage(&storage);
+    storage = new_storage;
+    count = live;
+
+    free(child_start);
+    free(children);
+    free(order);
+    free(new_index);
+
+    order_dirty = 0;
+
+    TRACE("Rebuilt transform hierarchy: %d transforms in %d subtrees.", count, subtree_count);
+}
+
+transform_t create_transform(transform_t parent) {
+    pthread_mutex_lock(&hierarchy_lock);
+
+    uint32_t parent_idx = NONE;
+    if (parent.id != NONE) {
+        parent_idx = get_dense(parent);
+        if (parent_idx == NONE) {
+            pthread_mutex_unlock(&hierarchy_lock);
+            return TRANSFORM_NONE;
+        }
+    }
+
+    reserve_dense(count + 1);
+
+    uint32_t handle = alloc_handle();
+    uint32_t idx = count++;
+
+    dense_of[handle] = idx;
+    storage.world[idx] = identity_matrix;
+    storage.local[idx] = identity_trs;
+    storage.parent[idx] = parent_idx;
+    storage.subtree[idx] = NONE;
+    storage.handle[idx] = handle;
+    storage.dirty[idx] = 1;
+    storage.changed[idx] = 0;
+
+    order_dirty = 1;
+
+    pthread_mutex_unlock(&hierarchy_lock);
+
+    TRACE("Created transform %d.", handle);
+
+    return (transform_t){ .id = handle };
+}
+
+void destroy_transform(transform_t transform) {
+    pthread_mutex_lock(&hierarchy_lock);
+
+    uint32_t idx = get_dense(transform);
+    if (idx == NONE) {
+        pthread_mutex_unlock(&hierarchy_lock);
+        return;
+    }
+
+    // the node itself is only dropped during the next rebuild
+    for (uint32_t i = 0; i < count; i++) {
+        if (storage.parent[i] == idx && storage.handle[i] != NONE) {
+            storage.parent[i] = storage.parent[idx];
+            storage.dirty[i] = 1;
+        }
+    }
+
+    storage.handle[idx] = NONE;
+    dense_of[transform.id] = NONE;
+    free_handles[free_count++] = transform.id;
+
+    order_dirty = 1;
+
+    pthread_mutex_unlock(&hierarchy_lock);
+
+    TRACE("Destroyed transform %d.", transform.id);
+}
+
+void set_transform_parent(transform_t transform, transform_t parent) {
+    pthread_mutex_lock(&hierarchy_lock);
+
+    uint32_t idx = get_dense(transform);
+    uint32_t parent_idx = NONE;
+    if (parent.id != NONE) {
+        parent_idx = get_dense(parent);
+        if (parent_idx == NONE) {
+            pthread_mutex_unlock(&hierarchy_lock);
+            return;
+        }
+    }
+
+    if (idx == NONE) {
+        pthread_mutex_unlock(&hierarchy_lock);
+        return;
+    }
+
+    for (uint32_t p = parent_idx; p != NONE; p = storage.parent[p]) {
+        if (p == idx) {
+            WARN("Cannot parent transform %d to its own descendant %d.", transform.id, parent.id);
+            pthread_mutex_unlock(&hierarchy_lock);
+            return;
+        }
+    }
+
+    storage.parent[idx] = parent_idx;
+    storage.dirty[idx] = 1;
+    order_dirty = 1;
+
+    pthread_mutex_unlock(&hierarchy_lock);
+}
+
+// the rest takes the lock too, create_transform() may move the storage from another system
+
+transform_t get_transform_parent(transform_t transform) {
+    pthread_mutex_lock(&hierarchy_lock);
+
+    transform_t parent = TRANSFORM_NONE;
+    uint32_t idx = get_dense(transform);
+    if (idx != NONE && storage.parent[idx] != NONE) {
+        parent.id = storage.handle[storage.parent[idx]];
+    }
+
+    pthread_mutex_unlock(&hierarchy_lock);
+    return parent;
+}
+
+void set_transform_position(transform_t transform, float x, float y, float z) {
+    pthread_mutex_lock(&hierarchy_lock);
+
+    uint32_t idx = get_dense(transform);
+    if (idx != NONE) {
+        storage.local[idx].position = vec3(x, y, z);
+        mark_dirty(idx);
+    }
+
+    pthread_mutex_unlock(&hierarchy_lock);
+}
+
+void set_transform_rotation(transform_t transform, float x, float y, float z, float w) {
+    pthread_mutex_lock(&hierarchy_lock);
+
+    uint32_t idx = get_dense(transform);
+    if (idx != NONE) {
+        storage.local[idx].rotation = quat(x, y, z, w);
+        mark_dirty(idx);
+    }
+
+    pthread_mutex_unlock(&hierarchy_lock);
+}
+
+void set_transform_scale(transform_t transform, float x, float y, float z) {
+    pthread_mutex_lock(&hierarchy_lock);
+
+    uint32_t idx = get_dense(transform);
+    if (idx != NONE) {
+        storage.local[idx].scale = vec3(x, y, z);
+        mark_dirty(idx);
+    }
+
+    pthread_mutex_unlock(&hierarchy_lock);
+}
+
+// read once per entity by parallel render systems, no lock, see the phase rule in transform.h
+const mat4_t* get_transform_world(transform_t transform) {
+    uint32_t idx = get_dense(transform);
+    return idx != NONE ? &storage.world[idx] : &identity_matrix;
+}
+
+int was_transform_updated(transform_t transform) {
+    uint32_t idx = get_dense(transform);
+    return idx != NONE && storage.changed[idx] == update_frame;
+}
+
+uint32_t get_transform_count() {
+    return count;
+}
+
+static void propagate_subtree(subtree_t* subtree) {
+    for (uint32_t i = subtree->start; i < subtree->end; i++) {
+        uint32_t p = storage.parent[i];
+        if (p != NONE && storage.dirty[p]) {
+            storage.dirty[i] = 1;
+        }
+
+        if (!storage.dirty[i]) {
+            continue;
+        }
+
+        storage.changed[i] = update_frame;
+
+        const trs_t* trs = &storage.local[i];
+        if (p == NONE) {
+            storage.world[i] = mat4_from_trs(trs->position, trs->rotation, trs->scale);
+        } else {
+            mat4_t local_matrix = mat4_from_trs(trs->position, trs->rotation, trs->scale);
+            mat4_mul_to(&storage.world[i], &storage.world[p], &local_matrix);
+        }
+    }
+
+    // children are always after their parents so the flags can only be cleared once the subtree is done
+    memset(&storage.dirty[subtree->start], 0, subtree->end - subtree->start);
+    subtree->dirty = 0;
+}
+
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+} subtree_range_t;
+
+static void* propagate_range(void* arg) {
+    subtree_range_t* range = arg;
+    for (uint32_t s = range->first; s < range->last; s++) {
+        if (subtrees[s].dirty) {
+            propagate_subtree(&subtrees[s]);
+        }
+    }
+    return NULL;
+}
+
+void update_transforms() {
+    pthread_mutex_lock(&hierarchy_lock);
+
+    update_frame++;
+
+    if (order_dirty) {
+        rebuild_order();
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t thread_count = cpus > 1 ? (uint32_t)cpus : 1;
+    if (thread_count > MAX_THREADS) {
+        thread_count = MAX_THREADS;
+    }
+
+    if (count < PARALLEL_THRESHOLD || subtree_count < 2 || thread_count == 1) {
+        subtree_range_t all = { .first = 0, .last = subtree_count };
+        propagate_range(&all);
+        pthread_mutex_unlock(&hierarchy_lock);
+        return;
+    }
+
+    // split the subtrees into contiguous ranges with roughly the same number of transforms
+    pthread_t threads[MAX_THREADS];
+    subtree_range_t ranges[MAX_THREADS];
+    uint32_t target = count / thread_count;
+    uint32_t used = 0;
+    uint32_t s = 0;
+
+    while (s < subtree_count && used < thread_count) {
+        ranges[used].first = s;
+        uint32_t nodes = 0;
+        while (s < subtree_count && (nodes < target || used == thread_count - 1)) {
+            nodes += subtrees[s].end - subtrees[s].start;
+            s++;
+        }
+        ranges[used].last = s;
+        used++;
+    }
+
+    for (uint32_t t = 1; t < used; t++) {
+        pthread_create(&threads[t], NULL, propagate_range, &ranges[t]);
+    }
+    propagate_range(&ranges[0]);
+    for (uint32_t t = 1; t < used; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    pthread_mutex_unlock(&hierarchy_lock);
+}
+
+// runs after gameplay so rendering sees this frame's transforms
+REGISTER_SYSTEM_FRONT(update_transforms, PRE_RENDER);
+
+void cleanup_transforms() {
+    free_storage(&storage);
+    free(dense_of);
+    free(free_handles);
+    free(subtrees);
+
+    dense_of = NULL;
+    free_handles = NULL;
+    subtrees = NULL;
+    count = capacity = 0;
+    handle_count = handle_capacity = free_count = 0;
+    subtree_count = subtree_capacity = 0;
+
+    TRACE("Cleaned up transforms.");
+}
+
+REGISTER_SYSTEM(cleanup_transforms, CLEANUP);
@@ -0,0 +1,50 @@
+#ifndef OVERTURE_TRANSFORM
+#define OVERTURE_TRANSFORM
+
+#include <stdint.h>
+#include "overture/math.h"
+
+/*
+ * Transforms live in one hierarchy owned by transform.c, entities only store a handle to them.
+ *
+ * Internally every root and all of its descendants are stored contiguously and sorted by depth,
+ * so world matrices are propagated in one linear pass (parents are always before their children)
+ * and independent root subtrees can be propagated on different threads. Subtrees where nothing
+ * changed since the last update are skipped entirely.
+ *
+ * Creating, destroying, reparenting and the setters are safe from the parallel UPDATE systems.
+ * get_transform_world() and was_transform_updated() take no lock so culling and the other
+ * PRE_RENDER and RENDER systems can call them per entity from many threads, which only holds
+ * as long as nothing changes the hierarchy while they run: do structural changes in UPDATE.
+ */
+
+typedef struct {
+    uint32_t id;
+} transform_t;
+
+#define TRANSFORM_NONE ((transform_t){ .id = UINT32_MAX })
+
+// pass TRANSFORM_NONE as the parent to create a root transform, returns TRANSFORM_NONE when the parent doesn't exist
+transform_t create_transform(transform_t parent);
+// children of a destroyed transform are attached to its parent
+void destroy_transform(transform_t transform);
+void set_transform_parent(transform_t transform, transform_t parent);
+transform_t get_transform_parent(transform_t transform);
+
+void set_transform_position(transform_t transform, float x, float y, float z);
+// rotation is a unit quaternion (x, y, z, w)
+void set_transform_rotation(transform_t transform, float x, float y, float z, float w);
+void set_transform_scale(transform_t transform, float x, float y, float z);
+
+// only valid until the next update_transforms() or structural change
+const mat4_t* get_transform_world(transform_t transform);
+
+// whether the world matrix changed in the last update_transforms()
+int was_transform_updated(transform_t transform);
+
+uint32_t get_transform_count();
+
+// propagates world matrices, registered at the front of PRE_RENDER
+void update_transforms();
+
+#endif
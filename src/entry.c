@@ -1,6 +1,8 @@
+#include "core/events.h"
 #include "core/systems.h"
 #include "graphics/opengl.h"
 #include "platform/window.h"
+#include "platform/input.h"
 
 //temp
 int should_exit = 0;
@@ -11,12 +13,17 @@ int main() {
     run_systems_sequential(SETUP);
     
     while (!should_exit) {
+        // last frame's events become readable
+        swap_event_buffers();
+        // update_input() in PRE_UPDATE picks up what this produced
+        poll_input();
         run_systems_parrallel(PRE_UPDATE);
         run_systems_parrallel(UPDATE);
         run_systems_parrallel(POST_UPDATE);
 
         run_systems_sequential(PRE_RENDER);
-        run_systems_sequential(RENDER);
+        // render systems only submit draw packets, they get executed in POST_RENDER
+        run_systems_parrallel(RENDER);
         run_systems_sequential(POST_RENDER);
     }
 
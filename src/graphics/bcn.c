@@ -0,0 +1,523 @@
+#include "graphics/bcn.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+static const uint8_t bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+uint32_t get_bc_block_size(bc_format_t format) {
+    return format == BC1_RGB ? 8 : 16;
+}
+
+size_t get_bc_level_size(bc_format_t format, uint32_t width, uint32_t height) {
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * get_bc_block_size(format);
+}
+
+// edge blocks repeat the last row and column
+static void load_block(const image_t* image, uint32_t bx, uint32_t by, float block[16][4]) {
+    for (uint32_t i = 0; i < 16; i++) {
+        uint32_t x = bx * 4 + i % 4, y = by * 4 + i / 4;
+        x = x < image->width ? x : image->width - 1;
+        y = y < image->height ? y : image->height - 1;
+
+        const uint8_t* p = image->pixels + ((size_t)y * image->width + x) * image->channels;
+        for (uint32_t c = 0; c < 4; c++) {
+            block[i][c] = image->channels == 1 ? (c < 3 ? p[0] : 255.0f) : p[c];
+        }
+    }
+}
+
+static float clampf(float v, float lo, float hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// endpoints at the extremes of the block along its principal axis
+static void fit_endpoints(const float block[16][4], uint32_t channels, float e0[4], float e1[4]) {
+    float mean[4] = {0}, cov[4][4] = {{0}};
+    for (uint32_t i = 0; i < 16; i++) {
+        for (uint32_t c = 0; c < channels; c++) {
+            mean[c] += block[i][c] / 16.0f;
+        }
+    }
+    for (uint32_t i = 0; i < 16; i++) {
+        for (uint32_t a = 0; a < channels; a++) {
+            for (uint32_t b = 0; b < channels; b++) {
+                cov[a][b] += (block[i][a] - mean[a]) * (block[i][b] - mean[b]);
+            }
+        }
+    }
+
+    // power iteration from the bounding box diagonal
+    float axis[4] = {0}, lo[4], hi[4];
+    for (uint32_t c = 0; c < channels; c++) {
+        lo[c] = hi[c] = block[0][c];
+        for (uint32_t i = 1; i < 16; i++) {
+            lo[c] = fminf(lo[c], block[i][c]);
+            hi[c] = fmaxf(hi[c], block[i][c]);
+        }
+        axis[c] = hi[c] - lo[c];
+    }
+
+    for (uint32_t iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {0}, length = 0.0f;
+        for (uint32_t a = 0; a < channels; a++) {
+            for (uint32_t b = 0; b < channels; b++) {
+                next[a] += cov[a][b] * axis[b];
+            }
+            length = fmaxf(length, fabsf(next[a]));
+        }
+        if (length < 1e-6f) {
+            break;
+        }
+        for (uint32_t c = 0; c < channels; c++) {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    float length = 0.0f;
+    for (uint32_t c = 0; c < channels; c++) {
+        length += axis[c] * axis[c];
+    }
+    if (length < 1e-12f) {
+        memcpy(e0, mean, sizeof(float) * 4);
+        memcpy(e1, mean, sizeof(float) * 4);
+        return;
+    }
+
+    float min_t = FLT_MAX, max_t = -FLT_MAX;
+    for (uint32_t i = 0; i < 16; i++) {
+        float t = 0.0f;
+        for (uint32_t c = 0; c < channels; c++) {
+            t += (block[i][c] - mean[c]) * axis[c];
+        }
+        min_t = fminf(min_t, t / length);
+        max_t = fmaxf(max_t, t / length);
+    }
+
+    for (uint32_t c = 0; c < channels; c++) {
+        e0[c] = clampf(mean[c] + axis[c] * min_t, 0.0f, 255.0f);
+        e1[c] = clampf(mean[c] + axis[c] * max_t, 0.0f, 255.0f);
+    }
+}
+
+// endpoints that minimize the error for fixed interpolation weights, keeps them when singular
+static void refine_endpoints(const float block[16][4], uint32_t channels, const float weights[16], float e0[4], float e1[4]) {
+    float aa = 0.0f, bb = 0.0f, ab = 0.0f, ax[4] = {0}, bx[4] = {0};
+    for (uint32_t i = 0; i < 16; i++) {
+        float b = weights[i], a = 1.0f - b;
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        for (uint32_t c = 0; c < channels; c++) {
+            ax[c] += a * block[i][c];
+            bx[c] += b * block[i][c];
+        }
+    }
+
+    float det = aa * bb - ab * ab;
+    if (fabsf(det) < 1e-6f) {
+        return;
+    }
+    for (uint32_t c = 0; c < channels; c++) {
+        e0[c] = clampf((ax[c] * bb - bx[c] * ab) / det, 0.0f, 255.0f);
+        e1[c] = clampf((bx[c] * aa - ax[c] * ab) / det, 0.0f, 255.0f);
+    }
+}
+
+// nearest palette entry for every texel, returns the summed squared error
+static float assign_indices(const float block[16][4], uint32_t channels, const float palette[][4], uint32_t count, uint8_t indices[16]) {
+    float total = 0.0f;
+    for (uint32_t i = 0; i < 16; i++) {
+        float best = FLT_MAX;
+        for (uint32_t p = 0; p < count; p++) {
+            float error = 0.0f;
+            for (uint32_t c = 0; c < channels; c++) {
+                float d = block[i][c] - palette[p][c];
+                error += d * d;
+            }
+            if (error < best) {
+                best = error;
+                indices[i] = p;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+static uint16_t pack_565(const float c[4]) {
+    uint32_t r = (uint32_t)(clampf(c[0], 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+    uint32_t g = (uint32_t)(clampf(c[1], 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+    uint32_t b = (uint32_t)(clampf(c[2], 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+static void unpack_565(uint16_t v, uint32_t c[3]) {
+    uint32_t r = v >> 11 & 31, g = v >> 5 & 63, b = v & 31;
+    c[0] = r << 3 | r >> 2;
+    c[1] = g << 2 | g >> 4;
+    c[2] = b << 3 | b >> 2;
+}
+
+// 4 color palette, the same integer math as decode_color_block
+static void color_palette(uint16_t c0, uint16_t c1, float palette[4][4]) {
+    uint32_t a[3], b[3];
+    unpack_565(c0, a);
+    unpack_565(c1, b);
+    for (uint32_t c = 0; c < 3; c++) {
+        palette[0][c] = a[c];
+        palette[1][c] = b[c];
+        palette[2][c] = (2 * a[c] + b[c]) / 3;
+        palette[3][c] = (a[c] + 2 * b[c]) / 3;
+    }
+}
+
+static float try_color_endpoints(const float block[16][4], const float e0[4], const float e1[4], uint16_t* c0, uint16_t* c1,
+                                 uint8_t indices[16]) {
+    *c0 = pack_565(e0);
+    *c1 = pack_565(e1);
+    // c0 > c1 selects the 4 color mode in BC1, in BC3 it is always used
+    if (*c0 < *c1) {
+        uint16_t t = *c0;
+        *c0 = *c1;
+        *c1 = t;
+    }
+
+    float palette[4][4];
+    color_palette(*c0, *c1, palette);
+    return assign_indices(block, 3, palette, *c0 == *c1 ? 1 : 4, indices);
+}
+
+static void encode_color_block(const float block[16][4], uint8_t out[8]) {
+    float e0[4], e1[4];
+    fit_endpoints(block, 3, e0, e1);
+
+    uint16_t c0, c1;
+    uint8_t indices[16];
+    float error = try_color_endpoints(block, e0, e1, &c0, &c1, indices);
+
+    if (c0 != c1) {
+        static const float index_weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+        float weights[16];
+        for (uint32_t i = 0; i < 16; i++) {
+            weights[i] = index_weights[indices[i]];
+        }
+
+        // weights go from c0 to c1, which may be swapped from e0 and e1
+        float palette[4][4];
+        color_palette(c0, c1, palette);
+        memcpy(e0, palette[0], sizeof(e0));
+        memcpy(e1, palette[1], sizeof(e1));
+        refine_endpoints(block, 3, weights, e0, e1);
+
+        uint16_t r0, r1;
+        uint8_t refined[16];
+        if (try_color_endpoints(block, e0, e1, &r0, &r1, refined) < error) {
+            c0 = r0;
+            c1 = r1;
+            memcpy(indices, refined, sizeof(indices));
+        }
+    }
+
+    uint32_t bits = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        bits |= (uint32_t)indices[i] << (i * 2);
+    }
+    out[0] = c0 & 0xff;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xff;
+    out[3] = c1 >> 8;
+    memcpy(out + 4, &bits, 4);
+}
+
+// BC4 block for one channel, always in the 8 value mode
+static void encode_channel_block(const float block[16][4], uint32_t channel, uint8_t out[8]) {
+    float lo = 255.0f, hi = 0.0f;
+    for (uint32_t i = 0; i < 16; i++) {
+        lo = fminf(lo, block[i][channel]);
+        hi = fmaxf(hi, block[i][channel]);
+    }
+
+    uint32_t a0 = (uint32_t)(hi + 0.5f), a1 = (uint32_t)(lo + 0.5f);
+    uint64_t bits = 0;
+    if (a0 != a1) {
+        float palette[8];
+        palette[0] = a0;
+        palette[1] = a1;
+        for (uint32_t k = 1; k < 7; k++) {
+            palette[k + 1] = ((7 - k) * a0 + k * a1) / 7;
+        }
+
+        for (uint32_t i = 0; i < 16; i++) {
+            uint64_t best_index = 0;
+            float best = FLT_MAX;
+            for (uint32_t p = 0; p < 8; p++) {
+                float d = fabsf(block[i][channel] - palette[p]);
+                if (d < best) {
+                    best = d;
+                    best_index = p;
+                }
+            }
+            bits |= best_index << (i * 3);
+        }
+    }
+
+    out[0] = a0;
+    out[1] = a1;
+    for (uint32_t i = 0; i < 6; i++) {
+        out[2 + i] = bits >> (i * 8) & 0xff;
+    }
+}
+
+// 7 bit endpoint plus the p bit that reproduce the color best
+static void quantize_bc7_endpoint(const float e[4], uint32_t q[4], uint32_t* p) {
+    float best = FLT_MAX;
+    for (uint32_t bit = 0; bit < 2; bit++) {
+        uint32_t candidate[4];
+        float error = 0.0f;
+        for (uint32_t c = 0; c < 4; c++) {
+            float v = (e[c] - bit) / 2.0f;
+            candidate[c] = (uint32_t)clampf(v + 0.5f, 0.0f, 127.0f);
+            float d = (float)(candidate[c] << 1 | bit) - e[c];
+            error += d * d;
+        }
+        if (error < best) {
+            best = error;
+            *p = bit;
+            memcpy(q, candidate, sizeof(candidate));
+        }
+    }
+}
+
+static float try_bc7_endpoints(const float block[16][4], const float e0[4], const float e1[4], uint32_t q0[4], uint32_t q1[4],
+                               uint32_t* p0, uint32_t* p1, uint8_t indices[16]) {
+    quantize_bc7_endpoint(e0, q0, p0);
+    quantize_bc7_endpoint(e1, q1, p1);
+
+    float palette[16][4];
+    for (uint32_t w = 0; w < 16; w++) {
+        for (uint32_t c = 0; c < 4; c++) {
+            uint32_t a = q0[c] << 1 | *p0, b = q1[c] << 1 | *p1;
+            palette[w][c] = ((64 - bc7_weights[w]) * a + bc7_weights[w] * b + 32) >> 6;
+        }
+    }
+    return assign_indices(block, 4, palette, 16, indices);
+}
+
+static void put_bits(uint8_t out[16], uint32_t* position, uint32_t value, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++, (*position)++) {
+        if (value >> i & 1) {
+            out[*position >> 3] |= 1 << (*position & 7);
+        }
+    }
+}
+
+static uint32_t get_bits(const uint8_t in[16], uint32_t* position, uint32_t count) {
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < count; i++, (*position)++) {
+        value |= (uint32_t)(in[*position >> 3] >> (*position & 7) & 1) << i;
+    }
+    return value;
+}
+
+static void encode_bc7_block(const float block[16][4], uint8_t out[16]) {
+    float e0[4], e1[4];
+    fit_endpoints(block, 4, e0, e1);
+
+    uint32_t q0[4], q1[4], p0, p1;
+    uint8_t indices[16];
+    float error = try_bc7_endpoints(block, e0, e1, q0, q1, &p0, &p1, indices);
+
+    float weights[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        weights[i] = bc7_weights[indices[i]] / 64.0f;
+    }
+    refine_endpoints(block, 4, weights, e0, e1);
+
+    uint32_t r0[4], r1[4], rp0, rp1;
+    uint8_t refined[16];
+    if (try_bc7_endpoints(block, e0, e1, r0, r1, &rp0, &rp1, refined) < error) {
+        memcpy(q0, r0, sizeof(q0));
+        memcpy(q1, r1, sizeof(q1));
+        p0 = rp0;
+        p1 = rp1;
+        memcpy(indices, refined, sizeof(indices));
+    }
+
+    // the first index has its top bit implied 0, swapping the endpoints flips the indices
+    if (indices[0] & 8) {
+        for (uint32_t c = 0; c < 4; c++) {
+            uint32_t t = q0[c];
+            q0[c] = q1[c];
+            q1[c] = t;
+        }
+        uint32_t t = p0;
+        p0 = p1;
+        p1 = t;
+        for (uint32_t i = 0; i < 16; i++) {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    memset(out, 0, 16);
+    uint32_t position = 0;
+    put_bits(out, &position, 1 << 6, 7);
+    for (uint32_t c = 0; c < 4; c++) {
+        put_bits(out, &position, q0[c], 7);
+        put_bits(out, &position, q1[c], 7);
+    }
+    put_bits(out, &position, p0, 1);
+    put_bits(out, &position, p1, 1);
+    for (uint32_t i = 0; i < 16; i++) {
+        put_bits(out, &position, indices[i], i == 0 ? 3 : 4);
+    }
+}
+
+void encode_bc_image(bc_format_t format, const image_t* image, uint8_t* out) {
+    uint32_t blocks_x = (image->width + 3) / 4, blocks_y = (image->height + 3) / 4;
+    uint32_t block_size = get_bc_block_size(format);
+
+    float block[16][4];
+    for (uint32_t by = 0; by < blocks_y; by++) {
+        for (uint32_t bx = 0; bx < blocks_x; bx++) {
+            load_block(image, bx, by, block);
+            uint8_t* dst = out + ((size_t)by * blocks_x + bx) * block_size;
+
+            switch (format) {
+            case BC1_RGB:
+                encode_color_block(block, dst);
+                break;
+            case BC3_RGBA:
+                encode_channel_block(block, 3, dst);
+                encode_color_block(block, dst + 8);
+                break;
+            case BC5_RG:
+                encode_channel_block(block, 0, dst);
+                encode_channel_block(block, 1, dst + 8);
+                break;
+            case BC7_RGBA:
+                encode_bc7_block(block, dst);
+                break;
+            }
+        }
+    }
+}
+
+static void decode_color_block(const uint8_t in[8], int four_color, uint8_t out[16][4]) {
+    uint16_t c0 = in[0] | in[1] << 8, c1 = in[2] | in[3] << 8;
+    uint32_t a[3], b[3], palette[4][4];
+    unpack_565(c0, a);
+    unpack_565(c1, b);
+
+    for (uint32_t c = 0; c < 3; c++) {
+        palette[0][c] = a[c];
+        palette[1][c] = b[c];
+        if (four_color || c0 > c1) {
+            palette[2][c] = (2 * a[c] + b[c]) / 3;
+            palette[3][c] = (a[c] + 2 * b[c]) / 3;
+        } else {
+            palette[2][c] = (a[c] + b[c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    palette[0][3] = palette[1][3] = palette[2][3] = 255;
+    palette[3][3] = four_color || c0 > c1 ? 255 : 0;
+
+    uint32_t bits;
+    memcpy(&bits, in + 4, 4);
+    for (uint32_t i = 0; i < 16; i++) {
+        for (uint32_t c = 0; c < 4; c++) {
+            out[i][c] = palette[bits >> (i * 2) & 3][c];
+        }
+    }
+}
+
+static void decode_channel_block(const uint8_t in[8], uint32_t channel, uint8_t out[16][4]) {
+    uint32_t a0 = in[0], a1 = in[1], palette[8] = { a0, a1 };
+    if (a0 > a1) {
+        for (uint32_t k = 1; k < 7; k++) {
+            palette[k + 1] = ((7 - k) * a0 + k * a1) / 7;
+        }
+    } else {
+        for (uint32_t k = 1; k < 5; k++) {
+            palette[k + 1] = ((5 - k) * a0 + k * a1) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i < 6; i++) {
+        bits |= (uint64_t)in[2 + i] << (i * 8);
+    }
+    for (uint32_t i = 0; i < 16; i++) {
+        out[i][channel] = palette[bits >> (i * 3) & 7];
+    }
+}
+
+static void decode_bc7_block(const uint8_t in[16], uint8_t out[16][4]) {
+    // modes other than 6 decode as magenta
+    if ((in[0] & 0x7f) != 1 << 6) {
+        for (uint32_t i = 0; i < 16; i++) {
+            out[i][0] = out[i][2] = out[i][3] = 255;
+            out[i][1] = 0;
+        }
+        return;
+    }
+
+    uint32_t position = 7, e0[4], e1[4];
+    for (uint32_t c = 0; c < 4; c++) {
+        e0[c] = get_bits(in, &position, 7);
+        e1[c] = get_bits(in, &position, 7);
+    }
+    uint32_t p0 = get_bits(in, &position, 1), p1 = get_bits(in, &position, 1);
+
+    for (uint32_t i = 0; i < 16; i++) {
+        uint32_t index = get_bits(in, &position, i == 0 ? 3 : 4);
+        for (uint32_t c = 0; c < 4; c++) {
+            uint32_t a = e0[c] << 1 | p0, b = e1[c] << 1 | p1;
+            out[i][c] = ((64 - bc7_weights[index]) * a + bc7_weights[index] * b + 32) >> 6;
+        }
+    }
+}
+
+void decode_bc_image(bc_format_t format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba) {
+    uint32_t blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+    uint32_t block_size = get_bc_block_size(format);
+
+    uint8_t block[16][4];
+    for (uint32_t by = 0; by < blocks_y; by++) {
+        for (uint32_t bx = 0; bx < blocks_x; bx++) {
+            const uint8_t* src = blocks + ((size_t)by * blocks_x + bx) * block_size;
+
+            switch (format) {
+            case BC1_RGB:
+                decode_color_block(src, 0, block);
+                break;
+            case BC3_RGBA:
+                decode_color_block(src + 8, 1, block);
+                decode_channel_block(src, 3, block);
+                break;
+            case BC5_RG:
+                decode_channel_block(src, 0, block);
+                decode_channel_block(src + 8, 1, block);
+                for (uint32_t i = 0; i < 16; i++) {
+                    block[i][2] = 0;
+                    block[i][3] = 255;
+                }
+                break;
+            case BC7_RGBA:
+                decode_bc7_block(src, block);
+                break;
+            }
+
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t x = bx * 4 + i % 4, y = by * 4 + i / 4;
+                if (x < width && y < height) {
+                    memcpy(rgba + ((size_t)y * width + x) * 4, block[i], 4);
+                }
+            }
+        }
+    }
+}
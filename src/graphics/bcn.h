@@ -0,0 +1,38 @@
+#ifndef OVERTURE_BCN
+#define OVERTURE_BCN
+
+#include <stddef.h>
+#include <stdint.h>
+#include "graphics/image.h"
+
+/*
+ * Block compression for textures. Every format stores 4x4 texel blocks, BC1 in 8 bytes (rgb,
+ * 8:1 against rgba8) and the others in 16 (4:1). The encoder fits block endpoints along the
+ * principal axis of the block's colors and refines them once with least squares, which is fast
+ * enough for an offline converter and close to what heavier encoders reach on smooth content.
+ *
+ *   BC1_RGB   opaque color
+ *   BC3_RGBA  color with smooth alpha
+ *   BC5_RG    two independent channels, normal maps with z rebuilt in the shader
+ *   BC7_RGBA  higher quality color and alpha, only mode 6 (one subset, 4 bit indices) is written
+ *
+ * The decoder exists for tools and tests, for BC7 it only understands mode 6 blocks.
+ */
+
+typedef enum {
+    BC1_RGB,
+    BC3_RGBA,
+    BC5_RG,
+    BC7_RGBA,
+} bc_format_t;
+
+// bytes per 4x4 block
+uint32_t get_bc_block_size(bc_format_t format);
+size_t get_bc_level_size(bc_format_t format, uint32_t width, uint32_t height);
+
+// grayscale images are expanded to rgb, out needs get_bc_level_size() bytes
+void encode_bc_image(bc_format_t format, const image_t* image, uint8_t* out);
+// into width * height rgba texels
+void decode_bc_image(bc_format_t format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba);
+
+#endif
@@ -0,0 +1,334 @@
+#include "graphics/image.h"
+#include "core/log.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define MAX_IMAGE_DECODERS 16
+
+typedef struct {
+    char extension[16];
+    image_decoder_t decoder;
+} decoder_entry_t;
+
+static int decode_tga(const uint8_t* data, size_t size, image_t* image);
+static int decode_pnm(const uint8_t* data, size_t size, image_t* image);
+
+static decoder_entry_t decoders[MAX_IMAGE_DECODERS] = {
+    { "tga", decode_tga },
+    { "pgm", decode_pnm },
+    { "ppm", decode_pnm },
+    { "pnm", decode_pnm },
+};
+static uint32_t decoder_count = 4;
+// decoders are looked up from the texture loader's worker threads
+static pthread_mutex_t decoder_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static float srgb_to_linear[256];
+static pthread_once_t srgb_once = PTHREAD_ONCE_INIT;
+
+void register_image_decoder(const char* extension, image_decoder_t decoder) {
+    pthread_mutex_lock(&decoder_lock);
+
+    for (uint32_t i = 0; i < decoder_count; i++) {
+        if (strcasecmp(decoders[i].extension, extension) == 0) {
+            decoders[i].decoder = decoder;
+            pthread_mutex_unlock(&decoder_lock);
+            return;
+        }
+    }
+
+    if (decoder_count == MAX_IMAGE_DECODERS || strlen(extension) >= sizeof(decoders[0].extension)) {
+        ERROR("Can't register an image decoder for %s.", extension);
+    } else {
+        strcpy(decoders[decoder_count].extension, extension);
+        decoders[decoder_count++].decoder = decoder;
+    }
+
+    pthread_mutex_unlock(&decoder_lock);
+}
+
+int decode_image(const char* extension, const uint8_t* data, size_t size, image_t* image) {
+    memset(image, 0, sizeof(image_t));
+
+    image_decoder_t decoder = NULL;
+    pthread_mutex_lock(&decoder_lock);
+    for (uint32_t i = 0; i < decoder_count; i++) {
+        if (strcasecmp(decoders[i].extension, extension) == 0) {
+            decoder = decoders[i].decoder;
+        }
+    }
+    pthread_mutex_unlock(&decoder_lock);
+
+    if (decoder == NULL) {
+        ERROR("No image decoder for %s.", extension);
+        return 0;
+    }
+
+    if (!decoder(data, size, image)) {
+        free(image->pixels);
+        memset(image, 0, sizeof(image_t));
+        return 0;
+    }
+    return 1;
+}
+
+int load_image(const char* path, image_t* image) {
+    memset(image, 0, sizeof(image_t));
+
+    const char* dot = strrchr(path, '.');
+    if (dot == NULL) {
+        ERROR("%s has no extension to pick a decoder by.", path);
+        return 0;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        ERROR("Failed to open image %s.", path);
+        return 0;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t* data = malloc(size > 0 ? size : 1);
+    int ok = size > 0 && fread(data, 1, size, file) == (size_t)size;
+    fclose(file);
+
+    ok = ok && decode_image(dot + 1, data, size, image);
+    free(data);
+
+    if (!ok) {
+        ERROR("Failed to decode image %s.", path);
+    }
+    return ok;
+}
+
+void free_image(image_t* image) {
+    free(image->pixels);
+    memset(image, 0, sizeof(image_t));
+}
+
+static int decode_tga(const uint8_t* data, size_t size, image_t* image) {
+    if (size < 18) {
+        return 0;
+    }
+
+    uint32_t id_length = data[0], colormap = data[1], type = data[2];
+    uint32_t width = data[12] | data[13] << 8, height = data[14] | data[15] << 8;
+    uint32_t bpp = data[16], descriptor = data[17];
+
+    int rle = type == 10 || type == 11;
+    int gray = type == 3 || type == 11;
+    if (colormap != 0 || (type != 2 && type != 3 && !rle) || width == 0 || height == 0 ||
+        (gray ? bpp != 8 : bpp != 24 && bpp != 32)) {
+        return 0;
+    }
+
+    uint32_t bytes = bpp / 8;
+    uint32_t count = width * height;
+    size_t offset = 18 + id_length;
+    // rows are stored bottom first unless the origin is at the top
+    int top_first = descriptor & 0x20;
+
+    image->width = width;
+    image->height = height;
+    image->channels = gray ? 1 : 4;
+    image->pixels = malloc((size_t)count * image->channels);
+
+    for (uint32_t i = 0; i < count;) {
+        uint32_t run = count - i;
+        int repeat = 0;
+        if (rle) {
+            if (offset >= size) {
+                return 0;
+            }
+            run = (data[offset] & 0x7f) + 1;
+            repeat = data[offset] & 0x80;
+            offset++;
+            run = run < count - i ? run : count - i;
+        }
+
+        const uint8_t* src = NULL;
+        for (uint32_t j = 0; j < run; j++, i++) {
+            if (!repeat || j == 0) {
+                if (offset + bytes > size) {
+                    return 0;
+                }
+                src = data + offset;
+                offset += bytes;
+            }
+
+            uint32_t row = i / width, column = i % width;
+            uint8_t* dst = image->pixels + ((size_t)(top_first ? row : height - 1 - row) * width + column) * image->channels;
+            if (gray) {
+                dst[0] = src[0];
+            } else {
+                dst[0] = src[2];
+                dst[1] = src[1];
+                dst[2] = src[0];
+                dst[3] = bytes == 4 ? src[3] : 255;
+            }
+        }
+    }
+
+    return 1;
+}
+
+// skips whitespace and comments, returns 0 when there is no number
+static int read_pnm_number(const uint8_t* data, size_t size, size_t* offset, uint32_t* value) {
+    while (*offset < size) {
+        if (data[*offset] == '#') {
+            while (*offset < size && data[*offset] != '\n') {
+                (*offset)++;
+            }
+        } else if (data[*offset] == ' ' || data[*offset] == '\t' || data[*offset] == '\r' || data[*offset] == '\n') {
+            (*offset)++;
+        } else {
+            break;
+        }
+    }
+
+    if (*offset >= size || data[*offset] < '0' || data[*offset] > '9') {
+        return 0;
+    }
+
+    *value = 0;
+    while (*offset < size && data[*offset] >= '0' && data[*offset] <= '9' && *value < 1u << 24) {
+        *value = *value * 10 + (data[(*offset)++] - '0');
+    }
+    return 1;
+}
+
+static int decode_pnm(const uint8_t* data, size_t size, image_t* image) {
+    if (size < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '6')) {
+        return 0;
+    }
+
+    size_t offset = 2;
+    uint32_t width, height, max_value;
+    if (!read_pnm_number(data, size, &offset, &width) || !read_pnm_number(data, size, &offset, &height) ||
+        !read_pnm_number(data, size, &offset, &max_value) || width == 0 || height == 0 || max_value == 0 || max_value > 255) {
+        return 0;
+    }
+    // exactly one whitespace byte before the pixels
+    offset++;
+
+    uint32_t file_channels = data[1] == '5' ? 1 : 3;
+    size_t count = (size_t)width * height;
+    if (offset + count * file_channels > size) {
+        return 0;
+    }
+
+    image->width = width;
+    image->height = height;
+    image->channels = file_channels == 1 ? 1 : 4;
+    image->pixels = malloc(count * image->channels);
+
+    const uint8_t* src = data + offset;
+    for (size_t i = 0; i < count; i++) {
+        for (uint32_t c = 0; c < file_channels; c++) {
+            image->pixels[i * image->channels + c] = (uint8_t)((src[i * file_channels + c] * 255u + max_value / 2) / max_value);
+        }
+        if (image->channels == 4) {
+            image->pixels[i * 4 + 3] = 255;
+        }
+    }
+
+    return 1;
+}
+
+int save_tga(const char* path, const image_t* image) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        ERROR("Failed to open %s for writing.", path);
+        return 0;
+    }
+
+    int gray = image->channels == 1;
+    uint8_t header[18] = {0};
+    header[2] = gray ? 3 : 2;
+    header[12] = image->width & 0xff;
+    header[13] = image->width >> 8;
+    header[14] = image->height & 0xff;
+    header[15] = image->height >> 8;
+    header[16] = gray ? 8 : 32;
+    header[17] = gray ? 0x20 : 0x28; // top left origin, 8 alpha bits
+
+    size_t count = (size_t)image->width * image->height;
+    uint8_t* pixels = malloc(count * image->channels);
+    for (size_t i = 0; i < count; i++) {
+        if (gray) {
+            pixels[i] = image->pixels[i];
+        } else {
+            pixels[i * 4] = image->pixels[i * 4 + 2];
+            pixels[i * 4 + 1] = image->pixels[i * 4 + 1];
+            pixels[i * 4 + 2] = image->pixels[i * 4];
+            pixels[i * 4 + 3] = image->pixels[i * 4 + 3];
+        }
+    }
+
+    int ok = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(pixels, image->channels, count, file) == count;
+    ok = fclose(file) == 0 && ok;
+    free(pixels);
+
+    if (!ok) {
+        ERROR("Failed to write image %s.", path);
+    }
+    return ok;
+}
+
+static void build_srgb_table() {
+    for (uint32_t i = 0; i < 256; i++) {
+        float c = i / 255.0f;
+        srgb_to_linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+}
+
+static uint8_t linear_to_srgb(float l) {
+    float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+    c = c < 0.0f ? 0.0f : (c > 1.0f ? 1.0f : c);
+    return (uint8_t)(c * 255.0f + 0.5f);
+}
+
+void downsample_image(const image_t* src, image_t* dst, int srgb) {
+    pthread_once(&srgb_once, build_srgb_table);
+
+    dst->width = src->width > 1 ? src->width >> 1 : 1;
+    dst->height = src->height > 1 ? src->height >> 1 : 1;
+    dst->channels = src->channels;
+
+    uint32_t channels = src->channels;
+    // alpha and grayscale data are averaged as is
+    uint32_t color_channels = srgb && channels == 4 ? 3 : 0;
+
+    for (uint32_t y = 0; y < dst->height; y++) {
+        uint32_t y0 = y * 2 < src->height ? y * 2 : src->height - 1;
+        uint32_t y1 = y * 2 + 1 < src->height ? y * 2 + 1 : src->height - 1;
+
+        for (uint32_t x = 0; x < dst->width; x++) {
+            uint32_t x0 = x * 2 < src->width ? x * 2 : src->width - 1;
+            uint32_t x1 = x * 2 + 1 < src->width ? x * 2 + 1 : src->width - 1;
+
+            const uint8_t* a = src->pixels + ((size_t)y0 * src->width + x0) * channels;
+            const uint8_t* b = src->pixels + ((size_t)y0 * src->width + x1) * channels;
+            const uint8_t* c = src->pixels + ((size_t)y1 * src->width + x0) * channels;
+            const uint8_t* d = src->pixels + ((size_t)y1 * src->width + x1) * channels;
+            uint8_t* out = dst->pixels + ((size_t)y * dst->width + x) * channels;
+
+            for (uint32_t i = 0; i < channels; i++) {
+                if (i < color_channels) {
+                    float sum = srgb_to_linear[a[i]] + srgb_to_linear[b[i]] + srgb_to_linear[c[i]] + srgb_to_linear[d[i]];
+                    out[i] = linear_to_srgb(sum * 0.25f);
+                } else {
+                    out[i] = (uint8_t)((a[i] + b[i] + c[i] + d[i] + 2) / 4);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef OVERTURE_IMAGE
+#define OVERTURE_IMAGE
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * CPU side images for the texture loader. Decoders are picked by file extension, tga (plain and
+ * rle, 8, 24 and 32 bit) and binary pgm/ppm are built in and register_image_decoder() adds more,
+ * for example a png decoder from an outside library. Decoded images are 8 bit with 1 channel for
+ * grayscale and 4 for everything else, rows are tightly packed with the top row first.
+ */
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels; // 1 or 4
+    uint8_t* pixels;
+} image_t;
+
+// fills image with malloc'd pixels, returns 0 when data isn't a valid image
+typedef int (*image_decoder_t)(const uint8_t* data, size_t size, image_t* image);
+
+// extension without the dot, replaces the built in decoder for it
+void register_image_decoder(const char* extension, image_decoder_t decoder);
+
+int decode_image(const char* extension, const uint8_t* data, size_t size, image_t* image);
+int load_image(const char* path, image_t* image);
+void free_image(image_t* image);
+
+// writes uncompressed tga, mostly for tools and tests, returns 0 on failure
+int save_tga(const char* path, const image_t* image);
+
+// half size with a box filter, dst->pixels needs room for the smaller image, srgb averages in linear space
+void downsample_image(const image_t* src, image_t* dst, int srgb);
+
+#endif
@@ -0,0 +1,688 @@
+#include "graphics/light_clusters.h"
+#include "core/camera.h"
+#include "core/log.h"
+#include "core/systems.h"
+#include "core/transform.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// below this many lights spawning threads costs more than it saves
+#define PARALLEL_THRESHOLD 1024
+#define MAX_THREADS 16
+
+REGISTER_COMPONENT(light_t);
+
+light_t point_light(vec3_t color, float intensity, float range) {
+    return (light_t){
+        .color = color,
+        .intensity = intensity,
+        .range = range,
+        .inner_cos = -1.0f,
+        .outer_cos = -1.0f,
+        .type = LIGHT_POINT,
+    };
+}
+
+light_t spot_light(vec3_t color, float intensity, float range, float inner_angle, float outer_angle) {
+    return (light_t){
+        .color = color,
+        .intensity = intensity,
+        .range = range,
+        .inner_cos = cosf(inner_angle),
+        .outer_cos = cosf(outer_angle),
+        .type = LIGHT_SPOT,
+    };
+}
+
+gpu_light_t make_gpu_light(const light_t* light, const mat4_t* view, const mat4_t* world) {
+    vec3_t position = mat4_mul_point(view, vec3(world->m[12], world->m[13], world->m[14]));
+    vec4_t forward = mat4_mul_vec4(view, vec4(-world->m[8], -world->m[9], -world->m[10], 0.0f));
+    vec3_t direction = vec3_normalize(vec3(forward.x, forward.y, forward.z));
+
+    return (gpu_light_t){
+        .position = vec4(position.x, position.y, position.z, light->range),
+        .color = vec4(light->color.x, light->color.y, light->color.z, light->intensity),
+        .direction = vec4(direction.x, direction.y, direction.z, light->outer_cos),
+        .cone = vec4(light->inner_cos, (float)light->type, 0.0f, 0.0f),
+    };
+}
+
+/* grid */
+
+static float* alloc_floats(uint32_t count) {
+    // padded so 4 wide loads at the end of a row stay in bounds
+    float* data = calloc(count + 4, sizeof(float));
+    if (data == NULL) {
+        FATAL("Failed to allocate %d floats for the cluster grid.", count);
+    }
+    return data;
+}
+
+static void free_grid_arrays(cluster_grid_t* grid) {
+    float** arrays[] = {
+        &grid->min_x, &grid->min_y, &grid->min_z, &grid->max_x, &grid->max_y, &grid->max_z,
+        &grid->sphere_x, &grid->sphere_y, &grid->sphere_z, &grid->sphere_radius,
+        &grid->column_min, &grid->column_max, &grid->row_min, &grid->row_max,
+        &grid->slice_min, &grid->slice_max,
+    };
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+        free(*arrays[i]);
+        *arrays[i] = NULL;
+    }
+}
+
+cluster_grid_t create_cluster_grid(uint32_t dim_x, uint32_t dim_y, uint32_t dim_z) {
+    return (cluster_grid_t){
+        .dim_x = dim_x ? dim_x : 1,
+        .dim_y = dim_y ? dim_y : 1,
+        .dim_z = dim_z ? dim_z : 1,
+    };
+}
+
+void destroy_cluster_grid(cluster_grid_t* grid) {
+    free_grid_arrays(grid);
+}
+
+static float slice_depth(const cluster_grid_t* grid, uint32_t slice) {
+    float t = (float)slice / (float)grid->dim_z;
+    if (grid->orthographic) {
+        return grid->near + (grid->far - grid->near) * t;
+    }
+    return grid->near * powf(grid->far / grid->near, t);
+}
+
+// view space point of a ndc xy at a positive view depth
+static vec3_t unproject_at_depth(const mat4_t* inverse, float x, float y, float depth) {
+    vec4_t near = mat4_mul_vec4(inverse, vec4(x, y, -1.0f, 1.0f));
+    vec4_t far = mat4_mul_vec4(inverse, vec4(x, y, 1.0f, 1.0f));
+    vec3_t pn = vec3_scale(vec3(near.x, near.y, near.z), 1.0f / near.w);
+    vec3_t pf = vec3_scale(vec3(far.x, far.y, far.z), 1.0f / far.w);
+
+    // points on the ray are linear in depth for perspective and ortho projections
+    float t = (depth + pn.z) / (pn.z - pf.z);
+    return vec3_lerp(pn, pf, t);
+}
+
+void build_cluster_grid(cluster_grid_t* grid, const mat4_t* projection, float near, float far) {
+    if (grid->min_x != NULL && grid->near == near && grid->far == far &&
+        memcmp(&grid->projection, projection, sizeof(mat4_t)) == 0) {
+        return;
+    }
+
+    free_grid_arrays(grid);
+
+    grid->projection = *projection;
+    grid->near = near;
+    grid->far = far;
+    grid->orthographic = projection->m[15] != 0.0f;
+
+    if (grid->orthographic) {
+        grid->z_scale = grid->dim_z / (far - near);
+        grid->z_bias = -near * grid->z_scale;
+    } else {
+        grid->z_scale = grid->dim_z / logf(far / near);
+        grid->z_bias = -logf(near) * grid->z_scale;
+    }
+
+    uint32_t count = get_cluster_count(grid);
+    grid->min_x = alloc_floats(count);
+    grid->min_y = alloc_floats(count);
+    grid->min_z = alloc_floats(count);
+    grid->max_x = alloc_floats(count);
+    grid->max_y = alloc_floats(count);
+    grid->max_z = alloc_floats(count);
+    grid->sphere_x = alloc_floats(count);
+    grid->sphere_y = alloc_floats(count);
+    grid->sphere_z = alloc_floats(count);
+    grid->sphere_radius = alloc_floats(count);
+    grid->column_min = alloc_floats(grid->dim_z * grid->dim_x);
+    grid->column_max = alloc_floats(grid->dim_z * grid->dim_x);
+    grid->row_min = alloc_floats(grid->dim_z * grid->dim_y);
+    grid->row_max = alloc_floats(grid->dim_z * grid->dim_y);
+    grid->slice_min = alloc_floats(grid->dim_z);
+    grid->slice_max = alloc_floats(grid->dim_z);
+
+    mat4_t inverse = mat4_inverse(projection);
+
+    for (uint32_t z = 0; z < grid->dim_z; z++) {
+        float depth_near = slice_depth(grid, z);
+        float depth_far = slice_depth(grid, z + 1);
+
+        // view space looks down -z
+        grid->slice_min[z] = -depth_far;
+        grid->slice_max[z] = -depth_near;
+
+        for (uint32_t i = 0; i < grid->dim_x; i++) {
+            grid->column_min[z * grid->dim_x + i] = 1e30f;
+            grid->column_max[z * grid->dim_x + i] = -1e30f;
+        }
+        for (uint32_t i = 0; i < grid->dim_y; i++) {
+            grid->row_min[z * grid->dim_y + i] = 1e30f;
+            grid->row_max[z * grid->dim_y + i] = -1e30f;
+        }
+
+        for (uint32_t y = 0; y < grid->dim_y; y++) {
+            for (uint32_t x = 0; x < grid->dim_x; x++) {
+                float x0 = -1.0f + 2.0f * x / grid->dim_x, x1 = -1.0f + 2.0f * (x + 1) / grid->dim_x;
+                float y0 = -1.0f + 2.0f * y / grid->dim_y, y1 = -1.0f + 2.0f * (y + 1) / grid->dim_y;
+
+                vec3_t min = vec3(1e30f, 1e30f, 1e30f);
+                vec3_t max = vec3(-1e30f, -1e30f, -1e30f);
+                for (int c = 0; c < 8; c++) {
+                    vec3_t p = unproject_at_depth(&inverse, c & 1 ? x1 : x0, c & 2 ? y1 : y0, c & 4 ? depth_far : depth_near);
+                    min = vec3_min(min, p);
+                    max = vec3_max(max, p);
+                }
+                min.z = -depth_far;
+                max.z = -depth_near;
+
+                uint32_t index = (z * grid->dim_y + y) * grid->dim_x + x;
+                grid->min_x[index] = min.x;
+                grid->min_y[index] = min.y;
+                grid->min_z[index] = min.z;
+                grid->max_x[index] = max.x;
+                grid->max_y[index] = max.y;
+                grid->max_z[index] = max.z;
+
+                vec3_t center = vec3_scale(vec3_add(min, max), 0.5f);
+                grid->sphere_x[index] = center.x;
+                grid->sphere_y[index] = center.y;
+                grid->sphere_z[index] = center.z;
+                grid->sphere_radius[index] = vec3_length(vec3_sub(max, center));
+
+                float* column_min = &grid->column_min[z * grid->dim_x + x];
+                float* column_max = &grid->column_max[z * grid->dim_x + x];
+                float* row_min = &grid->row_min[z * grid->dim_y + y];
+                float* row_max = &grid->row_max[z * grid->dim_y + y];
+                *column_min = min.x < *column_min ? min.x : *column_min;
+                *column_max = max.x > *column_max ? max.x : *column_max;
+                *row_min = min.y < *row_min ? min.y : *row_min;
+                *row_max = max.y > *row_max ? max.y : *row_max;
+            }
+        }
+    }
+
+    TRACE("Built a %dx%dx%d cluster grid from %.2f to %.2f.", grid->dim_x, grid->dim_y, grid->dim_z, near, far);
+}
+
+/* assignment */
+
+typedef struct {
+    uint32_t* pair_clusters;
+    uint32_t* pair_lights;
+    uint32_t pair_count;
+    uint32_t pair_capacity;
+
+    uint32_t* indices;
+    uint32_t index_count;
+    uint32_t index_capacity;
+} assign_scratch_t;
+
+typedef struct {
+    const cluster_grid_t* grid;
+    light_clusters_t* out;
+    uint32_t light_start;
+    uint32_t light_end;
+    uint32_t slice_start;
+    uint32_t slice_end;
+    assign_scratch_t* scratch;
+    pthread_barrier_t* barrier;
+} assign_job_t;
+
+// bounding spheres of this call's lights in soa layout, reused between calls
+static struct {
+    float* x;
+    float* y;
+    float* z;
+    float* radius;
+    float* sin; // of the outer spot angle
+} spheres;
+static uint32_t sphere_capacity = 0;
+
+static assign_scratch_t scratch[MAX_THREADS];
+
+static void reserve_lights(light_clusters_t* out, uint32_t count) {
+    if (count > out->light_capacity) {
+        out->light_capacity = out->light_capacity ? out->light_capacity : 256;
+        while (out->light_capacity < count) {
+            out->light_capacity *= 2;
+        }
+        out->lights = realloc(out->lights, out->light_capacity * sizeof(gpu_light_t));
+    }
+
+    if (count > sphere_capacity) {
+        sphere_capacity = out->light_capacity > count ? out->light_capacity : count;
+        spheres.x = realloc(spheres.x, sphere_capacity * sizeof(float));
+        spheres.y = realloc(spheres.y, sphere_capacity * sizeof(float));
+        spheres.z = realloc(spheres.z, sphere_capacity * sizeof(float));
+        spheres.radius = realloc(spheres.radius, sphere_capacity * sizeof(float));
+        spheres.sin = realloc(spheres.sin, sphere_capacity * sizeof(float));
+    }
+}
+
+static void reserve_clusters(light_clusters_t* out, uint32_t count) {
+    if (count > out->cluster_capacity) {
+        out->cluster_capacity = count;
+        out->clusters = realloc(out->clusters, count * sizeof(cluster_t));
+    }
+    out->cluster_count = count;
+}
+
+static void reserve_indices(uint32_t** indices, uint32_t* capacity, uint32_t count) {
+    if (count <= *capacity) {
+        return;
+    }
+
+    *capacity = *capacity ? *capacity : 1024;
+    while (*capacity < count) {
+        *capacity *= 2;
+    }
+    *indices = realloc(*indices, *capacity * sizeof(uint32_t));
+    if (*indices == NULL) {
+        FATAL("Failed to grow light index list to %d entries.", *capacity);
+    }
+}
+
+static inline int is_spot(const gpu_light_t* light) {
+    return light->cone.y == (float)LIGHT_SPOT && light->direction.w > 0.0f;
+}
+
+// smallest sphere around the cone for spot lights, the range for everything else
+static inline void light_sphere(const gpu_light_t* light, float* x, float* y, float* z, float* radius, float* outer_sin) {
+    float range = light->position.w;
+    *x = light->position.x;
+    *y = light->position.y;
+    *z = light->position.z;
+    *radius = range;
+    *outer_sin = 1.0f;
+
+    if (!is_spot(light)) {
+        return;
+    }
+
+    float outer_cos = light->direction.w;
+    *outer_sin = sqrtf(1.0f - outer_cos * outer_cos);
+
+    // wide cones are bounded by the cap, narrow ones by the sphere through the apex and the cap rim
+    float offset;
+    if (outer_cos < 0.70710678f) {
+        offset = range * outer_cos;
+        *radius = range * *outer_sin;
+    } else {
+        *radius = range / (2.0f * outer_cos);
+        offset = *radius;
+    }
+    *x += light->direction.x * offset;
+    *y += light->direction.y * offset;
+    *z += light->direction.z * offset;
+}
+
+static inline float axis_distance(float min, float max, float c) {
+    float d = fmaxf(min - c, c - max);
+    return d > 0.0f ? d : 0.0f;
+}
+
+static inline int sphere_box_test(const cluster_grid_t* grid, uint32_t cluster, float x, float y, float z, float radius) {
+    float dx = axis_distance(grid->min_x[cluster], grid->max_x[cluster], x);
+    float dy = axis_distance(grid->min_y[cluster], grid->max_y[cluster], y);
+    float dz = axis_distance(grid->min_z[cluster], grid->max_z[cluster], z);
+    return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
+
+// cone against the sphere around the cluster
+static inline int cone_test(const cluster_grid_t* grid, uint32_t cluster, const gpu_light_t* light, float outer_sin) {
+    float r = grid->sphere_radius[cluster];
+    vec3_t v = vec3(grid->sphere_x[cluster] - light->position.x,
+                    grid->sphere_y[cluster] - light->position.y,
+                    grid->sphere_z[cluster] - light->position.z);
+    float length_sq = vec3_dot(v, v);
+    float along = v.x * light->direction.x + v.y * light->direction.y + v.z * light->direction.z;
+    float across = sqrtf(fmaxf(length_sq - along * along, 0.0f));
+
+    float distance = light->direction.w * across - along * outer_sin;
+    return !(distance > r || along > r + light->position.w || along < -r);
+}
+
+// which of clusters first..first+3 the sphere touches, as a 4 bit mask
+static inline uint32_t sphere_box_test4(const cluster_grid_t* grid, uint32_t first, float x, float y, float z, float radius) {
+#if defined(OVERTURE_MATH_SSE)
+    const __m128 zero = _mm_setzero_ps();
+    __m128 cx = _mm_set1_ps(x), cy = _mm_set1_ps(y), cz = _mm_set1_ps(z);
+    __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(grid->min_x + first), cx), _mm_sub_ps(cx, _mm_loadu_ps(grid->max_x + first))), zero);
+    __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(grid->min_y + first), cy), _mm_sub_ps(cy, _mm_loadu_ps(grid->max_y + first))), zero);
+    __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(grid->min_z + first), cz), _mm_sub_ps(cz, _mm_loadu_ps(grid->max_z + first))), zero);
+    __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+    return _mm_movemask_ps(_mm_cmple_ps(distance, _mm_set1_ps(radius * radius)));
+#elif defined(OVERTURE_MATH_NEON)
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    float32x4_t cx = vdupq_n_f32(x), cy = vdupq_n_f32(y), cz = vdupq_n_f32(z);
+    float32x4_t dx = vmaxq_f32(vmaxq_f32(vsubq_f32(vld1q_f32(grid->min_x + first), cx), vsubq_f32(cx, vld1q_f32(grid->max_x + first))), zero);
+    float32x4_t dy = vmaxq_f32(vmaxq_f32(vsubq_f32(vld1q_f32(grid->min_y + first), cy), vsubq_f32(cy, vld1q_f32(grid->max_y + first))), zero);
+    float32x4_t dz = vmaxq_f32(vmaxq_f32(vsubq_f32(vld1q_f32(grid->min_z + first), cz), vsubq_f32(cz, vld1q_f32(grid->max_z + first))), zero);
+    float32x4_t distance = vaddq_f32(vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy)), vmulq_f32(dz, dz));
+    uint32_t lanes[4];
+    vst1q_u32(lanes, vcleq_f32(distance, vdupq_n_f32(radius * radius)));
+    return (lanes[0] & 1) | (lanes[1] & 2) | (lanes[2] & 4) | (lanes[3] & 8);
+#else
+    uint32_t mask = 0;
+    for (uint32_t lane = 0; lane < 4; lane++) {
+        mask |= sphere_box_test(grid, first + lane, x, y, z, radius) << lane;
+    }
+    return mask;
+#endif
+}
+
+// first and last entry of a bounds list the sphere can touch, returns 0 when there are none
+static inline int narrow_range(const float* min, const float* max, uint32_t count, float c, float radius, uint32_t* first, uint32_t* last) {
+    // same distance as the box test so nothing it would accept is skipped
+    float radius_sq = radius * radius;
+    uint32_t i = 0;
+    while (i < count && axis_distance(min[i], max[i], c) * axis_distance(min[i], max[i], c) > radius_sq) {
+        i++;
+    }
+    if (i == count) {
+        return 0;
+    }
+
+    uint32_t j = count - 1;
+    while (axis_distance(min[j], max[j], c) * axis_distance(min[j], max[j], c) > radius_sq) {
+        j--;
+    }
+
+    *first = i;
+    *last = j;
+    return 1;
+}
+
+static void push_pair(assign_scratch_t* s, uint32_t cluster, uint32_t light) {
+    if (s->pair_count == s->pair_capacity) {
+        s->pair_capacity = s->pair_capacity ? s->pair_capacity * 2 : 4096;
+        s->pair_clusters = realloc(s->pair_clusters, s->pair_capacity * sizeof(uint32_t));
+        s->pair_lights = realloc(s->pair_lights, s->pair_capacity * sizeof(uint32_t));
+        if (s->pair_clusters == NULL || s->pair_lights == NULL) {
+            FATAL("Failed to grow light cluster pairs to %d.", s->pair_capacity);
+        }
+    }
+    s->pair_clusters[s->pair_count] = cluster;
+    s->pair_lights[s->pair_count] = light;
+    s->pair_count++;
+}
+
+static void assign_slices(const assign_job_t* job) {
+    const cluster_grid_t* grid = job->grid;
+    const gpu_light_t* lights = job->out->lights;
+    cluster_t* clusters = job->out->clusters;
+    assign_scratch_t* s = job->scratch;
+
+    uint32_t slice_size = grid->dim_x * grid->dim_y;
+    uint32_t cluster_start = job->slice_start * slice_size;
+    uint32_t cluster_end = job->slice_end * slice_size;
+    s->pair_count = 0;
+
+    // lights in order so every cluster's list comes out sorted after the stable scatter
+    for (uint32_t i = 0; i < job->out->light_count; i++) {
+        float x = spheres.x[i], y = spheres.y[i], z = spheres.z[i], radius = spheres.radius[i];
+        int spot = is_spot(&lights[i]);
+
+        uint32_t z0, z1;
+        if (!narrow_range(grid->slice_min + job->slice_start, grid->slice_max + job->slice_start,
+                          job->slice_end - job->slice_start, z, radius, &z0, &z1)) {
+            continue;
+        }
+
+        for (uint32_t slice = job->slice_start + z0; slice <= job->slice_start + z1; slice++) {
+            uint32_t x0, x1, y0, y1;
+            if (!narrow_range(grid->column_min + slice * grid->dim_x, grid->column_max + slice * grid->dim_x, grid->dim_x, x, radius, &x0, &x1) ||
+                !narrow_range(grid->row_min + slice * grid->dim_y, grid->row_max + slice * grid->dim_y, grid->dim_y, y, radius, &y0, &y1)) {
+                continue;
+            }
+
+            for (uint32_t row = y0; row <= y1; row++) {
+                uint32_t base = slice * slice_size + row * grid->dim_x;
+                for (uint32_t column = x0; column <= x1; column += 4) {
+                    uint32_t mask = sphere_box_test4(grid, base + column, x, y, z, radius);
+                    if (x1 - column < 3) {
+                        mask &= (1u << (x1 - column + 1)) - 1;
+                    }
+
+                    while (mask) {
+                        uint32_t cluster = base + column + __builtin_ctz(mask);
+                        mask &= mask - 1;
+                        if (spot && !cone_test(grid, cluster, &lights[i], spheres.sin[i])) {
+                            continue;
+                        }
+                        push_pair(s, cluster, i);
+                    }
+                }
+            }
+        }
+    }
+
+    // counting sort by cluster, offsets are local to this job until the lists are joined
+    for (uint32_t c = cluster_start; c < cluster_end; c++) {
+        clusters[c].count = 0;
+    }
+    for (uint32_t p = 0; p < s->pair_count; p++) {
+        clusters[s->pair_clusters[p]].count++;
+    }
+
+    uint32_t offset = 0;
+    for (uint32_t c = cluster_start; c < cluster_end; c++) {
+        clusters[c].offset = offset;
+        offset += clusters[c].count;
+    }
+
+    reserve_indices(&s->indices, &s->index_capacity, s->pair_count);
+    s->index_count = s->pair_count;
+
+    for (uint32_t c = cluster_start; c < cluster_end; c++) {
+        clusters[c].count = 0;
+    }
+    for (uint32_t p = 0; p < s->pair_count; p++) {
+        cluster_t* cluster = &clusters[s->pair_clusters[p]];
+        s->indices[cluster->offset + cluster->count++] = s->pair_lights[p];
+    }
+}
+
+static void* assign_range(void* arg) {
+    assign_job_t* job = arg;
+
+    for (uint32_t i = job->light_start; i < job->light_end; i++) {
+        light_sphere(&job->out->lights[i], &spheres.x[i], &spheres.y[i], &spheres.z[i], &spheres.radius[i], &spheres.sin[i]);
+    }
+
+    // every job reads all the spheres
+    if (job->barrier != NULL) {
+        pthread_barrier_wait(job->barrier);
+    }
+
+    assign_slices(job);
+    return NULL;
+}
+
+void assign_lights(const cluster_grid_t* grid, const gpu_light_t* lights, uint32_t count, light_clusters_t* out) {
+    reserve_lights(out, count);
+    if (lights != out->lights) {
+        memcpy(out->lights, lights, count * sizeof(gpu_light_t));
+    }
+    out->light_count = count;
+
+    reserve_clusters(out, get_cluster_count(grid));
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t thread_count = cpus > 1 ? (uint32_t)cpus : 1;
+    if (thread_count > MAX_THREADS) {
+        thread_count = MAX_THREADS;
+    }
+    if (thread_count > grid->dim_z) {
+        thread_count = grid->dim_z;
+    }
+    if (count < PARALLEL_THRESHOLD) {
+        thread_count = 1;
+    }
+
+    pthread_t threads[MAX_THREADS];
+    assign_job_t jobs[MAX_THREADS];
+    pthread_barrier_t barrier;
+    if (thread_count > 1) {
+        pthread_barrier_init(&barrier, NULL, thread_count);
+    }
+
+    uint32_t per_thread = (count + thread_count - 1) / thread_count;
+    for (uint32_t t = 0; t < thread_count; t++) {
+        jobs[t] = (assign_job_t){
+            .grid = grid,
+            .out = out,
+            .light_start = t * per_thread < count ? t * per_thread : count,
+            .light_end = (t + 1) * per_thread < count ? (t + 1) * per_thread : count,
+            .slice_start = t * grid->dim_z / thread_count,
+            .slice_end = (t + 1) * grid->dim_z / thread_count,
+            .scratch = &scratch[t],
+            .barrier = thread_count > 1 ? &barrier : NULL,
+        };
+    }
+
+    for (uint32_t t = 1; t < thread_count; t++) {
+        pthread_create(&threads[t], NULL, assign_range, &jobs[t]);
+    }
+    assign_range(&jobs[0]);
+    for (uint32_t t = 1; t < thread_count; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    if (thread_count > 1) {
+        pthread_barrier_destroy(&barrier);
+    }
+
+    uint32_t total = 0;
+    for (uint32_t t = 0; t < thread_count; t++) {
+        total += scratch[t].index_count;
+    }
+    reserve_indices(&out->indices, &out->index_capacity, total);
+    out->index_count = total;
+
+    // jobs own whole slices in order, so joining is a copy and an offset shift
+    uint32_t slice_size = grid->dim_x * grid->dim_y;
+    uint32_t base = 0;
+    for (uint32_t t = 0; t < thread_count; t++) {
+        memcpy(out->indices + base, scratch[t].indices, scratch[t].index_count * sizeof(uint32_t));
+        for (uint32_t c = jobs[t].slice_start * slice_size; c < jobs[t].slice_end * slice_size; c++) {
+            out->clusters[c].offset += base;
+        }
+        base += scratch[t].index_count;
+    }
+
+    TRACE("Assigned %d lights to %d clusters with %d indices.", count, out->cluster_count, total);
+}
+
+void assign_lights_reference(const cluster_grid_t* grid, const gpu_light_t* lights, uint32_t count, light_clusters_t* out) {
+    reserve_lights(out, count);
+    if (lights != out->lights) {
+        memcpy(out->lights, lights, count * sizeof(gpu_light_t));
+    }
+    out->light_count = count;
+
+    uint32_t cluster_count = get_cluster_count(grid);
+    reserve_clusters(out, cluster_count);
+    out->index_count = 0;
+
+    for (uint32_t c = 0; c < cluster_count; c++) {
+        out->clusters[c].offset = out->index_count;
+        out->clusters[c].count = 0;
+
+        for (uint32_t i = 0; i < count; i++) {
+            float x, y, z, radius, outer_sin;
+            light_sphere(&lights[i], &x, &y, &z, &radius, &outer_sin);
+            if (!sphere_box_test(grid, c, x, y, z, radius)) {
+                continue;
+            }
+            if (is_spot(&lights[i]) && !cone_test(grid, c, &lights[i], outer_sin)) {
+                continue;
+            }
+
+            reserve_indices(&out->indices, &out->index_capacity, out->index_count + 1);
+            out->indices[out->index_count++] = i;
+            out->clusters[c].count++;
+        }
+    }
+}
+
+void destroy_light_clusters(light_clusters_t* clusters) {
+    free(clusters->lights);
+    free(clusters->clusters);
+    free(clusters->indices);
+    memset(clusters, 0, sizeof(light_clusters_t));
+}
+
+/* ecs */
+
+static cluster_grid_t scene_grid = { .dim_x = CLUSTER_DIM_X, .dim_y = CLUSTER_DIM_Y, .dim_z = CLUSTER_DIM_Z };
+static light_clusters_t light_clusters;
+
+void update_light_clusters() {
+    camera_t* camera = update_camera();
+    if (camera == NULL) {
+        light_clusters.light_count = 0;
+        light_clusters.cluster_count = 0;
+        light_clusters.index_count = 0;
+        return;
+    }
+
+    build_cluster_grid(&scene_grid, &camera->projection, camera->near, camera->far);
+
+    entity_t** list = FILTER_ENTITIES(light_t, transform_t);
+    uint32_t count = 0;
+    while (list[count] != NULL) {
+        count++;
+    }
+
+    // the filter guarantees both components, skip get_comp's signature checks and logging
+    uint64_t light_id = GET_ID(light_t);
+    uint64_t transform_id = GET_ID(transform_t);
+
+    reserve_lights(&light_clusters, count);
+    for (uint32_t i = 0; i < count; i++) {
+        light_t* light = list[i]->components[light_id - 1];
+        transform_t* transform = list[i]->components[transform_id - 1];
+        light_clusters.lights[i] = make_gpu_light(light, &camera->view, get_transform_world(*transform));
+    }
+    free(list);
+
+    assign_lights(&scene_grid, light_clusters.lights, count, &light_clusters);
+}
+
+// after update_transforms at the front of PRE_RENDER
+REGISTER_SYSTEM(update_light_clusters, PRE_RENDER);
+
+const light_clusters_t* get_light_clusters() {
+    return &light_clusters;
+}
+
+const cluster_grid_t* get_cluster_grid() {
+    return &scene_grid;
+}
+
+void cleanup_light_clusters() {
+    destroy_light_clusters(&light_clusters);
+    destroy_cluster_grid(&scene_grid);
+
+    for (uint32_t t = 0; t < MAX_THREADS; t++) {
+        free(scratch[t].pair_clusters);
+        free(scratch[t].pair_lights);
+        free(scratch[t].indices);
+    }
+    memset(scratch, 0, sizeof(scratch));
+
+    free(spheres.x);
+    free(spheres.y);
+    free(spheres.z);
+    free(spheres.radius);
+    free(spheres.sin);
+    memset(&spheres, 0, sizeof(spheres));
+    sphere_capacity = 0;
+}
+
+REGISTER_SYSTEM(cleanup_light_clusters, CLEANUP);
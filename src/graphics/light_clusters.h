@@ -0,0 +1,137 @@
+#ifndef OVERTURE_LIGHT_CLUSTERS
+#define OVERTURE_LIGHT_CLUSTERS
+
+#include <stdint.h>
+#include "core/ecs.h"
+#include "overture/math.h"
+
+/*
+ * CPU side of the clustered forward renderer. The view frustum is split into a grid of froxels,
+ * tiles in screen space and exponential slices in depth, and every light is assigned to the
+ * clusters its bounding volume touches. The result is three flat arrays laid out for std430
+ * storage buffers:
+ *
+ *   lights   gpu_light_t per light, view space
+ *   clusters offset and count into the index list per cluster
+ *   indices  light indices, every cluster's lights are contiguous and in ascending order
+ *
+ * A fragment finds its cluster with
+ *
+ *   slice = uint(log(depth) * z_scale + z_bias)   // depth * z_scale + z_bias for ortho cameras
+ *   cluster = (slice * dim_y + tile_y) * dim_x + tile_x
+ *
+ * Lights are a light_t on an entity with a transform_t, spot lights point down the transform's
+ * -Z like the camera. update_light_clusters() runs in PRE_RENDER with the active camera, the
+ * assignment functions don't touch the ecs and can be used on their own.
+ */
+
+typedef enum {
+    LIGHT_POINT,
+    LIGHT_SPOT,
+} light_type_t;
+
+typedef struct {
+    vec3_t color;
+    float intensity;
+    float range;
+    float inner_cos; // cos of the spot angles
+    float outer_cos;
+    light_type_t type;
+} light_t;
+
+light_t point_light(vec3_t color, float intensity, float range);
+// angles are the half angles of the cone in radians
+light_t spot_light(vec3_t color, float intensity, float range, float inner_angle, float outer_angle);
+
+typedef struct {
+    vec4_t position; // view space, range in w
+    vec4_t color; // intensity in w
+    vec4_t direction; // view space, outer cos in w
+    vec4_t cone; // inner cos, type, unused, unused
+} gpu_light_t;
+
+typedef struct {
+    uint32_t offset;
+    uint32_t count;
+} cluster_t;
+
+#define CLUSTER_DIM_X 16
+#define CLUSTER_DIM_Y 9
+#define CLUSTER_DIM_Z 24
+
+typedef struct {
+    uint32_t dim_x;
+    uint32_t dim_y;
+    uint32_t dim_z;
+    float z_scale;
+    float z_bias;
+    int orthographic;
+
+    // view space boxes and the spheres around them in soa layout, padded for 4 wide loads
+    float* min_x;
+    float* min_y;
+    float* min_z;
+    float* max_x;
+    float* max_y;
+    float* max_z;
+    float* sphere_x;
+    float* sphere_y;
+    float* sphere_z;
+    float* sphere_radius;
+
+    // bounds of every tile column, row and slice over the whole slice, used to narrow the search
+    float* column_min;
+    float* column_max;
+    float* row_min;
+    float* row_max;
+    float* slice_min;
+    float* slice_max;
+
+    mat4_t projection; // what the boxes were built from
+    float near;
+    float far;
+} cluster_grid_t;
+
+cluster_grid_t create_cluster_grid(uint32_t dim_x, uint32_t dim_y, uint32_t dim_z);
+void destroy_cluster_grid(cluster_grid_t* grid);
+// only rebuilds the boxes when the projection or planes changed
+void build_cluster_grid(cluster_grid_t* grid, const mat4_t* projection, float near, float far);
+
+static inline uint32_t get_cluster_count(const cluster_grid_t* grid) {
+    return grid->dim_x * grid->dim_y * grid->dim_z;
+}
+
+// output of an assignment, the arrays are reused between calls
+typedef struct {
+    gpu_light_t* lights;
+    uint32_t light_count;
+    cluster_t* clusters;
+    uint32_t cluster_count;
+    uint32_t* indices;
+    uint32_t index_count;
+
+    uint32_t light_capacity;
+    uint32_t cluster_capacity;
+    uint32_t index_capacity;
+} light_clusters_t;
+
+void destroy_light_clusters(light_clusters_t* clusters);
+
+gpu_light_t make_gpu_light(const light_t* light, const mat4_t* view, const mat4_t* world);
+
+/*
+ * Copies the view space lights into out and assigns them to the grid's clusters. Lights are
+ * bounded by a sphere, tested against the cluster boxes 4 at a time with SSE/NEON and spot
+ * lights are then tested against the cluster spheres with their cone. Split over threads by
+ * depth slice once there are enough lights.
+ */
+void assign_lights(const cluster_grid_t* grid, const gpu_light_t* lights, uint32_t count, light_clusters_t* out);
+// every light against every cluster with the same tests, for checking assign_lights
+void assign_lights_reference(const cluster_grid_t* grid, const gpu_light_t* lights, uint32_t count, light_clusters_t* out);
+
+const light_clusters_t* get_light_clusters();
+const cluster_grid_t* get_cluster_grid();
+
+void update_light_clusters();
+
+#endif
@@ -0,0 +1,324 @@
+#include "graphics/mesh_file.h"
+#include "core/log.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// rounds to nearest even like the gpu does
+uint16_t float_to_half(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t exponent = (x >> 23) & 0xff;
+    uint32_t mantissa = x & 0x7fffff;
+
+    if (exponent == 0xff) {
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+
+    int32_t e = (int32_t)exponent - 127 + 15;
+    if (e >= 31) {
+        return sign | 0x7c00;
+    }
+
+    if (e <= 0) {
+        // denormal half, or zero when even that is too small
+        if (e < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - e;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) {
+            half++;
+        }
+        return sign | half;
+    }
+
+    // a carry out of the mantissa correctly bumps the exponent
+    uint32_t half = ((uint32_t)e << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return sign | half;
+}
+
+float half_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    uint32_t x;
+
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            x = sign;
+        } else {
+            // normalize the denormal
+            exponent = 1;
+            while (!(mantissa & 0x400)) {
+                mantissa <<= 1;
+                exponent--;
+            }
+            mantissa &= 0x3ff;
+            x = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        }
+    } else if (exponent == 31) {
+        x = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        x = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+static inline float sign_not_zero(float v) {
+    return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+static inline int16_t to_snorm16(float v) {
+    v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+    return (int16_t)lroundf(v * 32767.0f);
+}
+
+void oct_encode(vec3_t n, int16_t out[2]) {
+    float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    if (l1 == 0.0f) {
+        out[0] = out[1] = 0;
+        return;
+    }
+
+    float x = n.x / l1, y = n.y / l1;
+    if (n.z < 0.0f) {
+        float folded_x = (1.0f - fabsf(y)) * sign_not_zero(x);
+        float folded_y = (1.0f - fabsf(x)) * sign_not_zero(y);
+        x = folded_x;
+        y = folded_y;
+    }
+
+    out[0] = to_snorm16(x);
+    out[1] = to_snorm16(y);
+}
+
+vec3_t oct_decode(const int16_t e[2]) {
+    float x = e[0] / 32767.0f, y = e[1] / 32767.0f;
+    x = x < -1.0f ? -1.0f : x;
+    y = y < -1.0f ? -1.0f : y;
+
+    vec3_t n = vec3(x, y, 1.0f - fabsf(x) - fabsf(y));
+    if (n.z < 0.0f) {
+        n.x = (1.0f - fabsf(y)) * sign_not_zero(x);
+        n.y = (1.0f - fabsf(x)) * sign_not_zero(y);
+    }
+    return vec3_normalize(n);
+}
+
+static uint32_t align_offset(uint32_t offset, uint32_t alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+int save_mesh_file(const char* path, const float* positions, const float* normals, const float* uvs, uint32_t vertex_count,
+                   const uint32_t* indices, uint32_t index_count) {
+    mesh_file_header_t header = {
+        .magic = MESH_FILE_MAGIC,
+        .version = MESH_FILE_VERSION,
+        .flags = (normals ? MESH_HAS_NORMALS : 0) | (uvs ? MESH_HAS_UVS : 0),
+        .vertex_count = vertex_count,
+        .index_count = index_count,
+        .index_size = vertex_count <= 65536 ? 2 : 4,
+        .bounds_min = { 0.0f, 0.0f, 0.0f },
+        .bounds_max = { 0.0f, 0.0f, 0.0f },
+    };
+    header.vertex_offset = align_offset(sizeof(mesh_file_header_t), 16);
+    header.index_offset = header.vertex_offset + vertex_count * sizeof(packed_vertex_t);
+
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        for (int i = 0; i < 3; i++) {
+            float p = positions[v * 3 + i];
+            header.bounds_min[i] = v == 0 || p < header.bounds_min[i] ? p : header.bounds_min[i];
+            header.bounds_max[i] = v == 0 || p > header.bounds_max[i] ? p : header.bounds_max[i];
+        }
+    }
+
+    float scale[3];
+    for (int i = 0; i < 3; i++) {
+        float extent = header.bounds_max[i] - header.bounds_min[i];
+        scale[i] = extent > 0.0f ? 65535.0f / extent : 0.0f;
+    }
+
+    packed_vertex_t* packed = calloc(vertex_count ? vertex_count : 1, sizeof(packed_vertex_t));
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        for (int i = 0; i < 3; i++) {
+            packed[v].position[i] = (uint16_t)lroundf((positions[v * 3 + i] - header.bounds_min[i]) * scale[i]);
+        }
+        if (normals != NULL) {
+            oct_encode(vec3(normals[v * 3], normals[v * 3 + 1], normals[v * 3 + 2]), packed[v].normal);
+        }
+        if (uvs != NULL) {
+            packed[v].uv[0] = float_to_half(uvs[v * 2]);
+            packed[v].uv[1] = float_to_half(uvs[v * 2 + 1]);
+        }
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        ERROR("Failed to open %s for writing.", path);
+        free(packed);
+        return 0;
+    }
+
+    uint8_t padding[16] = {0};
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(padding, header.vertex_offset - sizeof(header), 1, file) <= 1 &&
+             fwrite(packed, sizeof(packed_vertex_t), vertex_count, file) == vertex_count;
+
+    if (header.index_size == 2) {
+        uint16_t* short_indices = malloc((index_count ? index_count : 1) * sizeof(uint16_t));
+        for (uint32_t i = 0; i < index_count; i++) {
+            short_indices[i] = (uint16_t)indices[i];
+        }
+        ok = ok && fwrite(short_indices, sizeof(uint16_t), index_count, file) == index_count;
+        free(short_indices);
+    } else {
+        ok = ok && fwrite(indices, sizeof(uint32_t), index_count, file) == index_count;
+    }
+
+    ok = fclose(file) == 0 && ok;
+    free(packed);
+
+    if (!ok) {
+        ERROR("Failed to write mesh %s.", path);
+        return 0;
+    }
+
+    TRACE("Saved mesh %s with %d vertices and %d indices.", path, vertex_count, index_count);
+    return 1;
+}
+
+int open_mesh_file(const char* path, mesh_file_t* file) {
+    memset(file, 0, sizeof(mesh_file_t));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ERROR("Failed to open mesh %s.", path);
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(mesh_file_header_t)) {
+        ERROR("Mesh %s is too small.", path);
+        close(fd);
+        return 0;
+    }
+
+    void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file alive
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        ERROR("Failed to map mesh %s.", path);
+        return 0;
+    }
+
+    // everything is read once front to back on upload, the advice values aren't flags
+    madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+    madvise(mapping, st.st_size, MADV_WILLNEED);
+
+    const mesh_file_header_t* header = mapping;
+    size_t size = st.st_size;
+    uint64_t vertex_end = (uint64_t)header->vertex_offset + (uint64_t)header->vertex_count * sizeof(packed_vertex_t);
+    uint64_t index_end = (uint64_t)header->index_offset + (uint64_t)header->index_count * header->index_size;
+
+    if (header->magic != MESH_FILE_MAGIC || header->version != MESH_FILE_VERSION ||
+        (header->index_size != 2 && header->index_size != 4) ||
+        header->vertex_offset % 4 != 0 || header->index_offset % header->index_size != 0 ||
+        vertex_end > size || index_end > size) {
+        ERROR("%s is not a valid version %d mesh.", path, MESH_FILE_VERSION);
+        munmap(mapping, size);
+        return 0;
+    }
+
+    file->header = header;
+    file->vertices = (const packed_vertex_t*)((const uint8_t*)mapping + header->vertex_offset);
+    file->indices = (const uint8_t*)mapping + header->index_offset;
+    file->mapping = mapping;
+    file->size = size;
+
+    TRACE("Mapped mesh %s with %d vertices and %d indices.", path, header->vertex_count, header->index_count);
+    return 1;
+}
+
+void close_mesh_file(mesh_file_t* file) {
+    if (file->mapping != NULL) {
+        munmap(file->mapping, file->size);
+    }
+    memset(file, 0, sizeof(mesh_file_t));
+}
+
+GLenum get_mesh_index_type(const mesh_file_t* file) {
+    return file->header->index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+mat4_t get_mesh_dequantize(const mesh_file_t* file) {
+    const float* min = file->header->bounds_min;
+    const float* max = file->header->bounds_max;
+
+    mat4_t m = mat4_scale(vec3(max[0] - min[0], max[1] - min[1], max[2] - min[2]));
+    m.m[12] = min[0];
+    m.m[13] = min[1];
+    m.m[14] = min[2];
+    return m;
+}
+
+vertex_buffer_t create_mesh_vertex_buffer(const mesh_file_t* file) {
+    const mesh_file_header_t* header = file->header;
+
+    // gl copies straight out of the mapping
+    vertex_buffer_t buffer = create_vertex_buffer(header->vertex_count * sizeof(packed_vertex_t), (void*)file->vertices);
+    add_normalized_attrib(&buffer, 3, GL_UNSIGNED_SHORT, sizeof(packed_vertex_t), offsetof(packed_vertex_t, position));
+    add_normalized_attrib(&buffer, 2, GL_SHORT, sizeof(packed_vertex_t), offsetof(packed_vertex_t, normal));
+    add_attrib(&buffer, 2, GL_HALF_FLOAT, sizeof(packed_vertex_t), offsetof(packed_vertex_t, uv));
+    add_index_buffer(&buffer, (size_t)header->index_count * header->index_size, (void*)file->indices);
+
+    return buffer;
+}
+
+void add_mesh_file_attribs(mesh_pool_t* pool) {
+    add_mesh_pool_normalized_attrib(pool, 3, GL_UNSIGNED_SHORT, offsetof(packed_vertex_t, position));
+    add_mesh_pool_normalized_attrib(pool, 2, GL_SHORT, offsetof(packed_vertex_t, normal));
+    add_mesh_pool_attrib(pool, 2, GL_HALF_FLOAT, offsetof(packed_vertex_t, uv));
+}
+
+mesh_t add_mesh_file(mesh_pool_t* pool, const mesh_file_t* file) {
+    const mesh_file_header_t* header = file->header;
+    if (pool->vertex_stride != sizeof(packed_vertex_t)) {
+        ERROR("Mesh pool stride %zu doesn't match the mesh file's %zu.", pool->vertex_stride, sizeof(packed_vertex_t));
+        return (mesh_t){0};
+    }
+
+    if (header->index_size == 4) {
+        return add_mesh(pool, file->vertices, header->vertex_count, file->indices, header->index_count);
+    }
+
+    // pools only take 32 bit indices
+    uint32_t* indices = malloc((header->index_count ? header->index_count : 1) * sizeof(uint32_t));
+    const uint16_t* short_indices = file->indices;
+    for (uint32_t i = 0; i < header->index_count; i++) {
+        indices[i] = short_indices[i];
+    }
+
+    mesh_t mesh = add_mesh(pool, file->vertices, header->vertex_count, indices, header->index_count);
+    free(indices);
+    return mesh;
+}
@@ -0,0 +1,97 @@
+#ifndef OVERTURE_MESH_FILE
+#define OVERTURE_MESH_FILE
+
+#include <stddef.h>
+#include <stdint.h>
+#include "graphics/mesh_pool.h"
+#include "graphics/opengl.h"
+#include "overture/math.h"
+
+/*
+ * Binary mesh format, written offline by save_mesh_file() (see tools/mesh_convert) and mapped
+ * with mmap at runtime so vertex and index data go straight from the page cache into gl.
+ *
+ * Vertices are 16 bytes instead of 32 for float positions, normals and uvs:
+ *
+ *   uint16 position[3]  normalized over the mesh bounds, get_mesh_dequantize() maps it back
+ *   uint16 padding
+ *   int16 normal[2]     octahedral encoded, snorm
+ *   half uv[2]
+ *
+ * Indices are 16 bit when there are at most 65536 vertices. Everything is little endian.
+ *
+ * Shaders decode normals with
+ *
+ *   vec3 oct_decode(vec2 e) {
+ *       vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+ *       if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+ *       return normalize(n);
+ *   }
+ */
+
+#define MESH_FILE_MAGIC 0x534d564f // "OVMS"
+#define MESH_FILE_VERSION 1
+
+#define MESH_HAS_NORMALS 0x1
+#define MESH_HAS_UVS 0x2
+
+// attribute locations set up by add_mesh_file_attribs()
+#define MESH_POSITION_ATTRIB 0
+#define MESH_NORMAL_ATTRIB 1
+#define MESH_UV_ATTRIB 2
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t index_size; // 2 or 4
+    uint32_t vertex_offset; // from the start of the file
+    uint32_t index_offset;
+    float bounds_min[3];
+    float bounds_max[3];
+    uint32_t reserved[6];
+} mesh_file_header_t;
+
+typedef struct {
+    uint16_t position[4];
+    int16_t normal[2];
+    uint16_t uv[2];
+} packed_vertex_t;
+
+typedef struct {
+    const mesh_file_header_t* header;
+    const packed_vertex_t* vertices;
+    const void* indices;
+    void* mapping;
+    size_t size;
+} mesh_file_t;
+
+uint16_t float_to_half(float f);
+float half_to_float(uint16_t h);
+void oct_encode(vec3_t n, int16_t out[2]);
+vec3_t oct_decode(const int16_t e[2]);
+
+/*
+ * Quantizes and writes a mesh, normals and uvs are optional. The input should already be
+ * optimized (see mesh_optimize.h). Returns 0 on failure.
+ */
+int save_mesh_file(const char* path, const float* positions, const float* normals, const float* uvs, uint32_t vertex_count,
+                   const uint32_t* indices, uint32_t index_count);
+
+// maps the file, returns 0 when it can't be read or isn't a valid mesh
+int open_mesh_file(const char* path, mesh_file_t* file);
+void close_mesh_file(mesh_file_t* file);
+
+GLenum get_mesh_index_type(const mesh_file_t* file);
+// model space from the quantized positions, multiply the model matrix with it
+mat4_t get_mesh_dequantize(const mesh_file_t* file);
+
+// vertex buffer with the attributes at MESH_*_ATTRIB, the file can be closed afterwards
+vertex_buffer_t create_mesh_vertex_buffer(const mesh_file_t* file);
+void add_mesh_file_attribs(mesh_pool_t* pool);
+// the pool has to be created with sizeof(packed_vertex_t) and add_mesh_file_attribs()
+mesh_t add_mesh_file(mesh_pool_t* pool, const mesh_file_t* file);
+
+#endif
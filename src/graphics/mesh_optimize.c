@@ -0,0 +1,353 @@
+#include "graphics/mesh_optimize.h"
+#include "core/log.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+float analyze_vertex_cache(const uint32_t* indices, uint32_t index_count, uint32_t cache_size) {
+    if (index_count < 3) {
+        return 0.0f;
+    }
+
+    // fifo of vertex ids, a vertex is in the cache when it was one of the last cache_size misses
+    uint32_t fifo[64];
+    cache_size = cache_size > 64 ? 64 : cache_size;
+    uint32_t head = 0, filled = 0, misses = 0;
+
+    for (uint32_t i = 0; i < index_count; i++) {
+        int hit = 0;
+        for (uint32_t c = 0; c < filled && !hit; c++) {
+            hit = fifo[c] == indices[i];
+        }
+        if (hit) {
+            continue;
+        }
+
+        misses++;
+        fifo[head] = indices[i];
+        head = (head + 1) % cache_size;
+        filled = filled < cache_size ? filled + 1 : filled;
+    }
+
+    return (float)misses / (float)(index_count / 3);
+}
+
+typedef struct {
+    uint32_t* offsets; // per vertex into triangles, vertex_count + 1 entries
+    uint32_t* triangles;
+} adjacency_t;
+
+static adjacency_t build_adjacency(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count) {
+    adjacency_t adjacency = {
+        .offsets = calloc(vertex_count + 1, sizeof(uint32_t)),
+        .triangles = malloc((index_count ? index_count : 1) * sizeof(uint32_t)),
+    };
+
+    for (uint32_t i = 0; i < index_count; i++) {
+        adjacency.offsets[indices[i] + 1]++;
+    }
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        adjacency.offsets[v + 1] += adjacency.offsets[v];
+    }
+
+    uint32_t* fill = malloc((vertex_count ? vertex_count : 1) * sizeof(uint32_t));
+    memcpy(fill, adjacency.offsets, vertex_count * sizeof(uint32_t));
+    for (uint32_t i = 0; i < index_count; i++) {
+        adjacency.triangles[fill[indices[i]]++] = i / 3;
+    }
+    free(fill);
+
+    return adjacency;
+}
+
+uint32_t optimize_vertex_cache(uint32_t* out, const uint32_t* indices, uint32_t index_count, uint32_t vertex_count,
+                               uint32_t cache_size, uint32_t* clusters) {
+    uint32_t triangle_count = index_count / 3;
+    if (triangle_count == 0) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < index_count; i++) {
+        if (indices[i] >= vertex_count) {
+            ERROR("Index %d is out of range of %d vertices.", indices[i], vertex_count);
+            memcpy(out, indices, index_count * sizeof(uint32_t));
+            return 0;
+        }
+    }
+
+    adjacency_t adjacency = build_adjacency(indices, index_count, vertex_count);
+
+    uint32_t* live = malloc(vertex_count * sizeof(uint32_t));
+    uint32_t* cache_time = calloc(vertex_count, sizeof(uint32_t));
+    uint8_t* emitted = calloc(triangle_count, 1);
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+    }
+
+    // every vertex of every emitted triangle is pushed once, candidates are the vertices of one fan
+    uint32_t* dead_end = malloc(index_count * sizeof(uint32_t));
+    uint32_t dead_end_top = 0;
+    uint32_t* candidates = malloc(index_count * sizeof(uint32_t));
+
+    uint32_t timestamp = cache_size + 1;
+    uint32_t cursor = 0;
+    uint32_t out_count = 0;
+    uint32_t cluster_count = 0;
+
+    // the first vertex used by anything
+    while (live[cursor] == 0) {
+        cursor++;
+    }
+    uint32_t fan = cursor;
+
+    if (clusters != NULL) {
+        clusters[cluster_count] = 0;
+    }
+    cluster_count++;
+
+    for (;;) {
+        uint32_t candidate_count = 0;
+
+        for (uint32_t a = adjacency.offsets[fan]; a < adjacency.offsets[fan + 1]; a++) {
+            uint32_t t = adjacency.triangles[a];
+            if (emitted[t]) {
+                continue;
+            }
+            emitted[t] = 1;
+
+            for (uint32_t c = 0; c < 3; c++) {
+                uint32_t v = indices[t * 3 + c];
+                out[out_count++] = v;
+                dead_end[dead_end_top++] = v;
+                candidates[candidate_count++] = v;
+                live[v]--;
+
+                if (timestamp - cache_time[v] > cache_size) {
+                    cache_time[v] = timestamp++;
+                }
+            }
+        }
+
+        // prefer the candidate that will still be in the cache once its remaining triangles are emitted
+        uint32_t next = UINT32_MAX;
+        int32_t best = -1;
+        for (uint32_t c = 0; c < candidate_count; c++) {
+            uint32_t v = candidates[c];
+            if (live[v] == 0) {
+                continue;
+            }
+
+            int32_t priority = 0;
+            if (timestamp - cache_time[v] + 2 * live[v] <= cache_size) {
+                priority = timestamp - cache_time[v];
+            }
+            if (priority > best) {
+                best = priority;
+                next = v;
+            }
+        }
+
+        if (next == UINT32_MAX) {
+            // dead end, back up to a recent vertex that still has triangles or take the next unused one
+            while (dead_end_top > 0 && next == UINT32_MAX) {
+                uint32_t v = dead_end[--dead_end_top];
+                if (live[v] > 0) {
+                    next = v;
+                }
+            }
+            while (next == UINT32_MAX && cursor < vertex_count) {
+                if (live[cursor] > 0) {
+                    next = cursor;
+                }
+                cursor++;
+            }
+            if (next == UINT32_MAX) {
+                break;
+            }
+
+            if (clusters != NULL) {
+                clusters[cluster_count] = out_count / 3;
+            }
+            cluster_count++;
+        }
+
+        fan = next;
+    }
+
+    free(adjacency.offsets);
+    free(adjacency.triangles);
+    free(live);
+    free(cache_time);
+    free(emitted);
+    free(dead_end);
+    free(candidates);
+
+    return cluster_count;
+}
+
+typedef struct {
+    uint32_t start;
+    uint32_t count;
+    float center[3];
+    float normal[3];
+    float sort_key;
+} overdraw_cluster_t;
+
+static int compare_clusters(const void* a, const void* b) {
+    float ka = ((const overdraw_cluster_t*)a)->sort_key;
+    float kb = ((const overdraw_cluster_t*)b)->sort_key;
+    return (ka < kb) - (ka > kb);
+}
+
+static const float* vertex_position(const void* vertices, size_t stride, uint32_t index) {
+    return (const float*)((const uint8_t*)vertices + index * stride);
+}
+
+// splits every cluster where its misses per triangle so far are close enough to the whole cluster's
+static uint32_t split_clusters(const uint32_t* indices, uint32_t index_count, const uint32_t* clusters, uint32_t cluster_count,
+                               uint32_t cache_size, float threshold, uint32_t* split) {
+    uint32_t triangle_count = index_count / 3;
+    uint32_t split_count = 0;
+
+    for (uint32_t c = 0; c < cluster_count; c++) {
+        uint32_t start = clusters[c];
+        uint32_t end = c + 1 < cluster_count ? clusters[c + 1] : triangle_count;
+        float cluster_acmr = analyze_vertex_cache(indices + start * 3, (end - start) * 3, cache_size);
+
+        uint32_t fifo[64];
+        uint32_t head = 0, filled = 0, misses = 0;
+        uint32_t sub_start = start;
+        split[split_count++] = start;
+
+        for (uint32_t t = start; t < end; t++) {
+            for (uint32_t k = 0; k < 3; k++) {
+                uint32_t v = indices[t * 3 + k];
+                int hit = 0;
+                for (uint32_t i = 0; i < filled && !hit; i++) {
+                    hit = fifo[i] == v;
+                }
+                if (!hit) {
+                    misses++;
+                    fifo[head] = v;
+                    head = (head + 1) % cache_size;
+                    filled = filled < cache_size ? filled + 1 : filled;
+                }
+            }
+
+            if (t + 1 < end && (float)misses / (t + 1 - sub_start) <= threshold * cluster_acmr) {
+                sub_start = t + 1;
+                split[split_count++] = sub_start;
+                head = filled = misses = 0;
+            }
+        }
+    }
+
+    return split_count;
+}
+
+void optimize_overdraw(uint32_t* indices, uint32_t index_count, const void* vertices, size_t stride, uint32_t vertex_count,
+                       const uint32_t* clusters, uint32_t cluster_count, uint32_t cache_size, float threshold) {
+    uint32_t triangle_count = index_count / 3;
+    if (triangle_count == 0 || cluster_count == 0) {
+        return;
+    }
+    cache_size = cache_size > 64 ? 64 : cache_size;
+
+    uint32_t* split = malloc(triangle_count * sizeof(uint32_t));
+    uint32_t split_count = split_clusters(indices, index_count, clusters, cluster_count, cache_size, threshold, split);
+    overdraw_cluster_t* sorted = calloc(split_count, sizeof(overdraw_cluster_t));
+
+    // area weighted centroids and summed face normals
+    float mesh_center[3] = {0};
+    float mesh_area = 0.0f;
+
+    for (uint32_t c = 0; c < split_count; c++) {
+        overdraw_cluster_t* cluster = &sorted[c];
+        cluster->start = split[c];
+        cluster->count = (c + 1 < split_count ? split[c + 1] : triangle_count) - cluster->start;
+
+        float area = 0.0f;
+        for (uint32_t t = cluster->start; t < cluster->start + cluster->count; t++) {
+            const float* a = vertex_position(vertices, stride, indices[t * 3]);
+            const float* b = vertex_position(vertices, stride, indices[t * 3 + 1]);
+            const float* d = vertex_position(vertices, stride, indices[t * 3 + 2]);
+
+            float e0[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            float e1[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+            float n[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+            float w = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for (int i = 0; i < 3; i++) {
+                cluster->center[i] += (a[i] + b[i] + d[i]) / 3.0f * w;
+                cluster->normal[i] += n[i];
+            }
+            area += w;
+        }
+
+        for (int i = 0; i < 3; i++) {
+            mesh_center[i] += cluster->center[i];
+            cluster->center[i] = area > 0.0f ? cluster->center[i] / area : 0.0f;
+        }
+        mesh_area += area;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        mesh_center[i] = mesh_area > 0.0f ? mesh_center[i] / mesh_area : 0.0f;
+    }
+
+    // clusters facing away from the center are the outer shell, drawing them first occludes the rest
+    for (uint32_t c = 0; c < split_count; c++) {
+        overdraw_cluster_t* cluster = &sorted[c];
+        float length = sqrtf(cluster->normal[0] * cluster->normal[0] + cluster->normal[1] * cluster->normal[1] +
+                             cluster->normal[2] * cluster->normal[2]);
+        cluster->sort_key = 0.0f;
+        for (int i = 0; i < 3; i++) {
+            float n = length > 0.0f ? cluster->normal[i] / length : 0.0f;
+            cluster->sort_key += (cluster->center[i] - mesh_center[i]) * n;
+        }
+    }
+
+    qsort(sorted, split_count, sizeof(overdraw_cluster_t), compare_clusters);
+
+    uint32_t* copy = malloc(index_count * sizeof(uint32_t));
+    memcpy(copy, indices, index_count * sizeof(uint32_t));
+
+    uint32_t offset = 0;
+    for (uint32_t c = 0; c < split_count; c++) {
+        memcpy(indices + offset, copy + sorted[c].start * 3, sorted[c].count * 3 * sizeof(uint32_t));
+        offset += sorted[c].count * 3;
+    }
+
+    TRACE("Sorted %d clusters of %d vertices for overdraw.", split_count, vertex_count);
+
+    free(copy);
+    free(split);
+    free(sorted);
+}
+
+uint32_t optimize_vertex_fetch(void* vertices, size_t stride, uint32_t vertex_count, uint32_t* indices, uint32_t index_count) {
+    uint32_t* remap = malloc((vertex_count ? vertex_count : 1) * sizeof(uint32_t));
+    memset(remap, 0xff, vertex_count * sizeof(uint32_t));
+
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < index_count; i++) {
+        uint32_t v = indices[i];
+        if (remap[v] == UINT32_MAX) {
+            remap[v] = next++;
+        }
+        indices[i] = remap[v];
+    }
+
+    uint8_t* copy = malloc((vertex_count ? vertex_count : 1) * stride);
+    memcpy(copy, vertices, vertex_count * stride);
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        if (remap[v] != UINT32_MAX) {
+            memcpy((uint8_t*)vertices + remap[v] * stride, copy + v * stride, stride);
+        }
+    }
+
+    free(copy);
+    free(remap);
+    return next;
+}
@@ -0,0 +1,41 @@
+#ifndef OVERTURE_MESH_OPTIMIZE
+#define OVERTURE_MESH_OPTIMIZE
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Offline index and vertex reordering, run once when meshes are converted. The usual order is
+ *
+ *   optimize_vertex_cache() -> optimize_overdraw() -> optimize_vertex_fetch()
+ *
+ * optimize_vertex_cache() is Tipsify (Sander, Nehab and Barczak 2007), it reorders triangles so
+ * recently transformed vertices are reused while they are still in the post transform cache, and
+ * reports the clusters it jumped between. optimize_overdraw() splits those clusters further where
+ * that costs little cache efficiency and sorts them so outward facing ones are drawn first, which
+ * lets early z reject more of the rest. optimize_vertex_fetch() then renumbers the vertices in the
+ * order they are first used so fetches walk the vertex buffer linearly.
+ */
+
+#define VERTEX_CACHE_SIZE 16
+#define OVERDRAW_THRESHOLD 1.05f
+
+// average cache misses per triangle with a fifo cache, 0.5 is the best possible and 3 the worst
+float analyze_vertex_cache(const uint32_t* indices, uint32_t index_count, uint32_t cache_size);
+
+/*
+ * Writes the reordered indices to out (which can't alias indices). When clusters isn't NULL it
+ * gets the first triangle of every cluster, it needs room for index_count / 3 entries. Returns
+ * the number of clusters.
+ */
+uint32_t optimize_vertex_cache(uint32_t* out, const uint32_t* indices, uint32_t index_count, uint32_t vertex_count,
+                               uint32_t cache_size, uint32_t* clusters);
+
+// positions are 3 floats at the start of every vertex, indices are reordered in place
+void optimize_overdraw(uint32_t* indices, uint32_t index_count, const void* vertices, size_t stride, uint32_t vertex_count,
+                       const uint32_t* clusters, uint32_t cluster_count, uint32_t cache_size, float threshold);
+
+// reorders the vertices in place and rewrites the indices, unused vertices are dropped, returns the new vertex count
+uint32_t optimize_vertex_fetch(void* vertices, size_t stride, uint32_t vertex_count, uint32_t* indices, uint32_t index_count);
+
+#endif
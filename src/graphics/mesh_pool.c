@@ -0,0 +1,146 @@
+#include "graphics/mesh_pool.h"
+#include "core/log.h"
+
+static uint32_t create_buffer(GLenum target, size_t size) {
+    uint32_t buffer;
+    glGenBuffers(1, &buffer);
+    bind_buffer(target, buffer);
+    glBufferData(target, size, NULL, GL_STATIC_DRAW);
+    return buffer;
+}
+
+static void set_pool_attrib(mesh_pool_t* pool, uint32_t index) {
+    const mesh_attrib_t* attrib = &pool->attribs[index];
+    glVertexAttribPointer(index, attrib->size, attrib->type, attrib->normalized ? GL_TRUE : GL_FALSE, pool->vertex_stride, (void*)attrib->offset);
+    glEnableVertexAttribArray(index);
+}
+
+mesh_pool_t create_mesh_pool(size_t vertex_stride, uint32_t vertex_capacity, uint32_t index_capacity) {
+    mesh_pool_t pool = {0};
+    pool.vertex_stride = vertex_stride;
+    pool.vertex_capacity = vertex_capacity ? vertex_capacity : 1024;
+    pool.index_capacity = index_capacity ? index_capacity : 1024;
+
+    glGenVertexArrays(1, &pool.VAO);
+    bind_vertex_array(pool.VAO);
+
+    pool.VBO = create_buffer(GL_ARRAY_BUFFER, pool.vertex_capacity * vertex_stride);
+    pool.EBO = create_buffer(GL_ELEMENT_ARRAY_BUFFER, pool.index_capacity * sizeof(uint32_t));
+
+    enable_indirect_draws(pool.VAO);
+
+    TRACE("Created mesh pool for %d vertices and %d indices.", pool.vertex_capacity, pool.index_capacity);
+
+    return pool;
+}
+
+void destroy_mesh_pool(mesh_pool_t* pool) {
+    disable_indirect_draws(pool->VAO);
+
+    glDeleteVertexArrays(1, &pool->VAO);
+    glDeleteBuffers(1, &pool->VBO);
+    glDeleteBuffers(1, &pool->EBO);
+    invalidate_gl_state();
+
+    TRACE("Destroyed mesh pool.");
+}
+
+static void add_pool_attrib(mesh_pool_t* pool, uint32_t size, GLenum type, int normalized, size_t offset) {
+    if (pool->attrib_count == MESH_POOL_MAX_ATTRIBS) {
+        ERROR("Mesh pools support at most %d attributes.", MESH_POOL_MAX_ATTRIBS);
+        return;
+    }
+
+    pool->attribs[pool->attrib_count] = (mesh_attrib_t){ .size = size, .type = type, .normalized = normalized, .offset = offset };
+
+    bind_vertex_array(pool->VAO);
+    bind_buffer(GL_ARRAY_BUFFER, pool->VBO);
+    set_pool_attrib(pool, pool->attrib_count);
+    pool->attrib_count++;
+}
+
+void add_mesh_pool_attrib(mesh_pool_t* pool, uint32_t size, GLenum type, size_t offset) {
+    add_pool_attrib(pool, size, type, 0, offset);
+}
+
+void add_mesh_pool_normalized_attrib(mesh_pool_t* pool, uint32_t size, GLenum type, size_t offset) {
+    add_pool_attrib(pool, size, type, 1, offset);
+}
+
+// copies the used part into a bigger buffer, the old one is freed
+static uint32_t grow_buffer(uint32_t buffer, size_t used, size_t size) {
+    uint32_t grown;
+    glGenBuffers(1, &grown);
+    bind_buffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+
+    bind_buffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+
+    glDeleteBuffers(1, &buffer);
+    invalidate_gl_state();
+
+    return grown;
+}
+
+static void reserve_pool(mesh_pool_t* pool, uint32_t vertex_count, uint32_t index_count) {
+    if (vertex_count > pool->vertex_capacity) {
+        while (pool->vertex_capacity < vertex_count) {
+            pool->vertex_capacity *= 2;
+        }
+        pool->VBO = grow_buffer(pool->VBO, pool->vertex_count * pool->vertex_stride, pool->vertex_capacity * pool->vertex_stride);
+
+        // the vertex array keeps pointing at the old buffer until the attribs are set again
+        bind_vertex_array(pool->VAO);
+        bind_buffer(GL_ARRAY_BUFFER, pool->VBO);
+        for (uint32_t i = 0; i < pool->attrib_count; i++) {
+            set_pool_attrib(pool, i);
+        }
+
+        TRACE("Grew mesh pool to %d vertices.", pool->vertex_capacity);
+    }
+
+    if (index_count > pool->index_capacity) {
+        while (pool->index_capacity < index_count) {
+            pool->index_capacity *= 2;
+        }
+        pool->EBO = grow_buffer(pool->EBO, pool->index_count * sizeof(uint32_t), pool->index_capacity * sizeof(uint32_t));
+
+        bind_vertex_array(pool->VAO);
+        bind_buffer(GL_ELEMENT_ARRAY_BUFFER, pool->EBO);
+
+        TRACE("Grew mesh pool to %d indices.", pool->index_capacity);
+    }
+}
+
+mesh_t add_mesh(mesh_pool_t* pool, const void* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count) {
+    reserve_pool(pool, pool->vertex_count + vertex_count, pool->index_count + index_count);
+
+    mesh_t mesh = {
+        .vertex_array = pool->VAO,
+        .base_vertex = (int32_t)pool->vertex_count,
+        .first_index = pool->index_count,
+        .index_count = index_count,
+    };
+
+    bind_buffer(GL_ARRAY_BUFFER, pool->VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, pool->vertex_count * pool->vertex_stride, vertex_count * pool->vertex_stride, vertices);
+
+    // the element array binding is part of the vertex array
+    bind_vertex_array(pool->VAO);
+    bind_buffer(GL_ELEMENT_ARRAY_BUFFER, pool->EBO);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, pool->index_count * sizeof(uint32_t), index_count * sizeof(uint32_t), indices);
+
+    pool->vertex_count += vertex_count;
+    pool->index_count += index_count;
+
+    return mesh;
+}
+
+void set_packet_mesh(draw_packet_t* packet, mesh_t mesh) {
+    packet->vertex_array = mesh.vertex_array;
+    packet->index_type = GL_UNSIGNED_INT;
+    packet->first = mesh.first_index;
+    packet->count = mesh.index_count;
+    packet->base_vertex = mesh.base_vertex;
+}
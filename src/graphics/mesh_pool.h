@@ -0,0 +1,57 @@
+#ifndef OVERTURE_MESH_POOL
+#define OVERTURE_MESH_POOL
+
+#include <stddef.h>
+#include <stdint.h>
+#include "graphics/opengl.h"
+
+/*
+ * Many meshes with the same vertex layout suballocated from one vertex and one index buffer
+ * behind a single vertex array. Packets for pool meshes only differ in their index range and
+ * base vertex, so instanced programs get all of them drawn with one glMultiDrawElementsIndirect
+ * (see enable_indirect_draws()). Indices are always GL_UNSIGNED_INT and relative to the mesh.
+ *
+ * Buffers grow by copying when full, like all gl objects a pool belongs to the context it was
+ * created on.
+ */
+
+#define MESH_POOL_MAX_ATTRIBS RENDER_INSTANCE_ID_ATTRIB
+
+typedef struct {
+    uint32_t size;
+    GLenum type;
+    int normalized;
+    size_t offset;
+} mesh_attrib_t;
+
+typedef struct {
+    uint32_t VAO;
+    uint32_t VBO;
+    uint32_t EBO;
+    size_t vertex_stride;
+    uint32_t vertex_capacity;
+    uint32_t vertex_count;
+    uint32_t index_capacity;
+    uint32_t index_count;
+    mesh_attrib_t attribs[MESH_POOL_MAX_ATTRIBS];
+    uint32_t attrib_count;
+} mesh_pool_t;
+
+typedef struct {
+    uint32_t vertex_array;
+    int32_t base_vertex;
+    uint32_t first_index;
+    uint32_t index_count;
+} mesh_t;
+
+mesh_pool_t create_mesh_pool(size_t vertex_stride, uint32_t vertex_capacity, uint32_t index_capacity);
+void destroy_mesh_pool(mesh_pool_t* pool);
+void add_mesh_pool_attrib(mesh_pool_t* pool, uint32_t size, GLenum type, size_t offset);
+void add_mesh_pool_normalized_attrib(mesh_pool_t* pool, uint32_t size, GLenum type, size_t offset);
+
+mesh_t add_mesh(mesh_pool_t* pool, const void* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count);
+
+// fills in the mesh fields of a packet
+void set_packet_mesh(draw_packet_t* packet, mesh_t mesh);
+
+#endif
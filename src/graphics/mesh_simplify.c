@@ -0,0 +1,405 @@
+#include "graphics/mesh_simplify.h"
+#include "core/log.h"
+#include "overture/math.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// border planes are weighted by the squared edge length like faces are by area, times this
+#define BORDER_WEIGHT 10.0
+
+typedef enum {
+    VERTEX_MANIFOLD,
+    VERTEX_BORDER,
+    VERTEX_LOCKED,
+} vertex_kind_t;
+
+// symmetric 4x4 plane quadric, doubles because the error is a small difference of large sums
+typedef struct {
+    double a2, b2, c2, d2;
+    double ab, ac, ad, bc, bd, cd;
+    double weight; // summed face area the error is averaged over
+} quadric_t;
+
+typedef struct {
+    uint32_t from;
+    uint32_t to;
+    float cost;
+} collapse_t;
+
+typedef struct {
+    uint64_t* keys;
+    uint32_t mask;
+} edge_set_t;
+
+static vec3_t get_position(const void* vertices, size_t stride, uint32_t index) {
+    const float* p = (const float*)((const uint8_t*)vertices + index * stride);
+    return vec3(p[0], p[1], p[2]);
+}
+
+static void add_plane(quadric_t* q, vec3_t n, float d, double w) {
+    q->a2 += w * n.x * n.x;
+    q->b2 += w * n.y * n.y;
+    q->c2 += w * n.z * n.z;
+    q->d2 += w * d * d;
+    q->ab += w * n.x * n.y;
+    q->ac += w * n.x * n.z;
+    q->ad += w * n.x * d;
+    q->bc += w * n.y * n.z;
+    q->bd += w * n.y * d;
+    q->cd += w * n.z * d;
+}
+
+static void add_quadric(quadric_t* q, const quadric_t* other) {
+    q->a2 += other->a2;
+    q->b2 += other->b2;
+    q->c2 += other->c2;
+    q->d2 += other->d2;
+    q->ab += other->ab;
+    q->ac += other->ac;
+    q->ad += other->ad;
+    q->bc += other->bc;
+    q->bd += other->bd;
+    q->cd += other->cd;
+    q->weight += other->weight;
+}
+
+static float quadric_error(const quadric_t* q, vec3_t p) {
+    double x = p.x, y = p.y, z = p.z;
+    double r = q->a2 * x * x + q->b2 * y * y + q->c2 * z * z + q->d2 +
+               2.0 * (q->ab * x * y + q->ac * x * z + q->bc * y * z) +
+               2.0 * (q->ad * x + q->bd * y + q->cd * z);
+    r = r < 0.0 ? 0.0 : r;
+    return (float)(q->weight > 0.0 ? r / q->weight : r);
+}
+
+static uint32_t table_size(uint32_t count) {
+    uint32_t size = 64;
+    while (size < count * 2) {
+        size *= 2;
+    }
+    return size;
+}
+
+static uint64_t hash_key(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// vertices with bitwise equal positions map to the first of them
+static void build_position_remap(uint32_t* remap, const void* vertices, size_t stride, uint32_t vertex_count) {
+    uint32_t size = table_size(vertex_count);
+    uint32_t* table = malloc(size * sizeof(uint32_t));
+    memset(table, 0xff, size * sizeof(uint32_t));
+
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        uint32_t bits[3];
+        memcpy(bits, (const uint8_t*)vertices + v * stride, sizeof(bits));
+        uint64_t key = ((uint64_t)bits[0] * 73856093u) ^ ((uint64_t)bits[1] * 19349663u) ^ ((uint64_t)bits[2] * 83492791u);
+
+        uint32_t slot = hash_key(key) & (size - 1);
+        remap[v] = v;
+        while (table[slot] != UINT32_MAX) {
+            if (memcmp((const uint8_t*)vertices + table[slot] * stride, bits, sizeof(bits)) == 0) {
+                remap[v] = table[slot];
+                break;
+            }
+            slot = (slot + 1) & (size - 1);
+        }
+        if (remap[v] == v) {
+            table[slot] = v;
+        }
+    }
+
+    free(table);
+}
+
+// returns 0 when the directed edge was already there
+static int insert_edge(edge_set_t* set, uint32_t a, uint32_t b) {
+    uint64_t key = (uint64_t)a << 32 | b;
+    uint32_t slot = hash_key(key) & set->mask;
+    while (set->keys[slot] != UINT64_MAX) {
+        if (set->keys[slot] == key) {
+            return 0;
+        }
+        slot = (slot + 1) & set->mask;
+    }
+    set->keys[slot] = key;
+    return 1;
+}
+
+static int has_edge(const edge_set_t* set, uint32_t a, uint32_t b) {
+    uint64_t key = (uint64_t)a << 32 | b;
+    uint32_t slot = hash_key(key) & set->mask;
+    while (set->keys[slot] != UINT64_MAX) {
+        if (set->keys[slot] == key) {
+            return 1;
+        }
+        slot = (slot + 1) & set->mask;
+    }
+    return 0;
+}
+
+static void build_edges(edge_set_t* set, const uint32_t* indices, uint32_t index_count, const uint32_t* remap, uint8_t* kinds) {
+    memset(set->keys, 0xff, (set->mask + 1) * sizeof(uint64_t));
+
+    for (uint32_t i = 0; i < index_count; i += 3) {
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t a = remap[indices[i + k]], b = remap[indices[i + (k + 1) % 3]];
+            // the same directed edge twice means more than two triangles meet there
+            if (a != b && !insert_edge(set, a, b) && kinds != NULL) {
+                kinds[a] = kinds[b] = VERTEX_LOCKED;
+            }
+        }
+    }
+}
+
+static int compare_collapses(const void* a, const void* b) {
+    float ca = ((const collapse_t*)a)->cost;
+    float cb = ((const collapse_t*)b)->cost;
+    return (ca > cb) - (ca < cb);
+}
+
+// whether moving from onto to turns any of from's remaining triangles over
+static int collapse_flips(const uint32_t* indices, const uint32_t* offsets, const uint32_t* triangles, const uint32_t* collapse,
+                          const void* vertices, size_t stride, uint32_t from, uint32_t to) {
+    vec3_t p_from = get_position(vertices, stride, from);
+    vec3_t p_to = get_position(vertices, stride, to);
+
+    for (uint32_t i = offsets[from]; i < offsets[from + 1]; i++) {
+        const uint32_t* t = &indices[triangles[i] * 3];
+        uint32_t v[3] = { collapse[t[0]], collapse[t[1]], collapse[t[2]] };
+        if (v[0] == to || v[1] == to || v[2] == to) {
+            continue;
+        }
+
+        uint32_t corner = v[0] == from ? 0 : (v[1] == from ? 1 : 2);
+        vec3_t x = get_position(vertices, stride, v[(corner + 1) % 3]);
+        vec3_t y = get_position(vertices, stride, v[(corner + 2) % 3]);
+
+        vec3_t before = vec3_cross(vec3_sub(x, p_from), vec3_sub(y, p_from));
+        vec3_t after = vec3_cross(vec3_sub(x, p_to), vec3_sub(y, p_to));
+        if (vec3_dot(before, after) <= 0.0f) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+uint32_t simplify_mesh(uint32_t* out, const uint32_t* indices, uint32_t index_count, const void* vertices, size_t stride,
+                       uint32_t vertex_count, uint32_t target_index_count, float max_error, float* error) {
+    index_count -= index_count % 3;
+    if (out != indices) {
+        memcpy(out, indices, index_count * sizeof(uint32_t));
+    }
+    if (error != NULL) {
+        *error = 0.0f;
+    }
+    if (index_count <= target_index_count || vertex_count == 0) {
+        return index_count;
+    }
+
+    uint32_t* remap = malloc(vertex_count * sizeof(uint32_t));
+    uint32_t* group_size = calloc(vertex_count, sizeof(uint32_t));
+    uint8_t* kinds = calloc(vertex_count, sizeof(uint8_t));
+    quadric_t* quadrics = calloc(vertex_count, sizeof(quadric_t));
+    uint32_t* collapse = malloc(vertex_count * sizeof(uint32_t));
+    uint8_t* touched = malloc(vertex_count);
+    uint32_t* offsets = malloc((vertex_count + 1) * sizeof(uint32_t));
+    uint32_t* triangles = malloc(index_count * sizeof(uint32_t));
+    collapse_t* candidates = malloc(index_count * 2 * sizeof(collapse_t));
+    edge_set_t edges = { .keys = malloc(table_size(index_count) * sizeof(uint64_t)), .mask = table_size(index_count) - 1 };
+
+    // seams are kept whole by never moving a vertex that shares its position
+    build_position_remap(remap, vertices, stride, vertex_count);
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        group_size[remap[v]]++;
+        collapse[v] = v;
+    }
+
+    build_edges(&edges, out, index_count, remap, kinds);
+
+    for (uint32_t i = 0; i < index_count; i += 3) {
+        vec3_t p[3];
+        for (uint32_t k = 0; k < 3; k++) {
+            p[k] = get_position(vertices, stride, out[i + k]);
+        }
+
+        vec3_t n = vec3_cross(vec3_sub(p[1], p[0]), vec3_sub(p[2], p[0]));
+        float length = vec3_length(n);
+        if (length == 0.0f) {
+            continue;
+        }
+        n = vec3_scale(n, 1.0f / length);
+        float d = -vec3_dot(n, p[0]);
+
+        for (uint32_t k = 0; k < 3; k++) {
+            add_plane(&quadrics[out[i + k]], n, d, length * 0.5);
+            quadrics[out[i + k]].weight += length * 0.5;
+
+            // an edge without its twin is on the border, a plane through it keeps the outline in place
+            uint32_t a = out[i + k], b = out[i + (k + 1) % 3];
+            if (remap[a] == remap[b] || has_edge(&edges, remap[b], remap[a])) {
+                continue;
+            }
+            kinds[remap[a]] = kinds[remap[a]] == VERTEX_MANIFOLD ? VERTEX_BORDER : kinds[remap[a]];
+            kinds[remap[b]] = kinds[remap[b]] == VERTEX_MANIFOLD ? VERTEX_BORDER : kinds[remap[b]];
+
+            vec3_t edge = vec3_sub(p[(k + 1) % 3], p[k]);
+            vec3_t border_normal = vec3_normalize(vec3_cross(edge, n));
+            float border_d = -vec3_dot(border_normal, p[k]);
+            double border_weight = vec3_dot(edge, edge) * BORDER_WEIGHT;
+            add_plane(&quadrics[a], border_normal, border_d, border_weight);
+            add_plane(&quadrics[b], border_normal, border_d, border_weight);
+        }
+    }
+
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        if (group_size[remap[v]] > 1) {
+            kinds[remap[v]] = VERTEX_LOCKED;
+        }
+    }
+
+    float max_cost = max_error * max_error;
+    float result_cost = 0.0f;
+    uint32_t passes = 0;
+
+    while (index_count > target_index_count) {
+        passes++;
+
+        // triangles around every vertex
+        memset(offsets, 0, (vertex_count + 1) * sizeof(uint32_t));
+        for (uint32_t i = 0; i < index_count; i++) {
+            offsets[out[i] + 1]++;
+        }
+        for (uint32_t v = 0; v < vertex_count; v++) {
+            offsets[v + 1] += offsets[v];
+        }
+        for (uint32_t i = 0; i < index_count; i++) {
+            triangles[offsets[out[i]]++] = i / 3;
+        }
+        for (uint32_t v = vertex_count; v > 0; v--) {
+            offsets[v] = offsets[v - 1];
+        }
+        offsets[0] = 0;
+
+        build_edges(&edges, out, index_count, remap, NULL);
+
+        uint32_t candidate_count = 0;
+        for (uint32_t i = 0; i < index_count; i += 3) {
+            for (uint32_t k = 0; k < 3; k++) {
+                uint32_t a = out[i + k], b = out[i + (k + 1) % 3];
+                int border = !has_edge(&edges, remap[b], remap[a]);
+
+                for (uint32_t direction = 0; direction < 2; direction++) {
+                    uint32_t from = direction ? b : a, to = direction ? a : b;
+                    uint8_t from_kind = kinds[remap[from]];
+
+                    // border vertices only slide along the border
+                    if (from_kind == VERTEX_LOCKED || (from_kind == VERTEX_BORDER && (!border || kinds[remap[to]] != VERTEX_BORDER))) {
+                        continue;
+                    }
+
+                    quadric_t q = quadrics[from];
+                    add_quadric(&q, &quadrics[to]);
+                    candidates[candidate_count++] = (collapse_t){ from, to, quadric_error(&q, get_position(vertices, stride, to)) };
+                }
+            }
+        }
+
+        qsort(candidates, candidate_count, sizeof(collapse_t), compare_collapses);
+
+        // independent collapses only, the adjacency is stale for anything a collapse touched
+        memset(touched, 0, vertex_count);
+        uint32_t removed = 0, collapsed = 0;
+        uint32_t budget = (index_count - target_index_count) / 3;
+
+        for (uint32_t c = 0; c < candidate_count && removed < budget; c++) {
+            collapse_t* candidate = &candidates[c];
+            if (candidate->cost > max_cost) {
+                break;
+            }
+            if (touched[candidate->from] || touched[candidate->to] ||
+                collapse_flips(out, offsets, triangles, collapse, vertices, stride, candidate->from, candidate->to)) {
+                continue;
+            }
+
+            collapse[candidate->from] = candidate->to;
+            add_quadric(&quadrics[candidate->to], &quadrics[candidate->from]);
+            touched[candidate->from] = touched[candidate->to] = 1;
+
+            removed += kinds[remap[candidate->from]] == VERTEX_BORDER ? 1 : 2;
+            collapsed++;
+            result_cost = candidate->cost > result_cost ? candidate->cost : result_cost;
+        }
+
+        if (collapsed == 0) {
+            break;
+        }
+
+        uint32_t write = 0;
+        for (uint32_t i = 0; i < index_count; i += 3) {
+            uint32_t a = collapse[out[i]], b = collapse[out[i + 1]], c = collapse[out[i + 2]];
+            if (a != b && b != c && a != c) {
+                out[write++] = a;
+                out[write++] = b;
+                out[write++] = c;
+            }
+        }
+        index_count = write;
+    }
+
+    TRACE("Simplified to %d indices in %d passes, error %f.", index_count, passes, sqrtf(result_cost));
+
+    if (error != NULL) {
+        *error = sqrtf(result_cost);
+    }
+
+    free(remap);
+    free(group_size);
+    free(kinds);
+    free(quadrics);
+    free(collapse);
+    free(touched);
+    free(offsets);
+    free(triangles);
+    free(candidates);
+    free(edges.keys);
+    return index_count;
+}
+
+uint32_t generate_mesh_lods(uint32_t* out, mesh_lod_t* lods, uint32_t max_lods, const uint32_t* indices, uint32_t index_count,
+                            const void* vertices, size_t stride, uint32_t vertex_count, float ratio, float max_error) {
+    if (max_lods == 0) {
+        return 0;
+    }
+
+    index_count -= index_count % 3;
+    memcpy(out, indices, index_count * sizeof(uint32_t));
+    lods[0] = (mesh_lod_t){ .first = 0, .count = index_count, .error = 0.0f };
+
+    uint32_t lod_count = 1;
+    while (lod_count < max_lods) {
+        const mesh_lod_t* previous = &lods[lod_count - 1];
+        uint32_t target = (uint32_t)(previous->count / 3 * ratio) * 3;
+        if (target == 0) {
+            break;
+        }
+
+        // always from the full mesh so errors are measured against it and don't stack up
+        mesh_lod_t lod = { .first = previous->first + previous->count };
+        lod.count = simplify_mesh(out + lod.first, indices, index_count, vertices, stride, vertex_count, target, max_error, &lod.error);
+
+        if (lod.count == 0 || lod.count > previous->count * 0.9f) {
+            break;
+        }
+        lods[lod_count++] = lod;
+    }
+
+    TRACE("Generated %d levels of detail from %d triangles.", lod_count, index_count / 3);
+    return lod_count;
+}
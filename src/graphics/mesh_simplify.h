@@ -0,0 +1,42 @@
+#ifndef OVERTURE_MESH_SIMPLIFY
+#define OVERTURE_MESH_SIMPLIFY
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Offline simplification with quadric error metrics (Garland and Heckbert 1997). Edges are
+ * collapsed onto one of their vertices, so the vertex buffer is shared by every level of detail
+ * and only the indices change. Collapses are done in passes of independent edges, cheapest first,
+ * skipping any that would flip a triangle.
+ *
+ * Errors are in model units, the root of the area weighted mean squared distance of a vertex to
+ * the planes of the triangles it replaced. Vertices on open borders only slide along the border
+ * and vertices that share their position with another one (uv or normal seams) are kept.
+ */
+
+#define MAX_MESH_LODS 8
+
+typedef struct {
+    uint32_t first; // into the index buffer generate_mesh_lods() wrote
+    uint32_t count;
+    float error;
+} mesh_lod_t;
+
+/*
+ * Simplifies until at most target_index_count indices are left or the next collapse would be
+ * over max_error. positions are 3 floats at the start of every vertex. out can be indices.
+ * Returns the new index count, error gets the error of the result when it isn't NULL.
+ */
+uint32_t simplify_mesh(uint32_t* out, const uint32_t* indices, uint32_t index_count, const void* vertices, size_t stride,
+                       uint32_t vertex_count, uint32_t target_index_count, float max_error, float* error);
+
+/*
+ * Level 0 is the input, every further level aims for ratio of the previous one's triangles. Stops
+ * at max_lods, max_error or when a level doesn't get meaningfully smaller. out needs room for
+ * index_count * max_lods indices. Returns the number of levels.
+ */
+uint32_t generate_mesh_lods(uint32_t* out, mesh_lod_t* lods, uint32_t max_lods, const uint32_t* indices, uint32_t index_count,
+                            const void* vertices, size_t stride, uint32_t vertex_count, float ratio, float max_error);
+
+#endif
@@ -1,12 +1,531 @@
 #include "graphics/opengl.h"
 #include "core/log.h"
+#include "graphics/render_thread.h"
+#include "graphics/stream_buffer.h"
+#include <errno.h>
+#include <pthread.h>
 #include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+struct uniform_info_t {
+    char* name;
+    uint32_t hash;
+    int32_t location;
+    GLenum type;
+    int32_t size;
+    uint8_t has_value;
+    // last uploaded value, big enough for a mat4
+    uint32_t value[16];
+};
+
+typedef struct {
+    GLFWwindow* context;
+    program_t program;
+    uniform_info_t* uniforms;
+    uint32_t uniform_count;
+    int32_t* table; // open addressing, index into uniforms or -1
+    uint32_t table_size;
+    uint8_t instanced; // has the RENDER_INSTANCE_BLOCK storage block
+} program_info_t;
+
+// programs are only unique per context so they are keyed by both
+static program_info_t** program_table = NULL;
+static uint32_t program_table_size = 0;
+static uint32_t program_count = 0;
+
+static uint32_t hash_string(const char* str) {
+    uint32_t hash = 2166136261u;
+    while (*str) {
+        hash ^= (uint8_t)*str++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t hash_program(GLFWwindow* context, program_t program) {
+    uint64_t key = (uint64_t)(uintptr_t)context ^ ((uint64_t)program * 0x9E3779B97F4A7C15ull);
+    return (uint32_t)(key ^ (key >> 29));
+}
+
+static program_info_t** find_program_slot(GLFWwindow* context, program_t program) {
+    if (program_table_size == 0) {
+        return NULL;
+    }
+
+    uint32_t mask = program_table_size - 1;
+    uint32_t idx = hash_program(context, program) & mask;
+    while (program_table[idx] != NULL) {
+        if (program_table[idx]->context == context && program_table[idx]->program == program) {
+            return &program_table[idx];
+        }
+        idx = (idx + 1) & mask;
+    }
+    return &program_table[idx];
+}
+
+static void insert_program_info(program_info_t* info) {
+    if ((program_count + 1) * 2 > program_table_size) {
+        program_info_t** old_table = program_table;
+        uint32_t old_size = program_table_size;
+
+        program_table_size = program_table_size ? program_table_size * 2 : 64;
+        program_table = calloc(program_table_size, sizeof(program_info_t*));
+        program_count = 0;
+
+        for (uint32_t i = 0; i < old_size; i++) {
+            if (old_table[i] != NULL) {
+                *find_program_slot(old_table[i]->context, old_table[i]->program) = old_table[i];
+                program_count++;
+            }
+        }
+        free(old_table);
+    }
+
+    *find_program_slot(info->context, info->program) = info;
+    program_count++;
+}
+
+static void free_program_info(program_info_t* info) {
+    for (uint32_t i = 0; i < info->uniform_count; i++) {
+        free(info->uniforms[i].name);
+    }
+    free(info->uniforms);
+    free(info->table);
+    free(info);
+}
+
+static void remove_program_info(GLFWwindow* context, program_t program) {
+    program_info_t** slot = find_program_slot(context, program);
+    if (slot == NULL || *slot == NULL) {
+        return;
+    }
+
+    free_program_info(*slot);
+    *slot = NULL;
+    program_count--;
+
+    // reinsert the rest of the cluster so lookups don't stop at the hole
+    uint32_t mask = program_table_size - 1;
+    uint32_t idx = ((uint32_t)(slot - program_table) + 1) & mask;
+    while (program_table[idx] != NULL) {
+        program_info_t* info = program_table[idx];
+        program_table[idx] = NULL;
+        *find_program_slot(info->context, info->program) = info;
+        idx = (idx + 1) & mask;
+    }
+}
+
+static int32_t find_uniform(const program_info_t* info, const char* name, uint32_t hash) {
+    uint32_t mask = info->table_size - 1;
+    uint32_t idx = hash & mask;
+    while (info->table[idx] != -1) {
+        const uniform_info_t* uniform = &info->uniforms[info->table[idx]];
+        if (uniform->hash == hash && strcmp(uniform->name, name) == 0) {
+            return info->table[idx];
+        }
+        idx = (idx + 1) & mask;
+    }
+    return -1;
+}
+
+// has to run after every successful link, linking resets all uniform values
+static void introspect_program(program_t program) {
+    GLFWwindow* context = get_current_context();
+    remove_program_info(context, program);
+
+    int32_t active = 0;
+    int32_t max_length = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &active);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+    program_info_t* info = calloc(1, sizeof(program_info_t));
+    info->context = context;
+    info->program = program;
+    info->uniforms = calloc(active > 0 ? active : 1, sizeof(uniform_info_t));
+
+    info->table_size = 16;
+    while (info->table_size < (uint32_t)active * 2) {
+        info->table_size *= 2;
+    }
+    info->table = malloc(info->table_size * sizeof(int32_t));
+    memset(info->table, -1, info->table_size * sizeof(int32_t));
+
+    char* name = malloc(max_length + 1);
+    for (int32_t i = 0; i < active; i++) {
+        int32_t length = 0;
+        int32_t size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, i, max_length + 1, &length, &size, &type, name);
+
+        int32_t location = glGetUniformLocation(program, name);
+        if (location < 0) {
+            continue; // part of a uniform block
+        }
+
+        // arrays are reported as name[0], look them up by the plain name
+        char* bracket = strstr(name, "[0]");
+        if (bracket != NULL && bracket[3] == '\0') {
+            *bracket = '\0';
+        }
+
+        uniform_info_t* uniform = &info->uniforms[info->uniform_count];
+        uniform->name = strdup(name);
+        uniform->hash = hash_string(name);
+        uniform->location = location;
+        uniform->type = type;
+        uniform->size = size;
+
+        uint32_t mask = info->table_size - 1;
+        uint32_t idx = uniform->hash & mask;
+        while (info->table[idx] != -1) {
+            idx = (idx + 1) & mask;
+        }
+        info->table[idx] = info->uniform_count++;
+    }
+    free(name);
+
+    // pin the instance block to its binding so every program reads the same buffer
+    uint32_t block = glGetProgramResourceIndex(program, GL_SHADER_STORAGE_BLOCK, RENDER_INSTANCE_BLOCK);
+    if (block != GL_INVALID_INDEX) {
+        glShaderStorageBlockBinding(program, block, RENDER_INSTANCE_BINDING);
+        info->instanced = 1;
+    }
+
+    insert_program_info(info);
+
+    TRACE("Found %d active uniforms in program %d.", info->uniform_count, program);
+}
+
+#define UNKNOWN_BINDING UINT32_MAX
+#define MAX_TEXTURE_UNITS 32
+
+typedef enum {
+    BUFFER_ARRAY,
+    BUFFER_ELEMENT_ARRAY,
+    BUFFER_UNIFORM,
+    BUFFER_SHADER_STORAGE,
+    BUFFER_DRAW_INDIRECT,
+    BUFFER_PIXEL_UNPACK,
+    BUFFER_COPY_READ,
+    BUFFER_COPY_WRITE,
+    NUM_OF_BUFFER_TARGETS
+} buffer_target_t;
+
+// shadow of the gl state of one context, everything is UNKNOWN_BINDING until it has been set once
+typedef struct {
+    GLFWwindow* context;
+    program_t program;
+    uint32_t vertex_array;
+    uint32_t framebuffer;
+    uint32_t buffers[NUM_OF_BUFFER_TARGETS];
+    uint32_t active_texture;
+    uint32_t textures[MAX_TEXTURE_UNITS];
+    GLenum texture_targets[MAX_TEXTURE_UNITS];
+    uint32_t blend;
+    GLenum blend_src;
+    GLenum blend_dst;
+    uint32_t depth_test;
+    uint32_t depth_write;
+    GLenum depth_func;
+    // per context since buffers are not shared between contexts
+    stream_buffer_t* draw_stream; // instance data and indirect commands
+    uint32_t instance_id_buffer; // 0, 1, 2, ... read with divisor 1 by indirect vertex arrays
+    uint32_t instance_id_count;
+    uint32_t* indirect_arrays;
+    uint32_t indirect_array_count;
+    gl_state_stats_t stats;
+} gl_state_t;
+
+static gl_state_t** gl_states = NULL;
+static uint32_t gl_state_count = 0;
+static pthread_mutex_t gl_state_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// contexts are current per thread, so is the shadow
+static _Thread_local gl_state_t* current_state = NULL;
+
+static void reset_gl_state(gl_state_t* state) {
+    state->program = UNKNOWN_BINDING;
+    state->vertex_array = UNKNOWN_BINDING;
+    state->framebuffer = UNKNOWN_BINDING;
+    for (uint32_t i = 0; i < NUM_OF_BUFFER_TARGETS; i++) {
+        state->buffers[i] = UNKNOWN_BINDING;
+    }
+    state->active_texture = UNKNOWN_BINDING;
+    for (uint32_t i = 0; i < MAX_TEXTURE_UNITS; i++) {
+        state->textures[i] = UNKNOWN_BINDING;
+        state->texture_targets[i] = 0;
+    }
+    state->blend = UNKNOWN_BINDING;
+    state->blend_src = UNKNOWN_BINDING;
+    state->blend_dst = UNKNOWN_BINDING;
+    state->depth_test = UNKNOWN_BINDING;
+    state->depth_write = UNKNOWN_BINDING;
+    state->depth_func = UNKNOWN_BINDING;
+}
+
+static gl_state_t* get_gl_state(GLFWwindow* context) {
+    pthread_mutex_lock(&gl_state_lock);
+
+    for (uint32_t i = 0; i < gl_state_count; i++) {
+        if (gl_states[i]->context == context) {
+            pthread_mutex_unlock(&gl_state_lock);
+            return gl_states[i];
+        }
+    }
+
+    gl_state_t* state = calloc(1, sizeof(gl_state_t));
+    state->context = context;
+    reset_gl_state(state);
+
+    gl_states = realloc(gl_states, (gl_state_count + 1) * sizeof(gl_state_t*));
+    gl_states[gl_state_count++] = state;
+
+    pthread_mutex_unlock(&gl_state_lock);
+
+    TRACE("Tracking gl state of context %p.", context);
+
+    return state;
+}
+
+static int32_t buffer_target_index(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER: return BUFFER_ARRAY;
+        case GL_ELEMENT_ARRAY_BUFFER: return BUFFER_ELEMENT_ARRAY;
+        case GL_UNIFORM_BUFFER: return BUFFER_UNIFORM;
+        case GL_SHADER_STORAGE_BUFFER: return BUFFER_SHADER_STORAGE;
+        case GL_DRAW_INDIRECT_BUFFER: return BUFFER_DRAW_INDIRECT;
+        case GL_PIXEL_UNPACK_BUFFER: return BUFFER_PIXEL_UNPACK;
+        case GL_COPY_READ_BUFFER: return BUFFER_COPY_READ;
+        case GL_COPY_WRITE_BUFFER: return BUFFER_COPY_WRITE;
+        default: return -1;
+    }
+}
+
+// counts a call that had to be issued, returns 0 if the shadow already had the value
+static inline int update_shadow(uint32_t* shadow, uint32_t value) {
+    if (*shadow == value) {
+        current_state->stats.skipped++;
+        return 0;
+    }
+    *shadow = value;
+    current_state->stats.issued++;
+    return 1;
+}
+
+void make_context_current(GLFWwindow* context) {
+    if (current_state != NULL && current_state->context == context) {
+        current_state->stats.skipped_context_switches++;
+        return;
+    }
+
+    // contexts owned by a render thread have to be released by it first
+    if (context != NULL) {
+        borrow_render_context(context);
+    }
+
+    glfwMakeContextCurrent(context);
+
+    if (context == NULL) {
+        current_state = NULL;
+        return;
+    }
+
+    current_state = get_gl_state(context);
+    current_state->stats.context_switches++;
+}
+
+GLFWwindow* get_current_context() {
+    return current_state != NULL ? current_state->context : glfwGetCurrentContext();
+}
+
+void forget_context(GLFWwindow* context) {
+    pthread_mutex_lock(&gl_state_lock);
+
+    for (uint32_t i = 0; i < gl_state_count; i++) {
+        if (gl_states[i]->context == context) {
+            if (current_state == gl_states[i]) {
+                current_state = NULL;
+            }
+            release_stream_buffer(gl_states[i]->draw_stream);
+            free(gl_states[i]->indirect_arrays);
+            free(gl_states[i]);
+            gl_states[i] = gl_states[--gl_state_count];
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&gl_state_lock);
+
+    forget_stream_buffers(context);
+}
+
+void invalidate_gl_state() {
+    if (current_state != NULL) {
+        reset_gl_state(current_state);
+    }
+}
+
+void use_program(program_t program) {
+    if (current_state == NULL || update_shadow(&current_state->program, program)) {
+        glUseProgram(program);
+    }
+}
+
+void bind_vertex_array(uint32_t vertex_array) {
+    if (current_state == NULL) {
+        glBindVertexArray(vertex_array);
+        return;
+    }
+
+    if (update_shadow(&current_state->vertex_array, vertex_array)) {
+        glBindVertexArray(vertex_array);
+        // the element array binding is part of the vao
+        current_state->buffers[BUFFER_ELEMENT_ARRAY] = UNKNOWN_BINDING;
+    }
+}
+
+void bind_framebuffer(uint32_t framebuffer) {
+    if (current_state == NULL || update_shadow(&current_state->framebuffer, framebuffer)) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+}
+
+void bind_buffer(GLenum target, uint32_t buffer) {
+    int32_t idx = buffer_target_index(target);
+    if (current_state == NULL || idx < 0 || update_shadow(&current_state->buffers[idx], buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void bind_texture(uint32_t unit, GLenum target, uint32_t texture) {
+    if (current_state == NULL || unit >= MAX_TEXTURE_UNITS) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+
+        // the active unit changed behind the shadow's back, also the one of a context made current with glfw directly
+        GLFWwindow* context = glfwGetCurrentContext();
+        gl_state_t* state = current_state != NULL ? current_state : (context != NULL ? get_gl_state(context) : NULL);
+        if (state != NULL) {
+            state->active_texture = UNKNOWN_BINDING;
+            if (unit < MAX_TEXTURE_UNITS) {
+                state->textures[unit] = UNKNOWN_BINDING;
+            }
+        }
+        return;
+    }
+
+    if (current_state->textures[unit] == texture && current_state->texture_targets[unit] == target) {
+        current_state->stats.skipped++;
+        return;
+    }
+
+    if (update_shadow(&current_state->active_texture, unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    glBindTexture(target, texture);
+    current_state->textures[unit] = texture;
+    current_state->texture_targets[unit] = target;
+    current_state->stats.issued++;
+}
+
+void set_blend_state(int enabled, GLenum src, GLenum dst) {
+    if (current_state == NULL) {
+        enabled ? glEnable(GL_BLEND) : glDisable(GL_BLEND);
+        glBlendFunc(src, dst);
+        return;
+    }
+
+    if (update_shadow(&current_state->blend, enabled != 0)) {
+        enabled ? glEnable(GL_BLEND) : glDisable(GL_BLEND);
+    }
+
+    if (!enabled) {
+        return;
+    }
+
+    if (current_state->blend_src == src && current_state->blend_dst == dst) {
+        current_state->stats.skipped++;
+        return;
+    }
+
+    glBlendFunc(src, dst);
+    current_state->blend_src = src;
+    current_state->blend_dst = dst;
+    current_state->stats.issued++;
+}
+
+void set_depth_state(int test, int write, GLenum func) {
+    if (current_state == NULL) {
+        test ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+        glDepthFunc(func);
+        return;
+    }
+
+    if (update_shadow(&current_state->depth_test, test != 0)) {
+        test ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
+    }
+
+    if (update_shadow(&current_state->depth_write, write != 0)) {
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    if (test && update_shadow(&current_state->depth_func, func)) {
+        glDepthFunc(func);
+    }
+}
+
+gl_state_stats_t get_gl_state_stats() {
+    gl_state_stats_t total = {0};
+
+    pthread_mutex_lock(&gl_state_lock);
+    for (uint32_t i = 0; i < gl_state_count; i++) {
+        total.issued += gl_states[i]->stats.issued;
+        total.skipped += gl_states[i]->stats.skipped;
+        total.context_switches += gl_states[i]->stats.context_switches;
+        total.skipped_context_switches += gl_states[i]->stats.skipped_context_switches;
+    }
+    pthread_mutex_unlock(&gl_state_lock);
+
+    return total;
+}
+
+void reset_gl_state_stats() {
+    pthread_mutex_lock(&gl_state_lock);
+    for (uint32_t i = 0; i < gl_state_count; i++) {
+        memset(&gl_states[i]->stats, 0, sizeof(gl_state_stats_t));
+    }
+    pthread_mutex_unlock(&gl_state_lock);
+}
+
+typedef void (APIENTRYP buffer_storage_proc_t)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+static buffer_storage_proc_t gl_buffer_storage = NULL;
 
 void setup_gl_window() {
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
         ERROR("Failed to create opengl context.");
     }
     TRACE("Created opengl context.");
+
+    if (gl_buffer_storage == NULL && glfwExtensionSupported("GL_ARB_buffer_storage")) {
+        gl_buffer_storage = (buffer_storage_proc_t)glfwGetProcAddress("glBufferStorage");
+        TRACE("Loaded glBufferStorage.");
+    }
+}
+
+int has_buffer_storage() {
+    return gl_buffer_storage != NULL;
+}
+
+void buffer_storage(GLenum target, size_t size, const void* data, GLbitfield flags) {
+    if (gl_buffer_storage == NULL) {
+        FATAL("glBufferStorage is not supported by this driver.");
+    }
+    gl_buffer_storage(target, size, data, flags);
 }
 
 // NOTE: this won't be necessary after obj rendering is implemented
@@ -25,12 +544,16 @@ program_t create_program() {
 }
 
 void destroy_program(program_t program) {
+    remove_program_info(get_current_context(), program);
     glDeleteProgram(program);
+    if (current_state != NULL && current_state->program == program) {
+        current_state->program = UNKNOWN_BINDING;
+    }
     TRACE("Destroyed shader program.");
 }
 
-void add_shader(program_t program, const char* shader_source, shader_type_t shader_type) {
-    uint32_t shader = glCreateShader(shader_type);
+shader_t create_shader(const char* shader_source, shader_type_t shader_type) {
+    shader_t shader = glCreateShader(shader_type);
     glShaderSource(shader, 1, &shader_source, NULL);
     glCompileShader(shader);
 
@@ -44,20 +567,456 @@ void add_shader(program_t program, const char* shader_source, shader_type_t shad
 
     TRACE("Created shader.");
 
+    return shader;
+}
+
+void destroy_shader(shader_t shader) {
+    glDeleteShader(shader);
+    TRACE("Destroyed shader.");
+}
+
+void attach_shader(program_t program, shader_t shader) {
     glAttachShader(program, shader);
-    glLinkProgram(program); // TODO: figure out this works and its not a problem
-    
+}
+
+void add_shader(program_t program, const char* shader_source, shader_type_t shader_type) {
+    shader_t shader = create_shader(shader_source, shader_type);
+    glAttachShader(program, shader);
+
+    // only flags it, gl frees it once link_program detaches it
+    glDeleteShader(shader);
+}
+
+static int check_link_status(program_t program) {
+    int32_t success;
     glGetProgramiv(program, GL_LINK_STATUS, &success);
     if (!success) {
+        char info_log[512];
         glGetProgramInfoLog(program, 512, NULL, info_log);
         WARN("Shader linking failed: %s.", info_log);
+        return 0;
+    }
+
+    introspect_program(program);
+    return 1;
+}
+
+int link_program(program_t program) {
+    glLinkProgram(program);
+
+    // shaders aren't needed after linking, shared ones stay alive until destroy_shader
+    int32_t attached = 0;
+    shader_t shaders[16];
+    glGetAttachedShaders(program, 16, &attached, shaders);
+    for (int32_t i = 0; i < attached; i++) {
+        glDetachShader(program, shaders[i]);
+    }
+
+    int success = check_link_status(program);
+    TRACE("Linked program %d.", program);
+    return success;
+}
+
+static char* program_cache_dir = NULL;
+
+void set_program_cache_dir(const char* path) {
+    free(program_cache_dir);
+    program_cache_dir = NULL;
+
+    if (path == NULL) {
+        return;
+    }
+
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        WARN("Could not create program cache directory %s, program binaries won't be cached.", path);
+        return;
+    }
+
+    program_cache_dir = strdup(path);
+}
+
+#define PROGRAM_CACHE_MAGIC 0x4250564f // "OVPB"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t format;
+    uint32_t length;
+    uint32_t reserved;
+} program_cache_header_t;
+
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// binaries are only valid for the driver that produced them so it is part of the key
+static uint64_t hash_program_sources(const char** sources, const shader_type_t* types, uint32_t count) {
+    uint64_t hash = 14695981039346656037ull;
+
+    const GLenum driver_strings[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+    for (uint32_t i = 0; i < 3; i++) {
+        const char* str = (const char*)glGetString(driver_strings[i]);
+        if (str != NULL) {
+            hash = hash_bytes(hash, str, strlen(str));
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        hash = hash_bytes(hash, &types[i], sizeof(shader_type_t));
+        hash = hash_bytes(hash, sources[i], strlen(sources[i]));
+    }
+
+    return hash;
+}
+
+static int load_program_binary(program_t program, const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+
+    program_cache_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != PROGRAM_CACHE_MAGIC) {
+        fclose(file);
+        return 0;
+    }
+
+    // the header may be corrupt, the binary has to be exactly the rest of the file
+    long offset = ftell(file);
+    if (fseek(file, 0, SEEK_END) != 0 || ftell(file) - offset != (long)header.length || fseek(file, offset, SEEK_SET) != 0) {
+        WARN("Program binary %s is truncated or corrupt, compiling instead.", path);
+        fclose(file);
+        return 0;
+    }
+
+    void* binary = malloc(header.length);
+    if (binary == NULL) {
+        fclose(file);
+        return 0;
+    }
+    size_t read = fread(binary, 1, header.length, file);
+    fclose(file);
+
+    if (read != header.length) {
+        free(binary);
+        return 0;
+    }
+
+    glProgramBinary(program, header.format, binary, header.length);
+    free(binary);
+
+    int32_t success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success;
+}
+
+static void save_program_binary(program_t program, const char* path) {
+    int32_t length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    program_cache_header_t header = { .magic = PROGRAM_CACHE_MAGIC, .length = length };
+    void* binary = malloc(length);
+    glGetProgramBinary(program, length, NULL, &header.format, binary);
+
+    // write then rename so a crash never leaves a truncated binary behind
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE* file = fopen(tmp_path, "wb");
+    if (file == NULL) {
+        WARN("Could not write program binary %s.", tmp_path);
+        free(binary);
+        return;
+    }
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary, 1, length, file) == (size_t)length;
+    ok = fclose(file) == 0 && ok;
+    free(binary);
+
+    if (!ok || rename(tmp_path, path) != 0) {
+        WARN("Could not write program binary %s.", path);
+        remove(tmp_path);
+        return;
+    }
+
+    TRACE("Cached program binary %s.", path);
+}
+
+program_t create_program_cached(const char** sources, const shader_type_t* types, uint32_t count) {
+    program_t program = create_program();
+
+    int32_t formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+    char path[4096] = "";
+    if (program_cache_dir != NULL && formats > 0) {
+        uint64_t hash = hash_program_sources(sources, types, count);
+        snprintf(path, sizeof(path), "%s/%016llx.bin", program_cache_dir, (unsigned long long)hash);
+
+        if (load_program_binary(program, path)) {
+            introspect_program(program);
+            TRACE("Loaded program %d from cache %s.", program, path);
+            return program;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        add_shader(program, sources[i], types[i]);
+    }
+
+    if (path[0] != '\0') {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    if (link_program(program) && path[0] != '\0') {
+        save_program_binary(program, path);
+    }
+
+    return program;
+}
+
+uniform_t get_uniform(program_t program, const char* name) {
+    uniform_t uniform = { .program = program, .location = -1, .info = NULL };
+
+    program_info_t** slot = find_program_slot(get_current_context(), program);
+    if (slot == NULL || *slot == NULL) {
+        WARN("Program %d has not been linked on this context.", program);
+        return uniform;
+    }
+
+    int32_t idx = find_uniform(*slot, name, hash_string(name));
+    if (idx < 0) {
+        TRACE("Uniform %s does not exist in program %d.", name, program);
+        return uniform;
+    }
+
+    uniform.info = &(*slot)->uniforms[idx];
+    uniform.location = uniform.info->location;
+    return uniform;
+}
+
+// returns 1 if the value differs from the last upload and records it
+static int update_uniform_cache(uniform_t uniform, const void* value, size_t size) {
+    if (uniform.info == NULL) {
+        return 0;
+    }
+
+    if (uniform.info->has_value && memcmp(uniform.info->value, value, size) == 0) {
+        if (current_state != NULL) {
+            current_state->stats.skipped++;
+        }
+        return 0;
+    }
+
+    memcpy(uniform.info->value, value, size);
+    uniform.info->has_value = 1;
+    if (current_state != NULL) {
+        current_state->stats.issued++;
+    }
+    return 1;
+}
+
+void set_uniform_1f(uniform_t uniform, float x) {
+    float v[1] = {x};
+    if (update_uniform_cache(uniform, v, sizeof(v))) {
+        glProgramUniform1f(uniform.program, uniform.location, x);
+    }
+}
+
+void set_uniform_2f(uniform_t uniform, float x, float y) {
+    float v[2] = {x, y};
+    if (update_uniform_cache(uniform, v, sizeof(v))) {
+        glProgramUniform2f(uniform.program, uniform.location, x, y);
+    }
+}
+
+void set_uniform_3f(uniform_t uniform, float x, float y, float z) {
+    float v[3] = {x, y, z};
+    if (update_uniform_cache(uniform, v, sizeof(v))) {
+        glProgramUniform3f(uniform.program, uniform.location, x, y, z);
+    }
+}
+
+void set_uniform_4f(uniform_t uniform, float x, float y, float z, float w) {
+    float v[4] = {x, y, z, w};
+    if (update_uniform_cache(uniform, v, sizeof(v))) {
+        glProgramUniform4f(uniform.program, uniform.location, x, y, z, w);
+    }
+}
+
+void set_uniform_1i(uniform_t uniform, int32_t x) {
+    int32_t v[1] = {x};
+    if (update_uniform_cache(uniform, v, sizeof(v))) {
+        glProgramUniform1i(uniform.program, uniform.location, x);
+    }
+}
+
+void set_uniform_2i(uniform_t uniform, int32_t x, int32_t y) {
+    int32_t v[2] = {x, y};
+    if (update_uniform_cache(uniform, v, sizeof(v))) {
+        glProgramUniform2i(uniform.program, uniform.location, x, y);
+    }
+}
+
+void set_uniform_3i(uniform_t uniform, int32_t x, int32_t y, int32_t z) {
+    int32_t v[3] = {x, y, z};
+    if (update_uniform_cache(uniform, v, sizeof(v))) {
+        glProgramUniform3i(uniform.program, uniform.location, x, y, z);
+    }
+}
+
+void set_uniform_4i(uniform_t uniform, int32_t x, int32_t y, int32_t z, int32_t w) {
+    int32_t v[4] = {x, y, z, w};
+    if (update_uniform_cache(uniform, v, sizeof(v))) {
+        glProgramUniform4i(uniform.program, uniform.location, x, y, z, w);
+    }
+}
+
+void set_uniform_1ui(uniform_t uniform, uint32_t x) {
+    uint32_t v[1] = {x};
+    if (update_uniform_cache(uniform, v, sizeof(v))) {
+        glProgramUniform1ui(uniform.program, uniform.location, x);
     }
+}
+
+void set_uniform_2ui(uniform_t uniform, uint32_t x, uint32_t y) {
+    uint32_t v[2] = {x, y};
+    if (update_uniform_cache(uniform, v, sizeof(v))) {
+        glProgramUniform2ui(uniform.program, uniform.location, x, y);
+    }
+}
+
+void set_uniform_3ui(uniform_t uniform, uint32_t x, uint32_t y, uint32_t z) {
+    uint32_t v[3] = {x, y, z};
+    if (update_uniform_cache(uniform, v, sizeof(v))) {
+        glProgramUniform3ui(uniform.program, uniform.location, x, y, z);
+    }
+}
+
+void set_uniform_4ui(uniform_t uniform, uint32_t x, uint32_t y, uint32_t z, uint32_t w) {
+    uint32_t v[4] = {x, y, z, w};
+    if (update_uniform_cache(uniform, v, sizeof(v))) {
+        glProgramUniform4ui(uniform.program, uniform.location, x, y, z, w);
+    }
+}
+
+void set_uniform_1d(uniform_t uniform, double x) {
+    double v[1] = {x};
+    if (update_uniform_cache(uniform, v, sizeof(v))) {
+        glProgramUniform1d(uniform.program, uniform.location, x);
+    }
+}
+
+void set_uniform_2d(uniform_t uniform, double x, double y) {
+    double v[2] = {x, y};
+    if (update_uniform_cache(uniform, v, sizeof(v))) {
+        glProgramUniform2d(uniform.program, uniform.location, x, y);
+    }
+}
+
+void set_uniform_3d(uniform_t uniform, double x, double y, double z) {
+    double v[3] = {x, y, z};
+    if (update_uniform_cache(uniform, v, sizeof(v))) {
+        glProgramUniform3d(uniform.program, uniform.location, x, y, z);
+    }
+}
+
+void set_uniform_4d(uniform_t uniform, double x, double y, double z, double w) {
+    double v[4] = {x, y, z, w};
+    if (update_uniform_cache(uniform, v, sizeof(v))) {
+        glProgramUniform4d(uniform.program, uniform.location, x, y, z, w);
+    }
+}
+
+void set_uniform_vec2(uniform_t uniform, vec2_t v) {
+    set_uniform_2f(uniform, v.x, v.y);
+}
+
+void set_uniform_vec3(uniform_t uniform, vec3_t v) {
+    set_uniform_3f(uniform, v.x, v.y, v.z);
+}
+
+void set_uniform_vec4(uniform_t uniform, vec4_t v) {
+    set_uniform_4f(uniform, v.x, v.y, v.z, v.w);
+}
+
+void set_uniform_mat3(uniform_t uniform, const mat3_t* m) {
+    if (update_uniform_cache(uniform, m->m, sizeof(m->m))) {
+        glProgramUniformMatrix3fv(uniform.program, uniform.location, 1, GL_FALSE, m->m);
+    }
+}
+
+void set_uniform_mat4(uniform_t uniform, const mat4_t* m) {
+    if (update_uniform_cache(uniform, m->m, sizeof(m->m))) {
+        glProgramUniformMatrix4fv(uniform.program, uniform.location, 1, GL_FALSE, m->m);
+    }
+}
 
-    TRACE("Linked shader.");
-    
-    glDeleteShader(shader); // TODO: maybe have a seperate shader type so if a different program needs a shader then no need to recompile
+// uploads without the cache, whatever it held is stale afterwards
+static void forget_uniform_value(uniform_t uniform) {
+    if (uniform.info != NULL) {
+        uniform.info->has_value = 0;
+    }
+    if (current_state != NULL) {
+        current_state->stats.issued++;
+    }
 }
 
+#define UNIFORM_ARRAY_SETTER(type, value_t) \
+    void set_uniform_##type(uniform_t uniform, int32_t count, const value_t* value) { \
+        forget_uniform_value(uniform); \
+        glProgramUniform##type(uniform.program, uniform.location, count, value); \
+    }
+
+#define UNIFORM_MATRIX_SETTER(type, value_t) \
+    void set_uniform_##type(uniform_t uniform, int32_t count, GLboolean transpose, const value_t* value) { \
+        forget_uniform_value(uniform); \
+        glProgramUniform##type(uniform.program, uniform.location, count, transpose, value); \
+    }
+
+UNIFORM_ARRAY_SETTER(1fv, float)
+UNIFORM_ARRAY_SETTER(2fv, float)
+UNIFORM_ARRAY_SETTER(3fv, float)
+UNIFORM_ARRAY_SETTER(4fv, float)
+UNIFORM_ARRAY_SETTER(1iv, int32_t)
+UNIFORM_ARRAY_SETTER(2iv, int32_t)
+UNIFORM_ARRAY_SETTER(3iv, int32_t)
+UNIFORM_ARRAY_SETTER(4iv, int32_t)
+UNIFORM_ARRAY_SETTER(1uiv, uint32_t)
+UNIFORM_ARRAY_SETTER(2uiv, uint32_t)
+UNIFORM_ARRAY_SETTER(3uiv, uint32_t)
+UNIFORM_ARRAY_SETTER(4uiv, uint32_t)
+UNIFORM_ARRAY_SETTER(1dv, double)
+UNIFORM_ARRAY_SETTER(2dv, double)
+UNIFORM_ARRAY_SETTER(3dv, double)
+UNIFORM_ARRAY_SETTER(4dv, double)
+
+UNIFORM_MATRIX_SETTER(Matrix2fv, float)
+UNIFORM_MATRIX_SETTER(Matrix3fv, float)
+UNIFORM_MATRIX_SETTER(Matrix4fv, float)
+UNIFORM_MATRIX_SETTER(Matrix2x3fv, float)
+UNIFORM_MATRIX_SETTER(Matrix3x2fv, float)
+UNIFORM_MATRIX_SETTER(Matrix2x4fv, float)
+UNIFORM_MATRIX_SETTER(Matrix4x2fv, float)
+UNIFORM_MATRIX_SETTER(Matrix3x4fv, float)
+UNIFORM_MATRIX_SETTER(Matrix4x3fv, float)
+UNIFORM_MATRIX_SETTER(Matrix2dv, double)
+UNIFORM_MATRIX_SETTER(Matrix3dv, double)
+UNIFORM_MATRIX_SETTER(Matrix4dv, double)
+UNIFORM_MATRIX_SETTER(Matrix2x3dv, double)
+UNIFORM_MATRIX_SETTER(Matrix3x2dv, double)
+UNIFORM_MATRIX_SETTER(Matrix2x4dv, double)
+UNIFORM_MATRIX_SETTER(Matrix4x2dv, double)
+UNIFORM_MATRIX_SETTER(Matrix3x4dv, double)
+UNIFORM_MATRIX_SETTER(Matrix4x3dv, double)
+
 vertex_buffer_t create_vertex_buffer(size_t size, void* data) {
     vertex_buffer_t buffer;
 
@@ -67,9 +1026,9 @@ vertex_buffer_t create_vertex_buffer(size_t size, void* data) {
     glGenVertexArrays(1, &buffer.VAO);
     glGenBuffers(1, &buffer.VBO);
 
-    glBindVertexArray(buffer.VAO);
+    bind_vertex_array(buffer.VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, buffer.VBO);
+    bind_buffer(GL_ARRAY_BUFFER, buffer.VBO);
     glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
 
     TRACE("Created vertex buffer.");
@@ -84,22 +1043,474 @@ void destroy_vertex_buffer(vertex_buffer_t* vertex_buffer) {
     if (vertex_buffer->EBO != 0) {
         glDeleteBuffers(1, &vertex_buffer->EBO);
     }
+
+    // deleting bound objects resets their bindings to 0
+    if (current_state != NULL) {
+        if (current_state->vertex_array == vertex_buffer->VAO) {
+            current_state->vertex_array = 0;
+        }
+        if (current_state->buffers[BUFFER_ARRAY] == vertex_buffer->VBO) {
+            current_state->buffers[BUFFER_ARRAY] = 0;
+        }
+        current_state->buffers[BUFFER_ELEMENT_ARRAY] = UNKNOWN_BINDING;
+    }
     TRACE("Destroyed vertex buffer.");
 }
 
-void add_attrib(vertex_buffer_t* vertex_buffer, uint32_t size, GLenum type, size_t stride, size_t offset) {
-    glBindVertexArray(vertex_buffer->VAO);
-    glVertexAttribPointer(vertex_buffer->attrib_count, size, type, GL_FALSE, stride, (void*)offset);
+static void add_vertex_attrib(vertex_buffer_t* vertex_buffer, uint32_t size, GLenum type, GLboolean normalized, size_t stride, size_t offset) {
+    bind_vertex_array(vertex_buffer->VAO);
+    bind_buffer(GL_ARRAY_BUFFER, vertex_buffer->VBO);
+    glVertexAttribPointer(vertex_buffer->attrib_count, size, type, normalized, stride, (void*)offset);
     glEnableVertexAttribArray(vertex_buffer->attrib_count);
     vertex_buffer->attrib_count++;
 }
 
+void add_attrib(vertex_buffer_t* vertex_buffer, uint32_t size, GLenum type, size_t stride, size_t offset) {
+    add_vertex_attrib(vertex_buffer, size, type, GL_FALSE, stride, offset);
+}
+
+void add_normalized_attrib(vertex_buffer_t* vertex_buffer, uint32_t size, GLenum type, size_t stride, size_t offset) {
+    add_vertex_attrib(vertex_buffer, size, type, GL_TRUE, stride, offset);
+}
+
 void add_index_buffer(vertex_buffer_t* vertex_buffer, size_t size, void* data) {
-    glBindVertexArray(vertex_buffer->VAO);
+    bind_vertex_array(vertex_buffer->VAO);
     glGenBuffers(1, &vertex_buffer->EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vertex_buffer->EBO);
+    bind_buffer(GL_ELEMENT_ARRAY_BUFFER, vertex_buffer->EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
 }
 
+uint32_t get_mip_count(uint32_t width, uint32_t height) {
+    uint32_t size = width > height ? width : height;
+    uint32_t levels = 1;
+    while (size > 1) {
+        size >>= 1;
+        levels++;
+    }
+    return levels;
+}
+
+texture_t create_texture(uint32_t width, uint32_t height, uint32_t levels, GLenum internal_format) {
+    texture_t texture = {
+        .format = internal_format,
+        .width = width,
+        .height = height,
+        .levels = levels ? levels : 1,
+    };
+
+    glGenTextures(1, &texture.id);
+    bind_texture(0, GL_TEXTURE_2D, texture.id);
+    glTexStorage2D(GL_TEXTURE_2D, texture.levels, internal_format, width, height);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texture.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    TRACE("Created %dx%d texture with %d levels.", width, height, texture.levels);
+
+    return texture;
+}
+
+void destroy_texture(texture_t* texture) {
+    glDeleteTextures(1, &texture->id);
+
+    // deleting a bound texture resets its bindings to 0
+    if (current_state != NULL) {
+        for (uint32_t i = 0; i < MAX_TEXTURE_UNITS; i++) {
+            if (current_state->textures[i] == texture->id) {
+                current_state->textures[i] = 0;
+            }
+        }
+    }
+
+    texture->id = 0;
+    TRACE("Destroyed texture.");
+}
+
+void upload_texture_rows(const texture_t* texture, uint32_t level, uint32_t y, uint32_t rows, GLenum format, GLenum type,
+                         const void* data) {
+    uint32_t width = texture->width >> level ? texture->width >> level : 1;
+
+    bind_texture(0, GL_TEXTURE_2D, texture->id);
+    // rows of single channel levels aren't 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, rows, format, type, data);
+}
+
+void upload_compressed_texture_level(const texture_t* texture, uint32_t level, const void* data, size_t size) {
+    uint32_t width = texture->width >> level ? texture->width >> level : 1;
+    uint32_t height = texture->height >> level ? texture->height >> level : 1;
+
+    bind_texture(0, GL_TEXTURE_2D, texture->id);
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, texture->format, size, data);
+}
+
+void set_texture_level_range(const texture_t* texture, uint32_t base, uint32_t max) {
+    bind_texture(0, GL_TEXTURE_2D, texture->id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, base);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, max);
+}
+
+static size_t index_size(GLenum index_type) {
+    switch (index_type) {
+        case GL_UNSIGNED_BYTE: return 1;
+        case GL_UNSIGNED_SHORT: return 2;
+        default: return 4;
+    }
+}
+
+typedef struct {
+    mat4_t model;
+    vec4_t color;
+} instance_data_t;
+
+static int is_instanced_program(program_t program) {
+    program_info_t** slot = find_program_slot(get_current_context(), program);
+    return slot != NULL && *slot != NULL && (*slot)->instanced;
+}
+
+static int same_draw(const draw_packet_t* a, const draw_packet_t* b) {
+    return a->program == b->program && a->vertex_array == b->vertex_array && a->mode == b->mode &&
+           a->index_type == b->index_type && a->first == b->first && a->count == b->count &&
+           a->base_vertex == b->base_vertex;
+}
+
+// the id buffer is only ever respecified under the same name so vertex arrays pointing at it stay valid
+static void reserve_instance_ids(uint32_t count) {
+    if (current_state->instance_id_buffer != 0 && count <= current_state->instance_id_count) {
+        return;
+    }
+
+    uint32_t capacity = current_state->instance_id_count ? current_state->instance_id_count : 1024;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    uint32_t* ids = malloc(capacity * sizeof(uint32_t));
+    for (uint32_t i = 0; i < capacity; i++) {
+        ids[i] = i;
+    }
+
+    if (current_state->instance_id_buffer == 0) {
+        glGenBuffers(1, &current_state->instance_id_buffer);
+    }
+    bind_buffer(GL_ARRAY_BUFFER, current_state->instance_id_buffer);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(uint32_t), ids, GL_STATIC_DRAW);
+    current_state->instance_id_count = capacity;
+
+    free(ids);
+}
+
+void enable_indirect_draws(uint32_t vertex_array) {
+    if (current_state == NULL) {
+        ERROR("No current context to enable indirect draws on.");
+        return;
+    }
+
+    reserve_instance_ids(0);
+
+    bind_vertex_array(vertex_array);
+    bind_buffer(GL_ARRAY_BUFFER, current_state->instance_id_buffer);
+    glVertexAttribIPointer(RENDER_INSTANCE_ID_ATTRIB, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+    glVertexAttribDivisor(RENDER_INSTANCE_ID_ATTRIB, 1);
+    glEnableVertexAttribArray(RENDER_INSTANCE_ID_ATTRIB);
+
+    current_state->indirect_arrays = realloc(current_state->indirect_arrays, (current_state->indirect_array_count + 1) * sizeof(uint32_t));
+    current_state->indirect_arrays[current_state->indirect_array_count++] = vertex_array;
+}
+
+void disable_indirect_draws(uint32_t vertex_array) {
+    if (current_state == NULL) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < current_state->indirect_array_count; i++) {
+        if (current_state->indirect_arrays[i] == vertex_array) {
+            current_state->indirect_arrays[i] = current_state->indirect_arrays[--current_state->indirect_array_count];
+            return;
+        }
+    }
+}
+
+static int is_indirect_array(uint32_t vertex_array) {
+    for (uint32_t i = 0; i < current_state->indirect_array_count; i++) {
+        if (current_state->indirect_arrays[i] == vertex_array) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// layout expected by glMultiDrawElementsIndirect
+typedef struct {
+    uint32_t count;
+    uint32_t instance_count;
+    uint32_t first_index;
+    int32_t base_vertex;
+    uint32_t base_instance;
+} draw_command_t;
+
+static _Atomic int32_t storage_alignment = 0;
+
+// makes sure this frame's instances and commands fit into the draw stream, it is only ever
+// bound per draw so it can be replaced between frames
+static void reserve_draw_stream(size_t size) {
+    // render threads may get here together, they all read the same value
+    if (storage_alignment == 0) {
+        GLint alignment = 0;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        storage_alignment = alignment;
+    }
+
+    // the context may already have drawn from the region this frame
+    size += 2 * storage_alignment;
+    size_t head = current_state->draw_stream ? atomic_load(&current_state->draw_stream->head) : 0;
+    if (current_state->draw_stream != NULL && head + size <= current_state->draw_stream->size) {
+        return;
+    }
+
+    size_t stream_size = current_state->draw_stream ? current_state->draw_stream->size : 64 * 1024;
+    while (stream_size < head + size) {
+        stream_size *= 2;
+    }
+
+    if (current_state->draw_stream != NULL) {
+        destroy_stream_buffer(current_state->draw_stream);
+    }
+    current_state->draw_stream = create_stream_buffer(stream_size);
+}
+
+// packets all belong to the current context
+static uint32_t execute_context_packets(const draw_packet_t* packets, const uint32_t* order, uint32_t count) {
+    program_t program = UNKNOWN_BINDING;
+    int instanced = 0;
+    uint32_t instances = 0;
+    uint32_t indirect = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const draw_packet_t* packet = &packets[order[i]];
+        if (packet->program != program) {
+            program = packet->program;
+            instanced = is_instanced_program(program);
+        }
+        if (instanced) {
+            instances++;
+            indirect += packet->index_type != 0 && is_indirect_array(packet->vertex_array);
+        }
+    }
+
+    if (instances > 0) {
+        reserve_draw_stream(instances * sizeof(instance_data_t) + indirect * sizeof(draw_command_t));
+        if (indirect > 0) {
+            reserve_instance_ids(instances);
+        }
+
+        // written straight into the stream in draw order, which is also the instance order
+        stream_alloc_t alloc = stream_buffer_alloc(current_state->draw_stream, instances * sizeof(instance_data_t), storage_alignment);
+        if (alloc.data == NULL) {
+            return 0;
+        }
+        instance_data_t* instance = alloc.data;
+
+        program = UNKNOWN_BINDING;
+        for (uint32_t i = 0; i < count; i++) {
+            const draw_packet_t* packet = &packets[order[i]];
+            if (packet->program != program) {
+                program = packet->program;
+                instanced = is_instanced_program(program);
+            }
+            if (instanced) {
+                instance->model = packet->model;
+                instance->color = packet->color;
+                instance++;
+            }
+        }
+
+        stream_buffer_flush(current_state->draw_stream);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, RENDER_INSTANCE_BINDING, alloc.buffer, alloc.offset, instances * sizeof(instance_data_t));
+        current_state->buffers[BUFFER_SHADER_STORAGE] = alloc.buffer;
+    }
+
+    uniform_t model_uniform = {0};
+    uniform_t color_uniform = {0};
+    uniform_t base_uniform = {0};
+    uint32_t base = 0;
+    uint32_t draws = 0;
+    stream_alloc_t commands = {0};
+    uint32_t command_count = 0;
+    program = UNKNOWN_BINDING;
+
+    for (uint32_t i = 0; i < count; draws++) {
+        const draw_packet_t* packet = &packets[order[i]];
+
+        // sorted by program so this lookup only happens once per program
+        if (packet->program != program) {
+            use_program(packet->program);
+            program = packet->program;
+            instanced = is_instanced_program(program);
+            model_uniform = get_uniform(program, RENDER_MODEL_UNIFORM);
+            color_uniform = get_uniform(program, RENDER_COLOR_UNIFORM);
+            base_uniform = get_uniform(program, RENDER_INSTANCE_BASE_UNIFORM);
+        }
+
+        bind_vertex_array(packet->vertex_array);
+        void* indices = (void*)(uintptr_t)(packet->first * index_size(packet->index_type));
+
+        if (!instanced) {
+            set_uniform_mat4(model_uniform, &packet->model);
+            set_uniform_vec4(color_uniform, packet->color);
+
+            if (packet->index_type != 0) {
+                glDrawElementsBaseVertex(packet->mode, packet->count, packet->index_type, indices, packet->base_vertex);
+            } else {
+                glDrawArrays(packet->mode, packet->first, packet->count);
+            }
+            i++;
+            continue;
+        }
+
+        if (packet->index_type != 0 && is_indirect_array(packet->vertex_array)) {
+            if (commands.data == NULL) {
+                commands = stream_buffer_alloc(current_state->draw_stream, indirect * sizeof(draw_command_t), sizeof(uint32_t));
+                if (commands.data == NULL) {
+                    return draws;
+                }
+                bind_buffer(GL_DRAW_INDIRECT_BUFFER, commands.buffer);
+            }
+
+            // one command per run of the same range, one call for everything sharing program and vertex array
+            uint32_t first_command = command_count;
+            while (i < count) {
+                const draw_packet_t* next = &packets[order[i]];
+                if (next->program != packet->program || next->vertex_array != packet->vertex_array ||
+                    next->mode != packet->mode || next->index_type != packet->index_type) {
+                    break;
+                }
+
+                uint32_t run = 1;
+                while (i + run < count && same_draw(next, &packets[order[i + run]])) {
+                    run++;
+                }
+
+                ((draw_command_t*)commands.data)[command_count++] = (draw_command_t){
+                    .count = next->count,
+                    .instance_count = run,
+                    .first_index = next->first,
+                    .base_vertex = next->base_vertex,
+                    .base_instance = base,
+                };
+
+                base += run;
+                i += run;
+            }
+
+            stream_buffer_flush(current_state->draw_stream);
+            bind_buffer(GL_DRAW_INDIRECT_BUFFER, commands.buffer);
+
+            size_t offset = commands.offset + first_command * sizeof(draw_command_t);
+            glMultiDrawElementsIndirect(packet->mode, packet->index_type, (void*)offset, command_count - first_command, 0);
+            continue;
+        }
+
+        // same mesh and program end up next to each other after sorting, draw the whole run at once
+        uint32_t run = 1;
+        while (i + run < count && same_draw(packet, &packets[order[i + run]])) {
+            run++;
+        }
+
+        set_uniform_1ui(base_uniform, base);
+
+        if (packet->index_type != 0) {
+            glDrawElementsInstancedBaseVertex(packet->mode, packet->count, packet->index_type, indices, run, packet->base_vertex);
+        } else {
+            glDrawArraysInstanced(packet->mode, packet->first, packet->count, run);
+        }
+
+        base += run;
+        i += run;
+    }
+
+    return draws;
+}
+
+// contexts drawn on render threads in one frame, more fall back to drawing on this thread
+#define MAX_RENDER_JOBS 64
+
+typedef struct {
+    const draw_packet_t* packets;
+    const uint32_t* order;
+    uint32_t count;
+    uint32_t draws;
+    render_thread_t* thread;
+} context_job_t;
+
+static void execute_context_job(void* data) {
+    context_job_t* job = data;
+    job->draws = execute_context_packets(job->packets, job->order, job->count);
+}
+
+uint32_t execute_draw_packets(const draw_packet_t* packets, const uint32_t* order, uint32_t count) {
+    context_job_t jobs[MAX_RENDER_JOBS];
+    uint32_t job_count = 0;
+    uint32_t draws = 0;
+    uint32_t start = 0;
+
+    // sorted by context first, every context is one contiguous range
+    while (start < count) {
+        GLFWwindow* context = packets[order[start]].context;
+        uint32_t end = start + 1;
+        while (end < count && packets[order[end]].context == context) {
+            end++;
+        }
+
+        // contexts with a render thread draw on it, in parallel with the others
+        render_thread_t* thread = get_render_thread(context);
+        if (thread != NULL && job_count < MAX_RENDER_JOBS) {
+            jobs[job_count] = (context_job_t){ packets, order + start, end - start, 0, thread };
+            post_render_command(thread, execute_context_job, &jobs[job_count++]);
+        } else {
+            make_context_current(context);
+            draws += execute_context_packets(packets, order + start, end - start);
+        }
+        start = end;
+    }
+
+    for (uint32_t i = 0; i < job_count; i++) {
+        wait_render_thread(jobs[i].thread);
+        draws += jobs[i].draws;
+    }
+
+    return draws;
+}
+
 void cleanup_opengl() {
+    gl_state_stats_t stats = get_gl_state_stats();
+    INFO("GL state cache: %lu calls issued, %lu skipped, %lu context switches, %lu skipped.",
+         stats.issued, stats.skipped, stats.context_switches, stats.skipped_context_switches);
+
+    for (uint32_t i = 0; i < gl_state_count; i++) {
+        release_stream_buffer(gl_states[i]->draw_stream);
+        free(gl_states[i]->indirect_arrays);
+        free(gl_states[i]);
+    }
+    free(gl_states);
+    gl_states = NULL;
+    gl_state_count = 0;
+    current_state = NULL;
+
+    for (uint32_t i = 0; i < program_table_size; i++) {
+        if (program_table[i] != NULL) {
+            free_program_info(program_table[i]);
+        }
+    }
+    free(program_table);
+    program_table = NULL;
+    program_table_size = 0;
+    program_count = 0;
+
+    free(program_cache_dir);
+    program_cache_dir = NULL;
+
+    storage_alignment = 0;
 }
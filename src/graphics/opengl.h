@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include "overture/math.h"
 
 
 void cleanup_opengl();
@@ -14,6 +15,52 @@ void begin_gl_window_render();
 
 void resize_gl_viewport(uint32_t width, uint32_t height);
 
+/*
+ * State cache, every context gets a shadow copy of the bindings and fixed function state set
+ * through these functions so redundant gl calls and context switches are skipped. Everything
+ * that binds state should go through here, call invalidate_gl_state() after raw gl calls that
+ * change bindings behind its back.
+ */
+typedef struct {
+    uint64_t issued;
+    uint64_t skipped;
+    uint64_t context_switches;
+    uint64_t skipped_context_switches;
+} gl_state_stats_t;
+
+void make_context_current(GLFWwindow* context);
+GLFWwindow* get_current_context();
+// drops the shadow state, call before destroying the context
+void forget_context(GLFWwindow* context);
+void invalidate_gl_state();
+
+void use_program(uint32_t program);
+void bind_vertex_array(uint32_t vertex_array);
+// binds both the draw and read framebuffer
+void bind_framebuffer(uint32_t framebuffer);
+void bind_buffer(GLenum target, uint32_t buffer);
+void bind_texture(uint32_t unit, GLenum target, uint32_t texture);
+void set_blend_state(int enabled, GLenum src, GLenum dst);
+void set_depth_state(int test, int write, GLenum func);
+
+/*
+ * The context is gl 4.3 so glBufferStorage (4.4) is loaded at runtime when the driver has it,
+ * callers that want persistently mapped buffers have to fall back to plain uploads without it.
+ */
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+int has_buffer_storage();
+void buffer_storage(GLenum target, size_t size, const void* data, GLbitfield flags);
+
+// summed over all contexts, includes uniform uploads
+gl_state_stats_t get_gl_state_stats();
+void reset_gl_state_stats();
+
 typedef uint32_t program_t;
 
 typedef enum {
@@ -21,14 +68,112 @@ typedef enum {
     FRAGMENT_SHADER = GL_FRAGMENT_SHADER,
 } shader_type_t;
 
+typedef uint32_t shader_t;
+
 program_t create_program();
 void destroy_program(program_t program);
+
+// shaders are compiled once and can be attached to any number of programs on the same context
+shader_t create_shader(const char* shader_source, shader_type_t shader_type);
+void destroy_shader(shader_t shader);
+void attach_shader(program_t program, shader_t shader);
+// compiles and attaches a shader only this program uses, it is freed after link_program
 void add_shader(program_t program, const char* shader_source, shader_type_t shader_type);
+// links once all shaders are attached and detaches them, returns 0 on failure
+int link_program(program_t program);
+
+/*
+ * Program binary cache, programs made with create_program_cached() are stored in the cache dir
+ * keyed by a hash of their sources and the driver, so later runs skip compiling and linking.
+ * Caching is off until a directory is set, pass NULL to turn it off again.
+ */
+void set_program_cache_dir(const char* path);
+// returns a linked program
+program_t create_program_cached(const char** sources, const shader_type_t* types, uint32_t count);
+
+/*
+ * Active uniforms are introspected once after a program is linked, get_uniform() is a hash lookup
+ * into that table and the setters keep the last uploaded value so unchanged values are not sent
+ * to the driver again. Setters use glProgramUniform* so the program does not need to be bound.
+ *
+ * A uniform_t is invalidated when its program is relinked or destroyed.
+ */
+typedef struct uniform_info_t uniform_info_t;
+
+typedef struct {
+    program_t program;
+    int32_t location;
+    uniform_info_t* info;
+} uniform_t;
+
+// looks up the uniform in the program linked on the current context, missing uniforms are ignored by the setters
+uniform_t get_uniform(program_t program, const char* name);
+#define UNIFORM_EXISTS(uniform) ((uniform).info != NULL)
+
+void set_uniform_1f(uniform_t uniform, float x);
+void set_uniform_2f(uniform_t uniform, float x, float y);
+void set_uniform_3f(uniform_t uniform, float x, float y, float z);
+void set_uniform_4f(uniform_t uniform, float x, float y, float z, float w);
+void set_uniform_1i(uniform_t uniform, int32_t x);
+void set_uniform_2i(uniform_t uniform, int32_t x, int32_t y);
+void set_uniform_3i(uniform_t uniform, int32_t x, int32_t y, int32_t z);
+void set_uniform_4i(uniform_t uniform, int32_t x, int32_t y, int32_t z, int32_t w);
+void set_uniform_1ui(uniform_t uniform, uint32_t x);
+void set_uniform_2ui(uniform_t uniform, uint32_t x, uint32_t y);
+void set_uniform_3ui(uniform_t uniform, uint32_t x, uint32_t y, uint32_t z);
+void set_uniform_4ui(uniform_t uniform, uint32_t x, uint32_t y, uint32_t z, uint32_t w);
+void set_uniform_1d(uniform_t uniform, double x);
+void set_uniform_2d(uniform_t uniform, double x, double y);
+void set_uniform_3d(uniform_t uniform, double x, double y, double z);
+void set_uniform_4d(uniform_t uniform, double x, double y, double z, double w);
+void set_uniform_vec2(uniform_t uniform, vec2_t v);
+void set_uniform_vec3(uniform_t uniform, vec3_t v);
+void set_uniform_vec4(uniform_t uniform, vec4_t v);
+void set_uniform_mat3(uniform_t uniform, const mat3_t* m);
+void set_uniform_mat4(uniform_t uniform, const mat4_t* m);
+
+// arrays and raw matrices, same arguments as glUniform* after the location. These aren't
+// cached, they always upload and make the next cached set of the uniform upload too
+void set_uniform_1fv(uniform_t uniform, int32_t count, const float* value);
+void set_uniform_2fv(uniform_t uniform, int32_t count, const float* value);
+void set_uniform_3fv(uniform_t uniform, int32_t count, const float* value);
+void set_uniform_4fv(uniform_t uniform, int32_t count, const float* value);
+void set_uniform_1iv(uniform_t uniform, int32_t count, const int32_t* value);
+void set_uniform_2iv(uniform_t uniform, int32_t count, const int32_t* value);
+void set_uniform_3iv(uniform_t uniform, int32_t count, const int32_t* value);
+void set_uniform_4iv(uniform_t uniform, int32_t count, const int32_t* value);
+void set_uniform_1uiv(uniform_t uniform, int32_t count, const uint32_t* value);
+void set_uniform_2uiv(uniform_t uniform, int32_t count, const uint32_t* value);
+void set_uniform_3uiv(uniform_t uniform, int32_t count, const uint32_t* value);
+void set_uniform_4uiv(uniform_t uniform, int32_t count, const uint32_t* value);
+void set_uniform_1dv(uniform_t uniform, int32_t count, const double* value);
+void set_uniform_2dv(uniform_t uniform, int32_t count, const double* value);
+void set_uniform_3dv(uniform_t uniform, int32_t count, const double* value);
+void set_uniform_4dv(uniform_t uniform, int32_t count, const double* value);
+void set_uniform_Matrix2fv(uniform_t uniform, int32_t count, GLboolean transpose, const float* value);
+void set_uniform_Matrix3fv(uniform_t uniform, int32_t count, GLboolean transpose, const float* value);
+void set_uniform_Matrix4fv(uniform_t uniform, int32_t count, GLboolean transpose, const float* value);
+void set_uniform_Matrix2x3fv(uniform_t uniform, int32_t count, GLboolean transpose, const float* value);
+void set_uniform_Matrix3x2fv(uniform_t uniform, int32_t count, GLboolean transpose, const float* value);
+void set_uniform_Matrix2x4fv(uniform_t uniform, int32_t count, GLboolean transpose, const float* value);
+void set_uniform_Matrix4x2fv(uniform_t uniform, int32_t count, GLboolean transpose, const float* value);
+void set_uniform_Matrix3x4fv(uniform_t uniform, int32_t count, GLboolean transpose, const float* value);
+void set_uniform_Matrix4x3fv(uniform_t uniform, int32_t count, GLboolean transpose, const float* value);
+void set_uniform_Matrix2dv(uniform_t uniform, int32_t count, GLboolean transpose, const double* value);
+void set_uniform_Matrix3dv(uniform_t uniform, int32_t count, GLboolean transpose, const double* value);
+void set_uniform_Matrix4dv(uniform_t uniform, int32_t count, GLboolean transpose, const double* value);
+void set_uniform_Matrix2x3dv(uniform_t uniform, int32_t count, GLboolean transpose, const double* value);
+void set_uniform_Matrix3x2dv(uniform_t uniform, int32_t count, GLboolean transpose, const double* value);
+void set_uniform_Matrix2x4dv(uniform_t uniform, int32_t count, GLboolean transpose, const double* value);
+void set_uniform_Matrix4x2dv(uniform_t uniform, int32_t count, GLboolean transpose, const double* value);
+void set_uniform_Matrix3x4dv(uniform_t uniform, int32_t count, GLboolean transpose, const double* value);
+void set_uniform_Matrix4x3dv(uniform_t uniform, int32_t count, GLboolean transpose, const double* value);
 
 // NOTE: idk if ill keep this tho it does save a bit of work tho its hard to document
-// TODO: maybe add a way to check if uniform exists and only set it if it does
+// still hashes the name every call, keep the uniform_t around in hot paths. Takes every glUniform
+// type suffix, 1f to 4f, 1ui, 3fv, Matrix4fv, ...
 #define SET_UNIFORM(type, program, name, ...) \
-    glUniform ## type(glGetUniformLocation(program, name), __VA_ARGS__);
+    set_uniform_ ## type(get_uniform(program, name), __VA_ARGS__);
 
 typedef struct {
     uint32_t VAO;
@@ -37,9 +182,100 @@ typedef struct {
     uint32_t attrib_count;
 } vertex_buffer_t;
 
+typedef enum {
+    RENDER_PASS_DEPTH,
+    RENDER_PASS_OPAQUE,
+    RENDER_PASS_TRANSPARENT, // drawn back to front
+    RENDER_PASS_OVERLAY,
+    NUM_OF_RENDER_PASSES
+} render_pass_t;
+
+#define RENDER_MODEL_UNIFORM "model"
+#define RENDER_COLOR_UNIFORM "color"
+
+/*
+ * Programs that declare the RENDER_INSTANCE_BLOCK storage block are drawn instanced. Sorted
+ * packets with the same program, vertex array and draw range are merged into one instanced
+ * draw, their model and color go into a per context storage buffer and the shader reads its
+ * instance with
+ *
+ *   struct instance_t { mat4 model; vec4 color; };
+ *   layout(std430) readonly buffer instance_data { instance_t instances[]; };
+ *   uniform uint instance_base;
+ *   ... instances[instance_base + gl_InstanceID]
+ *
+ * Other programs get one draw per packet with model and color in the RENDER_MODEL_UNIFORM
+ * and RENDER_COLOR_UNIFORM uniforms when the program has them.
+ *
+ * Indexed instanced packets on a vertex array passed to enable_indirect_draws() are instead
+ * written as commands into a persistently mapped buffer and drawn with one
+ * glMultiDrawElementsIndirect per program and vertex array. A uniform can't change between
+ * those draws, so the shader gets its instance from an attribute
+ *
+ *   layout(location = RENDER_INSTANCE_ID_ATTRIB) in uint instance_id;
+ *   ... instances[instance_id]
+ */
+#define RENDER_INSTANCE_BLOCK "instance_data"
+#define RENDER_INSTANCE_BASE_UNIFORM "instance_base"
+#define RENDER_INSTANCE_BINDING 0
+#define RENDER_INSTANCE_ID_ATTRIB 15
+
+// sets up the instance id attribute on a vertex array of the current context
+void enable_indirect_draws(uint32_t vertex_array);
+void disable_indirect_draws(uint32_t vertex_array);
+
+// one draw call plus the per object data it needs
+typedef struct {
+    mat4_t model;
+    vec4_t color;
+    GLFWwindow* context;
+    program_t program;
+    uint32_t vertex_array;
+    GLenum mode;
+    GLenum index_type; // 0 uses glDrawArrays
+    uint32_t first; // first vertex or index
+    uint32_t count;
+    int32_t base_vertex; // added to every index
+    render_pass_t pass;
+    uint32_t material; // packets with the same material are kept together
+    float depth; // 0 near to 1 far
+} draw_packet_t;
+
+// issues the packets in the given order and returns the number of draw calls, called by the render queue
+uint32_t execute_draw_packets(const draw_packet_t* packets, const uint32_t* order, uint32_t count);
+
 vertex_buffer_t create_vertex_buffer(size_t size, void* data);
 void destroy_vertex_buffer(vertex_buffer_t* vertex_buffer);
 void add_attrib(vertex_buffer_t* vertex_buffer, uint32_t size, GLenum type, size_t stride, size_t offset);
+// integer data read as 0 to 1 (unsigned) or -1 to 1 (signed) floats
+void add_normalized_attrib(vertex_buffer_t* vertex_buffer, uint32_t size, GLenum type, size_t stride, size_t offset);
 void add_index_buffer(vertex_buffer_t* vertex_buffer, size_t size, void* data);
 
+/*
+ * 2d textures with immutable storage, every level is allocated by create_texture() and filled
+ * with upload_texture_rows(), which takes a band of rows so large levels can be uploaded over
+ * several frames. While a buffer is bound to GL_PIXEL_UNPACK_BUFFER data is an offset into it.
+ * Rows are tightly packed and the first row is y = 0.
+ */
+typedef struct {
+    uint32_t id;
+    GLenum format; // internal format
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+} texture_t;
+
+// levels of a full mip chain down to 1x1
+uint32_t get_mip_count(uint32_t width, uint32_t height);
+
+// trilinear filtering and repeat wrapping when there are mips, otherwise linear
+texture_t create_texture(uint32_t width, uint32_t height, uint32_t levels, GLenum internal_format);
+void destroy_texture(texture_t* texture);
+void upload_texture_rows(const texture_t* texture, uint32_t level, uint32_t y, uint32_t rows, GLenum format, GLenum type,
+                         const void* data);
+// a whole level of a texture created with a compressed internal format, size in bytes
+void upload_compressed_texture_level(const texture_t* texture, uint32_t level, const void* data, size_t size);
+// limits sampling to the levels that have been uploaded
+void set_texture_level_range(const texture_t* texture, uint32_t base, uint32_t max);
+
 #endif
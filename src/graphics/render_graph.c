@@ -0,0 +1,921 @@
+#include "graphics/render_graph.h"
+#include "core/log.h"
+#include "graphics/render_thread.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define GRAPH_NAME_SIZE 32
+
+// every barrier bit a read can need after an image or storage write
+#define GRAPH_DIRTY_BITS (GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | \
+                          GL_SHADER_STORAGE_BARRIER_BIT | GL_UNIFORM_BARRIER_BIT |            \
+                          GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT | \
+                          GL_COMMAND_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT)
+
+typedef enum {
+    GRAPH_TEXTURE,
+    GRAPH_BUFFER,
+} graph_resource_type_t;
+
+typedef struct {
+    char name[GRAPH_NAME_SIZE];
+    graph_resource_type_t type;
+    uint32_t width; // 0 follows the graph size
+    uint32_t height;
+    GLenum format;
+    size_t size;
+
+    int imported;
+    int backbuffer;
+    int output;
+    uint32_t external; // gl name of imported resources
+
+    // compiled
+    uint32_t first_use;
+    uint32_t last_use;
+    uint32_t physical;
+    GLbitfield dirty;
+} graph_resource_t;
+
+typedef struct {
+    uint32_t resource;
+    graph_access_t access;
+} graph_use_t;
+
+typedef struct {
+    char name[GRAPH_NAME_SIZE];
+    graph_pass_fn_t execute;
+    void* user;
+    uint32_t flags;
+
+    graph_use_t* uses;
+    uint32_t use_count;
+
+    // compiled
+    int culled;
+    GLbitfield barriers;
+    uint32_t framebuffer;
+} graph_pass_t;
+
+typedef struct {
+    graph_resource_type_t type;
+    uint32_t width;
+    uint32_t height;
+    GLenum format;
+    size_t size;
+    uint32_t last_use;
+    int imported; // never created, deleted or shared
+    uint32_t name; // gl name once realized
+} graph_physical_t;
+
+typedef struct {
+    uint32_t colors[GRAPH_MAX_COLOR_ATTACHMENTS]; // physical indices
+    uint32_t color_count;
+    uint32_t depth;
+    int backbuffer;
+    uint32_t width;
+    uint32_t height;
+    uint32_t name;
+} graph_framebuffer_t;
+
+struct render_graph_t {
+    GLFWwindow* context;
+    uint32_t width;
+    uint32_t height;
+
+    graph_pass_t* passes;
+    uint32_t pass_count;
+    graph_resource_t* resources;
+    uint32_t resource_count;
+
+    // compiled
+    int compiled;
+    int realized;
+    uint32_t* order;
+    uint32_t order_count;
+    graph_physical_t* physical;
+    uint32_t physical_count;
+    graph_framebuffer_t* framebuffers;
+    uint32_t framebuffer_count;
+    render_graph_stats_t stats;
+};
+
+render_graph_t* create_render_graph(GLFWwindow* context) {
+    render_graph_t* graph = calloc(1, sizeof(render_graph_t));
+    graph->context = context;
+    graph->width = 1;
+    graph->height = 1;
+    return graph;
+}
+
+// gl objects, compiled state stays
+static void release_gl_objects(render_graph_t* graph) {
+    if (!graph->realized) {
+        return;
+    }
+
+    make_context_current(graph->context);
+
+    for (uint32_t i = 0; i < graph->framebuffer_count; i++) {
+        if (graph->framebuffers[i].name != 0) {
+            glDeleteFramebuffers(1, &graph->framebuffers[i].name);
+            graph->framebuffers[i].name = 0;
+        }
+    }
+    for (uint32_t i = 0; i < graph->physical_count; i++) {
+        graph_physical_t* physical = &graph->physical[i];
+        if (physical->imported || physical->name == 0) {
+            physical->name = 0;
+            continue;
+        }
+        if (physical->type == GRAPH_TEXTURE) {
+            glDeleteTextures(1, &physical->name);
+        } else {
+            glDeleteBuffers(1, &physical->name);
+        }
+        physical->name = 0;
+    }
+
+    // names can be reused by the driver
+    invalidate_gl_state();
+    graph->realized = 0;
+}
+
+static void release_compiled(render_graph_t* graph) {
+    release_gl_objects(graph);
+
+    free(graph->order);
+    free(graph->physical);
+    free(graph->framebuffers);
+    graph->order = NULL;
+    graph->physical = NULL;
+    graph->framebuffers = NULL;
+    graph->order_count = graph->physical_count = graph->framebuffer_count = 0;
+    graph->compiled = 0;
+}
+
+void destroy_render_graph(render_graph_t* graph) {
+    release_compiled(graph);
+
+    for (uint32_t i = 0; i < graph->pass_count; i++) {
+        free(graph->passes[i].uses);
+    }
+    free(graph->passes);
+    free(graph->resources);
+    free(graph);
+}
+
+void set_render_graph_size(render_graph_t* graph, uint32_t width, uint32_t height) {
+    width = width ? width : 1;
+    height = height ? height : 1;
+    if (graph->width == width && graph->height == height) {
+        return;
+    }
+
+    graph->width = width;
+    graph->height = height;
+
+    // sizes decide which textures can alias
+    if (graph->compiled) {
+        release_compiled(graph);
+        compile_render_graph(graph);
+    }
+}
+
+static uint32_t add_resource(render_graph_t* graph, const char* name, graph_resource_type_t type) {
+    graph->resources = realloc(graph->resources, (graph->resource_count + 1) * sizeof(graph_resource_t));
+
+    graph_resource_t* resource = &graph->resources[graph->resource_count];
+    memset(resource, 0, sizeof(graph_resource_t));
+    strncpy(resource->name, name, GRAPH_NAME_SIZE - 1);
+    resource->type = type;
+    resource->physical = GRAPH_NONE;
+
+    graph->compiled = 0;
+    return graph->resource_count++;
+}
+
+uint32_t add_graph_texture(render_graph_t* graph, const char* name, uint32_t width, uint32_t height, GLenum format) {
+    uint32_t id = add_resource(graph, name, GRAPH_TEXTURE);
+    graph->resources[id].width = width;
+    graph->resources[id].height = height;
+    graph->resources[id].format = format;
+    return id;
+}
+
+uint32_t add_graph_buffer(render_graph_t* graph, const char* name, size_t size) {
+    uint32_t id = add_resource(graph, name, GRAPH_BUFFER);
+    graph->resources[id].size = size;
+    return id;
+}
+
+uint32_t import_graph_texture(render_graph_t* graph, const char* name, uint32_t texture, uint32_t width, uint32_t height, GLenum format) {
+    uint32_t id = add_graph_texture(graph, name, width, height, format);
+    graph->resources[id].imported = 1;
+    graph->resources[id].external = texture;
+    return id;
+}
+
+uint32_t import_graph_buffer(render_graph_t* graph, const char* name, uint32_t buffer, size_t size) {
+    uint32_t id = add_graph_buffer(graph, name, size);
+    graph->resources[id].imported = 1;
+    graph->resources[id].external = buffer;
+    return id;
+}
+
+uint32_t import_graph_backbuffer(render_graph_t* graph) {
+    uint32_t id = add_graph_texture(graph, "backbuffer", 0, 0, GL_RGBA8);
+    graph->resources[id].imported = 1;
+    graph->resources[id].backbuffer = 1;
+    return id;
+}
+
+void set_graph_output(render_graph_t* graph, uint32_t resource) {
+    graph->resources[resource].output = 1;
+    graph->compiled = 0;
+}
+
+uint32_t add_graph_pass(render_graph_t* graph, const char* name, graph_pass_fn_t execute, void* user, uint32_t flags) {
+    graph->passes = realloc(graph->passes, (graph->pass_count + 1) * sizeof(graph_pass_t));
+
+    graph_pass_t* pass = &graph->passes[graph->pass_count];
+    memset(pass, 0, sizeof(graph_pass_t));
+    strncpy(pass->name, name, GRAPH_NAME_SIZE - 1);
+    pass->execute = execute;
+    pass->user = user;
+    pass->flags = flags;
+    pass->framebuffer = GRAPH_NONE;
+
+    graph->compiled = 0;
+    return graph->pass_count++;
+}
+
+static void add_use(render_graph_t* graph, uint32_t pass, uint32_t resource, graph_access_t access) {
+    if (pass >= graph->pass_count || resource >= graph->resource_count) {
+        ERROR("Render graph use of resource %d in pass %d is out of range.", resource, pass);
+        return;
+    }
+
+    graph_pass_t* p = &graph->passes[pass];
+    p->uses = realloc(p->uses, (p->use_count + 1) * sizeof(graph_use_t));
+    p->uses[p->use_count++] = (graph_use_t){ .resource = resource, .access = access };
+    graph->compiled = 0;
+}
+
+void graph_read(render_graph_t* graph, uint32_t pass, uint32_t resource, graph_access_t access) {
+    if (GRAPH_IS_WRITE(access)) {
+        WARN("Pass %s reads %s with a write access.", graph->passes[pass].name, graph->resources[resource].name);
+    }
+    add_use(graph, pass, resource, access);
+}
+
+void graph_write(render_graph_t* graph, uint32_t pass, uint32_t resource, graph_access_t access) {
+    if (!GRAPH_IS_WRITE(access)) {
+        WARN("Pass %s writes %s with a read access.", graph->passes[pass].name, graph->resources[resource].name);
+    }
+    add_use(graph, pass, resource, access);
+}
+
+/* compile */
+
+static int is_attachment(graph_access_t access) {
+    return access == GRAPH_WRITE_COLOR || access == GRAPH_WRITE_DEPTH || access == GRAPH_READ_DEPTH;
+}
+
+static int access_matches_type(graph_access_t access, graph_resource_type_t type) {
+    switch (access) {
+        case GRAPH_READ_TEXTURE:
+        case GRAPH_READ_IMAGE:
+        case GRAPH_READ_DEPTH:
+        case GRAPH_WRITE_COLOR:
+        case GRAPH_WRITE_DEPTH:
+        case GRAPH_WRITE_IMAGE:
+            return type == GRAPH_TEXTURE;
+        default:
+            return type == GRAPH_BUFFER;
+    }
+}
+
+// what a read has to wait for when the resource was last written by an image or storage write
+static GLbitfield barrier_bits(graph_access_t access) {
+    switch (access) {
+        case GRAPH_READ_TEXTURE: return GL_TEXTURE_FETCH_BARRIER_BIT;
+        case GRAPH_READ_IMAGE: return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+        case GRAPH_READ_STORAGE: return GL_SHADER_STORAGE_BARRIER_BIT;
+        case GRAPH_READ_UNIFORM: return GL_UNIFORM_BARRIER_BIT;
+        case GRAPH_READ_VERTEX: return GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT;
+        case GRAPH_READ_INDIRECT: return GL_COMMAND_BARRIER_BIT;
+        case GRAPH_READ_DEPTH:
+        case GRAPH_WRITE_COLOR:
+        case GRAPH_WRITE_DEPTH: return GL_FRAMEBUFFER_BARRIER_BIT;
+        case GRAPH_WRITE_IMAGE: return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+        case GRAPH_WRITE_STORAGE: return GL_SHADER_STORAGE_BARRIER_BIT;
+    }
+    return 0;
+}
+
+static size_t bytes_per_pixel(GLenum format) {
+    switch (format) {
+        case GL_R8: return 1;
+        case GL_RG8:
+        case GL_R16F:
+        case GL_DEPTH_COMPONENT16: return 2;
+        case GL_RGBA16F:
+        case GL_RG32F: return 8;
+        case GL_RGBA32F: return 16;
+        default: return 4;
+    }
+}
+
+static void resolve_size(const render_graph_t* graph, const graph_resource_t* resource, uint32_t* width, uint32_t* height) {
+    *width = resource->width ? resource->width : graph->width;
+    *height = resource->height ? resource->height : graph->height;
+}
+
+static size_t resource_bytes(const render_graph_t* graph, const graph_resource_t* resource) {
+    if (resource->type == GRAPH_BUFFER) {
+        return resource->size;
+    }
+    uint32_t width, height;
+    resolve_size(graph, resource, &width, &height);
+    return (size_t)width * height * bytes_per_pixel(resource->format);
+}
+
+static int validate_graph(const render_graph_t* graph) {
+    for (uint32_t p = 0; p < graph->pass_count; p++) {
+        const graph_pass_t* pass = &graph->passes[p];
+        uint32_t colors = 0, depths = 0, backbuffer = 0;
+
+        for (uint32_t u = 0; u < pass->use_count; u++) {
+            const graph_resource_t* resource = &graph->resources[pass->uses[u].resource];
+            graph_access_t access = pass->uses[u].access;
+
+            if (!access_matches_type(access, resource->type)) {
+                ERROR("Pass %s uses %s with an access that doesn't fit its type.", pass->name, resource->name);
+                return 0;
+            }
+            if (resource->backbuffer && access != GRAPH_WRITE_COLOR) {
+                ERROR("Pass %s can only write the backbuffer as a color attachment.", pass->name);
+                return 0;
+            }
+
+            colors += access == GRAPH_WRITE_COLOR;
+            depths += access == GRAPH_WRITE_DEPTH || access == GRAPH_READ_DEPTH;
+            backbuffer |= resource->backbuffer;
+        }
+
+        if (colors > GRAPH_MAX_COLOR_ATTACHMENTS || depths > 1) {
+            ERROR("Pass %s has %d color and %d depth attachments.", pass->name, colors, depths);
+            return 0;
+        }
+        if (backbuffer && (colors > 1 || depths > 0)) {
+            ERROR("Pass %s can't combine the backbuffer with other attachments.", pass->name);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// walks the passes backwards keeping the ones that write something a later live pass or an output needs
+static void cull_passes(render_graph_t* graph) {
+    uint8_t* needed = calloc(graph->resource_count, 1);
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        needed[r] = graph->resources[r].output || graph->resources[r].imported;
+    }
+
+    for (uint32_t p = graph->pass_count; p-- > 0;) {
+        graph_pass_t* pass = &graph->passes[p];
+
+        int live = (pass->flags & GRAPH_PASS_KEEP) != 0;
+        for (uint32_t u = 0; u < pass->use_count && !live; u++) {
+            live = GRAPH_IS_WRITE(pass->uses[u].access) && needed[pass->uses[u].resource];
+        }
+
+        pass->culled = !live;
+        if (!live) {
+            continue;
+        }
+
+        // writes stay needed, a pass can blend onto or only partly overwrite earlier results
+        for (uint32_t u = 0; u < pass->use_count; u++) {
+            needed[pass->uses[u].resource] = 1;
+        }
+    }
+
+    free(needed);
+}
+
+static uint32_t framebuffer_key(const render_graph_t* graph, const graph_pass_t* pass, graph_framebuffer_t* fb) {
+    memset(fb, 0, sizeof(graph_framebuffer_t));
+    fb->depth = GRAPH_NONE;
+
+    uint32_t attachments = 0;
+    for (uint32_t u = 0; u < pass->use_count; u++) {
+        const graph_use_t* use = &pass->uses[u];
+        if (!is_attachment(use->access)) {
+            continue;
+        }
+
+        const graph_resource_t* resource = &graph->resources[use->resource];
+        resolve_size(graph, resource, &fb->width, &fb->height);
+        if (resource->backbuffer) {
+            fb->backbuffer = 1;
+        } else if (use->access == GRAPH_WRITE_COLOR) {
+            fb->colors[fb->color_count++] = use->resource;
+        } else {
+            fb->depth = use->resource;
+        }
+        attachments++;
+    }
+    return attachments;
+}
+
+// uses resource indices, compared before aliasing so passes are grouped by what they render to
+static int same_targets(const graph_framebuffer_t* a, const graph_framebuffer_t* b) {
+    return a->backbuffer == b->backbuffer && a->depth == b->depth && a->color_count == b->color_count &&
+           memcmp(a->colors, b->colors, a->color_count * sizeof(uint32_t)) == 0;
+}
+
+/*
+ * Every edge points from an earlier to a later pass in declaration order, so declaration order is
+ * always valid. Among the ready passes the one rendering to the same targets as the last is taken
+ * first, otherwise the earliest declared one.
+ */
+static int order_passes(render_graph_t* graph) {
+    uint32_t n = graph->pass_count;
+    uint8_t* edges = calloc((size_t)n * n, 1);
+    uint32_t* in_degree = calloc(n, sizeof(uint32_t));
+    uint32_t* readers = malloc((n ? n : 1) * sizeof(uint32_t));
+
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        uint32_t last_writer = GRAPH_NONE;
+        uint32_t reader_count = 0;
+
+        for (uint32_t p = 0; p < n; p++) {
+            const graph_pass_t* pass = &graph->passes[p];
+            if (pass->culled) {
+                continue;
+            }
+
+            int reads = 0, writes = 0;
+            for (uint32_t u = 0; u < pass->use_count; u++) {
+                if (pass->uses[u].resource == r) {
+                    writes |= GRAPH_IS_WRITE(pass->uses[u].access);
+                    reads |= !GRAPH_IS_WRITE(pass->uses[u].access);
+                }
+            }
+            if (!reads && !writes) {
+                continue;
+            }
+
+            if (last_writer != GRAPH_NONE && last_writer != p) {
+                edges[last_writer * n + p] = 1;
+            }
+            if (writes) {
+                // write after read
+                for (uint32_t i = 0; i < reader_count; i++) {
+                    if (readers[i] != p) {
+                        edges[readers[i] * n + p] = 1;
+                    }
+                }
+                last_writer = p;
+                reader_count = 0;
+            } else {
+                readers[reader_count++] = p;
+            }
+        }
+    }
+
+    for (uint32_t a = 0; a < n; a++) {
+        for (uint32_t b = 0; b < n; b++) {
+            in_degree[b] += edges[a * n + b];
+        }
+    }
+
+    graph->order = malloc((n ? n : 1) * sizeof(uint32_t));
+    graph->order_count = 0;
+
+    uint8_t* done = calloc(n ? n : 1, 1);
+    graph_framebuffer_t current, candidate;
+    int has_current = 0;
+
+    for (;;) {
+        uint32_t pick = GRAPH_NONE;
+        for (uint32_t p = 0; p < n; p++) {
+            if (done[p] || graph->passes[p].culled || in_degree[p] != 0) {
+                continue;
+            }
+            if (pick == GRAPH_NONE) {
+                pick = p;
+            }
+            if (has_current && framebuffer_key(graph, &graph->passes[p], &candidate) && same_targets(&current, &candidate)) {
+                pick = p;
+                break;
+            }
+        }
+
+        if (pick == GRAPH_NONE) {
+            break;
+        }
+
+        done[pick] = 1;
+        graph->order[graph->order_count++] = pick;
+        for (uint32_t b = 0; b < n; b++) {
+            in_degree[b] -= edges[pick * n + b];
+        }
+
+        // compute passes don't change the bound framebuffer
+        if (framebuffer_key(graph, &graph->passes[pick], &candidate)) {
+            current = candidate;
+            has_current = 1;
+        }
+    }
+
+    uint32_t live = 0;
+    for (uint32_t p = 0; p < n; p++) {
+        live += !graph->passes[p].culled;
+    }
+
+    free(edges);
+    free(in_degree);
+    free(readers);
+    free(done);
+
+    if (graph->order_count != live) {
+        ERROR("Render graph has a dependency cycle.");
+        return 0;
+    }
+    return 1;
+}
+
+static uint32_t add_physical(render_graph_t* graph, const graph_resource_t* resource) {
+    graph->physical = realloc(graph->physical, (graph->physical_count + 1) * sizeof(graph_physical_t));
+    graph_physical_t* physical = &graph->physical[graph->physical_count];
+    memset(physical, 0, sizeof(graph_physical_t));
+    physical->type = resource->type;
+    physical->format = resource->format;
+    physical->size = resource->size;
+    resolve_size(graph, resource, &physical->width, &physical->height);
+    physical->last_use = resource->last_use;
+    return graph->physical_count++;
+}
+
+// greedy in order of first use, a resource takes the first compatible gl object that is free by then
+static void alias_resources(render_graph_t* graph) {
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        graph->resources[r].first_use = GRAPH_NONE;
+        graph->resources[r].last_use = 0;
+        graph->resources[r].physical = GRAPH_NONE;
+    }
+
+    for (uint32_t i = 0; i < graph->order_count; i++) {
+        const graph_pass_t* pass = &graph->passes[graph->order[i]];
+        for (uint32_t u = 0; u < pass->use_count; u++) {
+            graph_resource_t* resource = &graph->resources[pass->uses[u].resource];
+            resource->first_use = resource->first_use == GRAPH_NONE ? i : resource->first_use;
+            resource->last_use = i;
+        }
+    }
+
+    uint32_t* sorted = malloc((graph->resource_count ? graph->resource_count : 1) * sizeof(uint32_t));
+    uint32_t count = 0;
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        uint32_t first_use = graph->resources[r].first_use;
+        if (first_use == GRAPH_NONE) {
+            continue;
+        }
+
+        // insertion sort, graphs have a handful of resources
+        uint32_t i = count++;
+        while (i > 0 && graph->resources[sorted[i - 1]].first_use > first_use) {
+            sorted[i] = sorted[i - 1];
+            i--;
+        }
+        sorted[i] = r;
+    }
+
+    graph->stats.transient_bytes = 0;
+    graph->stats.physical_bytes = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        graph_resource_t* resource = &graph->resources[sorted[i]];
+
+        // imported resources get their own slot that nothing else aliases
+        if (resource->imported) {
+            resource->physical = add_physical(graph, resource);
+            graph->physical[resource->physical].imported = 1;
+            continue;
+        }
+
+        graph->stats.transient_bytes += resource_bytes(graph, resource);
+
+        uint32_t width, height;
+        resolve_size(graph, resource, &width, &height);
+
+        for (uint32_t p = 0; p < graph->physical_count; p++) {
+            graph_physical_t* physical = &graph->physical[p];
+            if (!physical->imported && physical->last_use < resource->first_use && physical->type == resource->type &&
+                (resource->type == GRAPH_BUFFER ||
+                 (physical->format == resource->format && physical->width == width && physical->height == height))) {
+                resource->physical = p;
+                physical->last_use = resource->last_use;
+                physical->size = resource->size > physical->size ? resource->size : physical->size;
+                break;
+            }
+        }
+
+        if (resource->physical == GRAPH_NONE) {
+            resource->physical = add_physical(graph, resource);
+        }
+    }
+
+    for (uint32_t p = 0; p < graph->physical_count; p++) {
+        const graph_physical_t* physical = &graph->physical[p];
+        if (physical->imported) {
+            continue;
+        }
+        graph->stats.physical_bytes += physical->type == GRAPH_BUFFER ? physical->size
+                                     : (size_t)physical->width * physical->height * bytes_per_pixel(physical->format);
+    }
+
+    free(sorted);
+}
+
+// glMemoryBarrier is global, so bits issued before a pass clear them on every resource
+static void place_barriers(render_graph_t* graph) {
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        graph->resources[r].dirty = 0;
+    }
+
+    graph->stats.barriers = 0;
+    for (uint32_t i = 0; i < graph->order_count; i++) {
+        graph_pass_t* pass = &graph->passes[graph->order[i]];
+        pass->barriers = 0;
+
+        for (uint32_t u = 0; u < pass->use_count; u++) {
+            const graph_resource_t* resource = &graph->resources[pass->uses[u].resource];
+            pass->barriers |= barrier_bits(pass->uses[u].access) & resource->dirty;
+        }
+
+        if (pass->barriers) {
+            graph->stats.barriers++;
+            for (uint32_t r = 0; r < graph->resource_count; r++) {
+                graph->resources[r].dirty &= ~pass->barriers;
+            }
+        }
+
+        for (uint32_t u = 0; u < pass->use_count; u++) {
+            graph_access_t access = pass->uses[u].access;
+            if (access == GRAPH_WRITE_IMAGE || access == GRAPH_WRITE_STORAGE) {
+                graph->resources[pass->uses[u].resource].dirty = GRAPH_DIRTY_BITS;
+            }
+        }
+    }
+}
+
+// after aliasing framebuffers are keyed by gl object, passes on aliased targets share one
+static void assign_framebuffers(render_graph_t* graph) {
+    uint32_t binds = 0;
+    uint32_t bound = GRAPH_NONE;
+
+    for (uint32_t i = 0; i < graph->order_count; i++) {
+        graph_pass_t* pass = &graph->passes[graph->order[i]];
+        graph_framebuffer_t fb;
+        if (!framebuffer_key(graph, pass, &fb)) {
+            pass->framebuffer = GRAPH_NONE;
+            continue;
+        }
+
+        for (uint32_t c = 0; c < fb.color_count; c++) {
+            fb.colors[c] = graph->resources[fb.colors[c]].physical;
+        }
+        if (fb.depth != GRAPH_NONE) {
+            fb.depth = graph->resources[fb.depth].physical;
+        }
+
+        pass->framebuffer = GRAPH_NONE;
+        for (uint32_t f = 0; f < graph->framebuffer_count; f++) {
+            if (same_targets(&graph->framebuffers[f], &fb)) {
+                pass->framebuffer = f;
+                break;
+            }
+        }
+        if (pass->framebuffer == GRAPH_NONE) {
+            graph->framebuffers = realloc(graph->framebuffers, (graph->framebuffer_count + 1) * sizeof(graph_framebuffer_t));
+            graph->framebuffers[graph->framebuffer_count] = fb;
+            pass->framebuffer = graph->framebuffer_count++;
+        }
+
+        if (pass->framebuffer != bound) {
+            bound = pass->framebuffer;
+            binds++;
+        }
+    }
+
+    graph->stats.framebuffer_binds = binds;
+}
+
+int compile_render_graph(render_graph_t* graph) {
+    release_compiled(graph);
+    memset(&graph->stats, 0, sizeof(render_graph_stats_t));
+
+    if (!validate_graph(graph)) {
+        return 0;
+    }
+
+    cull_passes(graph);
+    if (!order_passes(graph)) {
+        return 0;
+    }
+    alias_resources(graph);
+    place_barriers(graph);
+    assign_framebuffers(graph);
+
+    graph->stats.pass_count = graph->pass_count;
+    graph->stats.culled_passes = graph->pass_count - graph->order_count;
+    graph->stats.resource_count = graph->resource_count;
+    graph->stats.physical_count = graph->physical_count;
+    graph->compiled = 1;
+
+    TRACE("Compiled render graph, %d of %d passes, %d resources in %d gl objects.",
+          graph->order_count, graph->pass_count, graph->resource_count, graph->physical_count);
+    return 1;
+}
+
+/* execute */
+
+static void realize_graph(render_graph_t* graph) {
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        const graph_resource_t* resource = &graph->resources[r];
+        if (resource->physical == GRAPH_NONE || !resource->imported) {
+            continue;
+        }
+        graph->physical[resource->physical].name = resource->external;
+    }
+
+    for (uint32_t p = 0; p < graph->physical_count; p++) {
+        graph_physical_t* physical = &graph->physical[p];
+        if (physical->imported) {
+            continue;
+        }
+
+        if (physical->type == GRAPH_TEXTURE) {
+            glGenTextures(1, &physical->name);
+            bind_texture(0, GL_TEXTURE_2D, physical->name);
+            glTexStorage2D(GL_TEXTURE_2D, 1, physical->format, physical->width, physical->height);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        } else {
+            glGenBuffers(1, &physical->name);
+            bind_buffer(GL_COPY_WRITE_BUFFER, physical->name);
+            glBufferData(GL_COPY_WRITE_BUFFER, physical->size, NULL, GL_DYNAMIC_COPY);
+        }
+    }
+
+    for (uint32_t f = 0; f < graph->framebuffer_count; f++) {
+        graph_framebuffer_t* fb = &graph->framebuffers[f];
+        if (fb->backbuffer) {
+            fb->name = 0;
+            continue;
+        }
+
+        glGenFramebuffers(1, &fb->name);
+        bind_framebuffer(fb->name);
+
+        GLenum draw_buffers[GRAPH_MAX_COLOR_ATTACHMENTS];
+        for (uint32_t c = 0; c < fb->color_count; c++) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + c, GL_TEXTURE_2D, graph->physical[fb->colors[c]].name, 0);
+            draw_buffers[c] = GL_COLOR_ATTACHMENT0 + c;
+        }
+        if (fb->depth != GRAPH_NONE) {
+            const graph_physical_t* depth = &graph->physical[fb->depth];
+            GLenum attachment = depth->format == GL_DEPTH24_STENCIL8 || depth->format == GL_DEPTH32F_STENCIL8
+                              ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, depth->name, 0);
+        }
+
+        if (fb->color_count > 0) {
+            glDrawBuffers(fb->color_count, draw_buffers);
+        } else {
+            glDrawBuffer(GL_NONE);
+        }
+
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            ERROR("Render graph framebuffer %d is incomplete, status 0x%x.", f, status);
+        }
+    }
+
+    graph->realized = 1;
+    TRACE("Created %d gl objects and %d framebuffers for the render graph.", graph->physical_count, graph->framebuffer_count);
+}
+
+// on the thread the graph's context is current on
+static void run_render_graph(void* data) {
+    render_graph_t* graph = data;
+
+    if (!graph->realized) {
+        realize_graph(graph);
+    }
+
+    uint32_t bound = GRAPH_NONE;
+    for (uint32_t i = 0; i < graph->order_count; i++) {
+        uint32_t id = graph->order[i];
+        graph_pass_t* pass = &graph->passes[id];
+
+        if (pass->barriers) {
+            glMemoryBarrier(pass->barriers);
+        }
+
+        if (pass->framebuffer != GRAPH_NONE && pass->framebuffer != bound) {
+            const graph_framebuffer_t* fb = &graph->framebuffers[pass->framebuffer];
+            bind_framebuffer(fb->name);
+            glViewport(0, 0, fb->width, fb->height);
+            bound = pass->framebuffer;
+        }
+
+        if (pass->execute != NULL) {
+            pass->execute(graph, id, pass->user);
+        }
+    }
+}
+
+void execute_render_graph(render_graph_t* graph) {
+    if (!graph->compiled && !compile_render_graph(graph)) {
+        return;
+    }
+
+    // a context owned by a render thread runs the passes there, borrowing it back every frame would stall
+    render_thread_t* thread = get_render_thread(graph->context);
+    if (thread != NULL && thread != get_current_render_thread()) {
+        post_render_command(thread, run_render_graph, graph);
+        wait_render_thread(thread);
+    } else {
+        make_context_current(graph->context);
+        run_render_graph(graph);
+    }
+}
+
+/* queries */
+
+const uint32_t* get_render_graph_order(const render_graph_t* graph, uint32_t* count) {
+    if (count != NULL) {
+        *count = graph->order_count;
+    }
+    return graph->order;
+}
+
+int is_graph_pass_culled(const render_graph_t* graph, uint32_t pass) {
+    return graph->passes[pass].culled;
+}
+
+GLbitfield get_graph_pass_barriers(const render_graph_t* graph, uint32_t pass) {
+    return graph->passes[pass].barriers;
+}
+
+uint32_t get_graph_physical(const render_graph_t* graph, uint32_t resource) {
+    return graph->resources[resource].physical;
+}
+
+render_graph_stats_t get_render_graph_stats(const render_graph_t* graph) {
+    return graph->stats;
+}
+
+void log_render_graph(const render_graph_t* graph) {
+    INFO("Render graph: %d passes, %d culled, %d framebuffer binds, %d barriers.",
+         graph->stats.pass_count, graph->stats.culled_passes, graph->stats.framebuffer_binds, graph->stats.barriers);
+
+    for (uint32_t i = 0; i < graph->order_count; i++) {
+        const graph_pass_t* pass = &graph->passes[graph->order[i]];
+        INFO("  %2d %-16s framebuffer %2d barriers 0x%04x", i, pass->name,
+             pass->framebuffer == GRAPH_NONE ? -1 : (int)pass->framebuffer, pass->barriers);
+    }
+
+    for (uint32_t r = 0; r < graph->resource_count; r++) {
+        const graph_resource_t* resource = &graph->resources[r];
+        if (resource->physical == GRAPH_NONE) {
+            INFO("  %-16s unused", resource->name);
+        } else {
+            INFO("  %-16s passes %d-%d gl object %d%s", resource->name, resource->first_use, resource->last_use,
+                 resource->physical, resource->imported ? " imported" : "");
+        }
+    }
+
+    INFO("Transient memory %zu KB aliased into %zu KB.", graph->stats.transient_bytes / 1024, graph->stats.physical_bytes / 1024);
+}
+
+uint32_t get_graph_texture(const render_graph_t* graph, uint32_t resource) {
+    uint32_t physical = graph->resources[resource].physical;
+    return physical == GRAPH_NONE ? 0 : graph->physical[physical].name;
+}
+
+uint32_t get_graph_buffer(const render_graph_t* graph, uint32_t resource) {
+    return get_graph_texture(graph, resource);
+}
+
+void get_graph_texture_size(const render_graph_t* graph, uint32_t resource, uint32_t* width, uint32_t* height) {
+    resolve_size(graph, &graph->resources[resource], width, height);
+}
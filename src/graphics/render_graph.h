@@ -0,0 +1,111 @@
+#ifndef OVERTURE_RENDER_GRAPH
+#define OVERTURE_RENDER_GRAPH
+
+#include <stddef.h>
+#include <stdint.h>
+#include "graphics/opengl.h"
+
+/*
+ * Render graph, a frame is described as passes that declare which textures and buffers they
+ * read and write instead of a fixed list of schedules. The graph is compiled once:
+ *
+ *   - passes that don't contribute to an output or an imported resource are culled
+ *   - passes are ordered by their dependencies, passes rendering to the same targets are kept
+ *     next to each other so framebuffers are rebound as little as possible
+ *   - transient textures and buffers whose lifetimes don't overlap share the same gl object,
+ *     so the first pass writing an aliased resource has to clear or fully overwrite it
+ *   - glMemoryBarrier bits are worked out for reads of image and storage writes
+ *
+ * Compiling doesn't touch gl, execute_render_graph() creates the gl objects on first use and
+ * then binds each pass's framebuffer and calls it on the graph's context. When a render thread
+ * owns the context the passes run on that thread and execute_render_graph() waits for them.
+ *
+ *   render_graph_t* graph = create_render_graph(window);
+ *   uint32_t depth = add_graph_texture(graph, "depth", 0, 0, GL_DEPTH_COMPONENT32F);
+ *   uint32_t back = import_graph_backbuffer(graph);
+ *   uint32_t prepass = add_graph_pass(graph, "prepass", draw_depth, NULL, 0);
+ *   graph_write(graph, prepass, depth, GRAPH_WRITE_DEPTH);
+ *   ...
+ *   compile_render_graph(graph);
+ *   execute_render_graph(graph); // every frame
+ */
+
+#define GRAPH_NONE UINT32_MAX
+#define GRAPH_MAX_COLOR_ATTACHMENTS 8
+
+typedef enum {
+    GRAPH_READ_TEXTURE, // sampled
+    GRAPH_READ_IMAGE, // imageLoad
+    GRAPH_READ_STORAGE,
+    GRAPH_READ_UNIFORM,
+    GRAPH_READ_VERTEX, // vertex or index data
+    GRAPH_READ_INDIRECT,
+    GRAPH_READ_DEPTH, // depth attachment with writes off
+    GRAPH_WRITE_COLOR, // attachments are numbered in the order they are declared
+    GRAPH_WRITE_DEPTH,
+    GRAPH_WRITE_IMAGE,
+    GRAPH_WRITE_STORAGE,
+} graph_access_t;
+
+#define GRAPH_IS_WRITE(access) ((access) >= GRAPH_WRITE_COLOR)
+
+// passes with side effects the graph can't see
+#define GRAPH_PASS_KEEP 0x1
+
+typedef struct render_graph_t render_graph_t;
+
+typedef void (*graph_pass_fn_t)(render_graph_t* graph, uint32_t pass, void* user);
+
+typedef struct {
+    uint32_t pass_count;
+    uint32_t culled_passes;
+    uint32_t resource_count;
+    uint32_t physical_count; // gl objects after aliasing
+    size_t transient_bytes; // what the transient resources would take without aliasing
+    size_t physical_bytes;
+    uint32_t framebuffer_binds; // per execution
+    uint32_t barriers;
+} render_graph_stats_t;
+
+render_graph_t* create_render_graph(GLFWwindow* context);
+// makes the graph's context current to free the gl objects
+void destroy_render_graph(render_graph_t* graph);
+
+// size of textures created with a width and height of 0, usually the window's framebuffer
+void set_render_graph_size(render_graph_t* graph, uint32_t width, uint32_t height);
+
+// transient resources live only inside the graph, returns a resource handle
+uint32_t add_graph_texture(render_graph_t* graph, const char* name, uint32_t width, uint32_t height, GLenum format);
+uint32_t add_graph_buffer(render_graph_t* graph, const char* name, size_t size);
+// resources owned by someone else, passes writing them are never culled
+uint32_t import_graph_texture(render_graph_t* graph, const char* name, uint32_t texture, uint32_t width, uint32_t height, GLenum format);
+uint32_t import_graph_buffer(render_graph_t* graph, const char* name, uint32_t buffer, size_t size);
+// the default framebuffer, can only be written as the single color attachment of a pass
+uint32_t import_graph_backbuffer(render_graph_t* graph);
+// keeps the passes writing the resource alive
+void set_graph_output(render_graph_t* graph, uint32_t resource);
+
+// passes run in the order they were added unless reordering doesn't change the result
+uint32_t add_graph_pass(render_graph_t* graph, const char* name, graph_pass_fn_t execute, void* user, uint32_t flags);
+void graph_read(render_graph_t* graph, uint32_t pass, uint32_t resource, graph_access_t access);
+void graph_write(render_graph_t* graph, uint32_t pass, uint32_t resource, graph_access_t access);
+
+// returns 0 when the graph is invalid, logs why
+int compile_render_graph(render_graph_t* graph);
+void execute_render_graph(render_graph_t* graph);
+
+// execution order of the live passes
+const uint32_t* get_render_graph_order(const render_graph_t* graph, uint32_t* count);
+int is_graph_pass_culled(const render_graph_t* graph, uint32_t pass);
+GLbitfield get_graph_pass_barriers(const render_graph_t* graph, uint32_t pass);
+// index of the gl object the resource uses, resources with the same one are aliased
+uint32_t get_graph_physical(const render_graph_t* graph, uint32_t resource);
+render_graph_stats_t get_render_graph_stats(const render_graph_t* graph);
+void log_render_graph(const render_graph_t* graph);
+
+// gl names, only valid inside a pass
+uint32_t get_graph_texture(const render_graph_t* graph, uint32_t resource);
+uint32_t get_graph_buffer(const render_graph_t* graph, uint32_t resource);
+void get_graph_texture_size(const render_graph_t* graph, uint32_t resource, uint32_t* width, uint32_t* height);
+
+#endif
@@ -0,0 +1,240 @@
+#include "graphics/render_queue.h"
+#include "core/log.h"
+#include "core/systems.h"
+#include "graphics/stream_buffer.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CONTEXT_SLOTS 64
+
+typedef struct {
+    draw_packet_t* packets;
+    uint32_t count;
+    uint32_t capacity;
+} draw_buffer_t;
+
+// system threads only live for one schedule so buffers are pooled and handed out per frame
+static draw_buffer_t** buffers = NULL;
+static uint32_t buffers_in_use = 0;
+static uint32_t buffers_allocated = 0;
+static pthread_mutex_t buffer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// bumped on every flush, a thread's buffer is only valid for the generation it was taken in
+static uint32_t generation = 1;
+static _Thread_local draw_buffer_t* thread_buffer = NULL;
+static _Thread_local uint32_t thread_generation = 0;
+
+// merged and sorted on flush, reused between frames
+static draw_packet_t* frame_packets = NULL;
+static uint64_t* keys = NULL;
+static uint64_t* tmp_keys = NULL;
+static uint32_t* order = NULL;
+static uint32_t* tmp_order = NULL;
+static uint32_t frame_capacity = 0;
+
+static GLFWwindow* context_slots[MAX_CONTEXT_SLOTS];
+static uint32_t context_slot_count = 0;
+
+static draw_buffer_t* acquire_buffer() {
+    if (thread_buffer != NULL && thread_generation == generation) {
+        return thread_buffer;
+    }
+
+    pthread_mutex_lock(&buffer_lock);
+
+    if (buffers_in_use == buffers_allocated) {
+        buffers = realloc(buffers, (buffers_allocated + 1) * sizeof(draw_buffer_t*));
+        buffers[buffers_allocated++] = calloc(1, sizeof(draw_buffer_t));
+    }
+    thread_buffer = buffers[buffers_in_use++];
+    thread_generation = generation;
+
+    pthread_mutex_unlock(&buffer_lock);
+
+    return thread_buffer;
+}
+
+void submit_draw(const draw_packet_t* packet) {
+    draw_buffer_t* buffer = acquire_buffer();
+
+    if (buffer->count == buffer->capacity) {
+        buffer->capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+        buffer->packets = realloc(buffer->packets, buffer->capacity * sizeof(draw_packet_t));
+        if (buffer->packets == NULL) {
+            FATAL("Failed to grow draw buffer to %d packets.", buffer->capacity);
+        }
+    }
+
+    buffer->packets[buffer->count++] = *packet;
+}
+
+static uint32_t get_context_slot(GLFWwindow* context) {
+    for (uint32_t i = 0; i < context_slot_count; i++) {
+        if (context_slots[i] == context) {
+            return i;
+        }
+    }
+
+    if (context_slot_count == MAX_CONTEXT_SLOTS) {
+        return MAX_CONTEXT_SLOTS - 1;
+    }
+
+    context_slots[context_slot_count] = context;
+    return context_slot_count++;
+}
+
+uint64_t make_sort_key(uint32_t context_slot, const draw_packet_t* packet) {
+    float depth = packet->depth < 0.0f ? 0.0f : (packet->depth > 1.0f ? 1.0f : packet->depth);
+    uint64_t quantized = (uint64_t)(depth * 65535.0f);
+    uint64_t head = ((uint64_t)(context_slot & 0x3f) << 58) | ((uint64_t)(packet->pass & 0x7) << 55);
+
+    // blending needs back to front across everything in the pass, state only breaks ties
+    if (packet->pass == RENDER_PASS_TRANSPARENT) {
+        return head |
+               ((65535 - quantized) << 39) |
+               ((uint64_t)(packet->program & 0xfff) << 27) |
+               ((uint64_t)(packet->material & 0xfff) << 15) |
+               (uint64_t)(packet->vertex_array & 0x7fff);
+    }
+
+    return head |
+           ((uint64_t)(packet->program & 0xfff) << 43) |
+           ((uint64_t)(packet->material & 0xfff) << 31) |
+           ((uint64_t)(packet->vertex_array & 0x7fff) << 16) |
+           quantized;
+}
+
+// lsd radix sort on bytes, passes where every key has the same byte are skipped
+static void radix_sort(uint32_t count) {
+    uint64_t* src_keys = keys;
+    uint64_t* dst_keys = tmp_keys;
+    uint32_t* src_order = order;
+    uint32_t* dst_order = tmp_order;
+
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        uint32_t histogram[256] = {0};
+        for (uint32_t i = 0; i < count; i++) {
+            histogram[(src_keys[i] >> shift) & 0xff]++;
+        }
+
+        if (histogram[(src_keys[0] >> shift) & 0xff] == count) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t b = 0; b < 256; b++) {
+            uint32_t n = histogram[b];
+            histogram[b] = offset;
+            offset += n;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t dst = histogram[(src_keys[i] >> shift) & 0xff]++;
+            dst_keys[dst] = src_keys[i];
+            dst_order[dst] = src_order[i];
+        }
+
+        uint64_t* swap_keys = src_keys;
+        src_keys = dst_keys;
+        dst_keys = swap_keys;
+        uint32_t* swap_order = src_order;
+        src_order = dst_order;
+        dst_order = swap_order;
+    }
+
+    if (src_order != order) {
+        memcpy(order, src_order, count * sizeof(uint32_t));
+    }
+}
+
+static void reserve_frame(uint32_t count) {
+    if (count <= frame_capacity) {
+        return;
+    }
+
+    frame_capacity = frame_capacity ? frame_capacity : 1024;
+    while (frame_capacity < count) {
+        frame_capacity *= 2;
+    }
+
+    frame_packets = realloc(frame_packets, frame_capacity * sizeof(draw_packet_t));
+    keys = realloc(keys, frame_capacity * sizeof(uint64_t));
+    tmp_keys = realloc(tmp_keys, frame_capacity * sizeof(uint64_t));
+    order = realloc(order, frame_capacity * sizeof(uint32_t));
+    tmp_order = realloc(tmp_order, frame_capacity * sizeof(uint32_t));
+
+    if (!frame_packets || !keys || !tmp_keys || !order || !tmp_order) {
+        FATAL("Failed to grow render queue to %d packets.", frame_capacity);
+    }
+}
+
+void flush_render_queue() {
+    pthread_mutex_lock(&buffer_lock);
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < buffers_in_use; i++) {
+        count += buffers[i]->count;
+    }
+
+    reserve_frame(count);
+
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < buffers_in_use; i++) {
+        memcpy(&frame_packets[offset], buffers[i]->packets, buffers[i]->count * sizeof(draw_packet_t));
+        offset += buffers[i]->count;
+        buffers[i]->count = 0;
+    }
+
+    buffers_in_use = 0;
+    generation++;
+
+    pthread_mutex_unlock(&buffer_lock);
+
+    if (count == 0) {
+        advance_stream_buffers();
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        keys[i] = make_sort_key(get_context_slot(frame_packets[i].context), &frame_packets[i]);
+        order[i] = i;
+    }
+
+    radix_sort(count);
+
+    // streamed data has to be uploaded before the draws using it and fenced after them
+    flush_stream_buffers();
+    uint32_t draws = execute_draw_packets(frame_packets, order, count);
+    advance_stream_buffers();
+
+    TRACE("Flushed %d draw packets in %d draw calls.", count, draws);
+}
+
+REGISTER_SYSTEM_FRONT(flush_render_queue, POST_RENDER);
+
+void cleanup_render_queue() {
+    for (uint32_t i = 0; i < buffers_allocated; i++) {
+        free(buffers[i]->packets);
+        free(buffers[i]);
+    }
+    free(buffers);
+    buffers = NULL;
+    buffers_in_use = buffers_allocated = 0;
+
+    free(frame_packets);
+    free(keys);
+    free(tmp_keys);
+    free(order);
+    free(tmp_order);
+    frame_packets = NULL;
+    keys = tmp_keys = NULL;
+    order = tmp_order = NULL;
+    frame_capacity = 0;
+
+    context_slot_count = 0;
+}
+
+REGISTER_SYSTEM(cleanup_render_queue, CLEANUP);
@@ -0,0 +1,26 @@
+#ifndef OVERTURE_RENDER_QUEUE
+#define OVERTURE_RENDER_QUEUE
+
+#include <stdint.h>
+#include "graphics/opengl.h"
+
+/*
+ * Systems submit draw packets instead of calling gl directly. Every thread appends to its own
+ * buffer so RENDER systems can collect draws in parallel, at the start of POST_RENDER the
+ * buffers are merged, radix sorted by a 64 bit key and executed on the main thread.
+ *
+ * Key layout from the most significant bit:
+ *   context 6 | pass 3 | program 12 | material 12 | vertex array 15 | depth 16
+ * and for the transparent pass, drawn back to front whatever the state
+ *   context 6 | pass 3 | inverted depth 16 | program 12 | material 12 | vertex array 15
+ * gl names are truncated to fit, which only affects how well packets get grouped.
+ */
+
+void submit_draw(const draw_packet_t* packet);
+
+uint64_t make_sort_key(uint32_t context_slot, const draw_packet_t* packet);
+
+// registered at the front of POST_RENDER
+void flush_render_queue();
+
+#endif
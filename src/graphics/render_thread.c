@@ -0,0 +1,232 @@
+#include "graphics/render_thread.h"
+#include "core/log.h"
+#include "graphics/opengl.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct {
+    render_command_t command;
+    void* data;
+} queued_command_t;
+
+struct render_thread_t {
+    GLFWwindow* context;
+    pthread_t thread;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t idle_cond;
+    queued_command_t queue[RENDER_QUEUE_SIZE];
+    uint32_t head;
+    uint32_t count; // queued plus the one running
+    int quit;
+
+    int holding; // render thread only
+    int borrowed; // main thread only
+};
+
+static render_thread_t** threads = NULL;
+static uint32_t thread_count = 0;
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static _Thread_local render_thread_t* current_thread = NULL;
+
+static void (*wait_hook)() = NULL;
+static long wait_hook_interval_ns = 0;
+static pthread_t main_thread;
+static int has_main_thread = 0;
+static _Thread_local int in_wait_hook = 0;
+
+static void release_context(void* data) {
+    render_thread_t* thread = data;
+    make_context_current(NULL);
+    thread->holding = 0;
+}
+
+static void* render_thread_main(void* data) {
+    render_thread_t* thread = data;
+    current_thread = thread;
+
+    pthread_mutex_lock(&thread->lock);
+    while (1) {
+        while (thread->count == 0 && !thread->quit) {
+            pthread_cond_wait(&thread->work_cond, &thread->lock);
+        }
+        if (thread->count == 0) {
+            break;
+        }
+
+        queued_command_t command = thread->queue[thread->head];
+        pthread_mutex_unlock(&thread->lock);
+
+        // taken back after the main thread borrowed it, see borrow_render_context
+        if (!thread->holding && command.command != release_context) {
+            make_context_current(thread->context);
+            thread->holding = 1;
+        }
+        command.command(command.data);
+
+        pthread_mutex_lock(&thread->lock);
+        thread->head = (thread->head + 1) % RENDER_QUEUE_SIZE;
+        thread->count--;
+        pthread_cond_broadcast(&thread->idle_cond);
+    }
+    pthread_mutex_unlock(&thread->lock);
+
+    if (thread->holding) {
+        make_context_current(NULL);
+    }
+    return NULL;
+}
+
+render_thread_t* start_render_thread(GLFWwindow* context) {
+    render_thread_t* thread = calloc(1, sizeof(render_thread_t));
+    thread->context = context;
+    pthread_mutex_init(&thread->lock, NULL);
+    pthread_cond_init(&thread->work_cond, NULL);
+    pthread_cond_init(&thread->idle_cond, NULL);
+
+    // setup code keeps using the context on this thread, the first posted command hands it over
+    thread->borrowed = get_current_context() == context;
+
+    if (pthread_create(&thread->thread, NULL, render_thread_main, thread) != 0) {
+        ERROR("Failed to start render thread for context %p.", context);
+        free(thread);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&threads_lock);
+    threads = realloc(threads, (thread_count + 1) * sizeof(render_thread_t*));
+    threads[thread_count++] = thread;
+    pthread_mutex_unlock(&threads_lock);
+
+    TRACE("Started render thread for context %p.", context);
+    return thread;
+}
+
+void stop_render_thread(render_thread_t* thread) {
+    if (thread == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&threads_lock);
+    for (uint32_t i = 0; i < thread_count; i++) {
+        if (threads[i] == thread) {
+            threads[i] = threads[--thread_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&threads_lock);
+
+    if (thread->borrowed && get_current_context() == thread->context) {
+        make_context_current(NULL);
+    }
+
+    pthread_mutex_lock(&thread->lock);
+    thread->quit = 1;
+    pthread_cond_signal(&thread->work_cond);
+    pthread_mutex_unlock(&thread->lock);
+    pthread_join(thread->thread, NULL);
+
+    pthread_mutex_destroy(&thread->lock);
+    pthread_cond_destroy(&thread->work_cond);
+    pthread_cond_destroy(&thread->idle_cond);
+    free(thread);
+
+    TRACE("Stopped render thread.");
+}
+
+void post_render_command(render_thread_t* thread, render_command_t command, void* data) {
+    // hand a borrowed context back first, the thread takes it when the command runs
+    if (thread->borrowed) {
+        if (get_current_context() == thread->context) {
+            make_context_current(NULL);
+        }
+        thread->borrowed = 0;
+    }
+
+    pthread_mutex_lock(&thread->lock);
+    while (thread->count == RENDER_QUEUE_SIZE) {
+        pthread_cond_wait(&thread->idle_cond, &thread->lock);
+    }
+
+    thread->queue[(thread->head + thread->count) % RENDER_QUEUE_SIZE] = (queued_command_t){ command, data };
+    thread->count++;
+
+    pthread_cond_signal(&thread->work_cond);
+    pthread_mutex_unlock(&thread->lock);
+}
+
+void set_render_wait_hook(void (*hook)(), double interval_ms) {
+    wait_hook = hook;
+    wait_hook_interval_ns = (long)(interval_ms * 1e6);
+}
+
+void set_render_main_thread(pthread_t thread) {
+    main_thread = thread;
+    has_main_thread = 1;
+}
+
+void wait_render_thread(render_thread_t* thread) {
+    // the hook polls glfw, which only works on the main thread, and may post commands itself, it
+    // never runs nested. Worker threads waiting on a render thread just wait
+    int hooked = wait_hook != NULL && has_main_thread && pthread_equal(pthread_self(), main_thread) && !in_wait_hook;
+
+    pthread_mutex_lock(&thread->lock);
+    while (thread->count != 0) {
+        if (!hooked) {
+            pthread_cond_wait(&thread->idle_cond, &thread->lock);
+            continue;
+        }
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += wait_hook_interval_ns;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000;
+        deadline.tv_nsec %= 1000000000;
+
+        if (pthread_cond_timedwait(&thread->idle_cond, &thread->lock, &deadline) == ETIMEDOUT) {
+            pthread_mutex_unlock(&thread->lock);
+            in_wait_hook = 1;
+            wait_hook();
+            in_wait_hook = 0;
+            pthread_mutex_lock(&thread->lock);
+        }
+    }
+    pthread_mutex_unlock(&thread->lock);
+}
+
+render_thread_t* get_render_thread(GLFWwindow* context) {
+    render_thread_t* thread = NULL;
+
+    pthread_mutex_lock(&threads_lock);
+    for (uint32_t i = 0; i < thread_count && context != NULL; i++) {
+        if (threads[i]->context == context) {
+            thread = threads[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&threads_lock);
+
+    return thread;
+}
+
+render_thread_t* get_current_render_thread() {
+    return current_thread;
+}
+
+void borrow_render_context(GLFWwindow* context) {
+    render_thread_t* thread = get_render_thread(context);
+    if (thread == NULL || thread == current_thread || thread->borrowed) {
+        return;
+    }
+
+    post_render_command(thread, release_context, thread);
+    wait_render_thread(thread);
+    thread->borrowed = 1;
+
+    TRACE("Borrowed context %p from its render thread.", context);
+}
@@ -0,0 +1,54 @@
+#ifndef OVERTURE_RENDER_THREAD
+#define OVERTURE_RENDER_THREAD
+
+#include <pthread.h>
+#include <stdint.h>
+#include <GLFW/glfw3.h>
+
+/*
+ * Render threads own one context each and run commands posted to them in order. With a thread
+ * per window the frame's draws for every window execute in parallel, each thread swaps its own
+ * window so vsync doesn't make windows wait on each other, and the main thread never switches
+ * contexts.
+ *
+ * execute_draw_packets(), flush_stream_buffers(), advance_stream_buffers() and the texture
+ * streaming send the work for owned contexts to their threads on their own, so does
+ * execute_render_graph(). A context current on the thread starting its render thread stays
+ * current there until the first command gets posted, so setup right after creating a window
+ * just works. Later gl calls on the main thread need make_context_current() first, which borrows
+ * the context back and waits for the thread's queue to drain, and the next posted command hands
+ * it back. That's meant for setup and loading, not every frame.
+ *
+ * Commands are posted from the main thread, and by get_default_stream() from render systems while
+ * the main thread waits for them.
+ */
+
+#define RENDER_QUEUE_SIZE 256
+
+typedef void (*render_command_t)(void* data);
+
+typedef struct render_thread_t render_thread_t;
+
+// takes the context over with the first posted command, it mustn't be current on any other thread
+render_thread_t* start_render_thread(GLFWwindow* context);
+// runs what's queued, then releases the context
+void stop_render_thread(render_thread_t* thread);
+
+// blocks while the queue is full, data has to stay valid until the command ran
+void post_render_command(render_thread_t* thread, render_command_t command, void* data);
+// until every posted command ran
+void wait_render_thread(render_thread_t* thread);
+
+// called about every interval_ms while the main thread waits in wait_render_thread(), NULL turns it off
+void set_render_wait_hook(void (*hook)(), double interval_ms);
+// the only thread the wait hook runs on, init_windowing() sets it to the one initializing glfw
+void set_render_main_thread(pthread_t thread);
+
+// NULL when no thread owns the context
+render_thread_t* get_render_thread(GLFWwindow* context);
+// NULL off render threads
+render_thread_t* get_current_render_thread();
+// called by make_context_current() before taking a context on this thread
+void borrow_render_context(GLFWwindow* context);
+
+#endif
@@ -0,0 +1,332 @@
+#include "graphics/stream_buffer.h"
+#include "core/log.h"
+#include "core/systems.h"
+#include "graphics/render_thread.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+static stream_buffer_t** streams = NULL;
+static uint32_t stream_count = 0;
+
+// default streams are owned by this file, one per context
+static stream_buffer_t** default_streams = NULL;
+static uint32_t default_stream_count = 0;
+
+// render threads create and walk streams of their own contexts at the same time
+static pthread_mutex_t stream_lock = PTHREAD_MUTEX_INITIALIZER;
+// held while a default stream is created, render systems asking for the same one wait for it
+static pthread_mutex_t default_stream_lock = PTHREAD_MUTEX_INITIALIZER;
+
+stream_buffer_t* create_stream_buffer(size_t size) {
+    stream_buffer_t* stream = calloc(1, sizeof(stream_buffer_t));
+    stream->context = get_current_context();
+    stream->size = size;
+    atomic_init(&stream->head, 0);
+
+    size_t total = size * STREAM_REGIONS;
+
+    glGenBuffers(1, &stream->buffer);
+    bind_buffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+
+    if (has_buffer_storage()) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        buffer_storage(GL_COPY_WRITE_BUFFER, total, NULL, flags);
+        stream->mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total, flags);
+    }
+
+    if (stream->mapped == NULL) {
+        glBufferData(GL_COPY_WRITE_BUFFER, total, NULL, GL_STREAM_DRAW);
+        stream->staging = malloc(size);
+    }
+
+    pthread_mutex_lock(&stream_lock);
+    streams = realloc(streams, (stream_count + 1) * sizeof(stream_buffer_t*));
+    streams[stream_count++] = stream;
+    pthread_mutex_unlock(&stream_lock);
+
+    TRACE("Created %s stream buffer with %d byte regions.", stream->mapped ? "persistent" : "staged", (int)size);
+
+    return stream;
+}
+
+static void unregister_stream(stream_buffer_t* stream) {
+    pthread_mutex_lock(&stream_lock);
+    for (uint32_t i = 0; i < stream_count; i++) {
+        if (streams[i] == stream) {
+            streams[i] = streams[--stream_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&stream_lock);
+}
+
+void destroy_stream_buffer(stream_buffer_t* stream) {
+    unregister_stream(stream);
+
+    for (uint32_t i = 0; i < STREAM_REGIONS; i++) {
+        if (stream->fences[i] != NULL) {
+            glDeleteSync(stream->fences[i]);
+        }
+    }
+
+    // also unmaps
+    glDeleteBuffers(1, &stream->buffer);
+    invalidate_gl_state();
+
+    free(stream->staging);
+    free(stream);
+}
+
+void release_stream_buffer(stream_buffer_t* stream) {
+    if (stream == NULL) {
+        return;
+    }
+
+    unregister_stream(stream);
+    free(stream->staging);
+    free(stream);
+}
+
+void forget_stream_buffers(GLFWwindow* context) {
+    stream_buffer_t* default_stream = NULL;
+
+    pthread_mutex_lock(&stream_lock);
+    for (uint32_t i = 0; i < default_stream_count; i++) {
+        if (default_streams[i]->context == context) {
+            default_stream = default_streams[i];
+            default_streams[i] = default_streams[--default_stream_count];
+            break;
+        }
+    }
+
+    for (uint32_t i = 0; i < stream_count;) {
+        if (streams[i]->context == context) {
+            streams[i] = streams[--stream_count];
+        } else {
+            i++;
+        }
+    }
+    pthread_mutex_unlock(&stream_lock);
+
+    if (default_stream != NULL) {
+        free(default_stream->staging);
+        free(default_stream);
+    }
+}
+
+stream_alloc_t stream_buffer_alloc(stream_buffer_t* stream, size_t size, size_t align) {
+    align = align ? align : 1;
+
+    // the region starts at a multiple of its size, so aligning the head aligns the offset as long as size is
+    size_t head = atomic_load_explicit(&stream->head, memory_order_relaxed);
+    size_t start;
+    do {
+        start = (head + align - 1) / align * align;
+        if (start + size > stream->size) {
+            ERROR("Stream buffer region of %d bytes is full.", (int)stream->size);
+            return (stream_alloc_t){ .data = NULL, .buffer = stream->buffer };
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&stream->head, &head, start + size, memory_order_relaxed, memory_order_relaxed));
+
+    size_t region_offset = stream->region * stream->size;
+
+    return (stream_alloc_t){
+        .data = stream->mapped ? stream->mapped + region_offset + start : stream->staging + start,
+        .buffer = stream->buffer,
+        .offset = region_offset + start,
+    };
+}
+
+void stream_buffer_flush(stream_buffer_t* stream) {
+    size_t head = atomic_load(&stream->head);
+    if (stream->mapped != NULL || head == stream->flushed) {
+        return;
+    }
+
+    bind_buffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, stream->region * stream->size + stream->flushed, head - stream->flushed, stream->staging + stream->flushed);
+    stream->flushed = head;
+}
+
+static void advance_stream(stream_buffer_t* stream) {
+    if (atomic_load(&stream->head) == 0) {
+        return; // nothing written this frame, the region can be reused as is
+    }
+
+    stream->fences[stream->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream->region = (stream->region + 1) % STREAM_REGIONS;
+    atomic_store(&stream->head, 0);
+    stream->flushed = 0;
+
+    // the next region was last used STREAM_REGIONS - 1 frames ago, this usually returns right away
+    GLsync fence = stream->fences[stream->region];
+    if (fence != NULL) {
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+            WARN("Waiting on stream buffer fence.");
+        }
+        glDeleteSync(fence);
+        stream->fences[stream->region] = NULL;
+    }
+}
+
+static stream_buffer_t* find_default_stream(GLFWwindow* context) {
+    stream_buffer_t* stream = NULL;
+
+    pthread_mutex_lock(&stream_lock);
+    for (uint32_t i = 0; i < default_stream_count; i++) {
+        if (default_streams[i]->context == context) {
+            stream = default_streams[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&stream_lock);
+
+    return stream;
+}
+
+// on a thread with the context current
+static void create_default_stream(void* data) {
+    (void)data;
+    stream_buffer_t* stream = create_stream_buffer(DEFAULT_STREAM_SIZE);
+
+    pthread_mutex_lock(&stream_lock);
+    default_streams = realloc(default_streams, (default_stream_count + 1) * sizeof(stream_buffer_t*));
+    default_streams[default_stream_count++] = stream;
+    pthread_mutex_unlock(&stream_lock);
+}
+
+stream_buffer_t* get_default_stream(GLFWwindow* context) {
+    stream_buffer_t* stream = find_default_stream(context);
+    if (stream != NULL) {
+        return stream;
+    }
+
+    pthread_mutex_lock(&default_stream_lock);
+    if (find_default_stream(context) == NULL) {
+        render_thread_t* thread = get_render_thread(context);
+        if (get_current_context() == context) {
+            create_default_stream(NULL);
+        } else if (thread != NULL) {
+            post_render_command(thread, create_default_stream, NULL);
+            wait_render_thread(thread);
+        } else {
+            make_context_current(context);
+            create_default_stream(NULL);
+        }
+    }
+    pthread_mutex_unlock(&default_stream_lock);
+
+    return find_default_stream(context);
+}
+
+stream_alloc_t stream_alloc(GLFWwindow* context, size_t size, size_t align) {
+    return stream_buffer_alloc(get_default_stream(context), size, align);
+}
+
+static int needs_flush(const stream_buffer_t* stream) {
+    return atomic_load(&stream->head) != stream->flushed && stream->mapped == NULL;
+}
+
+static int needs_advance(const stream_buffer_t* stream) {
+    return atomic_load(&stream->head) != 0;
+}
+
+// the streams of a context that need work, the lock isn't held while they're flushed or waited on
+static uint32_t collect_streams(GLFWwindow* context, int (*filter)(const stream_buffer_t*), stream_buffer_t*** out) {
+    pthread_mutex_lock(&stream_lock);
+    *out = malloc((stream_count ? stream_count : 1) * sizeof(stream_buffer_t*));
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < stream_count; i++) {
+        if (streams[i]->context == context && filter(streams[i])) {
+            (*out)[count++] = streams[i];
+        }
+    }
+    pthread_mutex_unlock(&stream_lock);
+    return count;
+}
+
+static void flush_context_streams(void* context) {
+    stream_buffer_t** list;
+    uint32_t count = collect_streams(context, needs_flush, &list);
+    for (uint32_t i = 0; i < count; i++) {
+        stream_buffer_flush(list[i]);
+    }
+    free(list);
+}
+
+static void advance_context_streams(void* context) {
+    stream_buffer_t** list;
+    uint32_t count = collect_streams(context, needs_advance, &list);
+    for (uint32_t i = 0; i < count; i++) {
+        advance_stream(list[i]);
+    }
+    free(list);
+}
+
+// runs the command once for every context with a stream that needs it, on the context's render thread if it has one
+static void run_for_stream_contexts(int (*filter)(const stream_buffer_t*), render_command_t command, int wait) {
+    pthread_mutex_lock(&stream_lock);
+    GLFWwindow** contexts = malloc((stream_count ? stream_count : 1) * sizeof(GLFWwindow*));
+    uint32_t context_count = 0;
+    for (uint32_t i = 0; i < stream_count; i++) {
+        if (!filter(streams[i])) {
+            continue;
+        }
+        uint32_t j = 0;
+        while (j < context_count && contexts[j] != streams[i]->context) {
+            j++;
+        }
+        if (j == context_count) {
+            contexts[context_count++] = streams[i]->context;
+        }
+    }
+    pthread_mutex_unlock(&stream_lock);
+
+    for (uint32_t i = 0; i < context_count; i++) {
+        render_thread_t* thread = get_render_thread(contexts[i]);
+        if (thread != NULL) {
+            post_render_command(thread, command, contexts[i]);
+        } else {
+            make_context_current(contexts[i]);
+            command(contexts[i]);
+        }
+    }
+
+    for (uint32_t i = 0; i < context_count && wait; i++) {
+        render_thread_t* thread = get_render_thread(contexts[i]);
+        if (thread != NULL) {
+            wait_render_thread(thread);
+        }
+    }
+
+    free(contexts);
+}
+
+void flush_stream_buffers() {
+    // queued ahead of the draws on the same thread, no need to wait
+    run_for_stream_contexts(needs_flush, flush_context_streams, 0);
+}
+
+void advance_stream_buffers() {
+    // heads are reset, which can't race with allocations for the next frame
+    run_for_stream_contexts(needs_advance, advance_context_streams, 1);
+}
+
+// the gl objects go away with their contexts, which may already be destroyed here
+void cleanup_stream_buffers() {
+    for (uint32_t i = 0; i < default_stream_count; i++) {
+        free(default_streams[i]->staging);
+        free(default_streams[i]);
+    }
+    free(default_streams);
+    default_streams = NULL;
+    default_stream_count = 0;
+
+    free(streams);
+    streams = NULL;
+    stream_count = 0;
+}
+
+REGISTER_SYSTEM(cleanup_stream_buffers, CLEANUP);
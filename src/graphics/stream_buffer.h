@@ -0,0 +1,70 @@
+#ifndef OVERTURE_STREAM_BUFFER
+#define OVERTURE_STREAM_BUFFER
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "graphics/opengl.h"
+
+/*
+ * Streaming buffers for data that is rewritten every frame. The buffer is split into
+ * STREAM_REGIONS regions of `size` bytes, each frame allocates linearly from one region and
+ * fences it once its draws are issued, so the cpu only waits when the gpu is more than
+ * STREAM_REGIONS - 1 frames behind.
+ *
+ * With glBufferStorage the buffer is persistently and coherently mapped and allocations are
+ * plain memory, otherwise they go to a staging copy that is uploaded on flush. Allocating is
+ * lock free and may happen from any thread, everything else needs the stream's context.
+ *
+ * Allocations are only valid for the frame they were made in, bind them with the returned
+ * buffer and offset (or as base vertex / first index on a vertex array using the buffer).
+ */
+
+#define STREAM_REGIONS 3
+
+#ifndef DEFAULT_STREAM_SIZE
+#define DEFAULT_STREAM_SIZE (4 << 20)
+#endif
+
+typedef struct {
+    GLFWwindow* context;
+    uint32_t buffer;
+    size_t size; // of one region
+    uint8_t* mapped; // all regions, NULL without buffer storage
+    uint8_t* staging; // one region, only without buffer storage
+    uint32_t region;
+    _Atomic size_t head;
+    size_t flushed;
+    GLsync fences[STREAM_REGIONS];
+} stream_buffer_t;
+
+typedef struct {
+    void* data; // NULL when the region is full
+    uint32_t buffer;
+    size_t offset; // from the start of the buffer
+} stream_alloc_t;
+
+// created on the current context
+stream_buffer_t* create_stream_buffer(size_t size);
+void destroy_stream_buffer(stream_buffer_t* stream);
+// frees the stream without any gl calls, for when its context is already gone
+void release_stream_buffer(stream_buffer_t* stream);
+// drops every stream of a context that is about to be destroyed, frees its default stream
+void forget_stream_buffers(GLFWwindow* context);
+
+stream_alloc_t stream_buffer_alloc(stream_buffer_t* stream, size_t size, size_t align);
+// uploads what was allocated since the last flush, does nothing when mapped
+void stream_buffer_flush(stream_buffer_t* stream);
+
+// allocates from the default stream of the context, usually the one a draw packet goes to. The
+// stream is created on first use, by the context's render thread if it has one, so render
+// systems on any thread can allocate
+stream_alloc_t stream_alloc(GLFWwindow* context, size_t size, size_t align);
+stream_buffer_t* get_default_stream(GLFWwindow* context);
+
+// called by the render queue around executing draws, flush uploads and advance fences the
+// current region and moves every stream on to the next one
+void flush_stream_buffers();
+void advance_stream_buffers();
+
+#endif
@@ -0,0 +1,172 @@
+#include "graphics/texture_file.h"
+#include "core/log.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static size_t align16(size_t v) {
+    return (v + 15) & ~(size_t)15;
+}
+
+static uint32_t level_dim(uint32_t size, uint32_t level) {
+    return size >> level ? size >> level : 1;
+}
+
+int save_texture_file(const char* path, bc_format_t format, uint32_t flags, uint32_t width, uint32_t height, uint32_t levels,
+                      const uint8_t* const* level_data) {
+    if (levels == 0 || levels > MAX_TEXTURE_FILE_LEVELS || levels > get_mip_count(width, height)) {
+        ERROR("Can't save %d levels of a %dx%d texture.", levels, width, height);
+        return 0;
+    }
+
+    texture_file_header_t header = {
+        .magic = TEXTURE_FILE_MAGIC,
+        .version = TEXTURE_FILE_VERSION,
+        .format = format,
+        .flags = flags,
+        .width = width,
+        .height = height,
+        .levels = levels,
+    };
+
+    size_t offset = align16(sizeof(header));
+    for (uint32_t level = 0; level < levels; level++) {
+        header.level_offsets[level] = offset;
+        header.level_sizes[level] = get_bc_level_size(format, level_dim(width, level), level_dim(height, level));
+        offset = align16(offset + header.level_sizes[level]);
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        ERROR("Failed to open %s for writing.", path);
+        return 0;
+    }
+
+    uint8_t padding[16] = {0};
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    size_t written = sizeof(header);
+    for (uint32_t level = 0; level < levels && ok; level++) {
+        ok = fwrite(padding, header.level_offsets[level] - written, 1, file) <= 1 &&
+             fwrite(level_data[level], header.level_sizes[level], 1, file) == 1;
+        written = header.level_offsets[level] + header.level_sizes[level];
+    }
+
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        ERROR("Failed to write texture %s.", path);
+        return 0;
+    }
+
+    TRACE("Saved %dx%d texture %s with %d levels.", width, height, path, levels);
+    return 1;
+}
+
+int open_texture_file(const char* path, texture_file_t* file) {
+    memset(file, 0, sizeof(texture_file_t));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ERROR("Failed to open texture %s.", path);
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(texture_file_header_t)) {
+        ERROR("Texture %s is too small.", path);
+        close(fd);
+        return 0;
+    }
+
+    void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file alive
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        ERROR("Failed to map texture %s.", path);
+        return 0;
+    }
+
+    // every level is read once front to back on upload, the advice values aren't flags
+    madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+    madvise(mapping, st.st_size, MADV_WILLNEED);
+
+    const texture_file_header_t* header = mapping;
+    size_t size = st.st_size;
+    int valid = header->magic == TEXTURE_FILE_MAGIC && header->version == TEXTURE_FILE_VERSION && header->format <= BC7_RGBA &&
+                header->width > 0 && header->height > 0 && header->levels > 0 && header->levels <= MAX_TEXTURE_FILE_LEVELS &&
+                header->levels <= get_mip_count(header->width, header->height);
+
+    for (uint32_t level = 0; valid && level < header->levels; level++) {
+        size_t expected = get_bc_level_size(header->format, level_dim(header->width, level), level_dim(header->height, level));
+        valid = header->level_sizes[level] == expected && header->level_offsets[level] % 16 == 0 &&
+                (uint64_t)header->level_offsets[level] + header->level_sizes[level] <= size;
+    }
+
+    if (!valid) {
+        ERROR("%s is not a valid version %d texture.", path, TEXTURE_FILE_VERSION);
+        munmap(mapping, size);
+        return 0;
+    }
+
+    file->header = header;
+    file->mapping = mapping;
+    file->size = size;
+
+    TRACE("Mapped %dx%d texture %s with %d levels.", header->width, header->height, path, header->levels);
+    return 1;
+}
+
+void close_texture_file(texture_file_t* file) {
+    if (file->mapping != NULL) {
+        munmap(file->mapping, file->size);
+    }
+    memset(file, 0, sizeof(texture_file_t));
+}
+
+const uint8_t* get_texture_file_level(const texture_file_t* file, uint32_t level) {
+    return (const uint8_t*)file->mapping + file->header->level_offsets[level];
+}
+
+GLenum get_bc_internal_format(bc_format_t format, int srgb) {
+    switch (format) {
+    case BC1_RGB:
+        return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BC3_RGBA:
+        return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BC5_RG:
+        return GL_COMPRESSED_RG_RGTC2;
+    case BC7_RGBA:
+        return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return 0;
+}
+
+texture_t create_texture_from_file(const texture_file_t* file) {
+    const texture_file_header_t* header = file->header;
+    texture_t texture = create_texture(header->width, header->height, header->levels,
+                                       get_bc_internal_format(header->format, header->flags & TEXTURE_FILE_SRGB));
+
+    // pointers into the mapping are only read as client memory without an unpack buffer
+    bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    for (uint32_t level = 0; level < header->levels; level++) {
+        upload_compressed_texture_level(&texture, level, get_texture_file_level(file, level), header->level_sizes[level]);
+    }
+
+    return texture;
+}
+
+texture_t load_texture_file(const char* path) {
+    texture_file_t file;
+    if (!open_texture_file(path, &file)) {
+        return (texture_t){0};
+    }
+
+    texture_t texture = create_texture_from_file(&file);
+    close_texture_file(&file);
+    return texture;
+}
@@ -0,0 +1,69 @@
+#ifndef OVERTURE_TEXTURE_FILE
+#define OVERTURE_TEXTURE_FILE
+
+#include <stddef.h>
+#include <stdint.h>
+#include "graphics/bcn.h"
+#include "graphics/opengl.h"
+
+/*
+ * Block compressed texture format, written offline by save_texture_file() (see
+ * tools/texture_convert) and mapped with mmap at runtime. Levels are stored finest first, each
+ * 16 byte aligned, in the layout glCompressedTexSubImage2D takes, so create_texture_from_file()
+ * hands pointers into the mapping straight to gl without decoding or copying anything.
+ *
+ * BC1 and BC3 need GL_EXT_texture_compression_s3tc, which every desktop driver has but glad
+ * doesn't define, BC5 (rgtc) and BC7 (bptc) are core in 4.3.
+ */
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+#define TEXTURE_FILE_MAGIC 0x5854564f // "OVTX"
+#define TEXTURE_FILE_VERSION 1
+#define MAX_TEXTURE_FILE_LEVELS 16
+
+#define TEXTURE_FILE_SRGB 0x1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format; // bc_format_t
+    uint32_t flags;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+    uint32_t reserved;
+    uint32_t level_offsets[MAX_TEXTURE_FILE_LEVELS]; // from the start of the file
+    uint32_t level_sizes[MAX_TEXTURE_FILE_LEVELS];
+} texture_file_header_t;
+
+typedef struct {
+    const texture_file_header_t* header;
+    void* mapping;
+    size_t size;
+} texture_file_t;
+
+// levels holds get_bc_level_size() bytes for each level, finest first, returns 0 on failure
+int save_texture_file(const char* path, bc_format_t format, uint32_t flags, uint32_t width, uint32_t height, uint32_t levels,
+                      const uint8_t* const* level_data);
+
+// maps the file, returns 0 when it can't be read or isn't a valid texture
+int open_texture_file(const char* path, texture_file_t* file);
+void close_texture_file(texture_file_t* file);
+
+const uint8_t* get_texture_file_level(const texture_file_t* file, uint32_t level);
+GLenum get_bc_internal_format(bc_format_t format, int srgb);
+
+// on the current context with every level uploaded, the file can be closed afterwards
+texture_t create_texture_from_file(const texture_file_t* file);
+// opens, uploads and closes, the texture id is 0 on failure
+texture_t load_texture_file(const char* path);
+
+#endif
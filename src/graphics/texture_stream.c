@@ -0,0 +1,609 @@
+#include "graphics/texture_stream.h"
+#include "core/log.h"
+#include "core/systems.h"
+#include "graphics/image.h"
+#include "graphics/render_thread.h"
+#include "graphics/stream_buffer.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_TEXTURE_LEVELS 16
+
+typedef struct texture_entry_t {
+    char* path;
+    uint32_t flags;
+    GLFWwindow* context;
+    texture_state_t state;
+    int unloaded; // while decoding, the worker frees the entry when it's done
+    struct texture_entry_t* next; // in the decode queue
+
+    // written by a worker before the entry is marked decoded
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels;
+    uint32_t level_count;
+    size_t level_offsets[MAX_TEXTURE_LEVELS];
+    uint8_t* staging;
+    size_t staging_size;
+
+    // with the lock held once decoded, written by whichever thread owns the context
+    texture_t texture;
+    uint32_t resident; // finest complete level, level_count while there is none
+    uint32_t wanted;
+    uint32_t next_row; // of level resident - 1
+} texture_entry_t;
+
+// everything gl happens on the thread owning the context, its render thread when it has one
+typedef struct {
+    GLFWwindow* context;
+    stream_buffer_t* stream; // created by the first pass
+    int posted; // a pass is queued on the render thread
+} upload_context_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+
+static texture_entry_t** entries = NULL;
+static uint32_t entry_count = 0;
+static texture_entry_t* queue_head = NULL;
+static texture_entry_t* queue_tail = NULL;
+static uint32_t decoding = 0;
+
+static pthread_t workers[TEXTURE_WORKERS];
+static uint32_t worker_count = 0;
+static int quit = 0;
+
+static upload_context_t** upload_contexts = NULL;
+static uint32_t upload_context_count = 0;
+
+static size_t upload_budget = TEXTURE_UPLOAD_BUDGET;
+static size_t budget_left = 0; // shared by this frame's passes
+static size_t uploaded_bytes = 0;
+static size_t total_uploaded_bytes = 0;
+
+static uint32_t level_width(const texture_entry_t* entry, uint32_t level) {
+    return entry->width >> level ? entry->width >> level : 1;
+}
+
+static uint32_t level_height(const texture_entry_t* entry, uint32_t level) {
+    return entry->height >> level ? entry->height >> level : 1;
+}
+
+static void free_entry(texture_entry_t* entry) {
+    free(entry->path);
+    free(entry->staging);
+    free(entry);
+}
+
+static int decode_entry(texture_entry_t* entry) {
+    image_t image;
+    if (!load_image(entry->path, &image)) {
+        return 0;
+    }
+
+    entry->width = image.width;
+    entry->height = image.height;
+    entry->channels = image.channels;
+    entry->level_count = entry->flags & TEXTURE_NO_MIPS ? 1 : get_mip_count(image.width, image.height);
+    entry->level_count = entry->level_count < MAX_TEXTURE_LEVELS ? entry->level_count : MAX_TEXTURE_LEVELS;
+
+    size_t size = 0;
+    for (uint32_t level = 0; level < entry->level_count; level++) {
+        entry->level_offsets[level] = size;
+        size += (size_t)level_width(entry, level) * level_height(entry, level) * entry->channels;
+    }
+
+    // the whole chain in one block, every level filtered from the one above it
+    entry->staging = malloc(size);
+    entry->staging_size = size;
+    memcpy(entry->staging, image.pixels, (size_t)image.width * image.height * image.channels);
+    free_image(&image);
+
+    for (uint32_t level = 1; level < entry->level_count; level++) {
+        image_t src = {
+            .width = level_width(entry, level - 1),
+            .height = level_height(entry, level - 1),
+            .channels = entry->channels,
+            .pixels = entry->staging + entry->level_offsets[level - 1],
+        };
+        image_t dst = { .pixels = entry->staging + entry->level_offsets[level] };
+        downsample_image(&src, &dst, entry->flags & TEXTURE_SRGB);
+    }
+
+    // only levels up to the tail are uploaded without being asked for
+    entry->wanted = entry->level_count - 1;
+    while (!(entry->flags & TEXTURE_LOAD_ALL) && entry->wanted > 0 &&
+           level_width(entry, entry->wanted - 1) <= TEXTURE_STREAM_TAIL && level_height(entry, entry->wanted - 1) <= TEXTURE_STREAM_TAIL) {
+        entry->wanted--;
+    }
+    if (entry->flags & TEXTURE_LOAD_ALL) {
+        entry->wanted = 0;
+    }
+
+    return 1;
+}
+
+static void* decode_worker(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&lock);
+
+    while (1) {
+        while (queue_head == NULL && !quit) {
+            pthread_cond_wait(&work_cond, &lock);
+        }
+        if (queue_head == NULL) {
+            break;
+        }
+
+        texture_entry_t* entry = queue_head;
+        queue_head = entry->next;
+        queue_tail = queue_head ? queue_tail : NULL;
+        entry->state = TEXTURE_DECODING;
+        decoding++;
+
+        pthread_mutex_unlock(&lock);
+        int ok = decode_entry(entry);
+        pthread_mutex_lock(&lock);
+
+        decoding--;
+        if (entry->unloaded) {
+            free_entry(entry);
+        } else {
+            entry->state = ok ? TEXTURE_DECODED : TEXTURE_FAILED;
+        }
+
+        if (queue_head == NULL && decoding == 0) {
+            pthread_cond_broadcast(&idle_cond);
+        }
+    }
+
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+// with the lock held
+static void start_workers() {
+    if (worker_count != 0) {
+        return;
+    }
+
+    // one core is left for the main thread
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t count = cpus > 2 ? (uint32_t)cpus - 1 : 1;
+    count = count < TEXTURE_WORKERS ? count : TEXTURE_WORKERS;
+
+    quit = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (pthread_create(&workers[worker_count], NULL, decode_worker, NULL) == 0) {
+            worker_count++;
+        }
+    }
+
+    TRACE("Started %d texture decode workers.", worker_count);
+}
+
+// on the thread owning the entry's context
+static void destroy_entry(void* data) {
+    texture_entry_t* entry = data;
+    if (entry->texture.id != 0) {
+        destroy_texture(&entry->texture);
+    }
+    free_entry(entry);
+}
+
+texture_handle_t load_texture(const char* path, uint32_t flags) {
+    texture_entry_t* entry = calloc(1, sizeof(texture_entry_t));
+    entry->path = strdup(path);
+    entry->flags = flags;
+    entry->context = get_current_context();
+    entry->state = TEXTURE_QUEUED;
+
+    pthread_mutex_lock(&lock);
+    start_workers();
+
+    entries = realloc(entries, (entry_count + 1) * sizeof(texture_entry_t*));
+    entries[entry_count] = entry;
+    texture_handle_t handle = { .id = entry_count++ };
+
+    if (queue_tail != NULL) {
+        queue_tail->next = entry;
+    } else {
+        queue_head = entry;
+    }
+    queue_tail = entry;
+
+    pthread_cond_signal(&work_cond);
+    pthread_mutex_unlock(&lock);
+
+    TRACE("Queued texture %s.", path);
+    return handle;
+}
+
+// with the lock held
+static texture_entry_t* get_entry(texture_handle_t handle) {
+    return handle.id < entry_count ? entries[handle.id] : NULL;
+}
+
+void unload_texture(texture_handle_t handle) {
+    pthread_mutex_lock(&lock);
+
+    texture_entry_t* entry = get_entry(handle);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    entries[handle.id] = NULL;
+
+    if (entry->state == TEXTURE_DECODING) {
+        entry->unloaded = 1;
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+
+    if (entry->state == TEXTURE_QUEUED) {
+        texture_entry_t* previous = NULL;
+        for (texture_entry_t* it = queue_head; it != NULL; previous = it, it = it->next) {
+            if (it == entry) {
+                *(previous ? &previous->next : &queue_head) = entry->next;
+                queue_tail = queue_tail == entry ? previous : queue_tail;
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    // no pass sees the entry anymore, the texture only has to go after the queued ones
+    render_thread_t* thread = get_render_thread(entry->context);
+    if (entry->texture.id != 0 && thread != NULL) {
+        post_render_command(thread, destroy_entry, entry);
+        return;
+    }
+    if (entry->texture.id != 0) {
+        make_context_current(entry->context);
+    }
+    destroy_entry(entry);
+}
+
+texture_state_t get_texture_state(texture_handle_t handle) {
+    pthread_mutex_lock(&lock);
+    texture_entry_t* entry = get_entry(handle);
+    texture_state_t state = entry ? entry->state : TEXTURE_FAILED;
+    pthread_mutex_unlock(&lock);
+    return state;
+}
+
+uint32_t get_texture(texture_handle_t handle, uint32_t* level) {
+    pthread_mutex_lock(&lock);
+
+    texture_entry_t* entry = get_entry(handle);
+    uint32_t id = 0;
+    if (entry != NULL && (entry->state == TEXTURE_STREAMING || entry->state == TEXTURE_RESIDENT) &&
+        entry->resident < entry->level_count) {
+        id = entry->texture.id;
+        if (level != NULL) {
+            *level = entry->resident;
+        }
+    }
+
+    pthread_mutex_unlock(&lock);
+    return id;
+}
+
+const texture_t* get_texture_info(texture_handle_t handle) {
+    pthread_mutex_lock(&lock);
+    texture_entry_t* entry = get_entry(handle);
+    const texture_t* texture = entry && entry->texture.id != 0 ? &entry->texture : NULL;
+    pthread_mutex_unlock(&lock);
+    return texture;
+}
+
+void request_texture_level(texture_handle_t handle, uint32_t level) {
+    pthread_mutex_lock(&lock);
+
+    texture_entry_t* entry = get_entry(handle);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+
+    // not decoded yet, the request is applied once the chain exists
+    if (entry->state == TEXTURE_QUEUED || entry->state == TEXTURE_DECODING) {
+        entry->flags |= level == 0 ? TEXTURE_LOAD_ALL : 0;
+    } else if (level < entry->wanted) {
+        entry->wanted = level;
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+uint32_t get_texture_level_for_size(texture_handle_t handle, float pixels) {
+    pthread_mutex_lock(&lock);
+
+    texture_entry_t* entry = get_entry(handle);
+    uint32_t level = 0;
+    if (entry != NULL && entry->level_count > 0 && entry->state != TEXTURE_QUEUED && entry->state != TEXTURE_DECODING) {
+        // the coarsest level that still has a texel for every pixel
+        uint32_t size = entry->width > entry->height ? entry->width : entry->height;
+        while (level + 1 < entry->level_count && (float)(size >> (level + 1)) >= pixels) {
+            level++;
+        }
+    }
+
+    pthread_mutex_unlock(&lock);
+    return level;
+}
+
+void set_texture_upload_budget(size_t bytes) {
+    upload_budget = bytes;
+}
+
+texture_stream_stats_t get_texture_stream_stats() {
+    texture_stream_stats_t stats = {0};
+
+    pthread_mutex_lock(&lock);
+    stats.uploaded_bytes = uploaded_bytes;
+    stats.total_uploaded_bytes = total_uploaded_bytes;
+    for (uint32_t i = 0; i < entry_count; i++) {
+        texture_entry_t* entry = entries[i];
+        if (entry == NULL) {
+            continue;
+        }
+        stats.queued += entry->state == TEXTURE_QUEUED;
+        stats.decoding += entry->state == TEXTURE_DECODING;
+        stats.streaming += entry->state == TEXTURE_STREAMING || entry->state == TEXTURE_DECODED;
+        stats.resident += entry->state == TEXTURE_RESIDENT;
+        stats.staging_bytes += entry->staging != NULL ? entry->staging_size : 0;
+    }
+    pthread_mutex_unlock(&lock);
+
+    return stats;
+}
+
+void wait_for_texture_decodes() {
+    pthread_mutex_lock(&lock);
+    while (queue_head != NULL || decoding != 0) {
+        pthread_cond_wait(&idle_cond, &lock);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+// with the lock held
+static upload_context_t* get_upload_context(GLFWwindow* context) {
+    for (uint32_t i = 0; i < upload_context_count; i++) {
+        if (upload_contexts[i]->context == context) {
+            return upload_contexts[i];
+        }
+    }
+
+    upload_context_t* upload = calloc(1, sizeof(upload_context_t));
+    upload->context = context;
+    upload_contexts = realloc(upload_contexts, (upload_context_count + 1) * sizeof(upload_context_t*));
+    upload_contexts[upload_context_count++] = upload;
+    return upload;
+}
+
+static void create_entry_texture(texture_entry_t* entry) {
+    GLenum format = entry->channels == 1 ? GL_R8 : (entry->flags & TEXTURE_SRGB ? GL_SRGB8_ALPHA8 : GL_RGBA8);
+
+    entry->texture = create_texture(entry->width, entry->height, entry->level_count, format);
+    entry->resident = entry->level_count;
+    entry->next_row = 0;
+    entry->state = TEXTURE_STREAMING;
+}
+
+static int wants_upload(const texture_entry_t* entry) {
+    return entry != NULL && entry->state == TEXTURE_STREAMING && entry->resident > entry->wanted;
+}
+
+// smallest missing level first, so every texture gets something drawable before large levels
+static texture_entry_t* next_upload(GLFWwindow* context) {
+    texture_entry_t* best = NULL;
+    uint64_t best_size = UINT64_MAX;
+
+    for (uint32_t i = 0; i < entry_count; i++) {
+        texture_entry_t* entry = entries[i];
+        if (!wants_upload(entry) || entry->context != context) {
+            continue;
+        }
+
+        uint32_t level = entry->resident - 1;
+        uint64_t size = (uint64_t)level_width(entry, level) * level_height(entry, level) * entry->channels;
+        if (size < best_size) {
+            best = entry;
+            best_size = size;
+        }
+    }
+
+    return best;
+}
+
+// uploads as many rows of the entry's next level as fit, returns the bytes used
+static size_t upload_band(texture_entry_t* entry, stream_buffer_t* stream, size_t budget, int force) {
+    uint32_t level = entry->resident - 1;
+    uint32_t width = level_width(entry, level), height = level_height(entry, level);
+    size_t row_bytes = (size_t)width * entry->channels;
+
+    size_t head = atomic_load(&stream->head);
+    size_t room = stream->size > head + 16 ? stream->size - head - 16 : 0;
+    budget = budget < room ? budget : room;
+
+    uint32_t rows = (uint32_t)(budget / row_bytes);
+    rows = rows < height - entry->next_row ? rows : height - entry->next_row;
+    if (rows == 0 && force && row_bytes <= room) {
+        rows = 1; // a single row over budget, still make progress
+    }
+    if (rows == 0) {
+        return 0;
+    }
+
+    size_t bytes = rows * row_bytes;
+    stream_alloc_t alloc = stream_buffer_alloc(stream, bytes, 16);
+    if (alloc.data == NULL) {
+        return 0;
+    }
+
+    memcpy(alloc.data, entry->staging + entry->level_offsets[level] + entry->next_row * row_bytes, bytes);
+    stream_buffer_flush(stream);
+
+    bind_buffer(GL_PIXEL_UNPACK_BUFFER, alloc.buffer);
+    upload_texture_rows(&entry->texture, level, entry->next_row, rows, entry->channels == 1 ? GL_RED : GL_RGBA,
+                        GL_UNSIGNED_BYTE, (const void*)alloc.offset);
+    bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    entry->next_row += rows;
+    if (entry->next_row == height) {
+        entry->resident = level;
+        entry->next_row = 0;
+        set_texture_level_range(&entry->texture, level, entry->level_count - 1);
+
+        if (level == 0) {
+            free(entry->staging);
+            entry->staging = NULL;
+            entry->state = TEXTURE_RESIDENT;
+            TRACE("Texture %s is resident.", entry->path);
+        }
+    }
+
+    return bytes;
+}
+
+// creates one context's decoded textures and uploads their next bands, on the thread owning it
+static void stream_context_textures(void* data) {
+    upload_context_t* upload = data;
+
+    // the main thread only takes the lock briefly, holding it over the uploads costs it little
+    pthread_mutex_lock(&lock);
+
+    if (upload->stream == NULL) {
+        upload->stream = create_stream_buffer(upload_budget);
+    }
+
+    for (uint32_t i = 0; i < entry_count; i++) {
+        if (entries[i] != NULL && entries[i]->state == TEXTURE_DECODED && entries[i]->context == upload->context) {
+            create_entry_texture(entries[i]);
+        }
+    }
+
+    size_t bytes = 0;
+    texture_entry_t* entry;
+    while (budget_left > 0 && (entry = next_upload(upload->context)) != NULL) {
+        size_t band = upload_band(entry, upload->stream, budget_left, uploaded_bytes == 0);
+        if (band == 0) {
+            break;
+        }
+        bytes += band;
+        uploaded_bytes += band;
+        budget_left = band < budget_left ? budget_left - band : 0;
+    }
+    total_uploaded_bytes += bytes;
+    upload->posted = 0;
+
+    pthread_mutex_unlock(&lock);
+
+    if (bytes != 0) {
+        TRACE("Uploaded %d bytes of texture data.", (int)bytes);
+    }
+}
+
+void update_texture_streaming() {
+    pthread_mutex_lock(&lock);
+
+    uploaded_bytes = 0;
+    budget_left = upload_budget;
+
+    if (entry_count == 0) {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+
+    // contexts with something to create or upload, each one gets a pass
+    upload_context_t** work = malloc((entry_count ? entry_count : 1) * sizeof(upload_context_t*));
+    uint32_t work_count = 0;
+    for (uint32_t i = 0; i < entry_count; i++) {
+        texture_entry_t* entry = entries[i];
+        if (entry == NULL || (entry->state != TEXTURE_DECODED && !wants_upload(entry))) {
+            continue;
+        }
+
+        upload_context_t* upload = get_upload_context(entry->context);
+        uint32_t j = 0;
+        while (j < work_count && work[j] != upload) {
+            j++;
+        }
+        if (j == work_count && !upload->posted) {
+            work[work_count++] = upload;
+        }
+    }
+
+    // queued ahead of the frame's draws, which see the uploads without this thread waiting
+    for (uint32_t i = 0; i < work_count; i++) {
+        work[i]->posted = get_render_thread(work[i]->context) != NULL;
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    for (uint32_t i = 0; i < work_count; i++) {
+        render_thread_t* thread = get_render_thread(work[i]->context);
+        if (thread != NULL) {
+            post_render_command(thread, stream_context_textures, work[i]);
+        } else {
+            make_context_current(work[i]->context);
+            stream_context_textures(work[i]);
+        }
+    }
+
+    free(work);
+}
+
+REGISTER_SYSTEM(update_texture_streaming, PRE_RENDER);
+
+// the gl objects go away with their contexts, which may already be destroyed here
+void cleanup_texture_streaming() {
+    pthread_mutex_lock(&lock);
+    while (queue_head != NULL) {
+        texture_entry_t* entry = queue_head;
+        queue_head = entry->next;
+        entry->state = TEXTURE_FAILED; // freed below with the rest
+    }
+    queue_tail = NULL;
+    quit = 1;
+    pthread_cond_broadcast(&work_cond);
+    pthread_mutex_unlock(&lock);
+
+    for (uint32_t i = 0; i < worker_count; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    worker_count = 0;
+
+    // passes still queued use the entries and contexts below
+    for (uint32_t i = 0; i < upload_context_count; i++) {
+        render_thread_t* thread = get_render_thread(upload_contexts[i]->context);
+        if (thread != NULL) {
+            wait_render_thread(thread);
+        }
+    }
+
+    for (uint32_t i = 0; i < entry_count; i++) {
+        if (entries[i] != NULL) {
+            free_entry(entries[i]);
+        }
+    }
+    free(entries);
+    entries = NULL;
+    entry_count = 0;
+
+    for (uint32_t i = 0; i < upload_context_count; i++) {
+        release_stream_buffer(upload_contexts[i]->stream);
+        free(upload_contexts[i]);
+    }
+    free(upload_contexts);
+    upload_contexts = NULL;
+    upload_context_count = 0;
+}
+
+REGISTER_SYSTEM(cleanup_texture_streaming, CLEANUP);
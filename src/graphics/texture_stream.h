@@ -0,0 +1,82 @@
+#ifndef OVERTURE_TEXTURE_STREAM
+#define OVERTURE_TEXTURE_STREAM
+
+#include <stddef.h>
+#include <stdint.h>
+#include "graphics/opengl.h"
+
+/*
+ * Asynchronous texture loading. load_texture() only queues the file, a pool of worker threads
+ * reads and decodes it and builds the whole mip chain in staging memory. update_texture_streaming()
+ * runs in PRE_RENDER, creates decoded textures on the context they were loaded from and uploads
+ * their levels through a pixel unpack stream buffer, at most TEXTURE_UPLOAD_BUDGET bytes a frame.
+ * A context owned by a render thread gets that work posted to it ahead of the frame's draws, the
+ * main thread never borrows it.
+ *
+ * Levels go up smallest first across all textures, so everything becomes drawable quickly before
+ * any large level is touched, and big levels are split into bands of rows spread over frames.
+ * Only levels up to TEXTURE_STREAM_TAIL texels are uploaded on their own, finer ones wait until
+ * request_texture_level() asks for them. GL_TEXTURE_BASE_LEVEL follows the finest complete
+ * level so partially streamed textures sample correctly.
+ *
+ * Storage is immutable, so the whole chain is allocated on the gpu when the texture is created.
+ * Streaming spreads out upload bandwidth and keeps big uploads from stalling a frame.
+ */
+
+#ifndef TEXTURE_UPLOAD_BUDGET
+#define TEXTURE_UPLOAD_BUDGET (8 << 20)
+#endif
+#define TEXTURE_STREAM_TAIL 128
+#define TEXTURE_WORKERS 4
+
+#define TEXTURE_SRGB 0x1
+#define TEXTURE_NO_MIPS 0x2
+// uploads every level without waiting for requests
+#define TEXTURE_LOAD_ALL 0x4
+
+typedef enum {
+    TEXTURE_QUEUED,
+    TEXTURE_DECODING,
+    TEXTURE_DECODED,
+    TEXTURE_STREAMING, // created, some levels uploaded
+    TEXTURE_RESIDENT, // every level uploaded, staging memory freed
+    TEXTURE_FAILED,
+} texture_state_t;
+
+typedef struct {
+    uint32_t id;
+} texture_handle_t;
+
+typedef struct {
+    uint32_t queued;
+    uint32_t decoding;
+    uint32_t streaming;
+    uint32_t resident;
+    size_t staging_bytes;
+    size_t uploaded_bytes; // last update
+    size_t total_uploaded_bytes;
+} texture_stream_stats_t;
+
+// on the current context, main thread only like the rest, only decoding happens on workers
+texture_handle_t load_texture(const char* path, uint32_t flags);
+void unload_texture(texture_handle_t handle);
+
+texture_state_t get_texture_state(texture_handle_t handle);
+// 0 until the smallest level is uploaded, level gets the finest level that can be sampled
+uint32_t get_texture(texture_handle_t handle, uint32_t* level);
+// NULL until the texture is created
+const texture_t* get_texture_info(texture_handle_t handle);
+
+// asks for every level down to this one, requests only ever add detail
+void request_texture_level(texture_handle_t handle, uint32_t level);
+// level whose size is closest to covering this many pixels on screen
+uint32_t get_texture_level_for_size(texture_handle_t handle, float pixels);
+
+void set_texture_upload_budget(size_t bytes);
+texture_stream_stats_t get_texture_stream_stats();
+// blocks until nothing is waiting to be decoded, for loading screens
+void wait_for_texture_decodes();
+
+void update_texture_streaming();
+
+#endif
@@ -0,0 +1,161 @@
+#include "platform/frame_pacer.h"
+#include "core/log.h"
+
+#include <GLFW/glfw3.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+static void sleep_seconds(double seconds) {
+    struct timespec ts = { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9) };
+    nanosleep(&ts, NULL);
+}
+
+void init_frame_pacer(frame_pacer_t* pacer, pacer_clock_t clock, pacer_sleep_t sleep, int enabled) {
+    memset(pacer, 0, sizeof(frame_pacer_t));
+    pthread_mutex_init(&pacer->lock, NULL);
+    pacer->clock = clock != NULL ? clock : glfwGetTime;
+    pacer->sleep = sleep != NULL ? sleep : sleep_seconds;
+    pacer->enabled = enabled;
+}
+
+void destroy_frame_pacer(frame_pacer_t* pacer) {
+    pthread_mutex_destroy(&pacer->lock);
+}
+
+static double window_max(const double* values, uint64_t count) {
+    uint64_t n = count < PACER_WINDOW ? count : PACER_WINDOW;
+    double max = 0.0;
+    for (uint64_t i = 0; i < n; i++) {
+        double value = values[(count - 1 - i) & (PACER_HISTORY - 1)];
+        max = value > max ? value : max;
+    }
+    return max;
+}
+
+double get_frame_start_delay(frame_pacer_t* pacer) {
+    pthread_mutex_lock(&pacer->lock);
+
+    // the first present has no interval
+    uint64_t count = pacer->presented > 0 ? pacer->presented - 1 : 0;
+    double delay = 0.0;
+    if (pacer->enabled && count > 0) {
+        // the shortest interval could be a multiple of the vblank while the frame rate is low
+        double interval = pacer->refresh;
+        uint64_t n = interval > 0.0 ? 0 : count < PACER_WINDOW ? count : PACER_WINDOW;
+        for (uint64_t i = 0; i < n; i++) {
+            double value = pacer->intervals[(pacer->presented - 1 - i) & (PACER_HISTORY - 1)];
+            interval = (interval == 0.0 || value < interval) && value > 0.0 ? value : interval;
+        }
+
+        double needed = window_max(pacer->cpu_times, pacer->presented) + window_max(pacer->gpu_times, pacer->presented) + PACER_MARGIN;
+        double start = pacer->last_present + (pacer->pending_count + 1) * interval - needed;
+        double now = pacer->clock();
+        while (start < now) {
+            start += interval;
+        }
+        delay = start - now;
+    }
+    pacer->last_delay = delay;
+
+    pthread_mutex_unlock(&pacer->lock);
+    return delay;
+}
+
+void begin_paced_frame(frame_pacer_t* pacer) {
+    pthread_mutex_lock(&pacer->lock);
+    pacer->frame_start = pacer->clock();
+    pthread_mutex_unlock(&pacer->lock);
+}
+
+void submit_paced_frame(frame_pacer_t* pacer) {
+    pthread_mutex_lock(&pacer->lock);
+    if (pacer->pending_count == PACER_MAX_QUEUED) {
+        WARN("More than %d frames waiting for their present, dropping the oldest.", PACER_MAX_QUEUED);
+        pacer->pending_head = (pacer->pending_head + 1) % PACER_MAX_QUEUED;
+        pacer->pending_count--;
+    }
+
+    uint32_t slot = (pacer->pending_head + pacer->pending_count) % PACER_MAX_QUEUED;
+    pacer->pending_starts[slot] = pacer->frame_start;
+    pacer->pending_submits[slot] = pacer->clock();
+    pacer->pending_count++;
+    pthread_mutex_unlock(&pacer->lock);
+}
+
+void present_paced_frame(frame_pacer_t* pacer, double draws_done, double present) {
+    pthread_mutex_lock(&pacer->lock);
+    if (pacer->pending_count == 0) {
+        pthread_mutex_unlock(&pacer->lock);
+        return;
+    }
+
+    double start = pacer->pending_starts[pacer->pending_head];
+    double submit = pacer->pending_submits[pacer->pending_head];
+    pacer->pending_head = (pacer->pending_head + 1) % PACER_MAX_QUEUED;
+    pacer->pending_count--;
+
+    uint32_t slot = pacer->presented & (PACER_HISTORY - 1);
+    pacer->intervals[slot] = pacer->presented > 0 ? present - pacer->last_present : 0.0;
+    pacer->latencies[slot] = present - start;
+    pacer->cpu_times[slot] = submit - start;
+    pacer->gpu_times[slot] = draws_done > submit ? draws_done - submit : 0.0;
+    pacer->last_present = present;
+    pacer->presented++;
+
+    pthread_mutex_unlock(&pacer->lock);
+}
+
+frame_timings_t get_frame_timings(frame_pacer_t* pacer) {
+    frame_timings_t timings = { 0 };
+
+    pthread_mutex_lock(&pacer->lock);
+    timings.delay = pacer->last_delay;
+    timings.frames = pacer->presented;
+
+    // the first present has no interval
+    uint64_t count = pacer->presented > 0 ? pacer->presented - 1 : 0;
+    uint64_t n = count < PACER_HISTORY ? count : PACER_HISTORY;
+    uint64_t latency_n = pacer->presented < PACER_HISTORY ? pacer->presented : PACER_HISTORY;
+
+    double sum = 0.0, sum_sq = 0.0;
+    for (uint64_t i = 0; i < n; i++) {
+        double interval = pacer->intervals[(pacer->presented - 1 - i) & (PACER_HISTORY - 1)];
+        timings.min = i == 0 || interval < timings.min ? interval : timings.min;
+        timings.max = interval > timings.max ? interval : timings.max;
+        sum += interval;
+        sum_sq += interval * interval;
+    }
+    for (uint64_t i = 0; i < latency_n; i++) {
+        timings.latency += pacer->latencies[(pacer->presented - 1 - i) & (PACER_HISTORY - 1)] / latency_n;
+    }
+    if (n > 0) {
+        timings.interval = pacer->intervals[(pacer->presented - 1) & (PACER_HISTORY - 1)];
+        timings.average = sum / n;
+        double variance = sum_sq / n - timings.average * timings.average;
+        timings.deviation = variance > 0.0 ? sqrt(variance) : 0.0;
+    }
+    pthread_mutex_unlock(&pacer->lock);
+
+    return timings;
+}
+
+void pace_frames(frame_pacer_t** pacers, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    // the window that needs to start first decides, the others start a bit early
+    double delay = get_frame_start_delay(pacers[0]);
+    for (uint32_t i = 1; i < count; i++) {
+        double window_delay = get_frame_start_delay(pacers[i]);
+        delay = window_delay < delay ? window_delay : delay;
+    }
+
+    if (delay > 0.0) {
+        pacers[0]->sleep(delay);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        begin_paced_frame(pacers[i]);
+    }
+}
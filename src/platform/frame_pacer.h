@@ -0,0 +1,91 @@
+#ifndef OVERTURE_FRAME_PACER
+#define OVERTURE_FRAME_PACER
+
+#include <pthread.h>
+#include <stdint.h>
+
+/*
+ * Frame pacing. Every swap is bracketed by two fences: the one before it signals when the gpu
+ * finished the frame's draws, the one after it when the frame was presented, with vsync that's
+ * the vblank it was shown at. Starting every frame right away lets frames queue up in front of
+ * the display, each one adding an interval of latency. The pacer delays the start of the next
+ * frame instead, so it's submitted just in time for the vblank after the ones already queued:
+ *
+ *     start = last present + (queued + 1) * interval - (cpu time + gpu time + margin)
+ *
+ * cpu time is frame start to submit and gpu time submit to draws done, both the largest of the
+ * last PACER_WINDOW frames. interval is the refresh period, or the shortest recent present to
+ * present when it isn't known. A frame that can't make that vblank anymore is aimed at the next
+ * one it can make, so a frame rate below the refresh rate settles on an even cadence instead of
+ * alternating between one and two vblanks.
+ *
+ * Submits come from the main thread, presents from whichever thread swaps. The clock and sleep
+ * can be replaced to test the pacing without a display.
+ */
+
+#define PACER_HISTORY 128 // power of two
+#define PACER_WINDOW 16 // frames the estimates look back, at most PACER_HISTORY
+#define PACER_MAX_QUEUED 8
+
+#ifndef PACER_MARGIN
+#define PACER_MARGIN 0.001 // seconds kept free before the vblank
+#endif
+
+typedef double (*pacer_clock_t)();
+typedef void (*pacer_sleep_t)(double seconds);
+
+typedef struct {
+    double interval; // present to present, of the last frame
+    double average;
+    double min;
+    double max;
+    double deviation; // standard deviation of the interval
+    double latency; // frame start to present, average
+    double delay; // frame start delay the pacer chose last
+    uint64_t frames; // presented
+} frame_timings_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pacer_clock_t clock;
+    pacer_sleep_t sleep;
+    int enabled; // measures either way, only delays when set
+    double refresh; // vblank period in seconds, 0 when unknown
+
+    // submitted and not yet presented, oldest first
+    double pending_starts[PACER_MAX_QUEUED];
+    double pending_submits[PACER_MAX_QUEUED];
+    uint32_t pending_head;
+    uint32_t pending_count;
+
+    double frame_start;
+    double last_present;
+    double last_delay;
+
+    // by presented frame, the last PACER_HISTORY
+    double intervals[PACER_HISTORY];
+    double latencies[PACER_HISTORY];
+    double cpu_times[PACER_HISTORY];
+    double gpu_times[PACER_HISTORY];
+    uint64_t presented;
+} frame_pacer_t;
+
+// NULL for the clock and sleep pick glfwGetTime() and nanosleep()
+void init_frame_pacer(frame_pacer_t* pacer, pacer_clock_t clock, pacer_sleep_t sleep, int enabled);
+void destroy_frame_pacer(frame_pacer_t* pacer);
+
+// seconds until the next frame should start, 0 when it's due or there's nothing to go by yet
+double get_frame_start_delay(frame_pacer_t* pacer);
+// marks the frame start, call after sleeping the delay
+void begin_paced_frame(frame_pacer_t* pacer);
+// the frame was handed to the swap, at most PACER_MAX_QUEUED may wait for their present
+void submit_paced_frame(frame_pacer_t* pacer);
+// the oldest submitted frame's draws were done at draws_done and it was presented at present
+void present_paced_frame(frame_pacer_t* pacer, double draws_done, double present);
+
+frame_timings_t get_frame_timings(frame_pacer_t* pacer);
+
+// sleeps the smallest delay of the pacers, the first one's sleep is used, then begins the frame on all
+void pace_frames(frame_pacer_t** pacers, uint32_t count);
+
+#endif
@@ -0,0 +1,151 @@
+#include "platform/input.h"
+#include "core/log.h"
+#include "core/resources.h"
+#include "core/systems.h"
+#include "graphics/render_thread.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+static input_event_t ring[INPUT_RING_SIZE];
+static _Atomic uint32_t ring_head = 0; // next slot written, only the producer stores it
+static _Atomic uint32_t ring_tail = 0; // next slot read, only the consumer stores it
+static _Atomic uint64_t dropped = 0;
+
+REGISTER_RESOURCE(input_state_t);
+
+static input_event_t* frame_events = NULL;
+static uint32_t frame_capacity = 0;
+
+int push_input_event(const input_event_t* event) {
+    uint32_t head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+    if (head - tail == INPUT_RING_SIZE) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return 0;
+    }
+
+    ring[head & (INPUT_RING_SIZE - 1)] = *event;
+    atomic_store_explicit(&ring_head, head + 1, memory_order_release);
+    return 1;
+}
+
+static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    (void)scancode;
+    input_event_t event = { INPUT_KEY, glfwGetTime(), window, key, action, mods, 0.0, 0.0 };
+    push_input_event(&event);
+}
+
+static void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+    input_event_t event = { INPUT_MOUSE_BUTTON, glfwGetTime(), window, button, action, mods, 0.0, 0.0 };
+    push_input_event(&event);
+}
+
+static void cursor_callback(GLFWwindow* window, double x, double y) {
+    input_event_t event = { INPUT_MOUSE_MOVE, glfwGetTime(), window, 0, 0, 0, x, y };
+    push_input_event(&event);
+}
+
+static void scroll_callback(GLFWwindow* window, double x, double y) {
+    input_event_t event = { INPUT_SCROLL, glfwGetTime(), window, 0, 0, 0, x, y };
+    push_input_event(&event);
+}
+
+void attach_input(GLFWwindow* window) {
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetCursorPosCallback(window, cursor_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+}
+
+void poll_input() {
+    glfwPollEvents();
+}
+
+void set_input_poll_rate(double hz) {
+    set_render_wait_hook(hz > 0.0 ? poll_input : NULL, hz > 0.0 ? 1000.0 / hz : 0.0);
+    TRACE("Polling input at %.0f hz while waiting on render threads.", hz);
+}
+
+const input_state_t* get_input() {
+    return GET_RESOURCE(input_state_t);
+}
+
+int is_key_down(int32_t key) {
+    return key >= 0 && key < INPUT_KEY_COUNT && GET_RESOURCE(input_state_t)->keys[key];
+}
+
+int was_key_pressed(int32_t key) {
+    return key >= 0 && key < INPUT_KEY_COUNT && GET_RESOURCE(input_state_t)->keys_pressed[key];
+}
+
+static void apply_event(input_state_t* state, const input_event_t* event) {
+    switch (event->type) {
+    case INPUT_KEY:
+        if (event->code >= 0 && event->code < INPUT_KEY_COUNT) {
+            state->keys[event->code] = event->action != GLFW_RELEASE;
+            state->keys_pressed[event->code] |= event->action == GLFW_PRESS;
+        }
+        break;
+    case INPUT_MOUSE_BUTTON:
+        if (event->code >= 0 && event->code < INPUT_BUTTON_COUNT) {
+            state->buttons[event->code] = event->action != GLFW_RELEASE;
+            state->buttons_pressed[event->code] |= event->action == GLFW_PRESS;
+        }
+        break;
+    case INPUT_MOUSE_MOVE:
+        state->cursor_x = event->x;
+        state->cursor_y = event->y;
+        break;
+    case INPUT_SCROLL:
+        state->scroll_x += event->x;
+        state->scroll_y += event->y;
+        break;
+    case INPUT_RESIZE:
+        break;
+    }
+}
+
+void update_input() {
+    uint32_t tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring_head, memory_order_acquire);
+    uint32_t count = head - tail;
+
+    if (count > frame_capacity) {
+        frame_capacity = count > INPUT_RING_SIZE ? count : INPUT_RING_SIZE;
+        frame_events = realloc(frame_events, frame_capacity * sizeof(input_event_t));
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        frame_events[i] = ring[(tail + i) & (INPUT_RING_SIZE - 1)];
+    }
+    // the slots can be reused once copied out
+    atomic_store_explicit(&ring_tail, head, memory_order_release);
+
+    input_state_t* state = GET_RESOURCE(input_state_t);
+    memset(state->keys_pressed, 0, sizeof(state->keys_pressed));
+    memset(state->buttons_pressed, 0, sizeof(state->buttons_pressed));
+    state->scroll_x = state->scroll_y = 0.0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        apply_event(state, &frame_events[i]);
+    }
+
+    state->events = frame_events;
+    state->event_count = count;
+    state->dropped = atomic_load_explicit(&dropped, memory_order_relaxed);
+}
+
+// systems from UPDATE on see the new state, PRE_UPDATE ones when they declare READS_RESOURCE
+REGISTER_SYSTEM(update_input, PRE_UPDATE);
+WRITES_RESOURCE(update_input, input_state_t);
+
+void cleanup_input() {
+    free(frame_events);
+    frame_events = NULL;
+    frame_capacity = 0;
+    memset(GET_RESOURCE(input_state_t), 0, sizeof(input_state_t));
+}
+
+REGISTER_SYSTEM(cleanup_input, CLEANUP);
@@ -0,0 +1,72 @@
+#ifndef OVERTURE_INPUT
+#define OVERTURE_INPUT
+
+#include <stdint.h>
+#include <GLFW/glfw3.h>
+
+/*
+ * Input. GLFW callbacks become timestamped events in a lock free single producer, single
+ * consumer ring: the main thread polls and produces, update_input() in PRE_UPDATE consumes and
+ * builds the input state, a resource. Systems from UPDATE on read get_input() for what is held
+ * down and for every event since the last update, so presses shorter than a frame aren't lost.
+ *
+ * glfw only allows polling on the main thread, so there is no separate input thread. The main
+ * thread polls at the start of every frame and again before rendering, and with
+ * set_input_poll_rate() also while it waits on render threads, which samples input faster than
+ * the frame rate on frames that are gpu or vsync bound. Events keep the time they were polled at.
+ */
+
+#define INPUT_RING_SIZE 1024 // power of two
+#define INPUT_KEY_COUNT (GLFW_KEY_LAST + 1)
+#define INPUT_BUTTON_COUNT (GLFW_MOUSE_BUTTON_LAST + 1)
+
+typedef enum {
+    INPUT_KEY,
+    INPUT_MOUSE_BUTTON,
+    INPUT_MOUSE_MOVE,
+    INPUT_SCROLL,
+    INPUT_RESIZE,
+} input_event_type_t;
+
+typedef struct {
+    input_event_type_t type;
+    double time; // glfwGetTime() when polled
+    GLFWwindow* window;
+    int32_t code; // key or mouse button
+    int32_t action; // GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT
+    int32_t mods;
+    double x; // cursor position, scroll offset or framebuffer size
+    double y;
+} input_event_t;
+
+typedef struct {
+    uint8_t keys[INPUT_KEY_COUNT]; // held down
+    uint8_t keys_pressed[INPUT_KEY_COUNT]; // went down since the last update
+    uint8_t buttons[INPUT_BUTTON_COUNT];
+    uint8_t buttons_pressed[INPUT_BUTTON_COUNT];
+    double cursor_x;
+    double cursor_y;
+    double scroll_x; // summed since the last update
+    double scroll_y;
+    const input_event_t* events; // since the last update, oldest first
+    uint32_t event_count;
+    uint64_t dropped; // events lost to a full ring, in total
+} input_state_t;
+
+// sets the window's key, button, cursor and scroll callbacks
+void attach_input(GLFWwindow* window);
+// main thread only
+void poll_input();
+// extra polls while the main thread waits on render threads, 0 turns them off
+void set_input_poll_rate(double hz);
+
+// producer side, the main thread or whatever replaces glfw as the only producer, 0 when full
+int push_input_event(const input_event_t* event);
+
+const input_state_t* get_input();
+int is_key_down(int32_t key);
+int was_key_pressed(int32_t key);
+
+void update_input();
+
+#endif
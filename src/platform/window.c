@@ -1,8 +1,10 @@
 #include "graphics/opengl.h"
+#include "graphics/render_thread.h"
 #include <GLFW/glfw3.h>
 #include <stdint.h>
 
 #include "platform/window.h"
+#include "platform/input.h"
 #include "core/log.h"
 #include "core/ecs.h"
 #include "core/systems.h"
@@ -11,16 +13,100 @@ static void error_callback(int error, const char* description) {
     ERROR("GLFW error %d: %s.", error, description);
 }
 
-static void framebuffer_size_callback(GLFWwindow* window, int32_t width, int32_t height) {
-    TRACE("Window: %p resized to %dx%d.", window, width, height);
+static void resize_window(void* data) {
+    window_t* window = data;
+    resize_gl_viewport(window->width, window->height);
+}
+
+static void begin_window(void* data) {
+    (void)data;
+    begin_gl_window_render();
+}
 
-    glfwMakeContextCurrent(window);
+struct swap_fences_t {
+    GLsync draws[PACER_MAX_QUEUED]; // signal when the frame's draws are done
+    GLsync presents[PACER_MAX_QUEUED]; // signal once the swap went through
+    uint32_t head;
+    uint32_t count;
+};
+
+static void apply_swap_interval(void* data) {
+    window_t* window = data;
+    int32_t interval = window->swap_interval;
+    if (interval < 0 && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+        WARN("Adaptive vsync isn't supported, using vsync.");
+        interval = 1;
+    }
+    glfwSwapInterval(interval);
+}
 
-    resize_gl_viewport(width, height);
+static double wait_fence(window_t* window, GLsync fence) {
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+        WARN("Waiting on swap fence.");
+    }
+    glDeleteSync(fence);
+    return window->pacer.clock();
+}
+
+static void swap_window(void* data) {
+    window_t* window = data;
+    struct swap_fences_t* fences = window->fences;
+
+    uint32_t slot = (fences->head + fences->count) % PACER_MAX_QUEUED;
+    fences->draws[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glfwSwapBuffers(window->window);
+    fences->presents[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    fences->count++;
+
+    // keeps the frames in front of the display down, the pacer learns the present times from it
+    while (fences->count >= window->max_queued_frames) {
+        double draws_done = wait_fence(window, fences->draws[fences->head]);
+        double present = wait_fence(window, fences->presents[fences->head]);
+        present_paced_frame(&window->pacer, draws_done, present);
+
+        fences->head = (fences->head + 1) % PACER_MAX_QUEUED;
+        fences->count--;
+    }
+}
+
+static void release_fences(void* data) {
+    window_t* window = data;
+    struct swap_fences_t* fences = window->fences;
+
+    for (uint32_t i = 0; i < fences->count; i++) {
+        uint32_t slot = (fences->head + i) % PACER_MAX_QUEUED;
+        glDeleteSync(fences->draws[slot]);
+        glDeleteSync(fences->presents[slot]);
+    }
+    fences->count = 0;
+}
+
+static void framebuffer_size_callback(GLFWwindow* glfw_window, int32_t width, int32_t height) {
+    TRACE("Window: %p resized to %dx%d.", glfw_window, width, height);
+
+    input_event_t event = { INPUT_RESIZE, glfwGetTime(), glfw_window, 0, 0, 0, width, height };
+    push_input_event(&event);
+
+    window_t* window = glfwGetWindowUserPointer(glfw_window);
+    if (window == NULL) {
+        make_context_current(glfw_window);
+        resize_gl_viewport(width, height);
+        return;
+    }
+
+    window->width = width;
+    window->height = height;
+    if (window->render_thread != NULL) {
+        post_render_command(window->render_thread, resize_window, window);
+    } else {
+        make_context_current(glfw_window);
+        resize_window(window);
+    }
 }
 
 void init_windowing() {
     glfwSetErrorCallback(error_callback);
+    set_render_main_thread(pthread_self());
 
     if (!glfwInit()) {
         FATAL("Failed to initialize glfw.");
@@ -37,29 +123,74 @@ void cleanup_windowing() {
 
 REGISTER_COMPONENT(window_t);
 
-// TODO: free window memory once window is closed
 window_t* create_window() {
-    window_t* window = malloc(sizeof(window_t));
+    return create_window_with(DEFAULT_WINDOW_CONFIG);
+}
+
+// TODO: free window memory once window is closed
+window_t* create_window_with(window_config_t config) {
+    window_t* window = calloc(1, sizeof(window_t));
+    window->fences = calloc(1, sizeof(struct swap_fences_t));
+    window->swap_interval = config.swap_interval;
+    window->max_queued_frames = config.max_queued_frames;
+    if (window->max_queued_frames < 1 || window->max_queued_frames > PACER_MAX_QUEUED) {
+        window->max_queued_frames = window->max_queued_frames < 1 ? 1 : PACER_MAX_QUEUED;
+        WARN("Can't queue %d frames, queueing %d.", config.max_queued_frames, window->max_queued_frames);
+    }
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    window->window = glfwCreateWindow(680, 480, "TEST GAME", NULL, NULL);
+    window->window = glfwCreateWindow(config.width, config.height, config.title, NULL, NULL);
     if (!window->window) {
         FATAL("Could not create window.");
     }
 
     TRACE("Created new window.");
 
+    int32_t width = config.width, height = config.height;
+    glfwGetFramebufferSize(window->window, &width, &height);
+    window->width = width;
+    window->height = height;
+    init_frame_pacer(&window->pacer, NULL, NULL, config.pacing);
+    // the window could be on another monitor, the pacer still lands on a vblank, just not the earliest
+    const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    if (mode != NULL && mode->refreshRate > 0) {
+        window->pacer.refresh = 1.0 / mode->refreshRate;
+    }
+    begin_paced_frame(&window->pacer);
+
+    glfwSetWindowUserPointer(window->window, window);
     glfwSetFramebufferSizeCallback(window->window, framebuffer_size_callback);
+    attach_input(window->window);
 
-    glfwMakeContextCurrent(window->window);
+    make_context_current(window->window);
     setup_gl_window();
+    apply_swap_interval(window);
+
+#if WINDOW_RENDER_THREADS
+    // the context stays current here until the first frame posts to the thread, setup can still use it
+    window->render_thread = start_render_thread(window->window);
+#endif
 
     return window;
 }
 
+void set_window_swap_interval(window_t* window, int32_t swap_interval) {
+    window->swap_interval = swap_interval;
+    if (window->render_thread != NULL) {
+        post_render_command(window->render_thread, apply_swap_interval, window);
+    } else {
+        make_context_current(window->window);
+        apply_swap_interval(window);
+    }
+}
+
+frame_timings_t get_window_frame_timings(window_t* window) {
+    return get_frame_timings(&window->pacer);
+}
+
 uint32_t should_window_close(window_t* window) {
     return glfwWindowShouldClose(window->window);
 }
@@ -71,6 +202,21 @@ void cleanup_windows() {
     while (*ent_ptr != NULL) {
         window_t* window = get_comp(*ent_ptr, GET_ID(window_t));
 
+        frame_timings_t timings = get_window_frame_timings(window);
+        INFO("Window %p: %lu frames, %.2f ms present to present (%.2f to %.2f, deviation %.2f), %.2f ms latency.", window->window,
+             timings.frames, timings.average * 1e3, timings.min * 1e3, timings.max * 1e3, timings.deviation * 1e3, timings.latency * 1e3);
+
+        if (window->render_thread != NULL) {
+            post_render_command(window->render_thread, release_fences, window);
+        } else {
+            make_context_current(window->window);
+            release_fences(window);
+        }
+        stop_render_thread(window->render_thread);
+        window->render_thread = NULL;
+        destroy_frame_pacer(&window->pacer);
+        free(window->fences);
+        forget_context(window->window);
         glfwDestroyWindow(window->window);
         
         ent_ptr++;
@@ -83,7 +229,8 @@ void cleanup_windows() {
 REGISTER_SYSTEM(cleanup_windows, CLEANUP);
 
 void start_window_render() {
-    glfwPollEvents();
+    // a second poll per frame, the events are read on the next update
+    poll_input();
 
     entity_t** list = FILTER_ENTITIES(window_t);
 
@@ -91,11 +238,14 @@ void start_window_render() {
     while (*ent_ptr != NULL) {
         window_t* window = get_comp(*ent_ptr, GET_ID(window_t));
 
-        glfwMakeContextCurrent(window->window);
-
         // TODO: pass window information such as clear color
 
-        begin_gl_window_render();
+        if (window->render_thread != NULL) {
+            post_render_command(window->render_thread, begin_window, NULL);
+        } else {
+            make_context_current(window->window);
+            begin_window(NULL);
+        }
 
         ent_ptr++;
     }
@@ -108,17 +258,33 @@ REGISTER_SYSTEM(start_window_render, PRE_RENDER);
 void display_to_windows() {
     entity_t** list = FILTER_ENTITIES(window_t);
 
+    uint32_t count = 0;
+    while (list[count] != NULL) {
+        count++;
+    }
+    frame_pacer_t** pacers = malloc(count * sizeof(frame_pacer_t*));
+
     entity_t** ent_ptr = list;
     while (*ent_ptr != NULL) {
         window_t* window = get_comp(*ent_ptr, GET_ID(window_t));
+        pacers[ent_ptr - list] = &window->pacer;
+        submit_paced_frame(&window->pacer);
 
-        glfwMakeContextCurrent(window->window); // TODO: might not be needed here but during rendering idk
-
-        glfwSwapBuffers(window->window);
+        // not waited on, the next frame's commands queue up behind the swap
+        if (window->render_thread != NULL) {
+            post_render_command(window->render_thread, swap_window, window);
+        } else {
+            make_context_current(window->window);
+            swap_window(window);
+        }
 
         ent_ptr++;
     }
 
+    // the next frame starts here, as late as the windows allow
+    pace_frames(pacers, count);
+
+    free(pacers);
     free(list);
 }
 
@@ -4,16 +4,50 @@
 #include <stdint.h>
 #include <GLFW/glfw3.h>
 
+#include "platform/frame_pacer.h"
+
 // rename or smt
 void init_windowing();
 void cleanup_windowing();
 
+/*
+ * With WINDOW_RENDER_THREADS every window's context is owned by a render thread of its own (see
+ * graphics/render_thread.h), clearing, drawing and swapping happen there and windows swap in
+ * parallel. Define it to 0 to render everything from the main thread.
+ */
+#ifndef WINDOW_RENDER_THREADS
+#define WINDOW_RENDER_THREADS 1
+#endif
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    const char* title;
+    int32_t swap_interval; // 0 off, 1 vsync, -1 adaptive: late frames tear instead of waiting a vblank
+    uint32_t max_queued_frames; // frames from swap to present, the swap waits for the oldest one, 1 is the lowest latency
+    int pacing; // delays frame starts, see platform/frame_pacer.h
+} window_config_t;
+
+#define DEFAULT_WINDOW_CONFIG ((window_config_t){ 680, 480, "TEST GAME", 1, 1, 1 })
+
 // TODO: window id or smt
 typedef struct {
     GLFWwindow* window;
+    struct render_thread_t* render_thread; // NULL without render threads
+    uint32_t width; // framebuffer size, applied on the render thread
+    uint32_t height;
+    int32_t swap_interval;
+    uint32_t max_queued_frames;
+    frame_pacer_t pacer;
+    struct swap_fences_t* fences; // used where the window swaps
 } window_t;
 
 window_t* create_window();
+window_t* create_window_with(window_config_t config);
+
+// applied before the next swap
+void set_window_swap_interval(window_t* window, int32_t swap_interval);
+frame_timings_t get_window_frame_timings(window_t* window);
 
 uint32_t should_window_close(window_t* window);
 
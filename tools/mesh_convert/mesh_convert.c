@@ -0,0 +1,262 @@
+#include "core/log.h"
+#include "graphics/mesh_file.h"
+#include "graphics/mesh_optimize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// converts a wavefront obj to the binary mesh format, usage: mesh_convert in.obj out.mesh
+
+typedef struct {
+    float* data;
+    uint32_t count;
+    uint32_t capacity;
+} float_list_t;
+
+typedef struct {
+    float position[3];
+    float normal[3];
+    float uv[2];
+} vertex_t;
+
+// v/vt/vn triple -> output vertex
+typedef struct {
+    int32_t key[3];
+    uint32_t vertex;
+} vertex_slot_t;
+
+typedef struct {
+    float_list_t positions;
+    float_list_t normals;
+    float_list_t uvs;
+
+    vertex_t* vertices;
+    uint32_t vertex_count;
+    uint32_t vertex_capacity;
+
+    uint32_t* indices;
+    uint32_t index_count;
+    uint32_t index_capacity;
+
+    vertex_slot_t* slots;
+    uint32_t slot_capacity;
+} obj_t;
+
+static void push_floats(float_list_t* list, const float* values, uint32_t count) {
+    if (list->count + count > list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 1024;
+        list->data = realloc(list->data, list->capacity * sizeof(float));
+    }
+    memcpy(list->data + list->count, values, count * sizeof(float));
+    list->count += count;
+}
+
+static void push_index(obj_t* obj, uint32_t index) {
+    if (obj->index_count == obj->index_capacity) {
+        obj->index_capacity = obj->index_capacity ? obj->index_capacity * 2 : 1024;
+        obj->indices = realloc(obj->indices, obj->index_capacity * sizeof(uint32_t));
+    }
+    obj->indices[obj->index_count++] = index;
+}
+
+static uint32_t hash_key(const int32_t key[3]) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 3; i++) {
+        h = (h ^ (uint32_t)key[i]) * 16777619u;
+    }
+    return h;
+}
+
+static void grow_slots(obj_t* obj);
+
+static uint32_t find_vertex(obj_t* obj, const int32_t key[3]) {
+    if (obj->vertex_count * 2 >= obj->slot_capacity) {
+        grow_slots(obj);
+    }
+
+    uint32_t mask = obj->slot_capacity - 1;
+    uint32_t slot = hash_key(key) & mask;
+    while (obj->slots[slot].vertex != UINT32_MAX) {
+        if (memcmp(obj->slots[slot].key, key, sizeof(int32_t) * 3) == 0) {
+            return obj->slots[slot].vertex;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if (obj->vertex_count == obj->vertex_capacity) {
+        obj->vertex_capacity = obj->vertex_capacity ? obj->vertex_capacity * 2 : 1024;
+        obj->vertices = realloc(obj->vertices, obj->vertex_capacity * sizeof(vertex_t));
+    }
+
+    vertex_t* vertex = &obj->vertices[obj->vertex_count];
+    memset(vertex, 0, sizeof(vertex_t));
+    memcpy(vertex->position, &obj->positions.data[key[0] * 3], sizeof(float) * 3);
+    if (key[1] >= 0) {
+        memcpy(vertex->uv, &obj->uvs.data[key[1] * 2], sizeof(float) * 2);
+    }
+    if (key[2] >= 0) {
+        memcpy(vertex->normal, &obj->normals.data[key[2] * 3], sizeof(float) * 3);
+    }
+
+    memcpy(obj->slots[slot].key, key, sizeof(int32_t) * 3);
+    obj->slots[slot].vertex = obj->vertex_count;
+    return obj->vertex_count++;
+}
+
+static void grow_slots(obj_t* obj) {
+    vertex_slot_t* old = obj->slots;
+    uint32_t old_capacity = obj->slot_capacity;
+
+    obj->slot_capacity = old_capacity ? old_capacity * 2 : 4096;
+    obj->slots = malloc(obj->slot_capacity * sizeof(vertex_slot_t));
+    for (uint32_t i = 0; i < obj->slot_capacity; i++) {
+        obj->slots[i].vertex = UINT32_MAX;
+    }
+
+    uint32_t mask = obj->slot_capacity - 1;
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (old[i].vertex == UINT32_MAX) {
+            continue;
+        }
+        uint32_t slot = hash_key(old[i].key) & mask;
+        while (obj->slots[slot].vertex != UINT32_MAX) {
+            slot = (slot + 1) & mask;
+        }
+        obj->slots[slot] = old[i];
+    }
+    free(old);
+}
+
+// obj indices are 1 based and negative ones count back from the end, returns -1 when missing
+static int32_t resolve_index(const char* text, uint32_t count) {
+    if (*text == '\0' || *text == '/') {
+        return -1;
+    }
+    long index = strtol(text, NULL, 10);
+    index = index < 0 ? (long)count + index : index - 1;
+    return index >= 0 && index < (long)count ? (int32_t)index : -1;
+}
+
+static int parse_corner(obj_t* obj, char* token, int32_t key[3]) {
+    char* uv = strchr(token, '/');
+    char* normal = uv ? strchr(uv + 1, '/') : NULL;
+
+    key[0] = resolve_index(token, obj->positions.count / 3);
+    key[1] = uv ? resolve_index(uv + 1, obj->uvs.count / 2) : -1;
+    key[2] = normal ? resolve_index(normal + 1, obj->normals.count / 3) : -1;
+    return key[0] >= 0;
+}
+
+static int load_obj(const char* path, obj_t* obj) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        ERROR("Failed to open %s.", path);
+        return 0;
+    }
+
+    char line[4096];
+    uint32_t line_number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        float values[3] = {0};
+
+        if (strncmp(line, "v ", 2) == 0) {
+            sscanf(line + 2, "%f %f %f", &values[0], &values[1], &values[2]);
+            push_floats(&obj->positions, values, 3);
+        } else if (strncmp(line, "vn ", 3) == 0) {
+            sscanf(line + 3, "%f %f %f", &values[0], &values[1], &values[2]);
+            push_floats(&obj->normals, values, 3);
+        } else if (strncmp(line, "vt ", 3) == 0) {
+            sscanf(line + 3, "%f %f", &values[0], &values[1]);
+            push_floats(&obj->uvs, values, 2);
+        } else if (strncmp(line, "f ", 2) == 0) {
+            // polygons are triangulated as fans
+            uint32_t first = 0, previous = 0, corners = 0;
+            char* save = NULL;
+            for (char* token = strtok_r(line + 2, " \t\r\n", &save); token; token = strtok_r(NULL, " \t\r\n", &save)) {
+                int32_t key[3];
+                if (!parse_corner(obj, token, key)) {
+                    WARN("Skipping bad face corner on line %d of %s.", line_number, path);
+                    continue;
+                }
+
+                uint32_t vertex = find_vertex(obj, key);
+                if (corners == 0) {
+                    first = vertex;
+                } else if (corners >= 2) {
+                    push_index(obj, first);
+                    push_index(obj, previous);
+                    push_index(obj, vertex);
+                }
+                previous = vertex;
+                corners++;
+            }
+        }
+    }
+
+    fclose(file);
+    return 1;
+}
+
+static void free_obj(obj_t* obj) {
+    free(obj->positions.data);
+    free(obj->normals.data);
+    free(obj->uvs.data);
+    free(obj->vertices);
+    free(obj->indices);
+    free(obj->slots);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s in.obj out.mesh\n", argv[0]);
+        return 1;
+    }
+
+    obj_t obj = {0};
+    if (!load_obj(argv[1], &obj) || obj.index_count == 0) {
+        ERROR("No triangles in %s.", argv[1]);
+        free_obj(&obj);
+        return 1;
+    }
+
+    uint32_t triangle_count = obj.index_count / 3;
+    uint32_t* optimized = malloc(obj.index_count * sizeof(uint32_t));
+    uint32_t* clusters = malloc(triangle_count * sizeof(uint32_t));
+
+    float acmr_before = analyze_vertex_cache(obj.indices, obj.index_count, VERTEX_CACHE_SIZE);
+    uint32_t cluster_count = optimize_vertex_cache(optimized, obj.indices, obj.index_count, obj.vertex_count, VERTEX_CACHE_SIZE, clusters);
+    optimize_overdraw(optimized, obj.index_count, obj.vertices, sizeof(vertex_t), obj.vertex_count, clusters, cluster_count,
+                      VERTEX_CACHE_SIZE, OVERDRAW_THRESHOLD);
+    float acmr_after = analyze_vertex_cache(optimized, obj.index_count, VERTEX_CACHE_SIZE);
+    uint32_t vertex_count = optimize_vertex_fetch(obj.vertices, sizeof(vertex_t), obj.vertex_count, optimized, obj.index_count);
+
+    // split back into the planar arrays save_mesh_file takes
+    float* positions = malloc(vertex_count * sizeof(float) * 3);
+    float* normals = obj.normals.count ? malloc(vertex_count * sizeof(float) * 3) : NULL;
+    float* uvs = obj.uvs.count ? malloc(vertex_count * sizeof(float) * 2) : NULL;
+    for (uint32_t i = 0; i < vertex_count; i++) {
+        memcpy(&positions[i * 3], obj.vertices[i].position, sizeof(float) * 3);
+        if (normals) {
+            memcpy(&normals[i * 3], obj.vertices[i].normal, sizeof(float) * 3);
+        }
+        if (uvs) {
+            memcpy(&uvs[i * 2], obj.vertices[i].uv, sizeof(float) * 2);
+        }
+    }
+
+    int ok = save_mesh_file(argv[2], positions, normals, uvs, vertex_count, optimized, obj.index_count);
+    if (ok) {
+        INFO("%s: %d vertices, %d triangles, %d clusters, acmr %.3f -> %.3f.", argv[2], vertex_count, triangle_count,
+             cluster_count, acmr_before, acmr_after);
+    }
+
+    free(positions);
+    free(normals);
+    free(uvs);
+    free(optimized);
+    free(clusters);
+    free_obj(&obj);
+    return ok ? 0 : 1;
+}
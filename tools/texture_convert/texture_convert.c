@@ -0,0 +1,86 @@
+#include "core/log.h"
+#include "graphics/bcn.h"
+#include "graphics/image.h"
+#include "graphics/texture_file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// block compresses an image with its mip chain, usage: texture_convert [-bc1|-bc3|-bc5|-bc7] [-srgb] [-nomips] in.tga out.tex
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [-bc1|-bc3|-bc5|-bc7] [-srgb] [-nomips] in out.tex\n", name);
+}
+
+int main(int argc, char** argv) {
+    bc_format_t format = BC7_RGBA;
+    int srgb = 0, mips = 1;
+    const char* paths[2] = {0};
+    uint32_t path_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-bc1") == 0) {
+            format = BC1_RGB;
+        } else if (strcmp(argv[i], "-bc3") == 0) {
+            format = BC3_RGBA;
+        } else if (strcmp(argv[i], "-bc5") == 0) {
+            format = BC5_RG;
+        } else if (strcmp(argv[i], "-bc7") == 0) {
+            format = BC7_RGBA;
+        } else if (strcmp(argv[i], "-srgb") == 0) {
+            srgb = 1;
+        } else if (strcmp(argv[i], "-nomips") == 0) {
+            mips = 0;
+        } else if (argv[i][0] != '-' && path_count < 2) {
+            paths[path_count++] = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (path_count != 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    image_t image;
+    if (!load_image(paths[0], &image)) {
+        return 1;
+    }
+
+    uint32_t levels = mips ? get_mip_count(image.width, image.height) : 1;
+    levels = levels < MAX_TEXTURE_FILE_LEVELS ? levels : MAX_TEXTURE_FILE_LEVELS;
+    uint8_t* level_data[MAX_TEXTURE_FILE_LEVELS];
+    size_t compressed = 0, uncompressed = 0;
+    uint32_t width = image.width, height = image.height;
+
+    // every level is filtered from the uncompressed one above it, srgb ones in linear light
+    for (uint32_t level = 0; level < levels; level++) {
+        size_t size = get_bc_level_size(format, image.width, image.height);
+        level_data[level] = malloc(size);
+        encode_bc_image(format, &image, level_data[level]);
+        compressed += size;
+        uncompressed += (size_t)image.width * image.height * 4;
+
+        if (level + 1 < levels) {
+            image_t next = { .pixels = malloc((size_t)image.width * image.height * image.channels) };
+            downsample_image(&image, &next, srgb);
+            free_image(&image);
+            image = next;
+        }
+    }
+    free_image(&image);
+
+    int ok = save_texture_file(paths[1], format, srgb ? TEXTURE_FILE_SRGB : 0, width, height, levels, (const uint8_t* const*)level_data);
+    if (ok) {
+        INFO("%s: %dx%d, %d levels, %d kb (%.1fx smaller than rgba8).", paths[1], width, height, levels, (int)(compressed >> 10),
+             (double)uncompressed / compressed);
+    }
+
+    for (uint32_t level = 0; level < levels; level++) {
+        free(level_data[level]);
+    }
+    return ok ? 0 : 1;
+}